@@ -0,0 +1,170 @@
+#ifndef _ATOMICS_H_
+#define _ATOMICS_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+// Atomic operations on 64-bit words
+// Compiler intrinsics are used, all operations are sequentially consistent, except the acquire and release ones.
+// With MSVC the operations are built on _InterlockedCompareExchange64, it is available on 32-bit x86 too.
+
+/*
+ * Returns the value of the word
+ */
+static inline uint64_t atomics_load_64(volatile uint64_t* word_ptr)
+{
+#if defined(_MSC_VER)
+    return (uint64_t)_InterlockedCompareExchange64((volatile __int64*)word_ptr, 0, 0);
+#else
+    return __atomic_load_n(word_ptr, __ATOMIC_SEQ_CST);
+#endif
+}
+
+/*
+ * Sets the value of the word
+ */
+static inline void atomics_store_64(volatile uint64_t* word_ptr, uint64_t value)
+{
+#if defined(_MSC_VER)
+    uint64_t old_value = atomics_load_64(word_ptr);
+    uint64_t current_value;
+    while ((current_value = (uint64_t)_InterlockedCompareExchange64((volatile __int64*)word_ptr, (__int64)value, (__int64)old_value)) != old_value) {
+        old_value = current_value;
+    }
+#else
+    __atomic_store_n(word_ptr, value, __ATOMIC_SEQ_CST);
+#endif
+}
+
+/*
+ * Sets the bits of the value in the word, returns the previous value of the word
+ */
+static inline uint64_t atomics_fetch_or_64(volatile uint64_t* word_ptr, uint64_t value)
+{
+#if defined(_MSC_VER)
+    uint64_t old_value = atomics_load_64(word_ptr);
+    uint64_t current_value;
+    while ((current_value = (uint64_t)_InterlockedCompareExchange64((volatile __int64*)word_ptr, (__int64)(old_value | value), (__int64)old_value)) != old_value) {
+        old_value = current_value;
+    }
+    return old_value;
+#else
+    return __atomic_fetch_or(word_ptr, value, __ATOMIC_SEQ_CST);
+#endif
+}
+
+/*
+ * Clears the bits of the word which are cleared in the value, returns the previous value of the word
+ */
+static inline uint64_t atomics_fetch_and_64(volatile uint64_t* word_ptr, uint64_t value)
+{
+#if defined(_MSC_VER)
+    uint64_t old_value = atomics_load_64(word_ptr);
+    uint64_t current_value;
+    while ((current_value = (uint64_t)_InterlockedCompareExchange64((volatile __int64*)word_ptr, (__int64)(old_value & value), (__int64)old_value)) != old_value) {
+        old_value = current_value;
+    }
+    return old_value;
+#else
+    return __atomic_fetch_and(word_ptr, value, __ATOMIC_SEQ_CST);
+#endif
+}
+
+/*
+ * Sets the value of the word, returns the previous value of the word
+ */
+static inline uint64_t atomics_exchange_64(volatile uint64_t* word_ptr, uint64_t value)
+{
+#if defined(_MSC_VER)
+    uint64_t old_value = atomics_load_64(word_ptr);
+    uint64_t current_value;
+    while ((current_value = (uint64_t)_InterlockedCompareExchange64((volatile __int64*)word_ptr, (__int64)value, (__int64)old_value)) != old_value) {
+        old_value = current_value;
+    }
+    return old_value;
+#else
+    return __atomic_exchange_n(word_ptr, value, __ATOMIC_SEQ_CST);
+#endif
+}
+
+/*
+ * Returns the value of the word, the following memory operations are not moved before it
+ * The word must be aligned, only one thread writes it (by atomics_store_release_64)
+ */
+static inline uint64_t atomics_load_acquire_64(volatile uint64_t* word_ptr)
+{
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_ARM64))
+    uint64_t value = *word_ptr;
+#if defined(_M_ARM64)
+    __dmb(_ARM64_BARRIER_ISH);
+#else
+    _ReadWriteBarrier();
+#endif
+    return value;
+#elif defined(_MSC_VER)
+    return atomics_load_64(word_ptr);
+#else
+    return __atomic_load_n(word_ptr, __ATOMIC_ACQUIRE);
+#endif
+}
+
+/*
+ * Sets the value of the word, the previous memory operations are not moved after it
+ * The word must be aligned, only one thread writes it
+ * Unlike atomics_store_64 it is a plain store on x86, it is used on hot paths.
+ */
+static inline void atomics_store_release_64(volatile uint64_t* word_ptr, uint64_t value)
+{
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_ARM64))
+#if defined(_M_ARM64)
+    __dmb(_ARM64_BARRIER_ISH);
+#else
+    _ReadWriteBarrier();
+#endif
+    *word_ptr = value;
+#elif defined(_MSC_VER)
+    atomics_store_64(word_ptr, value);
+#else
+    __atomic_store_n(word_ptr, value, __ATOMIC_RELEASE);
+#endif
+}
+
+/*
+ * Returns the value of the size_t word, the following memory operations are not moved before it
+ * The word must be aligned, it is written by atomics_store_release_size
+ */
+static inline size_t atomics_load_acquire_size(volatile size_t* word_ptr)
+{
+#if defined(_MSC_VER) && defined(_WIN64)
+    return (size_t)atomics_load_acquire_64((volatile uint64_t*)word_ptr);
+#elif defined(_MSC_VER)
+    // Aligned 32-bit loads are atomic on x86, and x86 doesn't move loads before loads
+    size_t value = *word_ptr;
+    _ReadWriteBarrier();
+    return value;
+#else
+    return __atomic_load_n(word_ptr, __ATOMIC_ACQUIRE);
+#endif
+}
+
+/*
+ * Sets the value of the size_t word, the previous memory operations are not moved after it
+ * The word must be aligned, only one thread writes it at a time
+ */
+static inline void atomics_store_release_size(volatile size_t* word_ptr, size_t value)
+{
+#if defined(_MSC_VER) && defined(_WIN64)
+    atomics_store_release_64((volatile uint64_t*)word_ptr, (uint64_t)value);
+#elif defined(_MSC_VER)
+    // Aligned 32-bit stores are atomic on x86, and x86 doesn't move stores after stores
+    _ReadWriteBarrier();
+    *word_ptr = value;
+#else
+    __atomic_store_n(word_ptr, value, __ATOMIC_RELEASE);
+#endif
+}
+
+#endif
@@ -0,0 +1,318 @@
+#include "buddy_allocator/buddy_allocator.h"
+#include "cycles/cycles.h"
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <time.h>
+
+/*
+ * Microbenchmarks of the core operations, the results are printed as CSV, so the runs can be compared.
+ *
+ * Usage:
+ * bench [--areas 1M,16M,256M,4G,64G] [--flags N]
+ *
+ * The areas are simulated, only the metadata is allocated, the area address is fake (BUDDY_ALLOCATOR_FLAG_IN_BLOCK_NODES is not allowed).
+ * The page size is 4 KB, the max order is 10 or less if the area is smaller than a large block.
+ * Benchmarks:
+ * fast_alloc, fast_free - allocation and free of a block of the order which is in the free list and whose buddy is allocated, no splits and no merges
+ * split_alloc - allocation of a page when only large blocks are free, max_order splits
+ * merge_free - free of that page, max_order merges
+ * churn - a random free and a random allocation of orders 0 - 3 with the occupancy kept at 50%, 90% or 99% of the area,
+ * the order of the allocation is lowered when the block doesn't fit under the occupancy
+ * The split and merge chains are timed one by one by the cycle counter, the cycles are converted to nanoseconds by the time of the whole run,
+ * the other benchmarks time whole batches.
+ */
+
+#define BENCH_PAGE_SIZE 4096
+#define BENCH_MAX_ORDER 10
+// Number of blocks in a batch of the fast path benchmarks
+#define BENCH_BATCH_SIZE 1024
+// Number of operations of each benchmark
+#define BENCH_OPERATIONS_NUMBER (1 << 20)
+// Maximum order of the churn allocations
+#define BENCH_CHURN_MAX_ORDER 3
+
+typedef struct {
+    buddy_allocator_t allocator;
+    void* required_memory;
+    size_t area_size;
+} bench_context_t;
+
+/*
+ * Returns current time in nanoseconds
+ */
+static uint64_t get_time_ns(void)
+{
+    struct timespec time;
+    timespec_get(&time, TIME_UTC);
+    return (uint64_t)time.tv_sec * 1000000000 + (uint64_t)time.tv_nsec;
+}
+
+/*
+ * xorshift64, the runs are the same for the same area
+ */
+static uint64_t get_random_64(uint64_t* state_ptr)
+{
+    uint64_t value = *state_ptr;
+    value ^= value << 13;
+    value ^= value >> 7;
+    value ^= value << 17;
+    *state_ptr = value;
+    return value;
+}
+
+static void print_row(const char* benchmark, const bench_context_t* context_ptr, int order, int occupancy_percent, uint64_t operations_number, double time_ns, uint64_t failures_number)
+{
+    printf("%s,%zu,%u,%u,%d,%d,%llu,%.2f,%llu\n", benchmark, context_ptr->area_size, BENCH_PAGE_SIZE, context_ptr->allocator.max_order, order, occupancy_percent,
+        (unsigned long long)operations_number, operations_number == 0 ? 0.0 : time_ns / (double)operations_number, (unsigned long long)failures_number);
+}
+
+static void fail(const char* message)
+{
+    fprintf(stderr, "%s\n", message);
+    exit(-1);
+}
+
+/*
+ * Prepares 2 * batch_size blocks of the order, every second one is freed, so each free block has an allocated buddy,
+ * then allocates and frees batch_size blocks repeatedly, they are taken from the free list and put back without splits and merges
+ */
+static void bench_fast_path(bench_context_t* context_ptr, uint8_t order, void** blocks)
+{
+    buddy_allocator_t* allocator_ptr = &context_ptr->allocator;
+    size_t block_size = (size_t)BENCH_PAGE_SIZE << order;
+    size_t batch_size = BENCH_BATCH_SIZE;
+    if (batch_size > allocator_ptr->area_size / block_size / 2) {
+        batch_size = allocator_ptr->area_size / block_size / 2;
+    }
+    if (batch_size == 0) {
+        return;
+    }
+    buddy_allocator_init(allocator_ptr, context_ptr->required_memory);
+    for (size_t i = 0; i < 2 * batch_size; ++i) {
+        blocks[i] = buddy_allocator_alloc(allocator_ptr, block_size);
+        if (blocks[i] == NULL) {
+            fail("Failed to prepare the fast path blocks");
+        }
+    }
+    for (size_t i = 0; i < batch_size; ++i) {
+        buddy_allocator_free(allocator_ptr, blocks[2 * i]);
+    }
+
+    uint64_t alloc_time = 0;
+    uint64_t free_time = 0;
+    uint64_t failures_number = 0;
+    size_t batches_number = BENCH_OPERATIONS_NUMBER / batch_size;
+    for (size_t batch = 0; batch < batches_number; ++batch) {
+        uint64_t start_time = get_time_ns();
+        for (size_t i = 0; i < batch_size; ++i) {
+            blocks[i] = buddy_allocator_alloc(allocator_ptr, block_size);
+        }
+        uint64_t middle_time = get_time_ns();
+        for (size_t i = 0; i < batch_size; ++i) {
+            failures_number += blocks[i] == NULL;
+            buddy_allocator_free(allocator_ptr, blocks[i]);
+        }
+        uint64_t end_time = get_time_ns();
+        alloc_time += middle_time - start_time;
+        free_time += end_time - middle_time;
+    }
+    print_row("fast_alloc", context_ptr, order, -1, batches_number * batch_size, (double)alloc_time, failures_number);
+    print_row("fast_free", context_ptr, order, -1, batches_number * batch_size, (double)free_time, 0);
+}
+
+/*
+ * Allocates a page from the fully free area and frees it, each allocation splits a large block down to order 0,
+ * each free merges it back
+ */
+static void bench_split_merge(bench_context_t* context_ptr)
+{
+    buddy_allocator_t* allocator_ptr = &context_ptr->allocator;
+    buddy_allocator_init(allocator_ptr, context_ptr->required_memory);
+    uint64_t alloc_cycles = 0;
+    uint64_t free_cycles = 0;
+    uint64_t failures_number = 0;
+    uint64_t start_time = get_time_ns();
+    uint64_t start_cycles = cycles_read();
+    for (size_t i = 0; i < BENCH_OPERATIONS_NUMBER; ++i) {
+        uint64_t alloc_start_cycles = cycles_read();
+        void* memory_ptr = buddy_allocator_alloc(allocator_ptr, BENCH_PAGE_SIZE);
+        uint64_t free_start_cycles = cycles_read();
+        buddy_allocator_free(allocator_ptr, memory_ptr);
+        uint64_t free_end_cycles = cycles_read();
+        alloc_cycles += free_start_cycles - alloc_start_cycles;
+        free_cycles += free_end_cycles - free_start_cycles;
+        failures_number += memory_ptr == NULL;
+    }
+    uint64_t total_cycles = cycles_read() - start_cycles;
+    uint64_t total_time = get_time_ns() - start_time;
+    double ns_per_cycle = total_cycles == 0 ? 0.0 : (double)total_time / (double)total_cycles;
+    print_row("split_alloc", context_ptr, 0, -1, BENCH_OPERATIONS_NUMBER, alloc_cycles * ns_per_cycle, failures_number);
+    print_row("merge_free", context_ptr, 0, -1, BENCH_OPERATIONS_NUMBER, free_cycles * ns_per_cycle, 0);
+}
+
+/*
+ * Fills the area with random blocks of orders 0 - BENCH_CHURN_MAX_ORDER up to the occupancy,
+ * then each step frees a random live block and allocates a random block
+ */
+static void bench_churn(bench_context_t* context_ptr, int occupancy_percent, void** live_blocks, uint8_t* live_blocks_orders)
+{
+    buddy_allocator_t* allocator_ptr = &context_ptr->allocator;
+    buddy_allocator_init(allocator_ptr, context_ptr->required_memory);
+    uint64_t random_state = 0x2545F4914F6CDD1D ^ context_ptr->area_size;
+    size_t occupied_size_max = (size_t)((double)allocator_ptr->area_size * occupancy_percent / 100.0);
+    size_t occupied_size = 0;
+    size_t live_blocks_number = 0;
+    while (true) {
+        uint8_t order = (uint8_t)(get_random_64(&random_state) % (BENCH_CHURN_MAX_ORDER + 1));
+        size_t block_size = (size_t)BENCH_PAGE_SIZE << order;
+        if (occupied_size + block_size > occupied_size_max) {
+            break;
+        }
+        void* memory_ptr = buddy_allocator_alloc(allocator_ptr, block_size);
+        if (memory_ptr == NULL) {
+            break;
+        }
+        live_blocks[live_blocks_number] = memory_ptr;
+        live_blocks_orders[live_blocks_number++] = order;
+        occupied_size += block_size;
+    }
+    if (live_blocks_number == 0) {
+        return;
+    }
+
+    uint64_t failures_number = 0;
+    // Operations which are actually done, the loop stops early if all blocks are dropped
+    uint64_t operations_number = 0;
+    uint64_t start_time = get_time_ns();
+    for (size_t i = 0; i < BENCH_OPERATIONS_NUMBER / 2; ++i) {
+        uint64_t random = get_random_64(&random_state);
+        size_t live_block_index = (size_t)((random >> 8) % live_blocks_number);
+        buddy_allocator_free(allocator_ptr, live_blocks[live_block_index]);
+        occupied_size -= (size_t)BENCH_PAGE_SIZE << live_blocks_orders[live_block_index];
+        // The largest order up to the random one which fits under the occupancy, the freed block always fits
+        uint8_t order = (uint8_t)(random % (BENCH_CHURN_MAX_ORDER + 1));
+        while (order > 0 && occupied_size + ((size_t)BENCH_PAGE_SIZE << order) > occupied_size_max) {
+            order--;
+        }
+        void* memory_ptr = buddy_allocator_alloc(allocator_ptr, (size_t)BENCH_PAGE_SIZE << order);
+        operations_number += 2;
+        if (memory_ptr == NULL) {
+            // The occupancy goes down a little, the slot is removed
+            failures_number++;
+            live_blocks[live_block_index] = live_blocks[--live_blocks_number];
+            live_blocks_orders[live_block_index] = live_blocks_orders[live_blocks_number];
+            if (live_blocks_number == 0) {
+                break;
+            }
+            continue;
+        }
+        live_blocks[live_block_index] = memory_ptr;
+        live_blocks_orders[live_block_index] = order;
+        occupied_size += (size_t)BENCH_PAGE_SIZE << order;
+    }
+    uint64_t total_time = get_time_ns() - start_time;
+    print_row("churn", context_ptr, -1, occupancy_percent, operations_number, (double)total_time, failures_number);
+}
+
+/*
+ * Parses the size with an optional K, M or G suffix
+ */
+static uint64_t parse_size(const char* string, char** end_ptr)
+{
+    uint64_t value = strtoull(string, end_ptr, 10);
+    switch (**end_ptr) {
+    case 'G':
+        value <<= 10;
+        // fall through
+    case 'M':
+        value <<= 10;
+        // fall through
+    case 'K':
+        value <<= 10;
+        (*end_ptr)++;
+        break;
+    default:
+        break;
+    }
+    return value;
+}
+
+static void run_area(size_t area_size, uint32_t flags)
+{
+    bench_context_t context;
+    memset(&context, 0, sizeof(context));
+    context.area_size = area_size;
+    uint8_t max_order = BENCH_MAX_ORDER;
+    while (max_order > 0 && ((size_t)BENCH_PAGE_SIZE << max_order) > area_size) {
+        max_order--;
+    }
+    size_t required_memory_size = 0;
+    buddy_allocator_preinit_ex(&context.allocator, 0x100000, area_size, max_order, BENCH_PAGE_SIZE, false, flags, &required_memory_size);
+    if (required_memory_size == 0) {
+        fprintf(stderr, "Failed to preinit the allocator for the area of %zu bytes\n", area_size);
+        return;
+    }
+    context.required_memory = malloc(required_memory_size);
+    size_t live_blocks_number_max = area_size / BENCH_PAGE_SIZE;
+    void** blocks = malloc((live_blocks_number_max > 2 * BENCH_BATCH_SIZE ? live_blocks_number_max : 2 * BENCH_BATCH_SIZE) * sizeof(void*));
+    uint8_t* blocks_orders = malloc(live_blocks_number_max * sizeof(uint8_t));
+    if (context.required_memory == NULL || blocks == NULL || blocks_orders == NULL) {
+        fail("Failed to allocate memory for the benchmark");
+    }
+    // Make the memory resident, so that page faults are not measured
+    memset(context.required_memory, 0xFF, required_memory_size);
+
+    for (uint8_t order = 0; order <= max_order; ++order) {
+        bench_fast_path(&context, order, blocks);
+    }
+    bench_split_merge(&context);
+    const int occupancies_percent[] = { 50, 90, 99 };
+    for (size_t i = 0; i < sizeof(occupancies_percent) / sizeof(int); ++i) {
+        bench_churn(&context, occupancies_percent[i], blocks, blocks_orders);
+    }
+
+    free(blocks_orders);
+    free(blocks);
+    free(context.required_memory);
+}
+
+int main(int argc, char* argv[])
+{
+    const char* areas = "1M,16M,256M,4G,64G";
+    uint32_t flags = 0;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        if (strcmp(argv[i], "--areas") == 0) {
+            areas = argv[i + 1];
+        }
+        else if (strcmp(argv[i], "--flags") == 0) {
+            flags = (uint32_t)strtoul(argv[i + 1], NULL, 0);
+        }
+        else {
+            fprintf(stderr, "Usage: bench [--areas 1M,16M,256M,4G,64G] [--flags N]\n");
+            return 1;
+        }
+    }
+    if (flags & BUDDY_ALLOCATOR_FLAG_IN_BLOCK_NODES) {
+        fprintf(stderr, "BUDDY_ALLOCATOR_FLAG_IN_BLOCK_NODES needs a real area\n");
+        return 1;
+    }
+
+    printf("benchmark,area_size,page_size,max_order,order,occupancy_percent,operations,ns_per_operation,failures\n");
+    const char* area = areas;
+    while (*area != '\0') {
+        char* end = NULL;
+        uint64_t area_size = parse_size(area, &end);
+        if (end == area || area_size > SIZE_MAX) {
+            fprintf(stderr, "Incorrect area size %s\n", area);
+            return 1;
+        }
+        run_area((size_t)area_size, flags);
+        area = *end == ',' ? end + 1 : end;
+        if (*end != ',' && *end != '\0') {
+            fprintf(stderr, "Incorrect area size %s\n", end);
+            return 1;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,625 @@
+#include "benchmarks.h"
+#include "../buddy_allocator/buddy_allocator.h"
+#include "../buddy_allocator/buddy_allocator_index.h"
+#include "../buddy_allocator/buddy_allocator_trace.h"
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <time.h>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <pthread.h>
+#endif
+
+// Number of different arguments for each measured function, power of 2
+#define BENCHMARKS_ARGUMENTS_NUMBER 1024
+// Number of calls for each measured function and order
+#define BENCHMARKS_CALLS_NUMBER (1 << 20)
+
+// Results are added here, so that the compiler can't throw away the measured calls
+volatile uint64_t g_benchmarks_sink = 0;
+
+/*
+ * Returns current time in nanoseconds
+ */
+static uint64_t get_time_ns(void)
+{
+    struct timespec time;
+    timespec_get(&time, TIME_UTC);
+    return (uint64_t)time.tv_sec * 1000000000 + (uint64_t)time.tv_nsec;
+}
+
+/*
+ * Returns random 64-bit number, rand() can return only 15 bits
+ */
+static uint64_t get_random_64(void)
+{
+    uint64_t value = 0;
+    for (uint8_t i = 0; i < 5; ++i) {
+        value = (value << 15) ^ (uint64_t)(rand() & 0x7FFF);
+    }
+    return value;
+}
+
+// BENCHMARKS_INDEX_ARITHMETIC STAFF
+// The loop versions of the index arithmetic that were used before the closed-form one, to compare with
+
+static uint8_t legacy_get_order_by_index(buddy_allocator_t* allocator_ptr, size_t block_index)
+{
+    uint8_t current_order = allocator_ptr->max_order;
+    size_t current_lower_index = 0;
+    size_t current_higher_index = allocator_ptr->large_blocks_number - 1;
+    size_t current_index_step = allocator_ptr->large_blocks_number;
+    while (block_index < current_lower_index || block_index > current_higher_index) {
+        current_order--;
+        current_lower_index = current_higher_index + 1;
+        current_higher_index += current_index_step * 2;
+        current_index_step *= 2;
+    }
+    return current_order;
+}
+
+static size_t legacy_get_index_in_order_by_index(buddy_allocator_t* allocator_ptr, size_t block_index)
+{
+    if (block_index < allocator_ptr->large_blocks_number) {
+        return block_index;
+    }
+    uint8_t order = legacy_get_order_by_index(allocator_ptr, block_index);
+    size_t blocks_number_in_previous_orders = allocator_ptr->large_blocks_number * ((((size_t)1) << (allocator_ptr->max_order - order)) - 1);
+    return block_index - blocks_number_in_previous_orders;
+}
+
+static uint8_t legacy_get_order_by_size(buddy_allocator_t* allocator_ptr, size_t size)
+{
+    size_t current_size = allocator_ptr->page_size;
+    uint8_t order = 0;
+    if (size > allocator_ptr->page_size) {
+        while (current_size < size) {
+            current_size *= 2;
+            order++;
+        }
+    }
+    return order;
+}
+
+/*
+ * Measures one function for all arguments, returns nanoseconds per call
+ */
+#define BENCHMARKS_MEASURE(result_ns, call_expression, arguments)                              \
+    do {                                                                                       \
+        uint64_t sum = 0;                                                                      \
+        uint64_t start_time = get_time_ns();                                                   \
+        for (uint32_t call = 0; call < BENCHMARKS_CALLS_NUMBER; ++call) {                      \
+            size_t argument = (arguments)[call & (BENCHMARKS_ARGUMENTS_NUMBER - 1)];           \
+            sum += (call_expression);                                                          \
+        }                                                                                      \
+        (result_ns) = (double)(get_time_ns() - start_time) / BENCHMARKS_CALLS_NUMBER;          \
+        g_benchmarks_sink += sum;                                                              \
+    } while (0)
+
+/*
+ * Measures the index arithmetic functions for blocks of each order
+ * and compares them with the loop versions.
+ * Two allocators are used: with a power of two large blocks number and with three large blocks.
+ * On 64-bit targets the max orders are larger, so that the block indices don't fit into 32 bits.
+ * Only preinit is called, the index arithmetic does not need the allocator memory.
+ */
+void benchmarks_index_arithmetic(void)
+{
+    const uint32_t large_blocks_numbers[] = { 1, 3 };
+#if UINTPTR_MAX > 0xFFFFFFFF
+    const uint8_t max_orders[] = { 40, 39 };
+#else
+    const uint8_t max_orders[] = { 30, 29 };
+#endif
+    size_t* indices = malloc(BENCHMARKS_ARGUMENTS_NUMBER * sizeof(size_t));
+    size_t* sizes = malloc(BENCHMARKS_ARGUMENTS_NUMBER * sizeof(size_t));
+    if (indices == NULL || sizes == NULL) {
+        printf("Failed to allocate memory for the benchmark\n");
+        exit(-1);
+    }
+    srand(0);
+
+    for (uint32_t k = 0; k < sizeof(large_blocks_numbers) / sizeof(uint32_t); ++k) {
+        buddy_allocator_t allocator;
+        size_t required_memory_size = 0;
+        memset(&allocator, 0, sizeof(buddy_allocator_t));
+        // Page size is 1, so that the area of the max order fits into size_t
+        size_t area_size = (size_t)large_blocks_numbers[k] << max_orders[k];
+        buddy_allocator_preinit(&allocator, 0x1000, area_size, max_orders[k], 1, false, &required_memory_size);
+        if (required_memory_size == 0) {
+            printf("Failed to preinit the allocator\n");
+            exit(-1);
+        }
+
+        printf("large_blocks_number: %zu, max_order: %u\n", allocator.large_blocks_number, allocator.max_order);
+        printf("order | get_order_by_index ns: loop closed | get_index_in_order_by_index ns: loop closed | get_order_by_size ns: loop closed\n");
+        for (int32_t order = allocator.max_order; order >= 0; --order) {
+            // Random blocks of this order and random sizes which are rounded up to this order
+            uint8_t depth = allocator.max_order - (uint8_t)order;
+            size_t first_index = allocator.first_index_by_depth[depth];
+            size_t blocks_number = allocator.first_index_by_depth[depth + 1] - first_index;
+            for (uint32_t i = 0; i < BENCHMARKS_ARGUMENTS_NUMBER; ++i) {
+                indices[i] = first_index + (size_t)(get_random_64() % blocks_number);
+                sizes[i] = order == 0 ? 1 : (((size_t)1) << (order - 1)) + 1 + (size_t)(get_random_64() % (((size_t)1) << (order - 1)));
+            }
+
+            double legacy_order_ns, order_ns, legacy_in_order_ns, in_order_ns, legacy_size_ns, size_ns;
+            BENCHMARKS_MEASURE(legacy_order_ns, legacy_get_order_by_index(&allocator, argument), indices);
+            BENCHMARKS_MEASURE(order_ns, get_order_by_index(&allocator, argument), indices);
+            BENCHMARKS_MEASURE(legacy_in_order_ns, legacy_get_index_in_order_by_index(&allocator, argument), indices);
+            BENCHMARKS_MEASURE(in_order_ns, get_index_in_order_by_index(&allocator, argument), indices);
+            BENCHMARKS_MEASURE(legacy_size_ns, legacy_get_order_by_size(&allocator, argument), sizes);
+            BENCHMARKS_MEASURE(size_ns, get_order_by_size(&allocator, argument), sizes);
+            printf("%5d | %6.2f %6.2f | %6.2f %6.2f | %6.2f %6.2f\n", order, legacy_order_ns, order_ns, legacy_in_order_ns, in_order_ns, legacy_size_ns, size_ns);
+
+            // Both versions must give the same results
+            for (uint32_t i = 0; i < BENCHMARKS_ARGUMENTS_NUMBER; ++i) {
+                if (legacy_get_order_by_index(&allocator, indices[i]) != get_order_by_index(&allocator, indices[i]) ||
+                    legacy_get_index_in_order_by_index(&allocator, indices[i]) != get_index_in_order_by_index(&allocator, indices[i]) ||
+                    legacy_get_order_by_size(&allocator, sizes[i]) != get_order_by_size(&allocator, sizes[i])) {
+                    printf("Closed-form index arithmetic does not match the loop version\n");
+                    exit(-1);
+                }
+            }
+        }
+        printf("\n");
+    }
+
+    free(indices);
+    free(sizes);
+}
+
+/*
+ * Compares buddy_allocator_alloc_bulk and buddy_allocator_free_bulk with loops of the single-block calls
+ * Blocks of order 0 are allocated and freed in groups of different sizes, like refills of a network RX ring.
+ * The area is 64 MB with 4 KB pages, the nodes are in the separate memory, so the area address is fake.
+ */
+void benchmarks_bulk(void)
+{
+    const size_t groups_sizes[] = { 16, 64, 256, 1024 };
+    const size_t blocks_per_measurement = (size_t)1 << 22;
+    buddy_allocator_t allocator;
+    size_t required_memory_size = 0;
+    memset(&allocator, 0, sizeof(buddy_allocator_t));
+    buddy_allocator_preinit(&allocator, 0x100000, (size_t)64 * 1024 * 1024, 10, 4096, false, &required_memory_size);
+    void* required_memory = malloc(required_memory_size);
+    void** blocks = malloc(1024 * sizeof(void*));
+    if (required_memory == NULL || blocks == NULL) {
+        printf("Failed to allocate memory for the benchmark\n");
+        exit(-1);
+    }
+
+    printf("group size | loop alloc ns | bulk alloc ns | loop free ns | bulk free ns (per block)\n");
+    for (uint32_t k = 0; k < sizeof(groups_sizes) / sizeof(size_t); ++k) {
+        size_t group_size = groups_sizes[k];
+        size_t groups_number = blocks_per_measurement / group_size;
+        uint64_t loop_alloc_time = 0, bulk_alloc_time = 0, loop_free_time = 0, bulk_free_time = 0;
+
+        buddy_allocator_init(&allocator, required_memory);
+        for (size_t group = 0; group < groups_number; ++group) {
+            uint64_t start_time = get_time_ns();
+            for (size_t i = 0; i < group_size; ++i) {
+                blocks[i] = buddy_allocator_alloc(&allocator, 4096);
+            }
+            uint64_t middle_time = get_time_ns();
+            for (size_t i = 0; i < group_size; ++i) {
+                buddy_allocator_free(&allocator, blocks[i]);
+            }
+            uint64_t end_time = get_time_ns();
+            loop_alloc_time += middle_time - start_time;
+            loop_free_time += end_time - middle_time;
+        }
+
+        buddy_allocator_init(&allocator, required_memory);
+        for (size_t group = 0; group < groups_number; ++group) {
+            uint64_t start_time = get_time_ns();
+            size_t allocated_blocks_number = buddy_allocator_alloc_bulk(&allocator, 0, group_size, blocks);
+            uint64_t middle_time = get_time_ns();
+            size_t freed_blocks_number = buddy_allocator_free_bulk(&allocator, blocks, allocated_blocks_number);
+            uint64_t end_time = get_time_ns();
+            if (allocated_blocks_number != group_size || freed_blocks_number != group_size) {
+                printf("Bulk functions have not allocated or freed all blocks\n");
+                exit(-1);
+            }
+            bulk_alloc_time += middle_time - start_time;
+            bulk_free_time += end_time - middle_time;
+        }
+
+        double blocks_number = (double)(groups_number * group_size);
+        printf("%10zu | %13.2f | %13.2f | %12.2f | %12.2f\n", group_size, loop_alloc_time / blocks_number, bulk_alloc_time / blocks_number, loop_free_time / blocks_number, bulk_free_time / blocks_number);
+    }
+
+    free(blocks);
+    free(required_memory);
+}
+
+/*
+ * Compares buddy_allocator_init with and without BUDDY_ALLOCATOR_FLAG_LAZY_INIT
+ * The area is 16 GB with 4 KB pages, the metadata takes about 133 MB, the area address is fake.
+ * With the lazy initialization the cost is moved to the allocations, so the first allocations are measured too.
+ */
+void benchmarks_lazy_init(void)
+{
+    const uint32_t flags[] = { 0, BUDDY_ALLOCATOR_FLAG_LAZY_INIT };
+    const size_t allocations_number = 1024;
+    buddy_allocator_t allocator;
+    size_t required_memory_size = 0;
+    memset(&allocator, 0, sizeof(buddy_allocator_t));
+    buddy_allocator_preinit(&allocator, 0x100000, (size_t)16 * 1024 * 1024 * 1024, 10, 4096, false, &required_memory_size);
+    if (required_memory_size == 0) {
+        printf("Failed to preinit the allocator\n");
+        return;
+    }
+    void* required_memory = malloc(required_memory_size);
+    if (required_memory == NULL) {
+        printf("Failed to allocate memory for the benchmark\n");
+        exit(-1);
+    }
+    // Make the memory resident, so that page faults are not measured
+    memset(required_memory, 0xFF, required_memory_size);
+
+    printf("required memory: %zu bytes\n", required_memory_size);
+    printf("mode  | init us | first %zu large blocks allocations us | first %zu pages allocations us\n", allocations_number, allocations_number);
+    for (uint32_t k = 0; k < sizeof(flags) / sizeof(uint32_t); ++k) {
+        memset(&allocator, 0, sizeof(buddy_allocator_t));
+        buddy_allocator_preinit_ex(&allocator, 0x100000, (size_t)16 * 1024 * 1024 * 1024, 10, 4096, false, flags[k], &required_memory_size);
+
+        uint64_t start_time = get_time_ns();
+        buddy_allocator_init(&allocator, required_memory);
+        uint64_t init_time = get_time_ns() - start_time;
+
+        start_time = get_time_ns();
+        for (size_t i = 0; i < allocations_number; ++i) {
+            buddy_allocator_alloc(&allocator, allocator.large_block_size);
+        }
+        uint64_t large_blocks_time = get_time_ns() - start_time;
+
+        start_time = get_time_ns();
+        for (size_t i = 0; i < allocations_number; ++i) {
+            buddy_allocator_alloc(&allocator, 4096);
+        }
+        uint64_t pages_time = get_time_ns() - start_time;
+
+        printf("%5s | %7.1f | %40.1f | %31.1f\n", flags[k] ? "lazy" : "eager", init_time / 1000.0, large_blocks_time / 1000.0, pages_time / 1000.0);
+    }
+
+    free(required_memory);
+}
+
+/*
+ * Compares the allocations and frees of small blocks with and without BUDDY_ALLOCATOR_FLAG_QUICKLISTS
+ * Blocks of orders 0 and 1 are allocated and freed in random slots of a working set, like the churn of small objects.
+ * The area is 64 MB with 4 KB pages, the area address is fake. With BUDDY_ALLOCATOR_STATS the splits and the merges are printed too.
+ */
+void benchmarks_quicklists(void)
+{
+    const uint32_t flags[] = { 0, BUDDY_ALLOCATOR_FLAG_QUICKLISTS };
+    const size_t slots_number = 4096;
+    const size_t operations_number = (size_t)1 << 24;
+    buddy_allocator_t allocator;
+    size_t required_memory_size = 0;
+    memset(&allocator, 0, sizeof(buddy_allocator_t));
+    buddy_allocator_preinit_ex(&allocator, 0x100000, (size_t)64 * 1024 * 1024, 10, 4096, false, BUDDY_ALLOCATOR_FLAG_QUICKLISTS, &required_memory_size);
+    void* required_memory = malloc(required_memory_size);
+    void** slots = malloc(slots_number * sizeof(void*));
+    uint32_t* randoms = malloc(operations_number * sizeof(uint32_t));
+    if (required_memory == NULL || slots == NULL || randoms == NULL) {
+        printf("Failed to allocate memory for the benchmark\n");
+        exit(-1);
+    }
+    // The same sequence of operations for both modes
+    for (size_t i = 0; i < operations_number; ++i) {
+        randoms[i] = (uint32_t)get_random_64();
+    }
+
+    printf("mode       | ns per operation | splits | merges\n");
+    for (uint32_t k = 0; k < sizeof(flags) / sizeof(uint32_t); ++k) {
+        memset(&allocator, 0, sizeof(buddy_allocator_t));
+        buddy_allocator_preinit_ex(&allocator, 0x100000, (size_t)64 * 1024 * 1024, 10, 4096, false, flags[k], &required_memory_size);
+        buddy_allocator_init(&allocator, required_memory);
+        memset(slots, 0, slots_number * sizeof(void*));
+
+        uint64_t start_time = get_time_ns();
+        for (size_t i = 0; i < operations_number; ++i) {
+            size_t slot = randoms[i] % slots_number;
+            if (slots[slot] != NULL) {
+                buddy_allocator_free(&allocator, slots[slot]);
+                slots[slot] = NULL;
+            }
+            else {
+                slots[slot] = buddy_allocator_alloc(&allocator, (size_t)4096 << ((randoms[i] >> 31) & 1));
+            }
+        }
+        uint64_t time = get_time_ns() - start_time;
+
+        uint64_t splits = 0, merges = 0;
+#ifdef BUDDY_ALLOCATOR_STATS
+        buddy_allocator_stats_t stats;
+        buddy_allocator_get_stats(&allocator, &stats);
+        for (uint8_t order = 0; order <= allocator.max_order; ++order) {
+            splits += stats.splits[order];
+            merges += stats.merges[order];
+        }
+#endif
+        printf("%10s | %16.2f | %6llu | %6llu\n", flags[k] ? "quicklists" : "eager", (double)time / operations_number, (unsigned long long)splits, (unsigned long long)merges);
+
+        for (size_t slot = 0; slot < slots_number; ++slot) {
+            if (slots[slot] != NULL) {
+                buddy_allocator_free(&allocator, slots[slot]);
+            }
+        }
+    }
+
+    free(randoms);
+    free(slots);
+    free(required_memory);
+}
+
+/*
+ * Compares the default allocation policy with BUDDY_ALLOCATOR_FLAG_ADDRESS_ORDERED
+ * Blocks of orders 0 - 3 are allocated and freed in random slots of a working set, which grows and shrinks between a quarter and all slots (about a half of the area).
+ * Each 1024th allocated block is long-lived, it is never freed. At the end all other blocks are freed,
+ * and the free large blocks and the free tail of the area (buddy_allocator_get_free_tail_size) are printed.
+ * The area is 64 MB with 4 KB pages, large blocks are 256 KB, the area address is fake.
+ */
+void benchmarks_address_ordered(void)
+{
+    const uint32_t flags[] = { 0, BUDDY_ALLOCATOR_FLAG_ADDRESS_ORDERED };
+    const size_t slots_number = 2048;
+    const size_t operations_number = (size_t)1 << 21;
+    buddy_allocator_t allocator;
+    size_t required_memory_size = 0;
+    memset(&allocator, 0, sizeof(buddy_allocator_t));
+    buddy_allocator_preinit_ex(&allocator, 0x100000, (size_t)64 * 1024 * 1024, 6, 4096, false, BUDDY_ALLOCATOR_FLAG_ADDRESS_ORDERED, &required_memory_size);
+    void* required_memory = malloc(required_memory_size);
+    void** slots = malloc(slots_number * sizeof(void*));
+    void** long_lived_blocks = malloc(operations_number / 1024 * sizeof(void*));
+    uint32_t* randoms = malloc(operations_number * sizeof(uint32_t));
+    if (required_memory == NULL || slots == NULL || long_lived_blocks == NULL || randoms == NULL) {
+        printf("Failed to allocate memory for the benchmark\n");
+        exit(-1);
+    }
+    // The same sequence of operations for both modes
+    for (size_t i = 0; i < operations_number; ++i) {
+        randoms[i] = (uint32_t)get_random_64();
+    }
+
+    printf("mode            | ns per operation | free large blocks | free tail MB\n");
+    for (uint32_t k = 0; k < sizeof(flags) / sizeof(uint32_t); ++k) {
+        memset(&allocator, 0, sizeof(buddy_allocator_t));
+        buddy_allocator_preinit_ex(&allocator, 0x100000, (size_t)64 * 1024 * 1024, 6, 4096, false, flags[k], &required_memory_size);
+        buddy_allocator_init(&allocator, required_memory);
+        memset(slots, 0, slots_number * sizeof(void*));
+
+        size_t allocations_number = 0;
+        size_t long_lived_blocks_number = 0;
+        uint64_t start_time = get_time_ns();
+        for (size_t i = 0; i < operations_number; ++i) {
+            // The working set has a quarter, a half, three quarters or all slots
+            size_t active_slots_number = slots_number * ((i >> 16) % 4 + 1) / 4;
+            size_t slot = randoms[i] % slots_number;
+            if (slots[slot] != NULL) {
+                buddy_allocator_free(&allocator, slots[slot]);
+                slots[slot] = NULL;
+            }
+            else if (slot < active_slots_number) {
+                slots[slot] = buddy_allocator_alloc(&allocator, (size_t)4096 << ((randoms[i] >> 30) & 3));
+                if (slots[slot] != NULL && allocations_number++ % 1024 == 1023) {
+                    long_lived_blocks[long_lived_blocks_number++] = slots[slot];
+                    slots[slot] = NULL;
+                }
+            }
+        }
+        uint64_t time = get_time_ns() - start_time;
+
+        for (size_t slot = 0; slot < slots_number; ++slot) {
+            if (slots[slot] != NULL) {
+                buddy_allocator_free(&allocator, slots[slot]);
+            }
+        }
+        buddy_allocator_order_info_t orders_info[BUDDY_ALLOCATOR_MAX_ORDER_LIMIT + 1];
+        buddy_allocator_get_orders_info(&allocator, orders_info);
+        printf("%15s | %16.2f | %17zu | %12.1f\n", flags[k] ? "address-ordered" : "default", (double)time / operations_number, orders_info[allocator.max_order].free_blocks_number, buddy_allocator_get_free_tail_size(&allocator) / (1024.0 * 1024.0));
+        for (size_t i = 0; i < long_lived_blocks_number; ++i) {
+            buddy_allocator_free(&allocator, long_lived_blocks[i]);
+        }
+    }
+
+    free(randoms);
+    free(long_lived_blocks);
+    free(slots);
+    free(required_memory);
+}
+
+// BENCHMARKS_INIT_PARALLEL STAFF
+// Maximum number of threads of the benchmark
+#define BENCHMARKS_THREADS_NUMBER_MAX 16
+
+typedef struct {
+    buddy_allocator_task_t task;
+    void* task_data_ptr;
+    size_t task_index;
+} benchmarks_thread_data_t;
+
+#ifdef _WIN32
+static DWORD WINAPI benchmarks_thread_function(LPVOID thread_data_ptr)
+#else
+static void* benchmarks_thread_function(void* thread_data_ptr)
+#endif
+{
+    benchmarks_thread_data_t* thread_data = thread_data_ptr;
+    thread_data->task(thread_data->task_data_ptr, thread_data->task_index);
+    return 0;
+}
+
+/*
+ * Runs each task in its own thread, the task 0 is run in the calling thread
+ */
+static void benchmarks_run_tasks(void* context_ptr, buddy_allocator_task_t task, void* task_data_ptr, size_t tasks_number)
+{
+    (void)context_ptr;
+    benchmarks_thread_data_t threads_data[BENCHMARKS_THREADS_NUMBER_MAX];
+#ifdef _WIN32
+    HANDLE threads[BENCHMARKS_THREADS_NUMBER_MAX];
+#else
+    pthread_t threads[BENCHMARKS_THREADS_NUMBER_MAX];
+#endif
+    for (size_t i = 1; i < tasks_number; ++i) {
+        threads_data[i].task = task;
+        threads_data[i].task_data_ptr = task_data_ptr;
+        threads_data[i].task_index = i;
+#ifdef _WIN32
+        threads[i] = CreateThread(NULL, 0, benchmarks_thread_function, &threads_data[i], 0, NULL);
+#else
+        pthread_create(&threads[i], NULL, benchmarks_thread_function, &threads_data[i]);
+#endif
+    }
+    task(task_data_ptr, 0);
+    for (size_t i = 1; i < tasks_number; ++i) {
+#ifdef _WIN32
+        WaitForSingleObject(threads[i], INFINITE);
+        CloseHandle(threads[i]);
+#else
+        pthread_join(threads[i], NULL);
+#endif
+    }
+}
+
+/*
+ * Compares buddy_allocator_init with buddy_allocator_init_parallel with different numbers of threads
+ * The area is 64 GB with 4 KB pages, the metadata takes about 530 MB, the area address is fake.
+ */
+void benchmarks_init_parallel(void)
+{
+    const size_t threads_numbers[] = { 1, 2, 4, 8, 16 };
+    const size_t area_size = (size_t)64 * 1024 * 1024 * 1024;
+    buddy_allocator_t allocator;
+    size_t required_memory_size = 0;
+    memset(&allocator, 0, sizeof(buddy_allocator_t));
+    buddy_allocator_preinit(&allocator, 0x100000, area_size, 10, 4096, false, &required_memory_size);
+    if (required_memory_size == 0) {
+        printf("Failed to preinit the allocator\n");
+        return;
+    }
+    void* required_memory = malloc(required_memory_size);
+    if (required_memory == NULL) {
+        printf("Failed to allocate memory for the benchmark\n");
+        exit(-1);
+    }
+    // Make the memory resident, so that page faults are not measured
+    memset(required_memory, 0xFF, required_memory_size);
+
+    printf("required memory: %zu bytes\n", required_memory_size);
+    printf("threads | init ms\n");
+    uint64_t start_time = get_time_ns();
+    buddy_allocator_init(&allocator, required_memory);
+    printf("%7s | %7.2f\n", "init", (get_time_ns() - start_time) / 1000000.0);
+    for (uint32_t k = 0; k < sizeof(threads_numbers) / sizeof(size_t); ++k) {
+        start_time = get_time_ns();
+        buddy_allocator_init_parallel(&allocator, required_memory, threads_numbers[k], benchmarks_run_tasks, NULL);
+        printf("%7zu | %7.2f\n", threads_numbers[k], (get_time_ns() - start_time) / 1000000.0);
+        if (allocator.free_blocks_lists[allocator.max_order].count != allocator.large_blocks_number) {
+            printf("Parallel initialization has not put all large blocks to the free list\n");
+            exit(-1);
+        }
+    }
+
+    free(required_memory);
+}
+
+#ifdef BUDDY_ALLOCATOR_TRACE
+// BENCHMARKS_TRACE STAFF
+// Number of operations between drains and the number of records of the ring, so nothing is dropped
+#define BENCHMARKS_TRACE_GROUP_SIZE 4096
+
+/*
+ * Writes nothing, only the writing of the records is measured by the benchmark
+ */
+static bool benchmarks_trace_write(void* context_ptr, const void* data_ptr, size_t size)
+{
+    (void)data_ptr;
+    *(uint64_t*)context_ptr += size;
+    return true;
+}
+
+/*
+ * Runs the group of random allocations and frees of orders 0 - 3, returns the time of the group in nanoseconds
+ * The slots array keeps the allocated blocks, a random slot is freed if it is allocated and allocated otherwise.
+ */
+static uint64_t benchmarks_trace_run_group(buddy_allocator_t* allocator_ptr, void** slots, const uint32_t* randoms)
+{
+    uint64_t start_time = get_time_ns();
+    for (size_t i = 0; i < BENCHMARKS_TRACE_GROUP_SIZE; ++i) {
+        uint32_t random = randoms[i];
+        void** slot_ptr = &slots[random % BENCHMARKS_ARGUMENTS_NUMBER];
+        if (*slot_ptr != NULL) {
+            buddy_allocator_free(allocator_ptr, *slot_ptr);
+            *slot_ptr = NULL;
+        }
+        else {
+            *slot_ptr = buddy_allocator_alloc(allocator_ptr, (size_t)4096 << ((random >> 16) & 3));
+        }
+    }
+    return get_time_ns() - start_time;
+}
+
+/*
+ * Compares the same random workload with the trace ring detached and attached
+ * The ring is drained between the groups, the drain is not measured.
+ */
+void benchmarks_trace(void)
+{
+    const size_t groups_number = 1024;
+    buddy_allocator_t allocators[2];
+    buddy_allocator_trace_t trace;
+    size_t required_memory_size = 0;
+    size_t trace_required_memory_size = 0;
+    void* required_memory[2];
+    void** slots[2];
+    for (int attached = 0; attached < 2; ++attached) {
+        memset(&allocators[attached], 0, sizeof(buddy_allocator_t));
+        buddy_allocator_preinit(&allocators[attached], 0x100000, (size_t)64 * 1024 * 1024, 10, 4096, false, &required_memory_size);
+        required_memory[attached] = malloc(required_memory_size);
+        slots[attached] = calloc(BENCHMARKS_ARGUMENTS_NUMBER, sizeof(void*));
+    }
+    buddy_allocator_trace_preinit(&trace, BENCHMARKS_TRACE_GROUP_SIZE, &trace_required_memory_size);
+    void* trace_required_memory = malloc(trace_required_memory_size);
+    uint32_t* randoms = malloc(groups_number * BENCHMARKS_TRACE_GROUP_SIZE * sizeof(uint32_t));
+    if (required_memory[0] == NULL || required_memory[1] == NULL || slots[0] == NULL || slots[1] == NULL || trace_required_memory == NULL || randoms == NULL) {
+        printf("Failed to allocate memory for the benchmark\n");
+        exit(-1);
+    }
+    for (size_t i = 0; i < groups_number * BENCHMARKS_TRACE_GROUP_SIZE; ++i) {
+        randoms[i] = (uint32_t)get_random_64();
+    }
+    for (int attached = 0; attached < 2; ++attached) {
+        buddy_allocator_init(&allocators[attached], required_memory[attached]);
+    }
+    buddy_allocator_trace_init(&trace, 0, trace_required_memory);
+    buddy_allocator_trace_attach(&allocators[1], &trace);
+
+    // Detached and attached runs are interleaved group by group, so both see the same CPU frequency
+    uint64_t times[2] = { 0, 0 };
+    uint64_t written_size = 0;
+    for (size_t group = 0; group < groups_number; ++group) {
+        for (int attached = 0; attached < 2; ++attached) {
+            times[attached] += benchmarks_trace_run_group(&allocators[attached], slots[attached], randoms + group * BENCHMARKS_TRACE_GROUP_SIZE);
+        }
+        buddy_allocator_trace_drain(&trace, benchmarks_trace_write, &written_size);
+    }
+
+    double operations_number = (double)(groups_number * BENCHMARKS_TRACE_GROUP_SIZE);
+    printf("detached ns | attached ns | overhead %% | written bytes | dropped records\n");
+    printf("%11.2f | %11.2f | %10.2f | %13llu | %15llu\n", times[0] / operations_number, times[1] / operations_number,
+        100.0 * ((double)times[1] - (double)times[0]) / (double)times[0], (unsigned long long)written_size, (unsigned long long)buddy_allocator_trace_get_dropped(&trace));
+
+    free(randoms);
+    free(trace_required_memory);
+    for (int attached = 0; attached < 2; ++attached) {
+        free(slots[attached]);
+        free(required_memory[attached]);
+    }
+}
+#endif
@@ -0,0 +1,20 @@
+#ifndef _BENCHMARKS_H_
+#define _BENCHMARKS_H_
+
+extern void benchmarks_index_arithmetic(void);
+
+extern void benchmarks_bulk(void);
+
+extern void benchmarks_lazy_init(void);
+
+extern void benchmarks_quicklists(void);
+
+extern void benchmarks_address_ordered(void);
+
+extern void benchmarks_init_parallel(void);
+
+#ifdef BUDDY_ALLOCATOR_TRACE
+extern void benchmarks_trace(void);
+#endif
+
+#endif
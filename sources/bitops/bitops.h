@@ -0,0 +1,62 @@
+#ifndef _BITOPS_H_
+#define _BITOPS_H_
+
+#include <stdint.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+// Bit operations on 64-bit words
+// Compiler intrinsics are used, so on most targets each function is a single instruction.
+
+/*
+ * Returns index of the least significant set bit
+ * The value must not be 0
+ */
+static inline uint8_t bitops_find_first_set(uint64_t value)
+{
+#if defined(_MSC_VER)
+    unsigned long index = 0;
+#if defined(_WIN64)
+    _BitScanForward64(&index, value);
+#else
+    if ((uint32_t)value != 0) {
+        _BitScanForward(&index, (uint32_t)value);
+    }
+    else {
+        _BitScanForward(&index, (uint32_t)(value >> 32));
+        index += 32;
+    }
+#endif
+    return (uint8_t)index;
+#else
+    return (uint8_t)__builtin_ctzll(value);
+#endif
+}
+
+/*
+ * Returns index of the most significant set bit, it is floor(log2(value))
+ * The value must not be 0
+ */
+static inline uint8_t bitops_find_last_set(uint64_t value)
+{
+#if defined(_MSC_VER)
+    unsigned long index = 0;
+#if defined(_WIN64)
+    _BitScanReverse64(&index, value);
+#else
+    if ((uint32_t)(value >> 32) != 0) {
+        _BitScanReverse(&index, (uint32_t)(value >> 32));
+        index += 32;
+    }
+    else {
+        _BitScanReverse(&index, (uint32_t)value);
+    }
+#endif
+    return (uint8_t)index;
+#else
+    return (uint8_t)(63 - __builtin_clzll(value));
+#endif
+}
+
+#endif
@@ -1,423 +1,407 @@
 #include "buddy_allocator.h"
+#include "buddy_allocator_index.h"
+#include "buddy_allocator_stats.h"
+#ifdef BUDDY_ALLOCATOR_LATENCY
+#include "../cycles/cycles.h"
+#endif
+#include "buddy_allocator_trace.h"
+#include "../bitops/bitops.h"
+#include "../atomics/atomics.h"
 #include <string.h>
 #include <stdbool.h>
 #include <stdio.h>
 
 /*
  * Get the memory block index by node pointer
+ * order is the order of the free list that contains the node, it is needed when the node is stored in the block itself
  */
-static uint32_t get_index_by_node(buddy_allocator_t* allocator_ptr, memory_block_node_t* block_node_ptr)
+static size_t get_index_by_node(buddy_allocator_t* allocator_ptr, dll_node_t* block_node_ptr, uint8_t order)
 {
+    if (allocator_ptr->flags & BUDDY_ALLOCATOR_FLAG_IN_BLOCK_NODES) {
+        size_t in_order_index = (size_t)(((uintptr_t)block_node_ptr - allocator_ptr->area_start_addr) >> (order + allocator_ptr->page_shift));
+        return get_index_by_in_order_index(allocator_ptr, in_order_index, order);
+    }
     return (((uintptr_t)block_node_ptr - (uintptr_t)allocator_ptr->blocks_nodes)) / sizeof(memory_block_node_t);
 }
 
 /*
  * Get the node pointer by memory block index
+ * With BUDDY_ALLOCATOR_FLAG_IN_BLOCK_NODES the node is placed at the start of the block memory, so the order of the block is needed to find it
  */
-static memory_block_node_t* get_node_by_index(buddy_allocator_t* allocator_ptr, uint32_t block_index)
+static dll_node_t* get_node_by_index(buddy_allocator_t* allocator_ptr, size_t block_index, uint8_t order)
 {
-    return (memory_block_node_t*)(block_index * sizeof(memory_block_node_t) + (uintptr_t)allocator_ptr->blocks_nodes);
+    if (allocator_ptr->flags & BUDDY_ALLOCATOR_FLAG_IN_BLOCK_NODES) {
+        size_t in_order_index = block_index - allocator_ptr->first_index_by_depth[allocator_ptr->max_order - order];
+        return (dll_node_t*)(((uintptr_t)in_order_index << (order + allocator_ptr->page_shift)) + allocator_ptr->area_start_addr);
+    }
+    return (dll_node_t*)(block_index * sizeof(memory_block_node_t) + (uintptr_t)allocator_ptr->blocks_nodes);
 }
 
 /*
- * Get order of block by index
- * Example:
- * 2 |     0     |     1     | 0 1
- * 1 |  2  |  3  |  4  |  5  | 2 5
- * 0 |6 |7 |8 |9 |10|11|12|13| 6 13
- * 1 - 2, 4 - 1, 8 - 0
+ * Returns true if the block is in any free list, otherwise false.
+ * The free blocks bitmap is updated by the free list functions below, so the block node itself is not touched.
  */
-static uint8_t get_order_by_index(buddy_allocator_t* allocator_ptr, uint32_t block_index)
+static bool is_block_in_free_list_by_index(buddy_allocator_t* allocator_ptr, size_t block_index)
 {
-    uint8_t current_order = allocator_ptr->max_order;
-    uint32_t current_lower_index = 0;
-    uint32_t current_higher_index = allocator_ptr->large_blocks_number - 1;
-    uint32_t current_index_step = allocator_ptr->large_blocks_number;
-    while (block_index < current_lower_index || block_index > current_higher_index) {
-        current_order--;
-        current_lower_index = current_higher_index + 1;
-        current_higher_index += current_index_step * 2;
-        current_index_step *= 2;
-    }
-    return current_order;
+    return (allocator_ptr->free_blocks_bitmap[block_index / 64] >> (block_index % 64)) & 1;
 }
 
 /*
- * Get block size by order
+ * Sets the bit of the block in the free blocks bitmap, and the bit of its word in the summary if it is used
  */
-static uint32_t get_size_by_order(buddy_allocator_t* allocator_ptr, uint8_t order)
+static void set_free_block_bit(buddy_allocator_t* allocator_ptr, size_t block_index)
 {
-    return (1 << order) * allocator_ptr->page_size;
+    allocator_ptr->free_blocks_bitmap[block_index / 64] |= (uint64_t)1 << (block_index % 64);
+    if (allocator_ptr->free_blocks_summary != NULL) {
+        allocator_ptr->free_blocks_summary[block_index / 4096] |= (uint64_t)1 << ((block_index / 64) % 64);
+    }
 }
 
 /*
- * Get order by size
+ * Clears the bits of the word of the free blocks bitmap which are set in the mask, the bit of the word in the summary is cleared if the word becomes 0
  */
-static uint8_t get_order_by_size(buddy_allocator_t* allocator_ptr, size_t size)
+static void clear_free_blocks_word_bits(buddy_allocator_t* allocator_ptr, size_t word_index, uint64_t bits_mask)
 {
-    // We cannot allocate memory less than 1 page (smallest block)
-    uint32_t current_size = allocator_ptr->page_size;
-    uint8_t order = 0;
-    // We trying to allocate memory larger than a small block
-    if (size > allocator_ptr->page_size) {
-        while (current_size < size) {
-            current_size *= 2;
-            order++;
-        }
+    allocator_ptr->free_blocks_bitmap[word_index] &= ~bits_mask;
+    if (allocator_ptr->free_blocks_summary != NULL && allocator_ptr->free_blocks_bitmap[word_index] == 0) {
+        allocator_ptr->free_blocks_summary[word_index / 64] &= ~((uint64_t)1 << (word_index % 64));
     }
-    return order;
 }
 
 /*
- * Get blocks number by order
+ * Returns true if there are large blocks which are free but not touched yet, see BUDDY_ALLOCATOR_FLAG_LAZY_INIT
  */
-static uint32_t get_blocks_number_by_order(buddy_allocator_t* allocator_ptr, uint8_t order)
+static bool has_untouched_free_large_blocks(buddy_allocator_t* allocator_ptr)
 {
-    // Number of blocks changes exponentially, let's find member of geometric progression
-    return allocator_ptr->large_blocks_number * (1 << (allocator_ptr->max_order - order));
+    return allocator_ptr->allocate_all_small_blocks == false && allocator_ptr->untouched_large_block_index < allocator_ptr->large_blocks_number;
 }
 
 /*
- * Get blocks first (left) child
- * 2 |     0     |
- * 1 |  1  |  2  |
- * 0 |3 |4 |5 |6 |
- * 0 - 1, 1 - 3, 2 - 5
- * 2 |     0     |     1     |
- * 1 |  2  |  3  |  4  |  5  |
- * 0 |6 |7 |8 |9 |10|11|12|13|
- * 0 - 2, 4 - 10, 5 - 12
- * 2 |     0     |     1     |     2     |
- * 1 |  3  |  4  |  5  |  6  |  7  |  8  |
- * 0 |9 |10|11|12|13|14|15|16|17|18|19|20|
- * 0 - 3, 3 - 9, 2 - 7, 8 - 19
+ * Get the migrate type of the block, it is the type of its large block
+ * Without BUDDY_ALLOCATOR_FLAG_MIGRATE_TYPES all blocks have type 0
  */
-static uint32_t get_first_child_by_index(buddy_allocator_t* allocator_ptr, uint32_t block_index)
+static uint8_t get_block_type(buddy_allocator_t* allocator_ptr, size_t block_index, uint8_t order)
 {
-    return (block_index * 2) + allocator_ptr->large_blocks_number;
+    if (allocator_ptr->migrate_types_number == 1) {
+        return 0;
+    }
+    size_t in_order_index = block_index - allocator_ptr->first_index_by_depth[allocator_ptr->max_order - order];
+    return allocator_ptr->large_block_types[in_order_index >> (allocator_ptr->max_order - order)];
 }
 
 /*
- * Get blocks second (right) child
- * 2 |     0     |
- * 1 |  1  |  2  |
- * 0 |3 |4 |5 |6 |
- * 0 - 2, 1 - 4, 2 - 6
- * 2 |     0     |     1     |
- * 1 |  2  |  3  |  4  |  5  |
- * 0 |6 |7 |8 |9 |10|11|12|13|
- * 0 - 3, 4 - 11, 5 - 13
- * 2 |     0     |     1     |     2     |
- * 1 |  3  |  4  |  5  |  6  |  7  |  8  |
- * 0 |9 |10|11|12|13|14|15|16|17|18|19|20|
- * 0 - 4, 3 - 10, 2 - 8, 8 - 20
+ * Get the type of large blocks after initialization, free large blocks are movable like in Linux
  */
-static uint32_t get_second_child_by_index(buddy_allocator_t* allocator_ptr, uint32_t block_index)
+static uint8_t get_initial_block_type(buddy_allocator_t* allocator_ptr)
 {
-    return ((block_index * 2) + allocator_ptr->large_blocks_number) + 1;
+    return allocator_ptr->migrate_types_number == 1 ? 0 : BUDDY_ALLOCATOR_MIGRATE_MOVABLE;
 }
 
 /*
- * Get blocks parent by index
+ * Get the index of the free list of the type and the order in free_blocks_lists (free_blocks_index_lists)
  */
-static uint32_t get_parent_by_index(buddy_allocator_t* allocator_ptr, uint32_t block_index)
+static size_t get_free_list_index(buddy_allocator_t* allocator_ptr, uint8_t type, uint8_t order)
 {
-    return (block_index - allocator_ptr->large_blocks_number) / 2;
+    return (size_t)type * (allocator_ptr->max_order + 1) + order;
 }
 
 /*
- * Get index in order by global index
+ * Get number of blocks in the free list of the type and the order
  */
-static uint32_t get_index_in_order_by_index(buddy_allocator_t* allocator_ptr, uint32_t block_index)
+static size_t free_list_get_count(buddy_allocator_t* allocator_ptr, uint8_t type, uint8_t order)
 {
-    if (block_index < allocator_ptr->large_blocks_number) {
-        return block_index;
+    if (allocator_ptr->flags & BUDDY_ALLOCATOR_FLAG_COMPACT_NODES) {
+        return allocator_ptr->free_blocks_index_lists[get_free_list_index(allocator_ptr, type, order)].count;
     }
-    uint8_t order = get_order_by_index(allocator_ptr, block_index);
-    uint32_t blocks_number_in_previous_orders = allocator_ptr->large_blocks_number * ((1 << (allocator_ptr->max_order - order)) - 1);
-    return block_index - blocks_number_in_previous_orders;
+    return allocator_ptr->free_blocks_lists[get_free_list_index(allocator_ptr, type, order)].count;
 }
 
 /*
- * Get block buddy index by index
- * Don't use if (block_index < large_blocks_number && (allocator_ptr->large_blocks_number % 2) == 1)
- * because last large block don't have buddy
- * In general, there is no need to call this function for large blocks because they are not merge
+ * Get index of the first block in the free list of the type and the order
+ * The list must not be empty
  */
-static uint32_t get_buddy_by_index(buddy_allocator_t* allocator_ptr, uint32_t block_index)
+static size_t free_list_get_head(buddy_allocator_t* allocator_ptr, uint8_t type, uint8_t order)
 {
-    if (block_index < allocator_ptr->large_blocks_number) {
-        return block_index ^ 1;
+    if (allocator_ptr->flags & BUDDY_ALLOCATOR_FLAG_COMPACT_NODES) {
+        return allocator_ptr->free_blocks_index_lists[get_free_list_index(allocator_ptr, type, order)].head;
     }
-    uint32_t in_order_index = get_index_in_order_by_index(allocator_ptr, block_index);
-    uint8_t order = get_order_by_index(allocator_ptr, block_index);
-    uint32_t blocks_number_in_previous_orders = allocator_ptr->large_blocks_number * ((1 << (allocator_ptr->max_order - order)) - 1);
-    return (in_order_index ^ 1) + blocks_number_in_previous_orders;
+    return get_index_by_node(allocator_ptr, allocator_ptr->free_blocks_lists[get_free_list_index(allocator_ptr, type, order)].head, order);
 }
 
 /*
- * Get global index by in order index
+ * Put block to the head of the free list of the order and mark it as free in the bitmap and the orders masks
+ * The list of the type of the block is used
  */
-static uint32_t get_index_by_in_order_index(buddy_allocator_t* allocator_ptr, uint32_t block_index, uint8_t order)
+static void free_list_insert_to_head(buddy_allocator_t* allocator_ptr, uint8_t order, size_t block_index)
 {
-    if (order == allocator_ptr->max_order) {
-        return block_index;
+    uint8_t type = get_block_type(allocator_ptr, block_index, order);
+    if (allocator_ptr->flags & BUDDY_ALLOCATOR_FLAG_COMPACT_NODES) {
+        dll_index_insert_node_to_head(&allocator_ptr->free_blocks_index_lists[get_free_list_index(allocator_ptr, type, order)], (dll_index_node_t*)allocator_ptr->blocks_compact_nodes, (uint32_t)block_index);
+    }
+    else {
+        dll_insert_node_to_head(&allocator_ptr->free_blocks_lists[get_free_list_index(allocator_ptr, type, order)], get_node_by_index(allocator_ptr, block_index, order));
     }
-    uint32_t blocks_number_in_previous_orders = allocator_ptr->large_blocks_number * ((1 << (allocator_ptr->max_order - order)) - 1);
-    return block_index + blocks_number_in_previous_orders;
+    set_free_block_bit(allocator_ptr, block_index);
+    allocator_ptr->free_orders_masks[type] |= (uint64_t)1 << order;
+    allocator_ptr->free_orders_mask |= (uint64_t)1 << order;
+    allocator_ptr->free_memory_size += (size_t)1 << (order + allocator_ptr->page_shift);
 }
 
 /*
- * Return true if block allocated (used by user) by index
- * false otherwise
+ * Put block to the tail of the free list of the order and mark it as free in the bitmap and the orders masks
+ * The list of the type of the block is used
  */
-static bool is_block_allocated_by_index(buddy_allocator_t* allocator_ptr, uint32_t block_index)
+static void free_list_insert_to_tail(buddy_allocator_t* allocator_ptr, uint8_t order, size_t block_index)
 {
-    uint32_t in_order_index = get_index_in_order_by_index(allocator_ptr, block_index);
-    uint8_t order = get_order_by_index(allocator_ptr, block_index);
-    uint32_t block_size = get_size_by_order(allocator_ptr, order);
-
-    if (allocator_ptr->allocations_orders[in_order_index * block_size / allocator_ptr->small_block_size] > 0) {
-        return true;
+    uint8_t type = get_block_type(allocator_ptr, block_index, order);
+    if (allocator_ptr->flags & BUDDY_ALLOCATOR_FLAG_COMPACT_NODES) {
+        dll_index_insert_node_to_tail(&allocator_ptr->free_blocks_index_lists[get_free_list_index(allocator_ptr, type, order)], (dll_index_node_t*)allocator_ptr->blocks_compact_nodes, (uint32_t)block_index);
     }
     else {
-        return false;
+        dll_insert_node_to_tail(&allocator_ptr->free_blocks_lists[get_free_list_index(allocator_ptr, type, order)], get_node_by_index(allocator_ptr, block_index, order));
     }
+    set_free_block_bit(allocator_ptr, block_index);
+    allocator_ptr->free_orders_masks[type] |= (uint64_t)1 << order;
+    allocator_ptr->free_orders_mask |= (uint64_t)1 << order;
+    allocator_ptr->free_memory_size += (size_t)1 << (order + allocator_ptr->page_shift);
 }
 
 /*
- * Returns true if the block is in any free list, otherwise false.
- * IMPORTANT. To make this function work, it is necessary to set the next and prev fields of the removed block equal to NULL when remove a block from free list.
+ * Remove block from the free list of the order and clear its bit in the bitmap
+ * If the list becomes empty, the order is removed from the orders mask of the type, and from the common mask if there are no such blocks of other types
  */
-static bool is_block_in_free_list_by_index(buddy_allocator_t* allocator_ptr, uint32_t block_index)
+static void free_list_remove(buddy_allocator_t* allocator_ptr, uint8_t order, size_t block_index)
 {
-    memory_block_node_t* block_node_ptr = get_node_by_index(allocator_ptr, block_index);
-    dll_node_t* dll_node_ptr = (dll_node_t*)block_node_ptr;
-    if (dll_node_ptr->next != NULL || dll_node_ptr->prev != NULL) {
-        return true;
+    uint8_t type = get_block_type(allocator_ptr, block_index, order);
+    if (allocator_ptr->flags & BUDDY_ALLOCATOR_FLAG_COMPACT_NODES) {
+        dll_index_remove_node(&allocator_ptr->free_blocks_index_lists[get_free_list_index(allocator_ptr, type, order)], (dll_index_node_t*)allocator_ptr->blocks_compact_nodes, (uint32_t)block_index);
     }
     else {
-        // In case there is only one element in the doubly-linked list, its next and prev fields will be equal to NULL.
-        uint8_t order = get_order_by_index(allocator_ptr, block_index);
-        if (allocator_ptr->free_blocks_lists[order].count == 1 && allocator_ptr->free_blocks_lists[order].head == dll_node_ptr && allocator_ptr->free_blocks_lists[order].tail == dll_node_ptr) {
-            return true;
+        dll_remove_node(&allocator_ptr->free_blocks_lists[get_free_list_index(allocator_ptr, type, order)], get_node_by_index(allocator_ptr, block_index, order));
+    }
+    clear_free_blocks_word_bits(allocator_ptr, block_index / 64, (uint64_t)1 << (block_index % 64));
+    allocator_ptr->free_memory_size -= (size_t)1 << (order + allocator_ptr->page_shift);
+    if (free_list_get_count(allocator_ptr, type, order) == 0) {
+        allocator_ptr->free_orders_masks[type] &= ~((uint64_t)1 << order);
+        uint64_t free_orders_mask = 0;
+        for (uint8_t i = 0; i < allocator_ptr->migrate_types_number; ++i) {
+            free_orders_mask |= allocator_ptr->free_orders_masks[i];
         }
-        return false;
+        // Untouched free large blocks are not in the lists, but the max order still has free blocks
+        if (has_untouched_free_large_blocks(allocator_ptr)) {
+            free_orders_mask |= (uint64_t)1 << allocator_ptr->max_order;
+        }
+        allocator_ptr->free_orders_mask = free_orders_mask;
     }
 }
 
-void buddy_allocator_preinit(buddy_allocator_t* allocator_ptr, uintptr_t area_start_addr, size_t area_size, uint8_t max_order, uint32_t page_size, bool allocate_all_small_blocks, size_t* required_memory_size_ptr)
+/*
+ * Moves the free large block to the free list of max order of another type
+ */
+static void change_free_large_block_type(buddy_allocator_t* allocator_ptr, size_t large_block_index, uint8_t type)
 {
-    if (page_size == 0) {
-        return;
-    }
-    if (allocator_ptr == NULL || area_start_addr == 0 || area_size == 0 || max_order >= 32 || (page_size && !(page_size & (page_size - 1))) == 0 || required_memory_size_ptr == NULL) {
-        return;
-    }
-    allocator_ptr->large_block_size = (1 << max_order) * page_size;
-    allocator_ptr->small_block_size = page_size;
-    if (area_size < allocator_ptr->large_block_size) {
-        // The memory area is less than one largest block, I don't want to work with it
-        return;
-    }
-
-    allocator_ptr->large_blocks_number = area_size / allocator_ptr->large_block_size;
-    allocator_ptr->small_blocks_number = allocator_ptr->large_blocks_number * (1 << max_order);
-    allocator_ptr->total_blocks_number = allocator_ptr->large_blocks_number * ((1 << (max_order + 1)) - 1);
-
-    allocator_ptr->area_start_addr = area_start_addr;
-    allocator_ptr->area_size = allocator_ptr->large_blocks_number * allocator_ptr->large_block_size;
-    allocator_ptr->max_order = max_order;
-    allocator_ptr->page_size = page_size;
-
-    allocator_ptr->allocate_all_small_blocks = allocate_all_small_blocks;
-
-    // For blocks nodes
-    allocator_ptr->blocks_nodes_memory_size = allocator_ptr->total_blocks_number * sizeof(memory_block_node_t);
-    // For free blocks lists
-    allocator_ptr->free_blocks_lists_memory_size = (allocator_ptr->max_order + 1) * sizeof(doubly_linked_list_t);
-    // For allocations orders array
-    allocator_ptr->allocations_orders_memory_size = allocator_ptr->small_blocks_number * sizeof(uint8_t);
+    free_list_remove(allocator_ptr, allocator_ptr->max_order, large_block_index);
+    allocator_ptr->large_block_types[large_block_index] = type;
+    free_list_insert_to_head(allocator_ptr, allocator_ptr->max_order, large_block_index);
+}
 
-    /*
-    // Debug
-    if (area_size == 4194304) {
-        FILE* file = fopen("debug_output.txt", "wb");
-        for (uint32_t i = 0; i < allocator_ptr->total_blocks_number; ++i) {
-            static uint32_t prev_order = BUDDY_ALLOCATOR_MAX_ORDER;
-            uint32_t order = get_order_by_index(allocator_ptr, i);
-            if (order != prev_order) {
-                prev_order = order;
-                fprintf(file, "\n");
-            }
-            fprintf(file, "%u ", order);
+/*
+ * Clears the bits of blocks_number blocks starting from the first block in the free blocks bitmap
+ * Only these bits are changed, the other bits of the words may belong to large blocks which are not touched yet
+ */
+static void clear_free_blocks_bits(buddy_allocator_t* allocator_ptr, size_t first_block_index, size_t blocks_number)
+{
+    size_t block_index = first_block_index;
+    size_t end_block_index = first_block_index + blocks_number;
+    while (block_index < end_block_index) {
+        size_t bit_index = block_index % 64;
+        size_t bits_number = 64 - bit_index;
+        if (bits_number > end_block_index - block_index) {
+            bits_number = end_block_index - block_index;
         }
-        fclose(file);
+        uint64_t bits_mask = (bits_number == 64) ? ~(uint64_t)0 : (((uint64_t)1 << bits_number) - 1) << bit_index;
+        clear_free_blocks_word_bits(allocator_ptr, block_index / 64, bits_mask);
+        block_index += bits_number;
     }
-    */
-
-    // Calculate required memory
-    // [blocks_nodes free_blocks_lists allocations_orders]
-    *required_memory_size_ptr = allocator_ptr->blocks_nodes_memory_size + allocator_ptr->free_blocks_lists_memory_size + allocator_ptr->allocations_orders_memory_size;
 }
 
-void buddy_allocator_init(buddy_allocator_t* allocator_ptr, void* required_memory_ptr)
+/*
+ * Initializes the metadata of all untouched large blocks before the end large block index (not including)
+ * Free large blocks are put to the tail of the free list of max order, as buddy_allocator_init does without BUDDY_ALLOCATOR_FLAG_LAZY_INIT
+ */
+static void touch_large_blocks(buddy_allocator_t* allocator_ptr, size_t end_large_block_index)
 {
-    if (allocator_ptr == NULL || required_memory_ptr == NULL) {
-        return;
+    while (allocator_ptr->untouched_large_block_index < end_large_block_index) {
+        size_t large_block_index = allocator_ptr->untouched_large_block_index;
+        // Pages of the block
+        memset(&allocator_ptr->allocations_orders[large_block_index << allocator_ptr->max_order], allocator_ptr->allocate_all_small_blocks ? 1 : 0, (size_t)1 << allocator_ptr->max_order);
+        // Nodes of the block, 2^depth nodes of each depth
+        for (uint8_t depth = 0; depth <= allocator_ptr->max_order; ++depth) {
+            clear_free_blocks_bits(allocator_ptr, allocator_ptr->first_index_by_depth[depth] + (large_block_index << depth), (size_t)1 << depth);
+        }
+        if (allocator_ptr->migrate_types_number > 1) {
+            allocator_ptr->large_block_types[large_block_index] = get_initial_block_type(allocator_ptr);
+        }
+        // The per-CPU caches read the index without the global lock, the metadata of the block must be visible before the index is changed
+        atomics_store_release_size(&allocator_ptr->untouched_large_block_index, large_block_index + 1);
+        if (allocator_ptr->allocate_all_small_blocks == false) {
+            // The block is already counted in free_memory_size
+            allocator_ptr->free_memory_size -= allocator_ptr->large_block_size;
+            free_list_insert_to_tail(allocator_ptr, allocator_ptr->max_order, large_block_index);
+        }
     }
+}
 
-    // Setting up required memory
-    // required_memory_ptr = [blocks_nodes free_blocks_lists allocations_orders]
-    // Blocks nodes
-    allocator_ptr->blocks_nodes = required_memory_ptr;
-    // Free blocks lists
-    allocator_ptr->free_blocks_lists = (doubly_linked_list_t*)((uintptr_t)allocator_ptr->blocks_nodes + allocator_ptr->blocks_nodes_memory_size);
-    // Allocations orders array
-    allocator_ptr->allocations_orders = (uint8_t*)((uintptr_t)allocator_ptr->free_blocks_lists + allocator_ptr->free_blocks_lists_memory_size);
-    
-    memset(allocator_ptr->blocks_nodes, 0, allocator_ptr->blocks_nodes_memory_size);
-    memset(allocator_ptr->free_blocks_lists, 0, allocator_ptr->free_blocks_lists_memory_size);
-    if (allocator_ptr->allocate_all_small_blocks) {
-        // Mark all small block as allocated
-        memset(allocator_ptr->allocations_orders, 1, allocator_ptr->allocations_orders_memory_size);
-    }
-    else {
-        memset(allocator_ptr->allocations_orders, 0, allocator_ptr->allocations_orders_memory_size);
-    }
+/*
+ * Touches the large blocks up to the one which contains the page, so that the metadata of the page can be used
+ */
+static void touch_page(buddy_allocator_t* allocator_ptr, size_t page_index)
+{
+    touch_large_blocks(allocator_ptr, (page_index >> allocator_ptr->max_order) + 1);
+}
 
-    if (allocator_ptr->allocate_all_small_blocks == false) {
-        // Right now all of our large blocks are free, let's put them on the free list
-        for (uint32_t index = 0; index < allocator_ptr->large_blocks_number; ++index) {
-            memory_block_node_t* memory_block_node = get_node_by_index(allocator_ptr, index);
-            dll_insert_node_to_tail(&allocator_ptr->free_blocks_lists[allocator_ptr->max_order], (dll_node_t*)memory_block_node);
+/*
+ * Finds the lowest-addressed free block of the order in the free blocks bitmap, see BUDDY_ALLOCATOR_FLAG_ADDRESS_ORDERED
+ * The blocks of the order are contiguous in the bitmap in the address order, the words without set bits are skipped by the summary.
+ * There is a single migrate type, so the first set bit is the block: one summary word per 4096 blocks of the order and one bitmap word are read.
+ * Only the bits of the touched large blocks are checked, the bits of the untouched ones aren't initialized.
+ * Returns SIZE_MAX if there are no such blocks.
+ */
+static size_t find_lowest_free_block(buddy_allocator_t* allocator_ptr, uint8_t order)
+{
+    uint8_t depth = allocator_ptr->max_order - order;
+    size_t block_index = allocator_ptr->first_index_by_depth[depth];
+    size_t end_block_index = block_index + (allocator_ptr->untouched_large_block_index << depth);
+    while (block_index < end_block_index) {
+        // The first word from the word of the block which may have set bits
+        size_t word_index = block_index / 64;
+        uint64_t summary_word = allocator_ptr->free_blocks_summary[word_index / 64] & (~(uint64_t)0 << (word_index % 64));
+        if (summary_word == 0) {
+            block_index = (word_index / 64 + 1) * 4096;
+            continue;
+        }
+        word_index = (word_index & ~(size_t)63) + bitops_find_first_set(summary_word);
+        if (word_index * 64 > block_index) {
+            block_index = word_index * 64;
+        }
+        // The first set bit from the block in the word
+        uint64_t word = allocator_ptr->free_blocks_bitmap[word_index] & (~(uint64_t)0 << (block_index % 64));
+        if (word == 0) {
+            block_index = (word_index + 1) * 64;
+            continue;
         }
+        block_index = word_index * 64 + bitops_find_first_set(word);
+        return block_index < end_block_index ? block_index : SIZE_MAX;
     }
+    return SIZE_MAX;
 }
 
-void* buddy_allocator_alloc(buddy_allocator_t* allocator_ptr, size_t size)
+/*
+ * Get index of the free block of the type and the order to allocate, the free list must not be empty
+ * It is the head of the free list, or the lowest-addressed block with BUDDY_ALLOCATOR_FLAG_ADDRESS_ORDERED
+ */
+static size_t get_free_block(buddy_allocator_t* allocator_ptr, uint8_t type, uint8_t order)
 {
-    if (allocator_ptr == NULL || size == 0 || size > allocator_ptr->large_block_size) {
-        return NULL;
-    }
-
-    uint8_t required_order = get_order_by_size(allocator_ptr, size);
-
-    // Trying to find a free block of required size
-    find_and_allocate_block:
-    if (allocator_ptr->free_blocks_lists[required_order].count > 0) {
-        // We found a free block of the requested size, we take it and remove it from the free list
-        // Take first free block node
-        memory_block_node_t* free_block_node_ptr = (memory_block_node_t*)allocator_ptr->free_blocks_lists[required_order].head;
-        uint32_t free_block_index = get_index_by_node(allocator_ptr, free_block_node_ptr);
-        uint32_t free_block_size = get_size_by_order(allocator_ptr, required_order);
-
-        // Calculate memory block addr
-        uintptr_t memory_block_addr = get_index_in_order_by_index(allocator_ptr, free_block_index) * free_block_size;
-
-        // Remove block from free list
-        //printf("A Remove node %u from order %u free list\n", get_index_by_node(allocator_ptr, free_block_node_ptr), required_order);
-        dll_remove_node(&allocator_ptr->free_blocks_lists[required_order], (dll_node_t*)free_block_node_ptr);
-        ((dll_node_t*)free_block_node_ptr)->next = NULL;
-        ((dll_node_t*)free_block_node_ptr)->prev = NULL;
-
-        // Save allocation order
-        allocator_ptr->allocations_orders[memory_block_addr / allocator_ptr->small_block_size] = (uint8_t)required_order + 1;
-
-        // Return calculated memory block addr
-        return (void*)(memory_block_addr + allocator_ptr->area_start_addr);
+    if (allocator_ptr->flags & BUDDY_ALLOCATOR_FLAG_ADDRESS_ORDERED) {
+        return find_lowest_free_block(allocator_ptr, order);
     }
-    else {
-        //printf("required %u\n", required_order);
-        // Failed to find a free block of the requested size, which means we need to recursively divide larger blocks until a free block of the requested size is created
-        // We're trying to allocate the largest block, but there isn't one
-        if (required_order == allocator_ptr->max_order) {
-            return NULL;
-        }
-        // Try to find free larger block
-        uint8_t current_order = required_order + 1;
-        while (allocator_ptr->free_blocks_lists[current_order].count == 0) {
-            if (current_order == allocator_ptr->max_order) {
-                return NULL;
-            }
-            current_order++;
-        }
-        // We found free larger block
-        // Split it
-        while (current_order > required_order) {
-            //printf("split order %u\n", current_order);
+    return free_list_get_head(allocator_ptr, type, order);
+}
 
-            memory_block_node_t* split_block_node_ptr = (memory_block_node_t*)allocator_ptr->free_blocks_lists[current_order].head;
-            uint32_t split_block_index = get_index_by_node(allocator_ptr, split_block_node_ptr);
-            uint32_t split_block_first_child_index = get_first_child_by_index(allocator_ptr, split_block_index);
-            uint32_t split_block_second_child_index = get_second_child_by_index(allocator_ptr, split_block_index);
-            //printf("index:%u f_c:%u s_c:%u\n", split_block_index, split_block_first_child_index, split_block_second_child_index);
-
-            // Split current block
-            // Put childs to the free list
-            memory_block_node_t* split_block_first_child_node_ptr = get_node_by_index(allocator_ptr, split_block_first_child_index);
-            memory_block_node_t* split_block_second_child_node_ptr = get_node_by_index(allocator_ptr, split_block_second_child_index);
-            //printf("A Put node %u in order %u free list\n", get_index_by_node(allocator_ptr, split_block_first_child_node_ptr), current_order - 1);
-            dll_insert_node_to_head(&allocator_ptr->free_blocks_lists[current_order - 1], (dll_node_t*)split_block_first_child_node_ptr);
-            //printf("A Put node %u in order %u free list\n", get_index_by_node(allocator_ptr, split_block_second_child_node_ptr), current_order - 1);
-            dll_insert_node_after_node(&allocator_ptr->free_blocks_lists[current_order - 1], (dll_node_t*)split_block_first_child_node_ptr, (dll_node_t*)split_block_second_child_node_ptr);
-
-            // Remove splitted block from the free list
-            //printf("A Remove node %u from order %u free list\n", get_index_by_node(allocator_ptr, split_block_node_ptr), current_order);
-            dll_remove_node(&allocator_ptr->free_blocks_lists[current_order], (dll_node_t*)split_block_node_ptr);
-            ((dll_node_t*)split_block_node_ptr)->next = NULL;
-            ((dll_node_t*)split_block_node_ptr)->prev = NULL;
+/*
+ * Types from which blocks are taken when there are no free blocks of the type, in the order of preference, like in Linux
+ */
+static const uint8_t g_fallback_types[BUDDY_ALLOCATOR_MIGRATE_TYPES_NUMBER][BUDDY_ALLOCATOR_MIGRATE_TYPES_NUMBER - 1] = {
+    [BUDDY_ALLOCATOR_MIGRATE_UNMOVABLE] = { BUDDY_ALLOCATOR_MIGRATE_RECLAIMABLE, BUDDY_ALLOCATOR_MIGRATE_MOVABLE },
+    [BUDDY_ALLOCATOR_MIGRATE_MOVABLE] = { BUDDY_ALLOCATOR_MIGRATE_RECLAIMABLE, BUDDY_ALLOCATOR_MIGRATE_UNMOVABLE },
+    [BUDDY_ALLOCATOR_MIGRATE_RECLAIMABLE] = { BUDDY_ALLOCATOR_MIGRATE_UNMOVABLE, BUDDY_ALLOCATOR_MIGRATE_MOVABLE },
+};
 
-            current_order--;
+/*
+ * Changes the type of a whole free large block of a fallback type to the type
+ * Returns false if there are no free large blocks of other types
+ */
+static bool steal_free_large_block(buddy_allocator_t* allocator_ptr, uint8_t type)
+{
+    for (uint8_t i = 0; i + 1 < allocator_ptr->migrate_types_number; ++i) {
+        uint8_t fallback_type = g_fallback_types[type][i];
+        if (allocator_ptr->free_orders_masks[fallback_type] & ((uint64_t)1 << allocator_ptr->max_order)) {
+            change_free_large_block_type(allocator_ptr, get_free_block(allocator_ptr, fallback_type, allocator_ptr->max_order), type);
+            return true;
         }
-
-        // Now we have a block of the requested size/order
-        goto find_and_allocate_block;
     }
+    return false;
 }
 
-void buddy_allocator_free(buddy_allocator_t* allocator_ptr, void* memory_ptr)
+/*
+ * Finds the free list to allocate a block of the required order of the type from
+ * Places the order and the type of the list to order_ptr and list_type_ptr, the list is not empty. Returns false if there are no suitable free blocks.
+ * If the type has no suitable blocks, a whole free large block is taken: stolen from another type or touched (BUDDY_ALLOCATOR_FLAG_LAZY_INIT).
+ * Only if there are no free large blocks, a smaller block of another type is used, its large block keeps its type.
+ * Without BUDDY_ALLOCATOR_FLAG_MIGRATE_TYPES there is only type 0, and this is just the search of the smallest suitable order.
+ */
+static bool find_free_list(buddy_allocator_t* allocator_ptr, uint8_t type, uint8_t required_order, uint8_t* order_ptr, uint8_t* list_type_ptr)
 {
-    if (allocator_ptr == NULL || memory_ptr == NULL) {
-        return;
+    // All orders less than required are masked out, the lowest remaining bit is the smallest suitable order
+    uint64_t suitable_orders_mask = ~(((uint64_t)1 << required_order) - 1);
+    if ((allocator_ptr->free_orders_mask & suitable_orders_mask) == 0) {
+        // There are no free blocks of the required size or larger
+        return false;
     }
-    if ((uintptr_t)memory_ptr < allocator_ptr->area_start_addr || (uintptr_t)memory_ptr >= allocator_ptr->area_start_addr + allocator_ptr->area_size) {
-        return;
+    if ((allocator_ptr->free_orders_masks[type] & suitable_orders_mask) == 0) {
+        if (!steal_free_large_block(allocator_ptr, type) && has_untouched_free_large_blocks(allocator_ptr)) {
+            // The touched block has the initial type, it is stolen if it is another type
+            touch_large_blocks(allocator_ptr, allocator_ptr->untouched_large_block_index + 1);
+            steal_free_large_block(allocator_ptr, type);
+        }
     }
-    uintptr_t memory_block_addr = (uintptr_t)memory_ptr - allocator_ptr->area_start_addr;
-    if (allocator_ptr->allocations_orders[memory_block_addr / allocator_ptr->small_block_size] == 0) {
-        // Block unnallocated
-        return;
+    if (allocator_ptr->free_orders_masks[type] & suitable_orders_mask) {
+        *order_ptr = bitops_find_first_set(allocator_ptr->free_orders_masks[type] & suitable_orders_mask);
+        *list_type_ptr = type;
+        return true;
     }
-    uint8_t freeing_block_order = allocator_ptr->allocations_orders[memory_block_addr / allocator_ptr->small_block_size] - 1;
-    allocator_ptr->allocations_orders[memory_block_addr / allocator_ptr->small_block_size] = 0;
 
-    uint32_t freeing_block_in_order_index = memory_block_addr / get_size_by_order(allocator_ptr, freeing_block_order);
-    uint32_t freeing_block_index = get_index_by_in_order_index(allocator_ptr, freeing_block_in_order_index, freeing_block_order);
+    // Fallback without stealing, the large block is fragmented by the allocation of another type
+    for (uint8_t i = 0; i + 1 < allocator_ptr->migrate_types_number; ++i) {
+        uint8_t fallback_type = g_fallback_types[type][i];
+        if (allocator_ptr->free_orders_masks[fallback_type] & suitable_orders_mask) {
+            *order_ptr = bitops_find_first_set(allocator_ptr->free_orders_masks[fallback_type] & suitable_orders_mask);
+            *list_type_ptr = fallback_type;
+            return true;
+        }
+    }
+    return false;
+}
 
+/*
+ * Puts the block to the free list, merging it with its buddies while they are free
+ * The block must be already marked as not allocated
+ * Returns the order of the block put to the free list, it is larger than the order of the freed block by the number of merges
+ */
+static uint8_t free_block(buddy_allocator_t* allocator_ptr, size_t freeing_block_index, uint8_t freeing_block_order)
+{
     try_free_block:
     // We try to free largest block?
     if (freeing_block_order == allocator_ptr->max_order) {
         // Put block to free list
-        memory_block_node_t* freeing_block_node_ptr = get_node_by_index(allocator_ptr, freeing_block_index);
-        //printf("F Put node %u in order %u free list\n", get_index_by_node(allocator_ptr, freeing_block_node_ptr), allocator_ptr->max_order);
-        dll_insert_node_to_head(&allocator_ptr->free_blocks_lists[allocator_ptr->max_order], (dll_node_t*)freeing_block_node_ptr);
+        //printf("F Put node %u in order %u free list\n", freeing_block_index, allocator_ptr->max_order);
+        free_list_insert_to_head(allocator_ptr, allocator_ptr->max_order, freeing_block_index);
     }
     else {
         // We need to merge blocks if two buddies are free
-        uint32_t freeing_block_buddy_index = get_buddy_by_index(allocator_ptr, freeing_block_index);
+        size_t freeing_block_buddy_index = get_buddy_by_index(allocator_ptr, freeing_block_index);
         //printf("%u %u\n", freeing_block_index, freeing_block_buddy_index);
 
         // Buddy is in free list?
         if (is_block_in_free_list_by_index(allocator_ptr, freeing_block_buddy_index)) {
             // Buddy is in free list
             // Remove buddy from free list
-            memory_block_node_t* freeing_block_buddy_node_ptr = get_node_by_index(allocator_ptr, freeing_block_buddy_index);
-            //printf("F Remove node %u from order %u free list\n", get_index_by_node(allocator_ptr, freeing_block_buddy_node_ptr), freeing_block_order);
-            dll_remove_node(&allocator_ptr->free_blocks_lists[freeing_block_order], (dll_node_t*)freeing_block_buddy_node_ptr);
+            //printf("F Remove node %u from order %u free list\n", freeing_block_buddy_index, freeing_block_order);
+            free_list_remove(allocator_ptr, freeing_block_order, freeing_block_buddy_index);
             // Go to parent
             freeing_block_index = get_parent_by_index(allocator_ptr, freeing_block_index);
             freeing_block_order++;
+            BUDDY_ALLOCATOR_STATS_UPDATE(allocator_ptr->stats.merges[freeing_block_order]++);
             goto try_free_block;
         }
         else {
@@ -426,9 +410,1420 @@ void buddy_allocator_free(buddy_allocator_t* allocator_ptr, void* memory_ptr)
             // Add block to free list
             // We add it to the tail, so it is less likely that it will be allocated and we are more likely to be able to merge blocks
             // If we were add blocks to head, then probably the buddies would never be free at the same time
-            memory_block_node_t* freeing_block_node_ptr = get_node_by_index(allocator_ptr, freeing_block_index);
-            //printf("F Put node %u in order %u free list\n", get_index_by_node(allocator_ptr, freeing_block_node_ptr), freeing_block_order);
-            dll_insert_node_to_tail(&allocator_ptr->free_blocks_lists[freeing_block_order], (dll_node_t*)freeing_block_node_ptr);
+            //printf("F Put node %u in order %u free list\n", freeing_block_index, freeing_block_order);
+            free_list_insert_to_tail(allocator_ptr, freeing_block_order, freeing_block_index);
+        }
+    }
+    return freeing_block_order;
+}
+
+/*
+ * Frees the allocation that starts at the page, the allocations orders entry of the page must be the start of an allocation
+ * If it is a run allocated by buddy_allocator_alloc_exact, the following blocks of the run are freed too
+ * Returns the number of merges
+ */
+static size_t free_allocation(buddy_allocator_t* allocator_ptr, size_t memory_block_page_index)
+{
+    size_t merges_number = 0;
+    do {
+        uint8_t freeing_block_order = (allocator_ptr->allocations_orders[memory_block_page_index] & ~BUDDY_ALLOCATOR_CONTINUATION_FLAG) - 1;
+        allocator_ptr->allocations_orders[memory_block_page_index] = 0;
+
+        size_t freeing_block_in_order_index = memory_block_page_index >> freeing_block_order;
+        size_t freeing_block_index = get_index_by_in_order_index(allocator_ptr, freeing_block_in_order_index, freeing_block_order);
+        merges_number += free_block(allocator_ptr, freeing_block_index, freeing_block_order) - freeing_block_order;
+
+        memory_block_page_index += (size_t)1 << freeing_block_order;
+        // A run never crosses a large block, the next large block may be not touched yet
+    } while ((memory_block_page_index & (((size_t)1 << allocator_ptr->max_order) - 1)) != 0 && (allocator_ptr->allocations_orders[memory_block_page_index] & BUDDY_ALLOCATOR_CONTINUATION_FLAG));
+    return merges_number;
+}
+
+/*
+ * Get the index of the quicklist of the type and the order in quicklists_counts, see BUDDY_ALLOCATOR_FLAG_QUICKLISTS
+ */
+static size_t get_quicklist_index(uint8_t type, uint8_t order)
+{
+    return (size_t)type * BUDDY_ALLOCATOR_QUICKLIST_ORDERS_NUMBER + order;
+}
+
+/*
+ * Clears the order in the quicklist orders mask if the quicklists of all types of the order are empty
+ */
+static void update_quicklist_orders_mask(buddy_allocator_t* allocator_ptr, uint8_t order)
+{
+    for (uint8_t type = 0; type < allocator_ptr->migrate_types_number; ++type) {
+        if (allocator_ptr->quicklists_counts[get_quicklist_index(type, order)] != 0) {
+            return;
+        }
+    }
+    allocator_ptr->quicklist_orders_mask &= ~((uint64_t)1 << order);
+}
+
+/*
+ * Coalesces the oldest blocks_number blocks of the quicklist of the type and the order, they are freed with merging
+ * Returns the number of merges
+ */
+static size_t coalesce_quicklist(buddy_allocator_t* allocator_ptr, uint8_t type, uint8_t order, size_t blocks_number)
+{
+    size_t quicklist_index = get_quicklist_index(type, order);
+    size_t* quicklist = allocator_ptr->quicklists + quicklist_index * BUDDY_ALLOCATOR_QUICKLIST_HIGH;
+    size_t count = allocator_ptr->quicklists_counts[quicklist_index];
+    if (blocks_number > count) {
+        blocks_number = count;
+    }
+    // The blocks are counted as free already, free_block counts them again
+    allocator_ptr->free_memory_size -= blocks_number << (order + allocator_ptr->page_shift);
+    size_t merges_number = 0;
+    for (size_t i = 0; i < blocks_number; ++i) {
+        merges_number += free_block(allocator_ptr, quicklist[i], order) - order;
+    }
+    memmove(quicklist, quicklist + blocks_number, (count - blocks_number) * sizeof(size_t));
+    allocator_ptr->quicklists_counts[quicklist_index] = (uint32_t)(count - blocks_number);
+    update_quicklist_orders_mask(allocator_ptr, order);
+    return merges_number;
+}
+
+/*
+ * Coalesces all quicklisted blocks
+ * Returns the number of merges
+ */
+static size_t coalesce_quicklists(buddy_allocator_t* allocator_ptr)
+{
+    size_t merges_number = 0;
+    if (allocator_ptr->quicklist_orders_mask == 0) {
+        return merges_number;
+    }
+    for (uint8_t type = 0; type < allocator_ptr->migrate_types_number; ++type) {
+        for (uint8_t order = 0; order < allocator_ptr->quicklist_orders_number; ++order) {
+            merges_number += coalesce_quicklist(allocator_ptr, type, order, BUDDY_ALLOCATOR_QUICKLIST_HIGH);
+        }
+    }
+    return merges_number;
+}
+
+/*
+ * Puts the freed block to the top of the quicklist of its type and order, the oldest blocks are coalesced if the quicklist is full
+ * The block must be already marked as not allocated
+ * Returns the number of merges of the coalesced blocks
+ */
+static size_t quicklist_push(buddy_allocator_t* allocator_ptr, size_t block_index, uint8_t order)
+{
+    uint8_t type = get_block_type(allocator_ptr, block_index, order);
+    size_t quicklist_index = get_quicklist_index(type, order);
+    size_t merges_number = 0;
+    if (allocator_ptr->quicklists_counts[quicklist_index] == BUDDY_ALLOCATOR_QUICKLIST_HIGH) {
+        merges_number = coalesce_quicklist(allocator_ptr, type, order, BUDDY_ALLOCATOR_QUICKLIST_BATCH);
+    }
+    allocator_ptr->quicklists[quicklist_index * BUDDY_ALLOCATOR_QUICKLIST_HIGH + allocator_ptr->quicklists_counts[quicklist_index]++] = block_index;
+    allocator_ptr->quicklist_orders_mask |= (uint64_t)1 << order;
+    allocator_ptr->free_memory_size += (size_t)1 << (order + allocator_ptr->page_shift);
+    return merges_number;
+}
+
+/*
+ * Takes the last freed block from the quicklist of the type and the order, returns SIZE_MAX if the quicklist is empty
+ */
+static size_t quicklist_pop(buddy_allocator_t* allocator_ptr, uint8_t type, uint8_t order)
+{
+    if (order >= allocator_ptr->quicklist_orders_number) {
+        return SIZE_MAX;
+    }
+    size_t quicklist_index = get_quicklist_index(type, order);
+    if (allocator_ptr->quicklists_counts[quicklist_index] == 0) {
+        return SIZE_MAX;
+    }
+    size_t block_index = allocator_ptr->quicklists[quicklist_index * BUDDY_ALLOCATOR_QUICKLIST_HIGH + --allocator_ptr->quicklists_counts[quicklist_index]];
+    if (allocator_ptr->quicklists_counts[quicklist_index] == 0) {
+        update_quicklist_orders_mask(allocator_ptr, order);
+    }
+    allocator_ptr->free_memory_size -= (size_t)1 << (order + allocator_ptr->page_shift);
+    return block_index;
+}
+
+/*
+ * Records the operation to the attached trace ring, without BUDDY_ALLOCATOR_TRACE it does nothing
+ * block_offset offset of the block from the start of the area in bytes
+ */
+static inline void trace_record(buddy_allocator_t* allocator_ptr, uint8_t operation, uint8_t order, uintptr_t block_offset, uint32_t value)
+{
+#ifdef BUDDY_ALLOCATOR_TRACE
+    if (allocator_ptr->trace_ptr != NULL) {
+        buddy_allocator_trace_record(allocator_ptr->trace_ptr, operation, order, block_offset, value);
+    }
+#else
+    (void)allocator_ptr;
+    (void)operation;
+    (void)order;
+    (void)block_offset;
+    (void)value;
+#endif
+}
+
+/*
+ * Records the pages range, it is split into several records if the number of pages doesn't fit the value
+ */
+static void trace_record_range(buddy_allocator_t* allocator_ptr, uint8_t operation, size_t first_page_index, size_t end_page_index)
+{
+    while (first_page_index < end_page_index) {
+        size_t pages_number = end_page_index - first_page_index < UINT32_MAX ? end_page_index - first_page_index : UINT32_MAX;
+        trace_record(allocator_ptr, operation, 0, (uintptr_t)first_page_index << allocator_ptr->page_shift, (uint32_t)pages_number);
+        first_page_index += pages_number;
+    }
+}
+
+/*
+ * Marks all blocks of the order inside the block as allocated and writes their addresses to the array
+ * The block must be already removed from the free lists or never put there
+ * is_split_block is true if the block is a half of a larger block split by the caller, then its blocks are counted as slow allocations
+ */
+static void hand_out_block(buddy_allocator_t* allocator_ptr, size_t block_index, uint8_t block_order, uint8_t order, bool is_split_block, void** blocks_array, size_t* allocated_blocks_number_ptr)
+{
+    uintptr_t block_addr = (uintptr_t)get_index_in_order_by_index(allocator_ptr, block_index) << (block_order + allocator_ptr->page_shift);
+    size_t pieces_number = (size_t)1 << (block_order - order);
+    for (size_t i = 0; i < pieces_number; ++i) {
+        uintptr_t piece_addr = block_addr + ((uintptr_t)i << (order + allocator_ptr->page_shift));
+        allocator_ptr->allocations_orders[piece_addr >> allocator_ptr->page_shift] = order + 1;
+        blocks_array[(*allocated_blocks_number_ptr)++] = (void*)(piece_addr + allocator_ptr->area_start_addr);
+        trace_record(allocator_ptr, BUDDY_ALLOCATOR_TRACE_ALLOC, order, piece_addr, BUDDY_ALLOCATOR_MIGRATE_UNMOVABLE);
+    }
+#ifdef BUDDY_ALLOCATOR_STATS
+    // The block is split into the pieces at once, 2^(block_order - k) blocks of each order k above the order are split
+    for (uint8_t split_order = order + 1; split_order <= block_order; ++split_order) {
+        allocator_ptr->stats.splits[split_order] += (uint64_t)1 << (block_order - split_order);
+    }
+    // Only a block found in the free list of the order (or in the quicklist) is handed out without splitting
+    if (block_order == order && !is_split_block) {
+        allocator_ptr->stats.fast_allocations[order]++;
+    }
+    else {
+        allocator_ptr->stats.slow_allocations[order] += pieces_number;
+    }
+    // The whole blocks are requested
+    allocator_ptr->stats.requested_memory_size += (uint64_t)pieces_number << (order + allocator_ptr->page_shift);
+    allocator_ptr->stats.granted_memory_size += (uint64_t)pieces_number << (order + allocator_ptr->page_shift);
+#else
+    (void)is_split_block;
+#endif
+}
+
+/*
+ * Sorts the addresses in ascending order, heapsort, so it needs no memory and has no quadratic worst case
+ */
+static void sort_addresses(void** array, size_t count)
+{
+    // Blocks allocated by buddy_allocator_alloc_bulk are usually freed in the same order, there is no need to sort them
+    size_t sorted_prefix_length = 1;
+    while (sorted_prefix_length < count && (uintptr_t)array[sorted_prefix_length - 1] <= (uintptr_t)array[sorted_prefix_length]) {
+        sorted_prefix_length++;
+    }
+    if (sorted_prefix_length >= count) {
+        return;
+    }
+    // Build max-heap, then move the maximum to the end one by one
+    for (size_t i = count / 2; i > 0; --i) {
+        size_t parent = i - 1;
+        while (parent * 2 + 1 < count) {
+            size_t child = parent * 2 + 1;
+            if (child + 1 < count && (uintptr_t)array[child + 1] > (uintptr_t)array[child]) {
+                child++;
+            }
+            if ((uintptr_t)array[parent] >= (uintptr_t)array[child]) {
+                break;
+            }
+            void* temp = array[parent];
+            array[parent] = array[child];
+            array[child] = temp;
+            parent = child;
+        }
+    }
+    for (size_t heap_size = count - 1; heap_size > 0; --heap_size) {
+        void* temp = array[0];
+        array[0] = array[heap_size];
+        array[heap_size] = temp;
+        size_t parent = 0;
+        while (parent * 2 + 1 < heap_size) {
+            size_t child = parent * 2 + 1;
+            if (child + 1 < heap_size && (uintptr_t)array[child + 1] > (uintptr_t)array[child]) {
+                child++;
+            }
+            if ((uintptr_t)array[parent] >= (uintptr_t)array[child]) {
+                break;
+            }
+            temp = array[parent];
+            array[parent] = array[child];
+            array[child] = temp;
+            parent = child;
+        }
+    }
+}
+
+/*
+ * Get the order of the largest naturally aligned block that starts at the page and ends not later than the end page
+ */
+static uint8_t get_largest_block_order(buddy_allocator_t* allocator_ptr, size_t page_index, size_t end_page_index)
+{
+    uint8_t order = allocator_ptr->max_order;
+    if (page_index != 0 && bitops_find_first_set(page_index) < order) {
+        order = bitops_find_first_set(page_index);
+    }
+    if (bitops_find_last_set(end_page_index - page_index) < order) {
+        order = bitops_find_last_set(end_page_index - page_index);
+    }
+    return order;
+}
+
+/*
+ * Puts the pages from page_index to end_page_index (not including) to the free lists as maximal aligned blocks without merging
+ * The pages must be a part of a block which was just removed from the free lists, so their buddies are not free
+ */
+static void insert_free_pages(buddy_allocator_t* allocator_ptr, size_t page_index, size_t end_page_index)
+{
+    while (page_index < end_page_index) {
+        uint8_t order = get_largest_block_order(allocator_ptr, page_index, end_page_index);
+        free_list_insert_to_tail(allocator_ptr, order, get_index_by_in_order_index(allocator_ptr, page_index >> order, order));
+        page_index += (size_t)1 << order;
+    }
+}
+
+/*
+ * Finds the free block that contains the page
+ * Returns false if the page is not free
+ */
+static bool find_free_block_by_page(buddy_allocator_t* allocator_ptr, size_t page_index, size_t* block_index_ptr, uint8_t* block_order_ptr)
+{
+    for (uint8_t order = 0; order <= allocator_ptr->max_order; ++order) {
+        size_t block_index = get_index_by_in_order_index(allocator_ptr, page_index >> order, order);
+        if (is_block_in_free_list_by_index(allocator_ptr, block_index)) {
+            *block_index_ptr = block_index;
+            *block_order_ptr = order;
+            return true;
         }
     }
+    return false;
+}
+
+/*
+ * Get the start of the blocks nodes in the required memory
+ */
+static void* get_blocks_nodes_memory(buddy_allocator_t* allocator_ptr)
+{
+    return (void*)((uintptr_t)allocator_ptr->free_blocks_bitmap + allocator_ptr->free_blocks_bitmap_memory_size + allocator_ptr->free_blocks_summary_memory_size);
+}
+
+/*
+ * Sets the pointers to the parts of the required memory and initializes the free lists heads, the lists are empty
+ */
+static void set_up_required_memory(buddy_allocator_t* allocator_ptr, void* required_memory_ptr)
+{
+    // Setting up required memory
+    // required_memory_ptr = [quicklists free_blocks_bitmap free_blocks_summary blocks_nodes free_blocks_lists allocations_orders large_block_types]
+    // Quicklists, NULL without BUDDY_ALLOCATOR_FLAG_QUICKLISTS
+    allocator_ptr->quicklists = allocator_ptr->quicklists_memory_size != 0 ? required_memory_ptr : NULL;
+    memset(allocator_ptr->quicklists_counts, 0, sizeof(allocator_ptr->quicklists_counts));
+    allocator_ptr->quicklist_orders_mask = 0;
+    // Free blocks bitmap
+    allocator_ptr->free_blocks_bitmap = (uint64_t*)((uintptr_t)required_memory_ptr + allocator_ptr->quicklists_memory_size);
+    // Summary of the bitmap, NULL without BUDDY_ALLOCATOR_FLAG_ADDRESS_ORDERED
+    // It is 1/64 of the bitmap, so it is cleared even with BUDDY_ALLOCATOR_FLAG_LAZY_INIT, the bits are set when blocks are put to the free lists
+    allocator_ptr->free_blocks_summary = NULL;
+    if (allocator_ptr->free_blocks_summary_memory_size != 0) {
+        allocator_ptr->free_blocks_summary = (uint64_t*)((uintptr_t)allocator_ptr->free_blocks_bitmap + allocator_ptr->free_blocks_bitmap_memory_size);
+        memset(allocator_ptr->free_blocks_summary, 0, allocator_ptr->free_blocks_summary_memory_size);
+    }
+    // Blocks nodes and free blocks lists
+    void* blocks_nodes_ptr = get_blocks_nodes_memory(allocator_ptr);
+    void* free_blocks_lists_ptr = (void*)((uintptr_t)blocks_nodes_ptr + allocator_ptr->blocks_nodes_memory_size);
+    // Allocations orders array
+    allocator_ptr->allocations_orders = (uint8_t*)((uintptr_t)free_blocks_lists_ptr + allocator_ptr->free_blocks_lists_memory_size);
+    // Large blocks types, NULL without BUDDY_ALLOCATOR_FLAG_MIGRATE_TYPES
+    allocator_ptr->large_block_types = NULL;
+    if (allocator_ptr->large_block_types_memory_size != 0) {
+        allocator_ptr->large_block_types = allocator_ptr->allocations_orders + allocator_ptr->allocations_orders_memory_size;
+    }
+
+    if (allocator_ptr->flags & BUDDY_ALLOCATOR_FLAG_COMPACT_NODES) {
+        allocator_ptr->blocks_nodes = NULL;
+        allocator_ptr->blocks_compact_nodes = blocks_nodes_ptr;
+        allocator_ptr->free_blocks_lists = NULL;
+        allocator_ptr->free_blocks_index_lists = free_blocks_lists_ptr;
+        for (size_t list_index = 0; list_index < (size_t)allocator_ptr->migrate_types_number * (allocator_ptr->max_order + 1); ++list_index) {
+            dll_index_init_list(&allocator_ptr->free_blocks_index_lists[list_index]);
+        }
+    }
+    else {
+        // With BUDDY_ALLOCATOR_FLAG_IN_BLOCK_NODES blocks_nodes_memory_size is 0, and blocks_nodes isn't used
+        allocator_ptr->blocks_nodes = blocks_nodes_ptr;
+        allocator_ptr->blocks_compact_nodes = NULL;
+        allocator_ptr->free_blocks_lists = free_blocks_lists_ptr;
+        allocator_ptr->free_blocks_index_lists = NULL;
+        memset(allocator_ptr->free_blocks_lists, 0, allocator_ptr->free_blocks_lists_memory_size);
+    }
+    allocator_ptr->free_orders_mask = 0;
+    memset(allocator_ptr->free_orders_masks, 0, sizeof(allocator_ptr->free_orders_masks));
+    allocator_ptr->free_memory_size = 0;
+    allocator_ptr->untouched_large_block_index = 0;
+    allocator_ptr->has_runs = 0;
+    BUDDY_ALLOCATOR_STATS_UPDATE(memset(&allocator_ptr->stats, 0, sizeof(buddy_allocator_stats_t)));
+#ifdef BUDDY_ALLOCATOR_LATENCY
+    allocator_ptr->latency_ptr = NULL;
+#endif
+#ifdef BUDDY_ALLOCATOR_TRACE
+    allocator_ptr->trace_ptr = NULL;
+#endif
+}
+
+/*
+ * Splits items_number items between tasks_number tasks as evenly as possible, the range of the task is [first, end)
+ */
+static void get_task_range(size_t items_number, size_t tasks_number, size_t task_index, size_t* first_item_index_ptr, size_t* end_item_index_ptr)
+{
+    size_t items_per_task = items_number / tasks_number;
+    size_t remainder = items_number % tasks_number;
+    // The first remainder tasks get one item more
+    *first_item_index_ptr = task_index * items_per_task + (task_index < remainder ? task_index : remainder);
+    *end_item_index_ptr = *first_item_index_ptr + items_per_task + (task_index < remainder ? 1 : 0);
+}
+
+// Data of the tasks of buddy_allocator_init_parallel
+typedef struct {
+    buddy_allocator_t* allocator_ptr;
+    size_t tasks_number;
+} init_task_data_t;
+
+/*
+ * Task of buddy_allocator_init_parallel, the tasks never write the same memory:
+ * each task initializes the nodes and the allocations orders of its range of large blocks and links the large blocks into a list segment,
+ * and writes its range of the bitmap words, the bits of the nodes of different large blocks can be in one word, so the words are split separately.
+ */
+static void init_task(void* task_data_ptr, size_t task_index)
+{
+    init_task_data_t* task_data = task_data_ptr;
+    buddy_allocator_t* allocator_ptr = task_data->allocator_ptr;
+
+    // Bitmap words, only the bits of the large blocks are set, they are the first large_blocks_number bits
+    size_t first_word_index = 0;
+    size_t end_word_index = 0;
+    get_task_range(allocator_ptr->free_blocks_bitmap_memory_size / sizeof(uint64_t), task_data->tasks_number, task_index, &first_word_index, &end_word_index);
+    size_t free_bits_number = allocator_ptr->allocate_all_small_blocks ? 0 : allocator_ptr->large_blocks_number;
+    for (size_t word_index = first_word_index; word_index < end_word_index; ++word_index) {
+        if (free_bits_number >= (word_index + 1) * 64) {
+            allocator_ptr->free_blocks_bitmap[word_index] = ~(uint64_t)0;
+        }
+        else if (free_bits_number > word_index * 64) {
+            allocator_ptr->free_blocks_bitmap[word_index] = ((uint64_t)1 << (free_bits_number - word_index * 64)) - 1;
+        }
+        else {
+            allocator_ptr->free_blocks_bitmap[word_index] = 0;
+        }
+    }
+
+    size_t first_large_block_index = 0;
+    size_t end_large_block_index = 0;
+    get_task_range(allocator_ptr->large_blocks_number, task_data->tasks_number, task_index, &first_large_block_index, &end_large_block_index);
+    if (first_large_block_index == end_large_block_index) {
+        return;
+    }
+
+    // Pages of the large blocks
+    size_t first_page_index = first_large_block_index << allocator_ptr->max_order;
+    size_t end_page_index = end_large_block_index << allocator_ptr->max_order;
+    memset(&allocator_ptr->allocations_orders[first_page_index], allocator_ptr->allocate_all_small_blocks ? 1 : 0, end_page_index - first_page_index);
+    if (allocator_ptr->large_block_types != NULL) {
+        memset(&allocator_ptr->large_block_types[first_large_block_index], get_initial_block_type(allocator_ptr), end_large_block_index - first_large_block_index);
+    }
+
+    // Nodes of the large blocks, the nodes of each depth are contiguous
+    if (allocator_ptr->blocks_nodes_memory_size != 0) {
+        size_t node_size = (allocator_ptr->flags & BUDDY_ALLOCATOR_FLAG_COMPACT_NODES) ? sizeof(memory_block_compact_node_t) : sizeof(memory_block_node_t);
+        for (uint8_t depth = 0; depth <= allocator_ptr->max_order; ++depth) {
+            size_t first_node_index = allocator_ptr->first_index_by_depth[depth] + (first_large_block_index << depth);
+            size_t nodes_number = (end_large_block_index - first_large_block_index) << depth;
+            memset((uint8_t*)get_blocks_nodes_memory(allocator_ptr) + first_node_index * node_size, 0, nodes_number * node_size);
+        }
+    }
+
+    if (allocator_ptr->allocate_all_small_blocks == false) {
+        // The segment is linked in a local list, buddy_allocator_init_parallel joins the segments
+        if (allocator_ptr->flags & BUDDY_ALLOCATOR_FLAG_COMPACT_NODES) {
+            doubly_linked_index_list_t segment;
+            dll_index_init_list(&segment);
+            for (size_t index = first_large_block_index; index < end_large_block_index; ++index) {
+                dll_index_insert_node_to_tail(&segment, (dll_index_node_t*)allocator_ptr->blocks_compact_nodes, (uint32_t)index);
+            }
+        }
+        else {
+            doubly_linked_list_t segment = { NULL, NULL, 0 };
+            for (size_t index = first_large_block_index; index < end_large_block_index; ++index) {
+                dll_insert_node_to_tail(&segment, get_node_by_index(allocator_ptr, index, allocator_ptr->max_order));
+            }
+        }
+    }
+}
+
+#ifdef BUDDY_ALLOCATOR_LATENCY
+/*
+ * Counts the call in the histogram, the bucket is the number of significant bits of the cycles
+ */
+static void record_latency(uint64_t* histogram, uint64_t cycles)
+{
+    uint8_t bucket = (cycles == 0) ? 0 : bitops_find_last_set(cycles) + 1;
+    if (bucket >= BUDDY_ALLOCATOR_LATENCY_BUCKETS_NUMBER) {
+        bucket = BUDDY_ALLOCATOR_LATENCY_BUCKETS_NUMBER - 1;
+    }
+    histogram[bucket]++;
+}
+#endif
+
+/*
+ * Get number of free blocks of the order of all types, the counters of the free lists are used
+ * Free large blocks which are not touched yet and quicklisted blocks are counted too
+ */
+static size_t get_free_blocks_number(buddy_allocator_t* allocator_ptr, uint8_t order)
+{
+    size_t free_blocks_number = 0;
+    for (uint8_t type = 0; type < allocator_ptr->migrate_types_number; ++type) {
+        free_blocks_number += free_list_get_count(allocator_ptr, type, order);
+        if (order < allocator_ptr->quicklist_orders_number) {
+            free_blocks_number += allocator_ptr->quicklists_counts[get_quicklist_index(type, order)];
+        }
+    }
+    if (order == allocator_ptr->max_order && has_untouched_free_large_blocks(allocator_ptr)) {
+        free_blocks_number += allocator_ptr->large_blocks_number - allocator_ptr->untouched_large_block_index;
+    }
+    return free_blocks_number;
+}
+
+/*
+ * Text written to a buffer of limited size, the length of the whole text is counted even if it doesn't fit
+ */
+typedef struct {
+    char* buffer;
+    size_t buffer_size;
+    size_t length;
+} text_writer_t;
+
+static void write_char(text_writer_t* writer_ptr, char character)
+{
+    if (writer_ptr->length + 1 < writer_ptr->buffer_size) {
+        writer_ptr->buffer[writer_ptr->length] = character;
+    }
+    writer_ptr->length++;
+}
+
+/*
+ * Writes the string aligned to the right by spaces to the width
+ */
+static void write_string(text_writer_t* writer_ptr, const char* string, size_t width)
+{
+    size_t string_length = strlen(string);
+    for (size_t i = string_length; i < width; ++i) {
+        write_char(writer_ptr, ' ');
+    }
+    for (size_t i = 0; i < string_length; ++i) {
+        write_char(writer_ptr, string[i]);
+    }
+}
+
+/*
+ * Writes the number in the base (10 or 16) aligned to the right by spaces to the width
+ */
+static void write_number(text_writer_t* writer_ptr, uint64_t value, uint8_t base, size_t width)
+{
+    // 64-bit number has at most 20 decimal digits
+    char digits[21];
+    size_t digits_number = sizeof(digits) - 1;
+    digits[digits_number] = '\0';
+    do {
+        digits[--digits_number] = "0123456789abcdef"[value % base];
+        value /= base;
+    } while (value != 0);
+    write_string(writer_ptr, &digits[digits_number], width);
+}
+
+void buddy_allocator_preinit(buddy_allocator_t* allocator_ptr, uintptr_t area_start_addr, size_t area_size, uint8_t max_order, uint32_t page_size, bool allocate_all_small_blocks, size_t* required_memory_size_ptr)
+{
+    buddy_allocator_preinit_ex(allocator_ptr, area_start_addr, area_size, max_order, page_size, allocate_all_small_blocks, 0, required_memory_size_ptr);
+}
+
+void buddy_allocator_preinit_ex(buddy_allocator_t* allocator_ptr, uintptr_t area_start_addr, size_t area_size, uint8_t max_order, uint32_t page_size, bool allocate_all_small_blocks, uint32_t flags, size_t* required_memory_size_ptr)
+{
+    if (page_size == 0) {
+        return;
+    }
+    if (allocator_ptr == NULL || area_start_addr == 0 || area_size == 0 || max_order > BUDDY_ALLOCATOR_MAX_ORDER_LIMIT || (page_size && !(page_size & (page_size - 1))) == 0 || required_memory_size_ptr == NULL) {
+        return;
+    }
+    if (max_order + bitops_find_last_set(page_size) >= sizeof(size_t) * 8) {
+        // The large block size doesn't fit into size_t
+        return;
+    }
+    allocator_ptr->large_block_size = (size_t)page_size << max_order;
+    allocator_ptr->small_block_size = page_size;
+    if (area_size < allocator_ptr->large_block_size) {
+        // The memory area is less than one largest block, I don't want to work with it
+        return;
+    }
+
+    allocator_ptr->large_blocks_number = area_size / allocator_ptr->large_block_size;
+    // The total blocks number is less than large_blocks_number * 2^(max_order + 1), it must fit into size_t.
+    // The shift is split in two, so that it is never by the full width of size_t.
+    if (allocator_ptr->large_blocks_number > ((SIZE_MAX >> max_order) >> 1)) {
+        return;
+    }
+    allocator_ptr->small_blocks_number = allocator_ptr->large_blocks_number << max_order;
+    allocator_ptr->total_blocks_number = allocator_ptr->large_blocks_number * ((((size_t)1) << (max_order + 1)) - 1);
+    // The required memory is less than 32 bytes per block, it must fit into size_t too
+    if (allocator_ptr->total_blocks_number > SIZE_MAX / 32) {
+        return;
+    }
+
+    allocator_ptr->area_size = allocator_ptr->large_blocks_number * allocator_ptr->large_block_size;
+    if (allocator_ptr->area_size - 1 > UINTPTR_MAX - area_start_addr) {
+        // The area wraps around the end of the address space
+        return;
+    }
+    allocator_ptr->area_start_addr = area_start_addr;
+    allocator_ptr->max_order = max_order;
+    allocator_ptr->page_size = page_size;
+    allocator_ptr->page_shift = bitops_find_last_set(page_size);
+
+    // Tables for the index arithmetic
+    allocator_ptr->large_blocks_number_log2 = bitops_find_last_set(allocator_ptr->large_blocks_number);
+    for (uint8_t depth = 0; depth <= max_order + 1; ++depth) {
+        allocator_ptr->first_index_by_depth[depth] = allocator_ptr->large_blocks_number * ((((size_t)1) << depth) - 1);
+    }
+
+    allocator_ptr->allocate_all_small_blocks = allocate_all_small_blocks;
+    allocator_ptr->flags = flags;
+    allocator_ptr->migrate_types_number = (flags & BUDDY_ALLOCATOR_FLAG_MIGRATE_TYPES) ? BUDDY_ALLOCATOR_MIGRATE_TYPES_NUMBER : 1;
+
+    if ((flags & BUDDY_ALLOCATOR_FLAG_COMPACT_NODES) && (flags & BUDDY_ALLOCATOR_FLAG_IN_BLOCK_NODES)) {
+        // Only one nodes format can be used
+        return;
+    }
+    if ((flags & BUDDY_ALLOCATOR_FLAG_QUICKLISTS) && (flags & BUDDY_ALLOCATOR_FLAG_ADDRESS_ORDERED)) {
+        // Quicklisted blocks are handed out in the LIFO order and they are not in the bitmap
+        return;
+    }
+    if ((flags & BUDDY_ALLOCATOR_FLAG_MIGRATE_TYPES) && (flags & BUDDY_ALLOCATOR_FLAG_ADDRESS_ORDERED)) {
+        // The bitmap has no types, the search would step through the free blocks of other types one by one
+        return;
+    }
+
+    if (flags & BUDDY_ALLOCATOR_FLAG_IN_BLOCK_NODES) {
+        // The node must fit into the smallest block
+        if (page_size < sizeof(dll_node_t)) {
+            return;
+        }
+        // There is no nodes array, nodes are in the free blocks themselves
+        allocator_ptr->blocks_nodes_memory_size = 0;
+        // For free blocks lists
+        allocator_ptr->free_blocks_lists_memory_size = allocator_ptr->migrate_types_number * (allocator_ptr->max_order + 1) * sizeof(doubly_linked_list_t);
+    }
+    else if (flags & BUDDY_ALLOCATOR_FLAG_COMPACT_NODES) {
+        // All block indices and DLL_INDEX_NONE must be different
+        if ((uint64_t)allocator_ptr->total_blocks_number >= DLL_INDEX_NONE) {
+            return;
+        }
+        // For blocks compact nodes
+        allocator_ptr->blocks_nodes_memory_size = allocator_ptr->total_blocks_number * sizeof(memory_block_compact_node_t);
+        // For free blocks index lists
+        allocator_ptr->free_blocks_lists_memory_size = allocator_ptr->migrate_types_number * (allocator_ptr->max_order + 1) * sizeof(doubly_linked_index_list_t);
+    }
+    else {
+        // For blocks nodes
+        allocator_ptr->blocks_nodes_memory_size = allocator_ptr->total_blocks_number * sizeof(memory_block_node_t);
+        // For free blocks lists
+        allocator_ptr->free_blocks_lists_memory_size = allocator_ptr->migrate_types_number * (allocator_ptr->max_order + 1) * sizeof(doubly_linked_list_t);
+    }
+    // For allocations orders array
+    allocator_ptr->allocations_orders_memory_size = allocator_ptr->small_blocks_number * sizeof(uint8_t);
+    // For large blocks types
+    allocator_ptr->large_block_types_memory_size = (allocator_ptr->migrate_types_number > 1) ? allocator_ptr->large_blocks_number * sizeof(uint8_t) : 0;
+    // For free blocks bitmap, one bit per node rounded up to whole words
+    allocator_ptr->free_blocks_bitmap_memory_size = (allocator_ptr->total_blocks_number / 64 + (allocator_ptr->total_blocks_number % 64 != 0)) * sizeof(uint64_t);
+    // For the summary of the bitmap, one bit per bitmap word rounded up to whole words
+    allocator_ptr->free_blocks_summary_memory_size = 0;
+    if (flags & BUDDY_ALLOCATOR_FLAG_ADDRESS_ORDERED) {
+        size_t bitmap_words_number = allocator_ptr->free_blocks_bitmap_memory_size / sizeof(uint64_t);
+        allocator_ptr->free_blocks_summary_memory_size = (bitmap_words_number / 64 + (bitmap_words_number % 64 != 0)) * sizeof(uint64_t);
+    }
+    // For quicklists, the max order is never quicklisted, the large blocks must stay in the free lists
+    allocator_ptr->quicklist_orders_number = 0;
+    allocator_ptr->quicklists_memory_size = 0;
+    if (flags & BUDDY_ALLOCATOR_FLAG_QUICKLISTS) {
+        allocator_ptr->quicklist_orders_number = max_order < BUDDY_ALLOCATOR_QUICKLIST_ORDERS_NUMBER ? max_order : BUDDY_ALLOCATOR_QUICKLIST_ORDERS_NUMBER;
+        allocator_ptr->quicklists_memory_size = (size_t)allocator_ptr->migrate_types_number * BUDDY_ALLOCATOR_QUICKLIST_ORDERS_NUMBER * BUDDY_ALLOCATOR_QUICKLIST_HIGH * sizeof(size_t);
+    }
+
+    /*
+    // Debug
+    if (area_size == 4194304) {
+        FILE* file = fopen("debug_output.txt", "wb");
+        for (size_t i = 0; i < allocator_ptr->total_blocks_number; ++i) {
+            static size_t prev_order = BUDDY_ALLOCATOR_MAX_ORDER;
+            size_t order = get_order_by_index(allocator_ptr, i);
+            if (order != prev_order) {
+                prev_order = order;
+                fprintf(file, "\n");
+            }
+            fprintf(file, "%u ", order);
+        }
+        fclose(file);
+    }
+    */
+
+    // Calculate required memory
+    // [quicklists free_blocks_bitmap free_blocks_summary blocks_nodes free_blocks_lists allocations_orders large_block_types]
+    // The quicklists and the bitmaps are placed first so that their words are aligned
+    *required_memory_size_ptr = allocator_ptr->quicklists_memory_size + allocator_ptr->free_blocks_bitmap_memory_size + allocator_ptr->free_blocks_summary_memory_size + allocator_ptr->blocks_nodes_memory_size + allocator_ptr->free_blocks_lists_memory_size + allocator_ptr->allocations_orders_memory_size + allocator_ptr->large_block_types_memory_size;
+}
+
+void buddy_allocator_init(buddy_allocator_t* allocator_ptr, void* required_memory_ptr)
+{
+    if (allocator_ptr == NULL || required_memory_ptr == NULL) {
+        return;
+    }
+
+    set_up_required_memory(allocator_ptr, required_memory_ptr);
+    if (allocator_ptr->flags & BUDDY_ALLOCATOR_FLAG_LAZY_INIT) {
+        // The bitmap, the nodes and the allocations orders are initialized when large blocks are touched
+        // Nodes are written when blocks are put to the free lists, so they are never initialized
+        // Only the common orders mask has the bit of untouched blocks, they have no type until they are touched
+        if (has_untouched_free_large_blocks(allocator_ptr)) {
+            allocator_ptr->free_orders_mask = (uint64_t)1 << allocator_ptr->max_order;
+            allocator_ptr->free_memory_size = allocator_ptr->area_size;
+        }
+        return;
+    }
+
+    memset(allocator_ptr->free_blocks_bitmap, 0, allocator_ptr->free_blocks_bitmap_memory_size);
+    memset(get_blocks_nodes_memory(allocator_ptr), 0, allocator_ptr->blocks_nodes_memory_size);
+    if (allocator_ptr->allocate_all_small_blocks) {
+        // Mark all small block as allocated
+        memset(allocator_ptr->allocations_orders, 1, allocator_ptr->allocations_orders_memory_size);
+    }
+    else {
+        memset(allocator_ptr->allocations_orders, 0, allocator_ptr->allocations_orders_memory_size);
+    }
+    if (allocator_ptr->large_block_types != NULL) {
+        memset(allocator_ptr->large_block_types, get_initial_block_type(allocator_ptr), allocator_ptr->large_block_types_memory_size);
+    }
+
+    if (allocator_ptr->allocate_all_small_blocks == false) {
+        // Right now all of our large blocks are free, let's put them on the free list
+        for (size_t index = 0; index < allocator_ptr->large_blocks_number; ++index) {
+            free_list_insert_to_tail(allocator_ptr, allocator_ptr->max_order, index);
+        }
+    }
+    allocator_ptr->untouched_large_block_index = allocator_ptr->large_blocks_number;
+}
+
+void buddy_allocator_init_parallel(buddy_allocator_t* allocator_ptr, void* required_memory_ptr, size_t tasks_number, buddy_allocator_run_tasks_t run_tasks, void* run_tasks_context_ptr)
+{
+    if (allocator_ptr == NULL || required_memory_ptr == NULL) {
+        return;
+    }
+    if (tasks_number <= 1 || run_tasks == NULL || (allocator_ptr->flags & BUDDY_ALLOCATOR_FLAG_LAZY_INIT)) {
+        // Nothing to split
+        buddy_allocator_init(allocator_ptr, required_memory_ptr);
+        return;
+    }
+
+    set_up_required_memory(allocator_ptr, required_memory_ptr);
+    init_task_data_t task_data = { allocator_ptr, tasks_number };
+    run_tasks(run_tasks_context_ptr, init_task, &task_data, tasks_number);
+
+    if (allocator_ptr->allocate_all_small_blocks == false) {
+        // Each task has linked its large blocks, the segments are joined in the order of tasks
+        // The head, the tail and the count of each segment are known from its range, so they are not stored by the tasks
+        for (size_t task_index = 0; task_index < tasks_number; ++task_index) {
+            size_t first_large_block_index = 0;
+            size_t end_large_block_index = 0;
+            get_task_range(allocator_ptr->large_blocks_number, tasks_number, task_index, &first_large_block_index, &end_large_block_index);
+            if (first_large_block_index == end_large_block_index) {
+                continue;
+            }
+            if (allocator_ptr->flags & BUDDY_ALLOCATOR_FLAG_COMPACT_NODES) {
+                doubly_linked_index_list_t segment = { (uint32_t)first_large_block_index, (uint32_t)(end_large_block_index - 1), end_large_block_index - first_large_block_index };
+                dll_index_append_list(&allocator_ptr->free_blocks_index_lists[get_free_list_index(allocator_ptr, get_initial_block_type(allocator_ptr), allocator_ptr->max_order)], (dll_index_node_t*)allocator_ptr->blocks_compact_nodes, &segment);
+            }
+            else {
+                doubly_linked_list_t segment = { get_node_by_index(allocator_ptr, first_large_block_index, allocator_ptr->max_order), get_node_by_index(allocator_ptr, end_large_block_index - 1, allocator_ptr->max_order), end_large_block_index - first_large_block_index };
+                dll_append_list(&allocator_ptr->free_blocks_lists[get_free_list_index(allocator_ptr, get_initial_block_type(allocator_ptr), allocator_ptr->max_order)], &segment);
+            }
+        }
+        allocator_ptr->free_orders_mask = (uint64_t)1 << allocator_ptr->max_order;
+        allocator_ptr->free_orders_masks[get_initial_block_type(allocator_ptr)] = (uint64_t)1 << allocator_ptr->max_order;
+        allocator_ptr->free_memory_size = allocator_ptr->area_size;
+        // The tasks have set the bits of the large blocks, they are the first large_blocks_number bits
+        if (allocator_ptr->free_blocks_summary != NULL) {
+            for (size_t word_index = 0; word_index * 64 < allocator_ptr->large_blocks_number; ++word_index) {
+                allocator_ptr->free_blocks_summary[word_index / 64] |= (uint64_t)1 << (word_index % 64);
+            }
+        }
+    }
+    allocator_ptr->untouched_large_block_index = allocator_ptr->large_blocks_number;
+}
+
+void* buddy_allocator_alloc(buddy_allocator_t* allocator_ptr, size_t size)
+{
+    return buddy_allocator_alloc_typed(allocator_ptr, size, BUDDY_ALLOCATOR_MIGRATE_UNMOVABLE);
+}
+
+/*
+ * Allocates a block of the size of the type, see buddy_allocator_alloc_typed
+ * Places the requested order and the number of splits to required_order_ptr and splits_number_ptr, they are not changed if the arguments are incorrect
+ * If the quicklisted blocks are coalesced to find a free block, their merges are added to the number of splits
+ */
+static void* alloc_block(buddy_allocator_t* allocator_ptr, size_t size, uint8_t type, uint8_t* required_order_ptr, size_t* splits_number_ptr)
+{
+    if (allocator_ptr == NULL || size == 0 || size > allocator_ptr->large_block_size) {
+        return NULL;
+    }
+    if (allocator_ptr->migrate_types_number == 1) {
+        // Types are ignored
+        type = 0;
+    }
+    else if (type >= allocator_ptr->migrate_types_number) {
+        return NULL;
+    }
+
+    uint8_t required_order = get_order_by_size(allocator_ptr, size);
+    *required_order_ptr = required_order;
+
+    // The last freed block of the order is taken first, it is likely still in the CPU cache
+    size_t free_block_index = quicklist_pop(allocator_ptr, type, required_order);
+    if (free_block_index != SIZE_MAX) {
+        *splits_number_ptr = 0;
+        BUDDY_ALLOCATOR_STATS_UPDATE(allocator_ptr->stats.fast_allocations[required_order]++);
+    }
+    else {
+        // Trying to find a free block of required size or larger
+        uint8_t current_order = 0;
+        uint8_t list_type = 0;
+        size_t merges_number = 0;
+        bool is_found = find_free_list(allocator_ptr, type, required_order, &current_order, &list_type);
+        if (!is_found && allocator_ptr->quicklist_orders_mask != 0) {
+            // The quicklisted blocks may merge into a block of the order
+            merges_number = coalesce_quicklists(allocator_ptr);
+            is_found = find_free_list(allocator_ptr, type, required_order, &current_order, &list_type);
+        }
+        *splits_number_ptr = merges_number;
+        if (!is_found) {
+            BUDDY_ALLOCATOR_STATS_UPDATE(allocator_ptr->stats.failed_allocations[required_order]++);
+            return NULL;
+        }
+        *splits_number_ptr += current_order - required_order;
+        if (current_order == required_order) {
+            BUDDY_ALLOCATOR_STATS_UPDATE(allocator_ptr->stats.fast_allocations[required_order]++);
+        }
+        else {
+            BUDDY_ALLOCATOR_STATS_UPDATE(allocator_ptr->stats.slow_allocations[required_order]++);
+        }
+
+        // Take first free block and remove it from the free list
+        free_block_index = get_free_block(allocator_ptr, list_type, current_order);
+        //printf("A Remove node %u from order %u free list\n", free_block_index, current_order);
+        free_list_remove(allocator_ptr, current_order, free_block_index);
+
+        // If the block is larger than requested, split it down to the requested order
+        // The free lists of the type of all orders between the required and the current one are empty (otherwise we would have found them),
+        // so each second (right) child is put to its free list, and we continue splitting the first (left) child.
+        while (current_order > required_order) {
+            //printf("split order %u\n", current_order);
+            BUDDY_ALLOCATOR_STATS_UPDATE(allocator_ptr->stats.splits[current_order]++);
+            size_t split_block_second_child_index = get_second_child_by_index(allocator_ptr, free_block_index);
+            //printf("A Put node %u in order %u free list\n", split_block_second_child_index, current_order - 1);
+            free_list_insert_to_head(allocator_ptr, current_order - 1, split_block_second_child_index);
+            free_block_index = get_first_child_by_index(allocator_ptr, free_block_index);
+            current_order--;
+        }
+    }
+
+    // Now we have a block of the requested size/order
+    // Calculate memory block addr
+    uintptr_t memory_block_addr = (uintptr_t)get_index_in_order_by_index(allocator_ptr, free_block_index) << (required_order + allocator_ptr->page_shift);
+
+    // Save allocation order
+    allocator_ptr->allocations_orders[memory_block_addr >> allocator_ptr->page_shift] = (uint8_t)required_order + 1;
+    BUDDY_ALLOCATOR_STATS_UPDATE(allocator_ptr->stats.requested_memory_size += size);
+    BUDDY_ALLOCATOR_STATS_UPDATE(allocator_ptr->stats.granted_memory_size += (uint64_t)1 << (required_order + allocator_ptr->page_shift));
+
+    // Return calculated memory block addr
+    return (void*)(memory_block_addr + allocator_ptr->area_start_addr);
+}
+
+void* buddy_allocator_alloc_typed(buddy_allocator_t* allocator_ptr, size_t size, uint8_t type)
+{
+    uint8_t required_order = BUDDY_ALLOCATOR_MAX_ORDER_LIMIT + 1;
+    size_t splits_number = 0;
+    void* memory_ptr = NULL;
+#ifdef BUDDY_ALLOCATOR_LATENCY
+    if (allocator_ptr != NULL && allocator_ptr->latency_ptr != NULL) {
+        uint64_t start_cycles = cycles_read();
+        memory_ptr = alloc_block(allocator_ptr, size, type, &required_order, &splits_number);
+        uint64_t cycles = cycles_read() - start_cycles;
+        if (required_order <= BUDDY_ALLOCATOR_MAX_ORDER_LIMIT) {
+            record_latency(allocator_ptr->latency_ptr->alloc_by_order[required_order], cycles);
+            record_latency(allocator_ptr->latency_ptr->alloc_by_splits[splits_number < BUDDY_ALLOCATOR_MAX_ORDER_LIMIT ? splits_number : BUDDY_ALLOCATOR_MAX_ORDER_LIMIT], cycles);
+        }
+    }
+    else {
+        memory_ptr = alloc_block(allocator_ptr, size, type, &required_order, &splits_number);
+    }
+#else
+    memory_ptr = alloc_block(allocator_ptr, size, type, &required_order, &splits_number);
+#endif
+    if (required_order <= BUDDY_ALLOCATOR_MAX_ORDER_LIMIT) {
+        // The arguments are correct
+        if (memory_ptr != NULL) {
+            trace_record(allocator_ptr, BUDDY_ALLOCATOR_TRACE_ALLOC, required_order, (uintptr_t)memory_ptr - allocator_ptr->area_start_addr, type);
+        }
+        else {
+            trace_record(allocator_ptr, BUDDY_ALLOCATOR_TRACE_ALLOC_FAILED, required_order, 0, type);
+        }
+    }
+    return memory_ptr;
+}
+
+/*
+ * Frees the memory, see buddy_allocator_free
+ * Places the order of the freed block and the number of merges to order_ptr and merges_number_ptr, returns false if nothing is freed
+ */
+static bool free_memory(buddy_allocator_t* allocator_ptr, void* memory_ptr, uint8_t* order_ptr, size_t* merges_number_ptr)
+{
+    if (allocator_ptr == NULL || memory_ptr == NULL) {
+        return false;
+    }
+    // The area may end at the very end of the address space, so the offset is compared instead of the end address
+    if ((uintptr_t)memory_ptr < allocator_ptr->area_start_addr || (uintptr_t)memory_ptr - allocator_ptr->area_start_addr >= allocator_ptr->area_size) {
+        BUDDY_ALLOCATOR_STATS_UPDATE(allocator_ptr->stats.rejected_frees++);
+        return false;
+    }
+    uintptr_t memory_block_addr = (uintptr_t)memory_ptr - allocator_ptr->area_start_addr;
+    size_t memory_block_page_index = (size_t)(memory_block_addr >> allocator_ptr->page_shift);
+    if ((memory_block_page_index >> allocator_ptr->max_order) >= allocator_ptr->untouched_large_block_index) {
+        if (allocator_ptr->allocate_all_small_blocks == false) {
+            // Untouched blocks are free
+            BUDDY_ALLOCATOR_STATS_UPDATE(allocator_ptr->stats.rejected_frees++);
+            return false;
+        }
+        touch_page(allocator_ptr, memory_block_page_index);
+    }
+    if (allocator_ptr->allocations_orders[memory_block_page_index] == 0) {
+        // Block unnallocated
+        BUDDY_ALLOCATOR_STATS_UPDATE(allocator_ptr->stats.rejected_frees++);
+        return false;
+    }
+    if (allocator_ptr->allocations_orders[memory_block_page_index] & BUDDY_ALLOCATOR_CONTINUATION_FLAG) {
+        // It is not the start of the run
+        BUDDY_ALLOCATOR_STATS_UPDATE(allocator_ptr->stats.rejected_frees++);
+        return false;
+    }
+
+    uint8_t order = allocator_ptr->allocations_orders[memory_block_page_index] - 1;
+    *order_ptr = order;
+    if (order < allocator_ptr->quicklist_orders_number && !is_run_start_by_page(allocator_ptr, memory_block_page_index, order)) {
+        // Coalescing is deferred
+        allocator_ptr->allocations_orders[memory_block_page_index] = 0;
+        // A full quicklist coalesces its oldest blocks, their merges are counted
+        *merges_number_ptr = quicklist_push(allocator_ptr, get_index_by_in_order_index(allocator_ptr, memory_block_page_index >> order, order), order);
+        return true;
+    }
+    *merges_number_ptr = free_allocation(allocator_ptr, memory_block_page_index);
+    return true;
+}
+
+void buddy_allocator_free(buddy_allocator_t* allocator_ptr, void* memory_ptr)
+{
+    uint8_t order = 0;
+    size_t merges_number = 0;
+    bool is_freed = false;
+#ifdef BUDDY_ALLOCATOR_LATENCY
+    if (allocator_ptr != NULL && allocator_ptr->latency_ptr != NULL) {
+        uint64_t start_cycles = cycles_read();
+        is_freed = free_memory(allocator_ptr, memory_ptr, &order, &merges_number);
+        uint64_t cycles = cycles_read() - start_cycles;
+        if (is_freed) {
+            record_latency(allocator_ptr->latency_ptr->free_by_order[order], cycles);
+            record_latency(allocator_ptr->latency_ptr->free_by_merges[merges_number < BUDDY_ALLOCATOR_MAX_ORDER_LIMIT ? merges_number : BUDDY_ALLOCATOR_MAX_ORDER_LIMIT], cycles);
+        }
+    }
+    else {
+        is_freed = free_memory(allocator_ptr, memory_ptr, &order, &merges_number);
+    }
+#else
+    is_freed = free_memory(allocator_ptr, memory_ptr, &order, &merges_number);
+#endif
+    if (is_freed) {
+        trace_record(allocator_ptr, BUDDY_ALLOCATOR_TRACE_FREE, order, (uintptr_t)memory_ptr - allocator_ptr->area_start_addr, 0);
+    }
+}
+
+void* buddy_allocator_alloc_exact(buddy_allocator_t* allocator_ptr, size_t size)
+{
+    // The block is allocated by alloc_block, so the operation is recorded to the trace once
+    uint8_t required_order = BUDDY_ALLOCATOR_MAX_ORDER_LIMIT + 1;
+    size_t splits_number = 0;
+    void* memory_ptr = alloc_block(allocator_ptr, size, BUDDY_ALLOCATOR_MIGRATE_UNMOVABLE, &required_order, &splits_number);
+    if (memory_ptr == NULL) {
+        if (required_order <= BUDDY_ALLOCATOR_MAX_ORDER_LIMIT) {
+            trace_record(allocator_ptr, BUDDY_ALLOCATOR_TRACE_ALLOC_FAILED, required_order, 0, BUDDY_ALLOCATOR_MIGRATE_UNMOVABLE);
+        }
+        return NULL;
+    }
+
+    size_t pages_number = ((size - 1) >> allocator_ptr->page_shift) + 1;
+    size_t memory_block_page_index = (size_t)(((uintptr_t)memory_ptr - allocator_ptr->area_start_addr) >> allocator_ptr->page_shift);
+    uint8_t current_order = allocator_ptr->allocations_orders[memory_block_page_index] - 1;
+    trace_record(allocator_ptr, BUDDY_ALLOCATOR_TRACE_ALLOC_EXACT, current_order, (uintptr_t)memory_ptr - allocator_ptr->area_start_addr, (uint32_t)pages_number);
+    if (pages_number == ((size_t)1 << current_order)) {
+        // The size is a power of 2, nothing to return
+        return memory_ptr;
+    }
+
+    // The per-CPU caches check the runs only after this
+    if (allocator_ptr->has_runs == 0) {
+        atomics_store_64(&allocator_ptr->has_runs, 1);
+    }
+
+    // Only the pages of the run are granted
+    BUDDY_ALLOCATOR_STATS_UPDATE(allocator_ptr->stats.granted_memory_size -= ((uint64_t)1 << (current_order + allocator_ptr->page_shift)) - ((uint64_t)pages_number << allocator_ptr->page_shift));
+
+    // Split the block: the first halves are kept while they are needed, the second halves which are not needed are freed.
+    // The kept blocks follow each other, the first one is the start of the run, the rest are continuations.
+    size_t current_block_index = get_index_by_in_order_index(allocator_ptr, memory_block_page_index >> current_order, current_order);
+    size_t remaining_pages_number = pages_number;
+    size_t kept_block_page_index = memory_block_page_index;
+    uint8_t continuation_flag = 0;
+    while (remaining_pages_number != 0) {
+        BUDDY_ALLOCATOR_STATS_UPDATE(allocator_ptr->stats.splits[current_order]++);
+        current_order--;
+        size_t half_pages_number = (size_t)1 << current_order;
+        size_t first_child_index = get_first_child_by_index(allocator_ptr, current_block_index);
+        size_t second_child_index = get_second_child_by_index(allocator_ptr, current_block_index);
+        if (remaining_pages_number >= half_pages_number) {
+            allocator_ptr->allocations_orders[kept_block_page_index] = (uint8_t)(current_order + 1) | continuation_flag;
+            continuation_flag = BUDDY_ALLOCATOR_CONTINUATION_FLAG;
+            kept_block_page_index += half_pages_number;
+            remaining_pages_number -= half_pages_number;
+            if (remaining_pages_number == 0) {
+                // The tail is put to the tail of the free list, like not merged blocks in buddy_allocator_free,
+                // so it is more likely still free when the run is freed and they can be merged
+                free_list_insert_to_tail(allocator_ptr, current_order, second_child_index);
+            }
+            current_block_index = second_child_index;
+        }
+        else {
+            free_list_insert_to_tail(allocator_ptr, current_order, second_child_index);
+            current_block_index = first_child_index;
+        }
+    }
+    return memory_ptr;
+}
+
+size_t buddy_allocator_alloc_bulk(buddy_allocator_t* allocator_ptr, uint8_t order, size_t count, void** blocks_array)
+{
+    if (allocator_ptr == NULL || order > allocator_ptr->max_order || blocks_array == NULL) {
+        return 0;
+    }
+
+    size_t allocated_blocks_number = 0;
+    while (allocated_blocks_number < count) {
+        // Quicklisted blocks are taken first
+        size_t quicklisted_block_index = quicklist_pop(allocator_ptr, BUDDY_ALLOCATOR_MIGRATE_UNMOVABLE, order);
+        if (quicklisted_block_index != SIZE_MAX) {
+            hand_out_block(allocator_ptr, quicklisted_block_index, order, order, false, blocks_array, &allocated_blocks_number);
+            continue;
+        }
+        uint8_t current_order = 0;
+        uint8_t list_type = 0;
+        if (!find_free_list(allocator_ptr, BUDDY_ALLOCATOR_MIGRATE_UNMOVABLE, order, &current_order, &list_type)) {
+            if (allocator_ptr->quicklist_orders_mask != 0) {
+                // The quicklisted blocks may merge into a block of the order
+                coalesce_quicklists(allocator_ptr);
+                continue;
+            }
+            // There are no free blocks of the required size or larger
+            BUDDY_ALLOCATOR_STATS_UPDATE(allocator_ptr->stats.failed_allocations[order]++);
+            trace_record(allocator_ptr, BUDDY_ALLOCATOR_TRACE_ALLOC_FAILED, order, 0, BUDDY_ALLOCATOR_MIGRATE_UNMOVABLE);
+            break;
+        }
+        size_t current_block_index = get_free_block(allocator_ptr, list_type, current_order);
+        free_list_remove(allocator_ptr, current_order, current_block_index);
+
+        size_t remaining_blocks_number = count - allocated_blocks_number;
+        if (remaining_blocks_number >= ((size_t)1 << (current_order - order))) {
+            // All pieces of the block are needed, it is not split at all
+            hand_out_block(allocator_ptr, current_block_index, current_order, order, false, blocks_array, &allocated_blocks_number);
+            continue;
+        }
+
+        // Only a part of the block is needed, it is split once: the first halves are handed out whole while they are needed,
+        // the second halves which are not needed are put to the free lists
+        while (remaining_blocks_number != 0) {
+            BUDDY_ALLOCATOR_STATS_UPDATE(allocator_ptr->stats.splits[current_order]++);
+            current_order--;
+            size_t half_blocks_number = (size_t)1 << (current_order - order);
+            size_t first_child_index = get_first_child_by_index(allocator_ptr, current_block_index);
+            size_t second_child_index = get_second_child_by_index(allocator_ptr, current_block_index);
+            if (remaining_blocks_number >= half_blocks_number) {
+                hand_out_block(allocator_ptr, first_child_index, current_order, order, true, blocks_array, &allocated_blocks_number);
+                remaining_blocks_number -= half_blocks_number;
+                if (remaining_blocks_number == 0) {
+                    free_list_insert_to_head(allocator_ptr, current_order, second_child_index);
+                }
+                current_block_index = second_child_index;
+            }
+            else {
+                free_list_insert_to_head(allocator_ptr, current_order, second_child_index);
+                current_block_index = first_child_index;
+            }
+        }
+    }
+    return allocated_blocks_number;
+}
+
+size_t buddy_allocator_free_bulk(buddy_allocator_t* allocator_ptr, void** blocks_array, size_t count)
+{
+    if (allocator_ptr == NULL || blocks_array == NULL) {
+        return 0;
+    }
+
+    // Buddies are neighbors after sorting, so they can be merged before they are put to the free lists.
+    // The beginning of the array is used as a stack of pending blocks, the stack is never longer than the number of processed addresses.
+    // The order of a pending block is kept in allocations_orders until it is freed, so merged blocks have their order too.
+    sort_addresses(blocks_array, count);
+    size_t pending_blocks_number = 0;
+    size_t freed_blocks_number = 0;
+    for (size_t i = 0; i < count; ++i) {
+        void* memory_ptr = blocks_array[i];
+        if ((uintptr_t)memory_ptr < allocator_ptr->area_start_addr || (uintptr_t)memory_ptr - allocator_ptr->area_start_addr >= allocator_ptr->area_size) {
+            BUDDY_ALLOCATOR_STATS_UPDATE(allocator_ptr->stats.rejected_frees += (memory_ptr != NULL));
+            continue;
+        }
+        size_t memory_block_page_index = (size_t)(((uintptr_t)memory_ptr - allocator_ptr->area_start_addr) >> allocator_ptr->page_shift);
+        if ((memory_block_page_index >> allocator_ptr->max_order) >= allocator_ptr->untouched_large_block_index) {
+            if (allocator_ptr->allocate_all_small_blocks == false) {
+                // Untouched blocks are free
+                BUDDY_ALLOCATOR_STATS_UPDATE(allocator_ptr->stats.rejected_frees++);
+                continue;
+            }
+            touch_page(allocator_ptr, memory_block_page_index);
+        }
+        if (allocator_ptr->allocations_orders[memory_block_page_index] == 0 || (allocator_ptr->allocations_orders[memory_block_page_index] & BUDDY_ALLOCATOR_CONTINUATION_FLAG)) {
+            // Block unnallocated, or it is not the first page of a block or of a run
+            BUDDY_ALLOCATOR_STATS_UPDATE(allocator_ptr->stats.rejected_frees++);
+            continue;
+        }
+        if (pending_blocks_number != 0 && blocks_array[pending_blocks_number - 1] == memory_ptr) {
+            // The same address twice
+            BUDDY_ALLOCATOR_STATS_UPDATE(allocator_ptr->stats.rejected_frees++);
+            continue;
+        }
+        blocks_array[pending_blocks_number++] = memory_ptr;
+        freed_blocks_number++;
+        trace_record(allocator_ptr, BUDDY_ALLOCATOR_TRACE_FREE, allocator_ptr->allocations_orders[memory_block_page_index] - 1, (uintptr_t)memory_ptr - allocator_ptr->area_start_addr, 0);
+
+        // Merge the two top blocks while they are buddies of the same order
+        while (pending_blocks_number >= 2) {
+            uintptr_t first_block_addr = (uintptr_t)blocks_array[pending_blocks_number - 2] - allocator_ptr->area_start_addr;
+            uintptr_t second_block_addr = (uintptr_t)blocks_array[pending_blocks_number - 1] - allocator_ptr->area_start_addr;
+            uint8_t* first_block_order_ptr = &allocator_ptr->allocations_orders[first_block_addr >> allocator_ptr->page_shift];
+            uint8_t* second_block_order_ptr = &allocator_ptr->allocations_orders[second_block_addr >> allocator_ptr->page_shift];
+            uint8_t block_order = *first_block_order_ptr - 1;
+            if (*first_block_order_ptr != *second_block_order_ptr || block_order == allocator_ptr->max_order) {
+                break;
+            }
+            // Buddies: the first one is aligned to the parent size, the second one follows it
+            uintptr_t block_size = (uintptr_t)1 << (block_order + allocator_ptr->page_shift);
+            if ((first_block_addr & ((block_size << 1) - 1)) != 0 || second_block_addr != first_block_addr + block_size) {
+                break;
+            }
+            // The second block can be the start of a run, the run must be freed as a whole
+            if (is_run_start_by_page(allocator_ptr, (size_t)(second_block_addr >> allocator_ptr->page_shift), block_order)) {
+                break;
+            }
+            *first_block_order_ptr = block_order + 2;
+            *second_block_order_ptr = 0;
+            pending_blocks_number--;
+            BUDDY_ALLOCATOR_STATS_UPDATE(allocator_ptr->stats.merges[block_order + 1]++);
+        }
+    }
+
+    for (size_t i = 0; i < pending_blocks_number; ++i) {
+        free_allocation(allocator_ptr, (size_t)(((uintptr_t)blocks_array[i] - allocator_ptr->area_start_addr) >> allocator_ptr->page_shift));
+    }
+    return freed_blocks_number;
+}
+
+void buddy_allocator_coalesce(buddy_allocator_t* allocator_ptr)
+{
+    if (allocator_ptr == NULL) {
+        return;
+    }
+    coalesce_quicklists(allocator_ptr);
+}
+
+bool buddy_allocator_free_range(buddy_allocator_t* allocator_ptr, void* start_ptr, size_t size)
+{
+    if (allocator_ptr == NULL || size == 0) {
+        return false;
+    }
+    if ((uintptr_t)start_ptr < allocator_ptr->area_start_addr || (uintptr_t)start_ptr - allocator_ptr->area_start_addr >= allocator_ptr->area_size) {
+        return false;
+    }
+    uintptr_t start_offset = (uintptr_t)start_ptr - allocator_ptr->area_start_addr;
+    if (size > allocator_ptr->area_size - start_offset) {
+        return false;
+    }
+
+    // Only whole pages of the range are freed
+    size_t first_page_index = (size_t)(start_offset >> allocator_ptr->page_shift) + ((start_offset & (allocator_ptr->page_size - 1)) != 0);
+    size_t end_page_index = (size_t)((start_offset + size) >> allocator_ptr->page_shift);
+
+    if (first_page_index < end_page_index && ((end_page_index - 1) >> allocator_ptr->max_order) >= allocator_ptr->untouched_large_block_index) {
+        if (allocator_ptr->allocate_all_small_blocks == false) {
+            // Untouched blocks are free
+            return false;
+        }
+        touch_page(allocator_ptr, end_page_index - 1);
+    }
+
+    // Validation pass, nothing is changed if the range can't be freed
+    // Exact allocations are never freed by range, their first block is larger than a page and other blocks are continuations
+    for (size_t page_index = first_page_index; page_index < end_page_index; ++page_index) {
+        if (allocator_ptr->allocations_orders[page_index] != 0 + 1) {
+            return false;
+        }
+    }
+
+    size_t page_index = first_page_index;
+    while (page_index < end_page_index) {
+        uint8_t order = get_largest_block_order(allocator_ptr, page_index, end_page_index);
+        memset(&allocator_ptr->allocations_orders[page_index], 0, (size_t)1 << order);
+        free_block(allocator_ptr, get_index_by_in_order_index(allocator_ptr, page_index >> order, order), order);
+        page_index += (size_t)1 << order;
+    }
+    trace_record_range(allocator_ptr, BUDDY_ALLOCATOR_TRACE_FREE_RANGE, first_page_index, end_page_index);
+    return true;
+}
+
+bool buddy_allocator_reserve_range(buddy_allocator_t* allocator_ptr, void* start_ptr, size_t size)
+{
+    if (allocator_ptr == NULL || size == 0) {
+        return false;
+    }
+    if ((uintptr_t)start_ptr < allocator_ptr->area_start_addr || (uintptr_t)start_ptr - allocator_ptr->area_start_addr >= allocator_ptr->area_size) {
+        return false;
+    }
+    uintptr_t start_offset = (uintptr_t)start_ptr - allocator_ptr->area_start_addr;
+    if (size > allocator_ptr->area_size - start_offset) {
+        return false;
+    }
+
+    // All pages touched by the range are reserved
+    size_t first_page_index = (size_t)(start_offset >> allocator_ptr->page_shift);
+    size_t end_page_index = (size_t)((start_offset + size - 1) >> allocator_ptr->page_shift) + 1;
+
+    if (((end_page_index - 1) >> allocator_ptr->max_order) >= allocator_ptr->untouched_large_block_index) {
+        if (allocator_ptr->allocate_all_small_blocks) {
+            // Untouched blocks are allocated
+            return false;
+        }
+        // Untouched free large blocks are put to the free list, so they can be carved
+        touch_page(allocator_ptr, end_page_index - 1);
+    }
+    // Free pages are found in the free lists
+    coalesce_quicklists(allocator_ptr);
+
+    // Validation pass, nothing is changed if any page of the range is not free
+    size_t block_index = 0;
+    uint8_t block_order = 0;
+    size_t page_index = first_page_index;
+    while (page_index < end_page_index) {
+        if (!find_free_block_by_page(allocator_ptr, page_index, &block_index, &block_order)) {
+            return false;
+        }
+        page_index = ((page_index >> block_order) + 1) << block_order;
+    }
+
+    // Each free block that intersects the range is removed from the free list,
+    // its parts before and after the range are put back as maximal aligned blocks
+    page_index = first_page_index;
+    while (page_index < end_page_index) {
+        find_free_block_by_page(allocator_ptr, page_index, &block_index, &block_order);
+        free_list_remove(allocator_ptr, block_order, block_index);
+        size_t block_first_page_index = (page_index >> block_order) << block_order;
+        size_t block_end_page_index = block_first_page_index + ((size_t)1 << block_order);
+        size_t reserved_end_page_index = end_page_index < block_end_page_index ? end_page_index : block_end_page_index;
+
+#ifdef BUDDY_ALLOCATOR_STATS
+        // The block is split down to the reserved pages, each block of the orders above 0 which intersects the range is split
+        for (uint8_t split_order = 1; split_order <= block_order; ++split_order) {
+            allocator_ptr->stats.splits[split_order] += ((reserved_end_page_index - 1) >> split_order) - (page_index >> split_order) + 1;
+        }
+#endif
+        insert_free_pages(allocator_ptr, block_first_page_index, page_index);
+        // Reserved pages are marked as allocated pages, like with allocate_all_small_blocks
+        memset(&allocator_ptr->allocations_orders[page_index], 0 + 1, reserved_end_page_index - page_index);
+        insert_free_pages(allocator_ptr, reserved_end_page_index, block_end_page_index);
+        page_index = reserved_end_page_index;
+    }
+    trace_record_range(allocator_ptr, BUDDY_ALLOCATOR_TRACE_RESERVE_RANGE, first_page_index, end_page_index);
+    return true;
+}
+
+void buddy_allocator_get_orders_info(buddy_allocator_t* allocator_ptr, buddy_allocator_order_info_t* orders_info)
+{
+    if (allocator_ptr == NULL || orders_info == NULL) {
+        return;
+    }
+
+    // Pages are used to avoid overflow in the indices
+    uint64_t free_pages_number = allocator_ptr->free_memory_size >> allocator_ptr->page_shift;
+    // Free pages in the blocks of the order and larger, the orders are passed from the largest one
+    uint64_t usable_free_pages_number = 0;
+    for (int16_t order = allocator_ptr->max_order; order >= 0; --order) {
+        buddy_allocator_order_info_t* order_info_ptr = &orders_info[order];
+        order_info_ptr->free_blocks_number = get_free_blocks_number(allocator_ptr, (uint8_t)order);
+        order_info_ptr->free_memory_size = order_info_ptr->free_blocks_number << (order + allocator_ptr->page_shift);
+        usable_free_pages_number += (uint64_t)order_info_ptr->free_blocks_number << order;
+        if (free_pages_number == 0) {
+            order_info_ptr->unusable_free_space_index = 1000;
+        }
+        else {
+            order_info_ptr->unusable_free_space_index = (uint32_t)((free_pages_number - usable_free_pages_number) * 1000 / free_pages_number);
+        }
+    }
+}
+
+int32_t buddy_allocator_get_fragmentation_index(buddy_allocator_t* allocator_ptr, uint8_t order)
+{
+    if (allocator_ptr == NULL || order > allocator_ptr->max_order) {
+        return 0;
+    }
+
+    // All orders less than required are masked out
+    if ((allocator_ptr->free_orders_mask | allocator_ptr->quicklist_orders_mask) & ~(((uint64_t)1 << order) - 1)) {
+        return -1000;
+    }
+    uint64_t free_blocks_number = 0;
+    for (uint8_t current_order = 0; current_order < order; ++current_order) {
+        free_blocks_number += get_free_blocks_number(allocator_ptr, current_order);
+    }
+    if (free_blocks_number == 0) {
+        return 0;
+    }
+    // 1 - (1 + free_pages / requested_pages) / free_blocks, the more small blocks hold the free pages, the closer it is to 1
+    uint64_t free_pages_number = allocator_ptr->free_memory_size >> allocator_ptr->page_shift;
+    return (int32_t)(1000 - (1000 + ((free_pages_number * 1000) >> order)) / free_blocks_number);
+}
+
+size_t buddy_allocator_get_free_tail_size(buddy_allocator_t* allocator_ptr)
+{
+    if (allocator_ptr == NULL) {
+        return 0;
+    }
+
+    size_t large_block_index = allocator_ptr->large_blocks_number;
+    while (large_block_index != 0) {
+        size_t previous_large_block_index = large_block_index - 1;
+        // Untouched large blocks are free unless all small blocks are allocated, touched ones are free when they are in the free list of max order
+        bool is_free = previous_large_block_index >= allocator_ptr->untouched_large_block_index ? !allocator_ptr->allocate_all_small_blocks : is_block_in_free_list_by_index(allocator_ptr, previous_large_block_index);
+        if (!is_free) {
+            break;
+        }
+        large_block_index = previous_large_block_index;
+    }
+    return (allocator_ptr->large_blocks_number - large_block_index) * allocator_ptr->large_block_size;
+}
+
+size_t buddy_allocator_format_buddyinfo(buddy_allocator_t* allocator_ptr, char* buffer, size_t buffer_size)
+{
+    if (allocator_ptr == NULL || (buffer == NULL && buffer_size != 0)) {
+        return 0;
+    }
+
+    static const char* const types_names[BUDDY_ALLOCATOR_MIGRATE_TYPES_NUMBER] = {
+        [BUDDY_ALLOCATOR_MIGRATE_UNMOVABLE] = "Unmovable",
+        [BUDDY_ALLOCATOR_MIGRATE_MOVABLE] = "Movable",
+        [BUDDY_ALLOCATOR_MIGRATE_RECLAIMABLE] = "Reclaimable",
+    };
+    text_writer_t writer = { buffer, buffer_size, 0 };
+    // The first line is for all types, then a line for each type
+    uint8_t lines_number = (allocator_ptr->migrate_types_number > 1) ? 1 + allocator_ptr->migrate_types_number : 1;
+    for (uint8_t line = 0; line < lines_number; ++line) {
+        write_string(&writer, "Area 0x", 0);
+        write_number(&writer, allocator_ptr->area_start_addr, 16, 0);
+        write_string(&writer, ", type ", 0);
+        write_string(&writer, line == 0 ? "All" : types_names[line - 1], 11);
+        for (uint8_t order = 0; order <= allocator_ptr->max_order; ++order) {
+            // Untouched free large blocks have no type yet, they are counted only in the first line
+            size_t free_blocks_number = line == 0 ? get_free_blocks_number(allocator_ptr, order) : free_list_get_count(allocator_ptr, line - 1, order);
+            if (line != 0 && order < allocator_ptr->quicklist_orders_number) {
+                free_blocks_number += allocator_ptr->quicklists_counts[get_quicklist_index(line - 1, order)];
+            }
+            write_char(&writer, ' ');
+            write_number(&writer, free_blocks_number, 10, 6);
+        }
+        write_char(&writer, '\n');
+    }
+    if (buffer_size != 0) {
+        buffer[writer.length < buffer_size ? writer.length : buffer_size - 1] = '\0';
+    }
+    return writer.length;
+}
+
+#ifdef BUDDY_ALLOCATOR_STATS
+void buddy_allocator_get_stats(buddy_allocator_t* allocator_ptr, buddy_allocator_stats_t* stats_ptr)
+{
+    if (allocator_ptr == NULL || stats_ptr == NULL) {
+        return;
+    }
+    *stats_ptr = allocator_ptr->stats;
+}
+
+void buddy_allocator_reset_stats(buddy_allocator_t* allocator_ptr)
+{
+    if (allocator_ptr == NULL) {
+        return;
+    }
+    memset(&allocator_ptr->stats, 0, sizeof(buddy_allocator_stats_t));
+}
+#endif
+
+#ifdef BUDDY_ALLOCATOR_LATENCY
+void buddy_allocator_attach_latency(buddy_allocator_t* allocator_ptr, buddy_allocator_latency_t* latency_ptr)
+{
+    if (allocator_ptr == NULL) {
+        return;
+    }
+    if (latency_ptr != NULL) {
+        memset(latency_ptr, 0, sizeof(buddy_allocator_latency_t));
+    }
+    allocator_ptr->latency_ptr = latency_ptr;
+}
+
+void buddy_allocator_get_latency(buddy_allocator_t* allocator_ptr, buddy_allocator_latency_t* snapshot_ptr)
+{
+    if (allocator_ptr == NULL || snapshot_ptr == NULL) {
+        return;
+    }
+    if (allocator_ptr->latency_ptr == NULL) {
+        memset(snapshot_ptr, 0, sizeof(buddy_allocator_latency_t));
+        return;
+    }
+    *snapshot_ptr = *allocator_ptr->latency_ptr;
+}
+
+void buddy_allocator_reset_latency(buddy_allocator_t* allocator_ptr)
+{
+    if (allocator_ptr == NULL || allocator_ptr->latency_ptr == NULL) {
+        return;
+    }
+    memset(allocator_ptr->latency_ptr, 0, sizeof(buddy_allocator_latency_t));
 }
+#endif
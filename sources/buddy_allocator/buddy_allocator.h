@@ -2,6 +2,7 @@
 #define _BUDDY_ALLOCATOR_H_
 
 #include <stdint.h>
+#include <stddef.h>
 #include <stdbool.h>
 #include "../dllist/dllist.h"
 
@@ -9,8 +10,9 @@
  * Implementation of buddy allocator.
  * It is oriented on using as physical memory allocator in the kernel, so it not using hosted functions (like malloc() or pow()).
  * 
- * == ATTENTION ==
- * It is oriented on 32-bit address space, probably there will be problems when working in 64-bit address space. I am testing only the 32-bit version.
+ * Both 32-bit and 64-bit address spaces are supported.
+ * Block indices, counts and sizes are size_t, so on 64-bit targets the area can be terabytes in size and placed anywhere in the address space.
+ * The area must not wrap around the end of the address space, and 2^max_order * page_size must fit into size_t.
  * 
  * Implementation details:
  * The allocator stores nodes for all blocks:
@@ -19,16 +21,141 @@
  * |3|4|5|6|
  * Total blocks (nodes) - 7
  * This is a bit wasteful, but for a maximum area size of 4GB, to store all nodes at a node size of 8 bytes would require about 16 megabytes of memory, not much.
+ * If it's too much, the nodes can be made compact or placed in the free blocks themselves, see BUDDY_ALLOCATOR_FLAG_* below.
  * 
  * If any block is free, it is placed in the free list according to its size.
  * The free lists allows to quickly get a block of the required size, if it.
  * Also allocator stores the size order of the allocated block.
+ *
+ * In addition to the free lists, the allocator keeps a free blocks bitmap with one bit per node.
+ * Nodes of each order occupy a contiguous range of indices, so the bitmap is effectively a separate bitmap for each order.
+ * The bit is set while the block is in a free list, so checking whether a buddy is free is a single bit test
+ * and does not touch the nodes memory.
  */
 
+// The largest supported max order
+// The actual limit also depends on the page size, 2^max_order * page_size must fit into size_t
+#define BUDDY_ALLOCATOR_MAX_ORDER_LIMIT 63
+
 typedef struct {
     dll_node_t dll_node;
 } memory_block_node_t;
 
+// Node of the block when BUDDY_ALLOCATOR_FLAG_COMPACT_NODES is used, free blocks are linked by 32-bit block indices
+typedef struct {
+    dll_index_node_t dll_index_node;
+} memory_block_compact_node_t;
+
+// Flags for buddy_allocator_preinit_ex
+// Link free blocks by 32-bit block indices instead of pointers.
+// It halves the memory needed for the blocks nodes on 64-bit targets, but the total blocks number must fit into 32 bits.
+#define BUDDY_ALLOCATOR_FLAG_COMPACT_NODES 0x1
+// Store the node of a free block in the first bytes of the block memory, like the classic kernel buddy allocator does.
+// There is no nodes array, only the allocations orders and the free blocks bitmap (a byte and a quarter per page) are stored separately.
+// The area must be writable memory, the page size must be at least sizeof(dll_node_t).
+#define BUDDY_ALLOCATOR_FLAG_IN_BLOCK_NODES 0x2
+// Initialize the metadata lazily, so that buddy_allocator_init doesn't touch the required memory (except the free lists heads).
+// Large blocks are touched one by one in the address order: the first allocation that needs a new large block,
+// or freeing/reserving memory in a large block that is not touched yet, initializes the metadata of the large blocks up to this one.
+// It is useful for huge areas, where initialization of all metadata at once takes too long.
+#define BUDDY_ALLOCATOR_FLAG_LAZY_INIT 0x4
+// Group blocks by mobility, like migrate types in Linux, to keep large blocks available under long-running mixed workloads.
+// Each large block has a type, each type has its own free lists, blocks are allocated from the large blocks of the requested type (buddy_allocator_alloc_typed).
+// When the type has no free blocks, a whole free large block of another type is taken and its type is changed,
+// only if there are no free large blocks, a smaller block of another type is used.
+// So long-lived unmovable allocations are packed into a few large blocks instead of being scattered across all of them.
+#define BUDDY_ALLOCATOR_FLAG_MIGRATE_TYPES 0x8
+// Defer coalescing of freed small blocks, like the lazy buddy system.
+// buddy_allocator_free puts a freed block of the lowest orders to a small LIFO quicklist of its order (and type) without merging,
+// and an allocation of the order takes the last freed block, its memory is likely still in the CPU cache, so churn of small blocks doesn't split and merge.
+// Quicklisted blocks are free: they are counted in free_memory_size and in the free space distribution, but they are not in the free lists and their buddies aren't merged with them.
+// They are coalesced (freed with merging) when a quicklist reaches BUDDY_ALLOCATOR_QUICKLIST_HIGH blocks (the oldest BUDDY_ALLOCATOR_QUICKLIST_BATCH ones),
+// when an allocation finds no free block, before buddy_allocator_reserve_range, and by buddy_allocator_coalesce.
+// Runs of buddy_allocator_alloc_exact and buddy_allocator_free_bulk are freed with merging as without the flag.
+#define BUDDY_ALLOCATOR_FLAG_QUICKLISTS 0x10
+// Allocate the lowest-addressed free block of the chosen order instead of the head of its free list.
+// The order is chosen as without the flag (the smallest suitable one), then the block is found by find-first-set in the free blocks bitmap,
+// the blocks of one order are contiguous in it in the address order. A summary bitmap (one bit per word of the free blocks bitmap) lets the search skip empty words.
+// So allocations are packed toward the start of the area, the end of the area stays in free large blocks and can be released, see buddy_allocator_get_free_tail_size.
+// It can't be used with BUDDY_ALLOCATOR_FLAG_QUICKLISTS, quicklisted blocks are not in the bitmap.
+// It can't be used with BUDDY_ALLOCATOR_FLAG_MIGRATE_TYPES, the bitmap has no types, and skipping the free blocks of other types would make the search linear.
+#define BUDDY_ALLOCATOR_FLAG_ADDRESS_ORDERED 0x20
+
+// Migrate types for buddy_allocator_alloc_typed
+// Allocations which can't be moved, buddy_allocator_alloc uses this type
+#define BUDDY_ALLOCATOR_MIGRATE_UNMOVABLE 0
+// Allocations which can be moved (user pages), all large blocks have this type after initialization
+#define BUDDY_ALLOCATOR_MIGRATE_MOVABLE 1
+// Allocations which can be freed on demand (caches)
+#define BUDDY_ALLOCATOR_MIGRATE_RECLAIMABLE 2
+#define BUDDY_ALLOCATOR_MIGRATE_TYPES_NUMBER 3
+
+// Quicklists parameters, see BUDDY_ALLOCATOR_FLAG_QUICKLISTS
+// Orders from 0 to BUDDY_ALLOCATOR_QUICKLIST_ORDERS_NUMBER - 1 are quicklisted, but never the max order
+#define BUDDY_ALLOCATOR_QUICKLIST_ORDERS_NUMBER 2
+// Maximum number of blocks in one quicklist
+#define BUDDY_ALLOCATOR_QUICKLIST_HIGH 64
+// Number of the oldest blocks coalesced when a quicklist is full
+#define BUDDY_ALLOCATOR_QUICKLIST_BATCH 32
+
+// Flag of allocations_orders entries for blocks which continue the run allocated by buddy_allocator_alloc_exact
+#define BUDDY_ALLOCATOR_CONTINUATION_FLAG 0x80
+
+#ifdef BUDDY_ALLOCATOR_STATS
+/*
+ * Instrumentation counters, they exist only if BUDDY_ALLOCATOR_STATS is defined for all files of the allocator (-DBUDDY_ALLOCATOR_STATS),
+ * otherwise they are compiled out entirely.
+ * The allocator is not thread-safe, so the counters of an allocator are updated under the same lock as the allocator itself,
+ * the per-CPU caches keep their own counters for each CPU, see buddy_allocator_pcp_get_stats.
+ * Arrays are indexed by order.
+ */
+typedef struct {
+    // Allocations which found a free block of the requested order (or were served by a per-CPU cache), a bulk allocation counts each block
+    uint64_t fast_allocations[BUDDY_ALLOCATOR_MAX_ORDER_LIMIT + 1];
+    // Allocations which split a larger block (or refilled a per-CPU cache), a bulk allocation counts each block cut from a split block
+    uint64_t slow_allocations[BUDDY_ALLOCATOR_MAX_ORDER_LIMIT + 1];
+    // Allocations which failed, there was no free memory of the order
+    uint64_t failed_allocations[BUDDY_ALLOCATOR_MAX_ORDER_LIMIT + 1];
+    // Blocks of the order split into two halves by allocations, including bulk and exact-size ones, and by range reservations
+    uint64_t splits[BUDDY_ALLOCATOR_MAX_ORDER_LIMIT + 1];
+    // Blocks of the order produced by merging two buddies by frees, including bulk and range ones
+    uint64_t merges[BUDDY_ALLOCATOR_MAX_ORDER_LIMIT + 1];
+    // Frees which did nothing, the pointer was out of the area, not allocated or not the start of an allocation (NULL is not counted)
+    uint64_t rejected_frees;
+    // Requested sizes and sizes of the allocated blocks of successful allocations, the difference is the internal fragmentation
+    // Bulk allocations take whole blocks, the whole size of each block is requested
+    uint64_t requested_memory_size;
+    uint64_t granted_memory_size;
+} buddy_allocator_stats_t;
+#endif
+
+#ifdef BUDDY_ALLOCATOR_LATENCY
+// Number of buckets of a latency histogram
+#define BUDDY_ALLOCATOR_LATENCY_BUCKETS_NUMBER 32
+
+/*
+ * Latency histograms of buddy_allocator_alloc (alloc_typed) and buddy_allocator_free, they exist only if BUDDY_ALLOCATOR_LATENCY is defined
+ * for all files of the allocator (-DBUDDY_ALLOCATOR_LATENCY), each call is timed by the cycle counter (rdtsc on x86).
+ * Histograms are log-bucketed: bucket 0 counts calls which took 0 cycles, bucket N counts calls which took from 2^(N-1) to 2^N - 1 cycles,
+ * the last bucket counts all longer calls.
+ * Each histogram is keyed twice: by the order of the block and by the number of splits (merges) done by the call,
+ * so slow calls can be attributed to deep splitting (merging).
+ * The histograms are large (64 KB), so they are not a part of the allocator, the memory is attached by buddy_allocator_attach_latency.
+ */
+typedef struct {
+    // Allocations by the requested order, failed ones are counted too
+    uint64_t alloc_by_order[BUDDY_ALLOCATOR_MAX_ORDER_LIMIT + 1][BUDDY_ALLOCATOR_LATENCY_BUCKETS_NUMBER];
+    // Allocations by the number of splits, it is the order of the found free block minus the requested order,
+    // the merges of the quicklisted blocks coalesced by the allocation are added, the number is limited by BUDDY_ALLOCATOR_MAX_ORDER_LIMIT
+    uint64_t alloc_by_splits[BUDDY_ALLOCATOR_MAX_ORDER_LIMIT + 1][BUDDY_ALLOCATOR_LATENCY_BUCKETS_NUMBER];
+    // Frees by the order of the freed block (the first block of a run), rejected frees are not counted
+    uint64_t free_by_order[BUDDY_ALLOCATOR_MAX_ORDER_LIMIT + 1][BUDDY_ALLOCATOR_LATENCY_BUCKETS_NUMBER];
+    // Frees by the number of merges, for a run of buddy_allocator_alloc_exact merges of all its blocks are summed,
+    // a free to a full quicklist counts the merges of the coalesced blocks, the number is limited by BUDDY_ALLOCATOR_MAX_ORDER_LIMIT
+    uint64_t free_by_merges[BUDDY_ALLOCATOR_MAX_ORDER_LIMIT + 1][BUDDY_ALLOCATOR_LATENCY_BUCKETS_NUMBER];
+} buddy_allocator_latency_t;
+#endif
+
 typedef struct {
     // Main variables
     uintptr_t area_start_addr;
@@ -38,22 +165,38 @@ typedef struct {
     uint8_t max_order;
     // Page size
     uint32_t page_size;
+    // log2(page_size), so that division by page size is a shift
+    uint8_t page_shift;
     // Should all small blocks be marked as highlighted during initialization
     bool allocate_all_small_blocks;
+    // BUDDY_ALLOCATOR_FLAG_* flags passed to preinit
+    uint32_t flags;
+    // BUDDY_ALLOCATOR_MIGRATE_TYPES_NUMBER with BUDDY_ALLOCATOR_FLAG_MIGRATE_TYPES, 1 otherwise
+    uint8_t migrate_types_number;
 
     // Large block size (2^MAX_ORDER * PAGE_SIZE)
     size_t large_block_size;
     // Small block size (PAGE_SIZE)
     size_t small_block_size;
     // Total number of the large blocks
-    uint32_t large_blocks_number;
+    size_t large_blocks_number;
     // Total number of the small blocks
-    uint32_t small_blocks_number;
+    size_t small_blocks_number;
     // Total of all blocks of all sizes
-    uint32_t total_blocks_number;
+    size_t total_blocks_number;
+    // floor(log2(large_blocks_number))
+    uint8_t large_blocks_number_log2;
+    // Index of the first block of each depth (max_order - order), large_blocks_number * (2^depth - 1).
+    // It has max_order + 2 valid entries, the last one is equal to total_blocks_number.
+    // Used to calculate the order of the block by index without loops.
+    size_t first_index_by_depth[BUDDY_ALLOCATOR_MAX_ORDER_LIMIT + 2];
 
     // Array of all blocks nodes
+    // Only one of blocks_nodes and blocks_compact_nodes is used, depending on BUDDY_ALLOCATOR_FLAG_COMPACT_NODES
+    // With BUDDY_ALLOCATOR_FLAG_IN_BLOCK_NODES there is no array, nodes are in the free blocks
     memory_block_node_t* blocks_nodes;
+    // Array of all blocks compact nodes
+    memory_block_compact_node_t* blocks_compact_nodes;
     // Size of this array
     size_t blocks_nodes_memory_size;
 
@@ -61,9 +204,15 @@ typedef struct {
     // To free memory by address, we need to know the block size, this array contains the allocation orders, the allocation address is the offset in this array.
     // Stores order + 1, so that it can be determined whether a block is actually allocated. If the value is 0, the block has not been allocated and cannot be released.
     // Protects against re-releasing or releasing unallocated memory.
+    // Blocks allocated by buddy_allocator_alloc_exact are runs of several blocks, all blocks of a run except the first one
+    // have BUDDY_ALLOCATOR_CONTINUATION_FLAG set, they are freed together with the first one and cannot be freed directly.
     uint8_t* allocations_orders;
     // Size of this array
     size_t allocations_orders_memory_size;
+    // 1 after buddy_allocator_alloc_exact has allocated a run, it is never cleared until initialization.
+    // It is written with atomics under the lock of the allocator, the per-CPU caches read it without the global lock:
+    // while it is 0, no block can be the start of a run, so the allocation orders of other blocks aren't read.
+    uint64_t has_runs;
 
     /*
      * An array of free lists, each element of which represents a pointer to the beginning of a separate doubly-linked list for each order.
@@ -72,10 +221,73 @@ typedef struct {
      * free_blocks_lists[1] is a list of free blocks of size 2^1 * PAGE_SIZE
      * up to
      * free_blocks_lists[MAX_ORDER] is a list of free blocks of size 2^MAX_ORDER * PAGE_SIZE
+     * With BUDDY_ALLOCATOR_FLAG_MIGRATE_TYPES there is such a set of lists for each type, the list of the type and the order is free_blocks_lists[type * (MAX_ORDER + 1) + order].
+     * With BUDDY_ALLOCATOR_FLAG_COMPACT_NODES free_blocks_index_lists is used instead, it is organized in the same way.
      */
     doubly_linked_list_t* free_blocks_lists;
+    doubly_linked_index_list_t* free_blocks_index_lists;
+    // Size of this array
+    size_t free_blocks_lists_memory_size;
+    // Orders with free blocks, bit N is set when free_blocks_lists[N] is not empty.
+    // Allows to find the smallest suitable order with a single bit scan.
+    // With BUDDY_ALLOCATOR_FLAG_MIGRATE_TYPES it is the union of the masks of all types.
+    uint64_t free_orders_mask;
+    // The same masks for the lists of each type
+    uint64_t free_orders_masks[BUDDY_ALLOCATOR_MIGRATE_TYPES_NUMBER];
+    // Total size of all free blocks in bytes, including free large blocks which are not touched yet and quicklisted blocks
+    size_t free_memory_size;
+
+    /*
+     * Quicklists, only with BUDDY_ALLOCATOR_FLAG_QUICKLISTS, NULL otherwise
+     * The quicklist of the type and the order starts at quicklists[(type * BUDDY_ALLOCATOR_QUICKLIST_ORDERS_NUMBER + order) * BUDDY_ALLOCATOR_QUICKLIST_HIGH],
+     * it is a stack of block indices, the last freed block is on the top, the oldest one is at the bottom.
+     */
+    size_t* quicklists;
+    // Size of this array
+    size_t quicklists_memory_size;
+    // Numbers of blocks in the quicklists, indexed by type * BUDDY_ALLOCATOR_QUICKLIST_ORDERS_NUMBER + order
+    uint32_t quicklists_counts[BUDDY_ALLOCATOR_MIGRATE_TYPES_NUMBER * BUDDY_ALLOCATOR_QUICKLIST_ORDERS_NUMBER];
+    // Number of quicklisted orders, 0 without BUDDY_ALLOCATOR_FLAG_QUICKLISTS
+    uint8_t quicklist_orders_number;
+    // Orders with quicklisted blocks, bit N is set when a quicklist of the order N of any type is not empty
+    // free_orders_mask doesn't include them
+    uint64_t quicklist_orders_mask;
+
+    // Free blocks bitmap, one bit per node, the bit index is the block index.
+    // The bit is set when the block is in the free list and cleared when it is removed from it.
+    uint64_t* free_blocks_bitmap;
+    // Size of this array
+    size_t free_blocks_bitmap_memory_size;
+    // Summary of the free blocks bitmap, only with BUDDY_ALLOCATOR_FLAG_ADDRESS_ORDERED, NULL otherwise
+    // Bit N is set when word N of the free blocks bitmap may have set bits, it is cleared when the word becomes 0.
+    uint64_t* free_blocks_summary;
     // Size of this array
-    uint32_t free_blocks_lists_memory_size;
+    size_t free_blocks_summary_memory_size;
+
+    // Array of large blocks types, only with BUDDY_ALLOCATOR_FLAG_MIGRATE_TYPES, NULL otherwise
+    // A free block is in the free lists of the type of its large block, blocks of one large block are always merged in the same lists.
+    uint8_t* large_block_types;
+    // Size of this array
+    size_t large_block_types_memory_size;
+
+    // Index of the first large block which metadata (bits of its nodes and allocations orders of its pages) is not initialized yet.
+    // All large blocks from this one are untouched, they are free (or allocated if allocate_all_small_blocks is used), but not in the free lists.
+    // While there are untouched free large blocks, the bit of max order in free_orders_mask stays set.
+    // Without BUDDY_ALLOCATOR_FLAG_LAZY_INIT it is equal to large_blocks_number after initialization.
+    size_t untouched_large_block_index;
+
+#ifdef BUDDY_ALLOCATOR_STATS
+    // Instrumentation counters, reset by initialization
+    buddy_allocator_stats_t stats;
+#endif
+#ifdef BUDDY_ALLOCATOR_LATENCY
+    // Attached latency histograms, NULL after initialization, calls are not timed while it is NULL
+    buddy_allocator_latency_t* latency_ptr;
+#endif
+#ifdef BUDDY_ALLOCATOR_TRACE
+    // Attached event trace ring (buddy_allocator_trace.h), NULL after initialization, operations are not recorded while it is NULL
+    struct buddy_allocator_trace* trace_ptr;
+#endif
 } buddy_allocator_t;
 
 /*
@@ -91,7 +303,8 @@ typedef struct {
  * The true value is useful when there are areas occupied by something else in the area controlled by the allocator,
  * in this case, the entire area is marked as occupied and then free pages are released in it using the page-by-page call of the free function.
  * For example, in the OS kernel, we can have one allocator for the entire memory area, but it contains occupied areas (the kernel itself, ACPI, etc.),
- * in this case, we can use allocate_all_small_blocks = true, and then free up unoccupied pages using the free function.
+ * in this case, we can use allocate_all_small_blocks = true, and then free up unoccupied ranges using buddy_allocator_free_range function
+ * (or page by page using the free function).
  * required_memory_size_ptr total size of the memory required by the allocator WILL BE PLACED BY THIS FUNCTION in this variable, it is necessary to allocate at least.
  * If it contains 0 after the function call, then the initialization has failed.
  *
@@ -101,6 +314,21 @@ typedef struct {
  */
 extern void buddy_allocator_preinit(buddy_allocator_t* allocator_ptr, uintptr_t area_start_addr, size_t area_size, uint8_t max_order, uint32_t page_size, bool allocate_all_small_blocks, size_t* required_memory_size_ptr);
 
+/*
+ * The same as buddy_allocator_preinit, but takes additional flags
+ * flags combination of BUDDY_ALLOCATOR_FLAG_* flags
+ * BUDDY_ALLOCATOR_FLAG_COMPACT_NODES - blocks nodes are 8 bytes long regardless of the pointer size,
+ * if the total blocks number doesn't fit into 32 bits, the initialization fails.
+ * BUDDY_ALLOCATOR_FLAG_IN_BLOCK_NODES - the nodes of free blocks are written into the blocks, the allocator doesn't need memory for nodes,
+ * but the first sizeof(dll_node_t) bytes of the block are overwritten when it is freed.
+ * With this flag the area must be writable (unless allocate_all_small_blocks is true, the large blocks are written during initialization),
+ * if the page size is less than sizeof(dll_node_t), the initialization fails.
+ * Only one of BUDDY_ALLOCATOR_FLAG_COMPACT_NODES and BUDDY_ALLOCATOR_FLAG_IN_BLOCK_NODES can be used.
+ * Only one of BUDDY_ALLOCATOR_FLAG_QUICKLISTS and BUDDY_ALLOCATOR_FLAG_ADDRESS_ORDERED can be used.
+ * Only one of BUDDY_ALLOCATOR_FLAG_MIGRATE_TYPES and BUDDY_ALLOCATOR_FLAG_ADDRESS_ORDERED can be used.
+ */
+extern void buddy_allocator_preinit_ex(buddy_allocator_t* allocator_ptr, uintptr_t area_start_addr, size_t area_size, uint8_t max_order, uint32_t page_size, bool allocate_all_small_blocks, uint32_t flags, size_t* required_memory_size_ptr);
+
 /*
  * Finishes initialization by initializing the memory required to work the allocator.
  * allocator_ptr pointer to allocator data
@@ -110,6 +338,26 @@ extern void buddy_allocator_preinit(buddy_allocator_t* allocator_ptr, uintptr_t
  */
 extern void buddy_allocator_init(buddy_allocator_t* allocator_ptr, void* required_memory_ptr);
 
+// Task of buddy_allocator_init_parallel, task_index is from 0 to tasks_number - 1
+typedef void (*buddy_allocator_task_t)(void* task_data_ptr, size_t task_index);
+
+/*
+ * Runs the tasks, provided by the caller, so that any threads can be used (pthreads, kernel workers, etc.)
+ * context_ptr the context passed to buddy_allocator_init_parallel
+ * Must call task(task_data_ptr, i) once for each i from 0 to tasks_number - 1, in any order and in parallel, and return when all calls are done.
+ */
+typedef void (*buddy_allocator_run_tasks_t)(void* context_ptr, buddy_allocator_task_t task, void* task_data_ptr, size_t tasks_number);
+
+/*
+ * The same as buddy_allocator_init, but the initialization is split into tasks_number tasks which are run by run_tasks.
+ * Each task initializes the metadata of its range of large blocks and links them into a list segment,
+ * after all tasks the segments are joined into the free list of max order, it takes O(tasks_number).
+ * The result is the same as after buddy_allocator_init.
+ * If tasks_number is less than 2 or run_tasks is NULL, or BUDDY_ALLOCATOR_FLAG_LAZY_INIT is used, it is buddy_allocator_init.
+ * run_tasks_context_ptr the context passed to run_tasks
+ */
+extern void buddy_allocator_init_parallel(buddy_allocator_t* allocator_ptr, void* required_memory_ptr, size_t tasks_number, buddy_allocator_run_tasks_t run_tasks, void* run_tasks_context_ptr);
+
 /*
  * Allocates a block of memory, returns a pointer to memory within the allocator memory area
  * allocator_ptr pointer to allocator data
@@ -126,4 +374,147 @@ extern void* buddy_allocator_alloc(buddy_allocator_t* allocator_ptr, size_t size
  */
 extern void buddy_allocator_free(buddy_allocator_t* allocator_ptr, void* memory_ptr);
 
+/*
+ * Allocates a block of memory of the migrate type, BUDDY_ALLOCATOR_MIGRATE_*
+ * The same as buddy_allocator_alloc, which allocates unmovable blocks, the memory is freed by buddy_allocator_free.
+ * Without BUDDY_ALLOCATOR_FLAG_MIGRATE_TYPES the type is ignored.
+ */
+extern void* buddy_allocator_alloc_typed(buddy_allocator_t* allocator_ptr, size_t size, uint8_t type);
+
+/*
+ * Frees all whole pages of the range, returns true on success
+ * allocator_ptr pointer to allocator data
+ * start_ptr start of the range
+ * size size of the range
+ * The pages must be reserved: marked as allocated by allocate_all_small_blocks, reserved by buddy_allocator_reserve_range or allocated as single pages.
+ * If any page is not, or the range is not inside the area, nothing is freed and false is returned.
+ * The range is split into maximal naturally aligned blocks which are freed at once, so the cost depends on the number of blocks, not pages.
+ * It is the fast way to free the usable memory after initialization with allocate_all_small_blocks = true.
+ */
+extern bool buddy_allocator_free_range(buddy_allocator_t* allocator_ptr, void* start_ptr, size_t size);
+
+/*
+ * Reserves all pages touched by the range, returns true on success
+ * allocator_ptr pointer to allocator data
+ * start_ptr start of the range
+ * size size of the range
+ * All pages of the range must be free, otherwise nothing is reserved and false is returned.
+ * Free blocks that intersect the range are carved: their parts outside the range are put back to the free lists as maximal aligned blocks.
+ * Reserved pages are marked as allocated pages, they can be freed by buddy_allocator_free_range or page by page.
+ * For example, it is used to exclude holes reserved by firmware after initialization with allocate_all_small_blocks = false.
+ */
+extern bool buddy_allocator_reserve_range(buddy_allocator_t* allocator_ptr, void* start_ptr, size_t size);
+
+/*
+ * Allocates exactly ceil(size / PAGE_SIZE) pages, returns a pointer to memory within the allocator memory area
+ * allocator_ptr pointer to allocator data
+ * size requested memory size, the size cannot be larger than PAGE_SIZE * 2^MAX_ORDER
+ * The block covering the size is allocated, then its unused tail is returned to the free lists as maximal aligned blocks.
+ * For example, 5 pages are a block of 4 pages and a block of 1 page, the remaining 3 pages (1 + 2) are free.
+ * The memory is freed by buddy_allocator_free as usual, all blocks of the run are freed at once.
+ */
+extern void* buddy_allocator_alloc_exact(buddy_allocator_t* allocator_ptr, size_t size);
+
+/*
+ * Allocates count blocks of the order at once, returns the number of allocated blocks, it is less than count if there is not enough memory
+ * allocator_ptr pointer to allocator data
+ * order order of the blocks
+ * count number of blocks
+ * blocks_array array of at least count elements, the addresses of the allocated blocks are written to it in ascending order within each split block
+ * A larger block is taken from the free lists once and all its pieces are handed out in one pass,
+ * only the pieces that are not needed are put to the free lists.
+ */
+extern size_t buddy_allocator_alloc_bulk(buddy_allocator_t* allocator_ptr, uint8_t order, size_t count, void** blocks_array);
+
+/*
+ * Frees count blocks at once, returns the number of freed blocks, incorrect and repeated addresses are skipped
+ * allocator_ptr pointer to allocator data
+ * blocks_array addresses of the blocks, they can be of different orders.
+ * THE ARRAY IS SORTED AND OVERWRITTEN, the addresses are sorted and buddies are merged before the free lists are touched.
+ * count number of addresses
+ */
+extern size_t buddy_allocator_free_bulk(buddy_allocator_t* allocator_ptr, void** blocks_array, size_t count);
+
+/*
+ * Coalesces all quicklisted blocks, they are put to the free lists and merged with their buddies, see BUDDY_ALLOCATOR_FLAG_QUICKLISTS
+ * For example, it is called before the free lists are inspected or when the memory is low, without the flag it does nothing.
+ */
+extern void buddy_allocator_coalesce(buddy_allocator_t* allocator_ptr);
+
+// Free space of one order
+typedef struct {
+    // Number of free blocks of the order
+    size_t free_blocks_number;
+    // Free memory in these blocks in bytes
+    size_t free_memory_size;
+    // Unusable free space index in thousandths, the part of the free memory which is in blocks smaller than the order
+    // 0 - all free memory can be used for allocations of the order, 1000 - none of it (or there is no free memory)
+    uint32_t unusable_free_space_index;
+} buddy_allocator_order_info_t;
+
+/*
+ * Gets the free space distribution, in O(MAX_ORDER), the free lists are not walked
+ * allocator_ptr pointer to allocator data
+ * orders_info array of MAX_ORDER + 1 elements, element N describes the order N
+ * With BUDDY_ALLOCATOR_FLAG_MIGRATE_TYPES the blocks of all types are counted.
+ */
+extern void buddy_allocator_get_orders_info(buddy_allocator_t* allocator_ptr, buddy_allocator_order_info_t* orders_info);
+
+/*
+ * Gets the external fragmentation index for allocations of the order in thousandths, like fragmentation_index in Linux
+ * -1000 if an allocation of the order would succeed
+ * Otherwise from 0 to 1000, values close to 0 mean that the allocation fails because there is not enough free memory,
+ * values close to 1000 mean that it fails because the free memory is fragmented.
+ */
+extern int32_t buddy_allocator_get_fragmentation_index(buddy_allocator_t* allocator_ptr, uint8_t order);
+
+/*
+ * Gets the size of the free memory at the end of the area in whole large blocks, in O(number of these blocks)
+ * These large blocks are free, their memory can be released (for example, returned to the OS) while they stay free,
+ * the allocator doesn't touch the memory of free blocks unless BUDDY_ALLOCATOR_FLAG_IN_BLOCK_NODES is used.
+ * With BUDDY_ALLOCATOR_FLAG_ADDRESS_ORDERED the free large blocks are kept at the end of the area.
+ */
+extern size_t buddy_allocator_get_free_tail_size(buddy_allocator_t* allocator_ptr);
+
+/*
+ * Formats the numbers of free blocks of each order as text, like /proc/buddyinfo in Linux:
+ * Area 0x1000, type       All      3      0      1      0
+ * With BUDDY_ALLOCATOR_FLAG_MIGRATE_TYPES a line for each type follows, the line of the type Unmovable, Movable or Reclaimable.
+ * buffer, buffer_size the text is written to the buffer, it is truncated to buffer_size - 1 characters and null-terminated
+ * Returns the length of the whole text without the null character, the text is truncated if it is not less than buffer_size.
+ */
+extern size_t buddy_allocator_format_buddyinfo(buddy_allocator_t* allocator_ptr, char* buffer, size_t buffer_size);
+
+#ifdef BUDDY_ALLOCATOR_STATS
+/*
+ * Copies the instrumentation counters of the allocator
+ */
+extern void buddy_allocator_get_stats(buddy_allocator_t* allocator_ptr, buddy_allocator_stats_t* stats_ptr);
+
+/*
+ * Sets all instrumentation counters of the allocator to 0
+ */
+extern void buddy_allocator_reset_stats(buddy_allocator_t* allocator_ptr);
+#endif
+
+#ifdef BUDDY_ALLOCATOR_LATENCY
+/*
+ * Attaches the memory for the latency histograms, they are cleared, the calls are timed from now on
+ * allocator_ptr pointer to allocator data, it must be initialized
+ * latency_ptr memory for the histograms, it must be valid while it is attached, NULL detaches the histograms
+ */
+extern void buddy_allocator_attach_latency(buddy_allocator_t* allocator_ptr, buddy_allocator_latency_t* latency_ptr);
+
+/*
+ * Copies the attached latency histograms, the copy is cleared if they are not attached
+ * The histograms are updated by the allocator calls, so the copy is consistent if it is taken under the same lock as the calls.
+ */
+extern void buddy_allocator_get_latency(buddy_allocator_t* allocator_ptr, buddy_allocator_latency_t* snapshot_ptr);
+
+/*
+ * Clears the attached latency histograms, for example after each snapshot to get the latency of an interval
+ */
+extern void buddy_allocator_reset_latency(buddy_allocator_t* allocator_ptr);
+#endif
+
 #endif
@@ -0,0 +1,167 @@
+#ifndef _BUDDY_ALLOCATOR_INDEX_H_
+#define _BUDDY_ALLOCATOR_INDEX_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "buddy_allocator.h"
+#include "../bitops/bitops.h"
+
+/*
+ * Block index arithmetic of the buddy allocator.
+ * It is internal to the allocator, the functions are in the header only so that the benchmarks can measure them.
+ *
+ * Blocks are numbered order by order starting from the max order:
+ * 2 |     0     |     1     |
+ * 1 |  2  |  3  |  4  |  5  |
+ * 0 |6 |7 |8 |9 |10|11|12|13|
+ * The depth of a block is max_order - order.
+ * The first block of depth D has index large_blocks_number * (2^D - 1), these values are precomputed in first_index_by_depth.
+ * No function here loops, all of them are a few shifts, a bit scan and a table lookup.
+ */
+
+/*
+ * Get depth (max_order - order) of block by index
+ * For a block of depth D: large_blocks_number * 2^D <= block_index + large_blocks_number < large_blocks_number * 2^(D+1),
+ * so log2(block_index + large_blocks_number) - log2(large_blocks_number) is either D or D + 1.
+ * The comparison with the first index of that depth selects the right one,
+ * when large_blocks_number is a power of two it is always false and the result is just the difference of the logarithms.
+ */
+static inline uint8_t get_depth_by_index(buddy_allocator_t* allocator_ptr, size_t block_index)
+{
+    uint8_t depth = bitops_find_last_set((uint64_t)block_index + allocator_ptr->large_blocks_number) - allocator_ptr->large_blocks_number_log2;
+    depth -= (uint8_t)(block_index < allocator_ptr->first_index_by_depth[depth]);
+    return depth;
+}
+
+/*
+ * Get order of block by index
+ * Example:
+ * 2 |     0     |     1     | 0 1
+ * 1 |  2  |  3  |  4  |  5  | 2 5
+ * 0 |6 |7 |8 |9 |10|11|12|13| 6 13
+ * 1 - 2, 4 - 1, 8 - 0
+ */
+static inline uint8_t get_order_by_index(buddy_allocator_t* allocator_ptr, size_t block_index)
+{
+    return allocator_ptr->max_order - get_depth_by_index(allocator_ptr, block_index);
+}
+
+/*
+ * Get block size by order
+ */
+static inline size_t get_size_by_order(buddy_allocator_t* allocator_ptr, uint8_t order)
+{
+    return (size_t)1 << (order + allocator_ptr->page_shift);
+}
+
+/*
+ * Get order by size
+ * It is the ceil(log2) of the number of pages, so for size > page_size it is log2(number of pages - 1) + 1
+ */
+static inline uint8_t get_order_by_size(buddy_allocator_t* allocator_ptr, size_t size)
+{
+    // We cannot allocate memory less than 1 page (smallest block)
+    if (size <= allocator_ptr->small_block_size) {
+        return 0;
+    }
+    return bitops_find_last_set((size - 1) >> allocator_ptr->page_shift) + 1;
+}
+
+/*
+ * Get blocks number by order
+ */
+static inline size_t get_blocks_number_by_order(buddy_allocator_t* allocator_ptr, uint8_t order)
+{
+    // Number of blocks changes exponentially, let's find member of geometric progression
+    return allocator_ptr->large_blocks_number << (allocator_ptr->max_order - order);
+}
+
+/*
+ * Get blocks first (left) child
+ * 2 |     0     |
+ * 1 |  1  |  2  |
+ * 0 |3 |4 |5 |6 |
+ * 0 - 1, 1 - 3, 2 - 5
+ * 2 |     0     |     1     |
+ * 1 |  2  |  3  |  4  |  5  |
+ * 0 |6 |7 |8 |9 |10|11|12|13|
+ * 0 - 2, 4 - 10, 5 - 12
+ * 2 |     0     |     1     |     2     |
+ * 1 |  3  |  4  |  5  |  6  |  7  |  8  |
+ * 0 |9 |10|11|12|13|14|15|16|17|18|19|20|
+ * 0 - 3, 3 - 9, 2 - 7, 8 - 19
+ */
+static inline size_t get_first_child_by_index(buddy_allocator_t* allocator_ptr, size_t block_index)
+{
+    return (block_index * 2) + allocator_ptr->large_blocks_number;
+}
+
+/*
+ * Get blocks second (right) child
+ * 2 |     0     |
+ * 1 |  1  |  2  |
+ * 0 |3 |4 |5 |6 |
+ * 0 - 2, 1 - 4, 2 - 6
+ * 2 |     0     |     1     |
+ * 1 |  2  |  3  |  4  |  5  |
+ * 0 |6 |7 |8 |9 |10|11|12|13|
+ * 0 - 3, 4 - 11, 5 - 13
+ * 2 |     0     |     1     |     2     |
+ * 1 |  3  |  4  |  5  |  6  |  7  |  8  |
+ * 0 |9 |10|11|12|13|14|15|16|17|18|19|20|
+ * 0 - 4, 3 - 10, 2 - 8, 8 - 20
+ */
+static inline size_t get_second_child_by_index(buddy_allocator_t* allocator_ptr, size_t block_index)
+{
+    return ((block_index * 2) + allocator_ptr->large_blocks_number) + 1;
+}
+
+/*
+ * Get blocks parent by index
+ */
+static inline size_t get_parent_by_index(buddy_allocator_t* allocator_ptr, size_t block_index)
+{
+    return (block_index - allocator_ptr->large_blocks_number) / 2;
+}
+
+/*
+ * Get index in order by global index
+ */
+static inline size_t get_index_in_order_by_index(buddy_allocator_t* allocator_ptr, size_t block_index)
+{
+    return block_index - allocator_ptr->first_index_by_depth[get_depth_by_index(allocator_ptr, block_index)];
+}
+
+/*
+ * Get block buddy index by index
+ * Don't use if (block_index < large_blocks_number && (allocator_ptr->large_blocks_number % 2) == 1)
+ * because last large block don't have buddy
+ * In general, there is no need to call this function for large blocks because they are not merge
+ */
+static inline size_t get_buddy_by_index(buddy_allocator_t* allocator_ptr, size_t block_index)
+{
+    size_t first_index_in_order = allocator_ptr->first_index_by_depth[get_depth_by_index(allocator_ptr, block_index)];
+    return ((block_index - first_index_in_order) ^ 1) + first_index_in_order;
+}
+
+/*
+ * Get global index by in order index
+ */
+static inline size_t get_index_by_in_order_index(buddy_allocator_t* allocator_ptr, size_t block_index, uint8_t order)
+{
+    return block_index + allocator_ptr->first_index_by_depth[allocator_ptr->max_order - order];
+}
+
+/*
+ * Returns true if the allocated block of the order at the page is the start of a run allocated by buddy_allocator_alloc_exact
+ * The block after the first block of a run is a continuation. A run never crosses a large block,
+ * so the page after a block which ends at the end of its large block isn't read, the next large block may be not touched yet.
+ */
+static inline bool is_run_start_by_page(buddy_allocator_t* allocator_ptr, size_t page_index, uint8_t order)
+{
+    size_t next_page_index = page_index + ((size_t)1 << order);
+    return (next_page_index & (((size_t)1 << allocator_ptr->max_order) - 1)) != 0 && (allocator_ptr->allocations_orders[next_page_index] & BUDDY_ALLOCATOR_CONTINUATION_FLAG);
+}
+
+#endif
@@ -0,0 +1,27 @@
+#ifndef _BUDDY_ALLOCATOR_LOCK_H_
+#define _BUDDY_ALLOCATOR_LOCK_H_
+
+#include <stddef.h>
+
+// Locks for the thread-safe front ends of the allocator, the allocator itself doesn't use locks
+
+// Alignment of each lock in the required memory, the required memory itself must be aligned to it too
+#define BUDDY_ALLOCATOR_LOCK_ALIGNMENT 16
+// Data used by different CPUs is placed on different cache lines
+#define BUDDY_ALLOCATOR_CACHE_LINE_SIZE 64
+
+/*
+ * Lock operations provided by the caller
+ * lock_size size of one lock object, the memory for the locks is the part of the required memory
+ * lock_init initializes a lock object, it can be NULL if the lock doesn't need initialization
+ * lock and unlock take a pointer to the lock object
+ * For example, a pthread_mutex_t or a spinlock can be used.
+ */
+typedef struct {
+    size_t lock_size;
+    void (*lock_init)(void* lock_ptr);
+    void (*lock)(void* lock_ptr);
+    void (*unlock)(void* lock_ptr);
+} buddy_allocator_lock_ops_t;
+
+#endif
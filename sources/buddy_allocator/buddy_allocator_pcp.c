@@ -0,0 +1,309 @@
+#include "buddy_allocator_pcp.h"
+#include "buddy_allocator_index.h"
+#include "buddy_allocator_stats.h"
+#include "../atomics/atomics.h"
+#include <string.h>
+
+/*
+ * Rounds the value up to the alignment, the alignment must be power of 2
+ */
+static size_t round_up(size_t value, size_t alignment)
+{
+    return (value + alignment - 1) & ~(alignment - 1);
+}
+
+static uint8_t* get_cpu_memory(buddy_allocator_pcp_t* pcp_ptr, size_t cpu)
+{
+    return pcp_ptr->cpus_memory_ptr + cpu * pcp_ptr->cpu_memory_size;
+}
+
+static void* get_cpu_lock(buddy_allocator_pcp_t* pcp_ptr, size_t cpu)
+{
+    return get_cpu_memory(pcp_ptr, cpu);
+}
+
+#ifdef BUDDY_ALLOCATOR_STATS
+/*
+ * Get instrumentation counters of the CPU, they are protected by the CPU lock
+ */
+static buddy_allocator_stats_t* get_cpu_stats(buddy_allocator_pcp_t* pcp_ptr, size_t cpu)
+{
+    return (buddy_allocator_stats_t*)(get_cpu_memory(pcp_ptr, cpu) + pcp_ptr->cpu_stats_offset);
+}
+#endif
+
+/*
+ * Get number of blocks in the cache of the order
+ */
+static size_t* get_cache_count(buddy_allocator_pcp_t* pcp_ptr, size_t cpu, uint8_t order)
+{
+    return (size_t*)(get_cpu_memory(pcp_ptr, cpu) + pcp_ptr->cpu_counts_offset) + order;
+}
+
+/*
+ * Get blocks addresses stack of the cache of the order
+ */
+static void** get_cache_blocks(buddy_allocator_pcp_t* pcp_ptr, size_t cpu, uint8_t order)
+{
+    return (void**)(get_cpu_memory(pcp_ptr, cpu) + pcp_ptr->cpu_blocks_offset) + order * pcp_ptr->high;
+}
+
+/*
+ * Returns the first blocks_number blocks (the coldest ones) of the cache to the allocator under one global lock acquisition
+ * The CPU lock must be held
+ */
+static void drain_cache(buddy_allocator_pcp_t* pcp_ptr, size_t cpu, uint8_t order, size_t blocks_number)
+{
+    size_t* count_ptr = get_cache_count(pcp_ptr, cpu, order);
+    void** blocks = get_cache_blocks(pcp_ptr, cpu, order);
+    if (blocks_number > *count_ptr) {
+        blocks_number = *count_ptr;
+    }
+    if (blocks_number == 0) {
+        return;
+    }
+
+    pcp_ptr->lock_ops.lock(pcp_ptr->global_lock_ptr);
+    buddy_allocator_free_bulk(pcp_ptr->allocator_ptr, blocks, blocks_number);
+    pcp_ptr->lock_ops.unlock(pcp_ptr->global_lock_ptr);
+
+    *count_ptr -= blocks_number;
+    memmove(blocks, blocks + blocks_number, *count_ptr * sizeof(void*));
+}
+
+/*
+ * Takes a block of the size from the cache, the cache is refilled if it is empty
+ * Returns NULL if the allocator has no free blocks of this order
+ */
+static void* alloc_from_cache(buddy_allocator_pcp_t* pcp_ptr, size_t cpu, size_t size)
+{
+    uint8_t order = get_order_by_size(pcp_ptr->allocator_ptr, size);
+    void* cpu_lock_ptr = get_cpu_lock(pcp_ptr, cpu);
+    pcp_ptr->lock_ops.lock(cpu_lock_ptr);
+
+    size_t* count_ptr = get_cache_count(pcp_ptr, cpu, order);
+    void** blocks = get_cache_blocks(pcp_ptr, cpu, order);
+    if (*count_ptr != 0) {
+        BUDDY_ALLOCATOR_STATS_UPDATE(get_cpu_stats(pcp_ptr, cpu)->fast_allocations[order]++);
+    }
+    else {
+        // Refill the cache with batch blocks under one global lock acquisition
+        pcp_ptr->lock_ops.lock(pcp_ptr->global_lock_ptr);
+        *count_ptr = buddy_allocator_alloc_bulk(pcp_ptr->allocator_ptr, order, pcp_ptr->batch, blocks);
+        pcp_ptr->lock_ops.unlock(pcp_ptr->global_lock_ptr);
+
+        // The cache is a stack, reverse the blocks so that they are allocated in the same order as they were allocated from the allocator
+        for (size_t i = 0; i < *count_ptr / 2; ++i) {
+            void* block_ptr = blocks[i];
+            blocks[i] = blocks[*count_ptr - 1 - i];
+            blocks[*count_ptr - 1 - i] = block_ptr;
+        }
+        BUDDY_ALLOCATOR_STATS_UPDATE(get_cpu_stats(pcp_ptr, cpu)->slow_allocations[order] += (*count_ptr != 0));
+    }
+
+    void* memory_ptr = NULL;
+    if (*count_ptr != 0) {
+        memory_ptr = blocks[--(*count_ptr)];
+        // The block is already requested and granted whole by the bulk allocation of the refill, only the requested size is corrected,
+        // the counter of the CPU may wrap around, the sum of the counters doesn't
+        BUDDY_ALLOCATOR_STATS_UPDATE(get_cpu_stats(pcp_ptr, cpu)->requested_memory_size -= ((uint64_t)1 << (order + pcp_ptr->allocator_ptr->page_shift)) - size);
+    }
+
+    pcp_ptr->lock_ops.unlock(cpu_lock_ptr);
+    return memory_ptr;
+}
+
+void buddy_allocator_pcp_preinit(buddy_allocator_pcp_t* pcp_ptr, buddy_allocator_t* allocator_ptr, size_t cpus_number, uint8_t cached_orders_number, size_t high, size_t batch, const buddy_allocator_lock_ops_t* lock_ops_ptr, size_t* required_memory_size_ptr)
+{
+    if (pcp_ptr == NULL || allocator_ptr == NULL || lock_ops_ptr == NULL || lock_ops_ptr->lock == NULL || lock_ops_ptr->unlock == NULL || required_memory_size_ptr == NULL) {
+        return;
+    }
+    if (allocator_ptr->large_blocks_number == 0) {
+        // The allocator is not pre-initialized
+        return;
+    }
+    if (cpus_number == 0 || cached_orders_number == 0 || cached_orders_number > allocator_ptr->max_order + 1 || batch == 0 || batch > high) {
+        return;
+    }
+    if (lock_ops_ptr->lock_size > SIZE_MAX / 4 || high > SIZE_MAX / sizeof(void*) / cached_orders_number / 4) {
+        return;
+    }
+
+    pcp_ptr->allocator_ptr = allocator_ptr;
+    pcp_ptr->lock_ops = *lock_ops_ptr;
+    pcp_ptr->cpus_number = cpus_number;
+    pcp_ptr->cached_orders_number = cached_orders_number;
+    pcp_ptr->high = high;
+    pcp_ptr->batch = batch;
+
+    // CPU = [CPU lock, caches counts, caches blocks]
+#ifdef BUDDY_ALLOCATOR_STATS
+    pcp_ptr->cpu_stats_offset = round_up(pcp_ptr->lock_ops.lock_size, BUDDY_ALLOCATOR_LOCK_ALIGNMENT);
+    pcp_ptr->cpu_counts_offset = round_up(pcp_ptr->cpu_stats_offset + sizeof(buddy_allocator_stats_t), BUDDY_ALLOCATOR_LOCK_ALIGNMENT);
+#else
+    pcp_ptr->cpu_counts_offset = round_up(pcp_ptr->lock_ops.lock_size, BUDDY_ALLOCATOR_LOCK_ALIGNMENT);
+#endif
+    pcp_ptr->cpu_blocks_offset = pcp_ptr->cpu_counts_offset + cached_orders_number * sizeof(size_t);
+    pcp_ptr->cpu_memory_size = round_up(pcp_ptr->cpu_blocks_offset + cached_orders_number * high * sizeof(void*), BUDDY_ALLOCATOR_CACHE_LINE_SIZE);
+
+    // [global lock | CPU 0 | CPU 1 | ... ]
+    size_t global_lock_memory_size = round_up(pcp_ptr->lock_ops.lock_size, BUDDY_ALLOCATOR_CACHE_LINE_SIZE);
+    if (cpus_number > (SIZE_MAX - global_lock_memory_size) / pcp_ptr->cpu_memory_size) {
+        return;
+    }
+    *required_memory_size_ptr = global_lock_memory_size + cpus_number * pcp_ptr->cpu_memory_size;
+}
+
+void buddy_allocator_pcp_init(buddy_allocator_pcp_t* pcp_ptr, void* required_memory_ptr)
+{
+    if (pcp_ptr == NULL || required_memory_ptr == NULL) {
+        return;
+    }
+
+    // required_memory_ptr = [global lock | CPU 0 | CPU 1 | ... ]
+    pcp_ptr->global_lock_ptr = required_memory_ptr;
+    pcp_ptr->cpus_memory_ptr = (uint8_t*)required_memory_ptr + round_up(pcp_ptr->lock_ops.lock_size, BUDDY_ALLOCATOR_CACHE_LINE_SIZE);
+    memset(pcp_ptr->cpus_memory_ptr, 0, pcp_ptr->cpus_number * pcp_ptr->cpu_memory_size);
+
+    if (pcp_ptr->lock_ops.lock_init != NULL) {
+        pcp_ptr->lock_ops.lock_init(pcp_ptr->global_lock_ptr);
+        for (size_t cpu = 0; cpu < pcp_ptr->cpus_number; ++cpu) {
+            pcp_ptr->lock_ops.lock_init(get_cpu_lock(pcp_ptr, cpu));
+        }
+    }
+}
+
+void* buddy_allocator_pcp_alloc(buddy_allocator_pcp_t* pcp_ptr, size_t cpu, size_t size)
+{
+    if (pcp_ptr == NULL || cpu >= pcp_ptr->cpus_number || size == 0 || size > pcp_ptr->allocator_ptr->large_block_size) {
+        return NULL;
+    }
+
+    uint8_t order = get_order_by_size(pcp_ptr->allocator_ptr, size);
+    void* memory_ptr = NULL;
+    if (order < pcp_ptr->cached_orders_number) {
+        memory_ptr = alloc_from_cache(pcp_ptr, cpu, size);
+    }
+    else {
+        pcp_ptr->lock_ops.lock(pcp_ptr->global_lock_ptr);
+        memory_ptr = buddy_allocator_alloc(pcp_ptr->allocator_ptr, size);
+        pcp_ptr->lock_ops.unlock(pcp_ptr->global_lock_ptr);
+    }
+
+    if (memory_ptr == NULL) {
+        // The free memory may be in the caches, return it to the allocator and try again
+        // The block is allocated directly, there is no point in refilling the cache when there is little memory
+        buddy_allocator_pcp_drain_all(pcp_ptr);
+        pcp_ptr->lock_ops.lock(pcp_ptr->global_lock_ptr);
+        memory_ptr = buddy_allocator_alloc(pcp_ptr->allocator_ptr, size);
+        pcp_ptr->lock_ops.unlock(pcp_ptr->global_lock_ptr);
+    }
+    return memory_ptr;
+}
+
+void buddy_allocator_pcp_free(buddy_allocator_pcp_t* pcp_ptr, size_t cpu, void* memory_ptr)
+{
+    if (pcp_ptr == NULL || cpu >= pcp_ptr->cpus_number || memory_ptr == NULL) {
+        return;
+    }
+    buddy_allocator_t* allocator_ptr = pcp_ptr->allocator_ptr;
+
+    // The allocation order of the block doesn't change while the block is allocated, it can be read without the global lock
+    // Incorrect addresses and addresses in untouched large blocks (BUDDY_ALLOCATOR_FLAG_LAZY_INIT) are passed to the allocator, it checks them
+    // The untouched large block index is changed by other threads under the global lock, so it is read with acquire:
+    // the allocator publishes it with release after initializing the metadata of the block, so the allocation orders of touched blocks are initialized.
+    // It only grows, a stale value makes the free go to the allocator, which checks the address under the global lock.
+    size_t memory_block_page_index = 0;
+    uint8_t allocation_order = 0;
+    if ((uintptr_t)memory_ptr >= allocator_ptr->area_start_addr && (uintptr_t)memory_ptr - allocator_ptr->area_start_addr < allocator_ptr->area_size) {
+        memory_block_page_index = ((uintptr_t)memory_ptr - allocator_ptr->area_start_addr) >> allocator_ptr->page_shift;
+        if ((memory_block_page_index >> allocator_ptr->max_order) < atomics_load_acquire_size(&allocator_ptr->untouched_large_block_index)) {
+            allocation_order = allocator_ptr->allocations_orders[memory_block_page_index];
+        }
+    }
+    bool is_cached = allocation_order != 0 && allocation_order - 1 < pcp_ptr->cached_orders_number;
+    if (is_cached && atomics_load_64(&allocator_ptr->has_runs) != 0) {
+        // Runs of buddy_allocator_alloc_exact are not cached. The next page may belong to a block of another thread,
+        // its allocation order is changed under the global lock, so it is read under it.
+        // A run sets has_runs before it is returned, so if the freed block is a run, has_runs is already 1 here.
+        pcp_ptr->lock_ops.lock(pcp_ptr->global_lock_ptr);
+        is_cached = !is_run_start_by_page(allocator_ptr, memory_block_page_index, allocation_order - 1);
+        pcp_ptr->lock_ops.unlock(pcp_ptr->global_lock_ptr);
+    }
+    if (is_cached) {
+        uint8_t order = allocation_order - 1;
+        void* cpu_lock_ptr = get_cpu_lock(pcp_ptr, cpu);
+        pcp_ptr->lock_ops.lock(cpu_lock_ptr);
+        size_t* count_ptr = get_cache_count(pcp_ptr, cpu, order);
+        if (*count_ptr == pcp_ptr->high) {
+            // The cache is full, return the coldest blocks to the allocator
+            drain_cache(pcp_ptr, cpu, order, pcp_ptr->batch);
+        }
+        get_cache_blocks(pcp_ptr, cpu, order)[(*count_ptr)++] = memory_ptr;
+        pcp_ptr->lock_ops.unlock(cpu_lock_ptr);
+    }
+    else {
+        // Large blocks and incorrect addresses, the allocator checks them
+        pcp_ptr->lock_ops.lock(pcp_ptr->global_lock_ptr);
+        buddy_allocator_free(allocator_ptr, memory_ptr);
+        pcp_ptr->lock_ops.unlock(pcp_ptr->global_lock_ptr);
+    }
+}
+
+void buddy_allocator_pcp_drain(buddy_allocator_pcp_t* pcp_ptr, size_t cpu)
+{
+    if (pcp_ptr == NULL || cpu >= pcp_ptr->cpus_number) {
+        return;
+    }
+    void* cpu_lock_ptr = get_cpu_lock(pcp_ptr, cpu);
+    pcp_ptr->lock_ops.lock(cpu_lock_ptr);
+    for (uint8_t order = 0; order < pcp_ptr->cached_orders_number; ++order) {
+        drain_cache(pcp_ptr, cpu, order, pcp_ptr->high);
+    }
+    pcp_ptr->lock_ops.unlock(cpu_lock_ptr);
+}
+
+void buddy_allocator_pcp_drain_all(buddy_allocator_pcp_t* pcp_ptr)
+{
+    if (pcp_ptr == NULL) {
+        return;
+    }
+    // One CPU lock at a time, so it can't deadlock with other CPUs
+    for (size_t cpu = 0; cpu < pcp_ptr->cpus_number; ++cpu) {
+        buddy_allocator_pcp_drain(pcp_ptr, cpu);
+    }
+}
+
+#ifdef BUDDY_ALLOCATOR_STATS
+void buddy_allocator_pcp_get_stats(buddy_allocator_pcp_t* pcp_ptr, buddy_allocator_stats_t* stats_ptr)
+{
+    if (pcp_ptr == NULL || stats_ptr == NULL) {
+        return;
+    }
+    pcp_ptr->lock_ops.lock(pcp_ptr->global_lock_ptr);
+    buddy_allocator_get_stats(pcp_ptr->allocator_ptr, stats_ptr);
+    pcp_ptr->lock_ops.unlock(pcp_ptr->global_lock_ptr);
+    for (size_t cpu = 0; cpu < pcp_ptr->cpus_number; ++cpu) {
+        void* cpu_lock_ptr = get_cpu_lock(pcp_ptr, cpu);
+        pcp_ptr->lock_ops.lock(cpu_lock_ptr);
+        add_stats(stats_ptr, get_cpu_stats(pcp_ptr, cpu));
+        pcp_ptr->lock_ops.unlock(cpu_lock_ptr);
+    }
+}
+
+void buddy_allocator_pcp_reset_stats(buddy_allocator_pcp_t* pcp_ptr)
+{
+    if (pcp_ptr == NULL) {
+        return;
+    }
+    pcp_ptr->lock_ops.lock(pcp_ptr->global_lock_ptr);
+    buddy_allocator_reset_stats(pcp_ptr->allocator_ptr);
+    pcp_ptr->lock_ops.unlock(pcp_ptr->global_lock_ptr);
+    for (size_t cpu = 0; cpu < pcp_ptr->cpus_number; ++cpu) {
+        void* cpu_lock_ptr = get_cpu_lock(pcp_ptr, cpu);
+        pcp_ptr->lock_ops.lock(cpu_lock_ptr);
+        memset(get_cpu_stats(pcp_ptr, cpu), 0, sizeof(buddy_allocator_stats_t));
+        pcp_ptr->lock_ops.unlock(cpu_lock_ptr);
+    }
+}
+#endif
@@ -0,0 +1,126 @@
+#ifndef _BUDDY_ALLOCATOR_PCP_H_
+#define _BUDDY_ALLOCATOR_PCP_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "buddy_allocator.h"
+#include "buddy_allocator_lock.h"
+
+/*
+ * Thread-safe front end of the buddy allocator with per-CPU caches of small blocks, like per-CPU page lists in Linux.
+ * It doesn't use hosted functions too, the locks are provided by the caller.
+ *
+ * Implementation details:
+ * The allocator itself is protected by one global lock.
+ * Each CPU has a cache of free blocks for each of the cached orders (the lowest orders, usually only order 0),
+ * the cache is a stack of block addresses, the last freed block is allocated first, its memory is likely still in the CPU cache.
+ * When the cache is empty, it is refilled with batch blocks at once, and when it reaches high blocks, batch blocks are drained back,
+ * so the global lock is taken once per batch blocks instead of once per block.
+ * Blocks in the caches are allocated from the allocator point of view, they are not merged with their buddies until they are drained.
+ *
+ * Each CPU cache has its own lock too, it is almost never contended, it is taken by other CPU only when all caches are drained.
+ * Locks order: a CPU lock, then the global lock. Two CPU locks are never taken at once.
+ * The CPU index is passed by the caller, the same index can be used from different threads, the CPU lock protects the cache anyway.
+ */
+
+typedef struct {
+    // The allocator, it must not be used directly while the per-CPU caches are used
+    buddy_allocator_t* allocator_ptr;
+    buddy_allocator_lock_ops_t lock_ops;
+
+    // Number of CPUs
+    size_t cpus_number;
+    // Orders from 0 to cached_orders_number - 1 are cached
+    uint8_t cached_orders_number;
+    // Maximum number of blocks in one cache, when it is reached, batch blocks are drained
+    size_t high;
+    // Number of blocks moved between a cache and the allocator under one global lock acquisition
+    size_t batch;
+
+    /*
+     * Required memory:
+     * [global lock | CPU 0 | CPU 1 | ... ]
+     * Each part is rounded up to BUDDY_ALLOCATOR_CACHE_LINE_SIZE.
+     * CPU = [CPU lock, instrumentation counters (only with BUDDY_ALLOCATOR_STATS), caches counts (size_t for each cached order), caches blocks (high block addresses for each cached order)]
+     */
+    void* global_lock_ptr;
+    uint8_t* cpus_memory_ptr;
+    // Size of the memory of one CPU
+    size_t cpu_memory_size;
+    // Offsets in the memory of one CPU
+#ifdef BUDDY_ALLOCATOR_STATS
+    size_t cpu_stats_offset;
+#endif
+    size_t cpu_counts_offset;
+    size_t cpu_blocks_offset;
+} buddy_allocator_pcp_t;
+
+/*
+ * Pre-initializes the per-CPU caches and calculates the size of memory needed.
+ * After this function buddy_allocator_pcp_init function should be called.
+ *
+ * pcp_ptr pointer to per-CPU caches data
+ * allocator_ptr pointer to the allocator, it must be pre-initialized, the caches must be initialized after the allocator
+ * cpus_number number of CPUs (or threads), CPU indices are from 0 to cpus_number - 1
+ * cached_orders_number number of cached orders, orders from 0 to cached_orders_number - 1 are cached, must be from 1 to max_order + 1
+ * high maximum number of blocks in one cache
+ * batch number of blocks moved between a cache and the allocator at once, must be from 1 to high
+ * lock_ops_ptr lock operations, they are copied
+ * required_memory_size_ptr total size of the memory required by the caches WILL BE PLACED BY THIS FUNCTION in this variable.
+ * If it contains 0 after the function call, then the initialization has failed.
+ */
+extern void buddy_allocator_pcp_preinit(buddy_allocator_pcp_t* pcp_ptr, buddy_allocator_t* allocator_ptr, size_t cpus_number, uint8_t cached_orders_number, size_t high, size_t batch, const buddy_allocator_lock_ops_t* lock_ops_ptr, size_t* required_memory_size_ptr);
+
+/*
+ * Finishes initialization, all caches are empty
+ * pcp_ptr pointer to per-CPU caches data
+ * required_memory_ptr pointer to the memory allocated for the caches, aligned to BUDDY_ALLOCATOR_LOCK_ALIGNMENT
+ */
+extern void buddy_allocator_pcp_init(buddy_allocator_pcp_t* pcp_ptr, void* required_memory_ptr);
+
+/*
+ * Allocates a block of memory, the same as buddy_allocator_alloc, but thread-safe
+ * Small blocks are taken from the cache of the CPU.
+ * If there is no free memory, all caches are drained and the allocation is retried.
+ * cpu index of the current CPU
+ */
+extern void* buddy_allocator_pcp_alloc(buddy_allocator_pcp_t* pcp_ptr, size_t cpu, size_t size);
+
+/*
+ * Frees the memory, the same as buddy_allocator_free, but thread-safe
+ * Small blocks are put to the cache of the CPU, the cache of any CPU can be used, not only of the allocating one.
+ * Double freeing of a small block is not detected while the block is in a cache.
+ * cpu index of the current CPU
+ */
+extern void buddy_allocator_pcp_free(buddy_allocator_pcp_t* pcp_ptr, size_t cpu, void* memory_ptr);
+
+/*
+ * Returns all blocks from the caches of the CPU to the allocator
+ * For example, it is used when the CPU goes offline.
+ */
+extern void buddy_allocator_pcp_drain(buddy_allocator_pcp_t* pcp_ptr, size_t cpu);
+
+/*
+ * Returns all blocks from all caches to the allocator, so that they can be merged
+ * It is the hook for low memory situations, it is also called by buddy_allocator_pcp_alloc when the allocator has no free memory.
+ */
+extern void buddy_allocator_pcp_drain_all(buddy_allocator_pcp_t* pcp_ptr);
+
+#ifdef BUDDY_ALLOCATOR_STATS
+/*
+ * Gets the sum of the instrumentation counters of the allocator and of all CPUs
+ * Allocations served by a cache are counted by the CPU as fast ones, allocations which refilled the cache as slow ones,
+ * so the counters of the CPUs are never shared. Other allocations and all frees are counted by the allocator.
+ * The blocks of a refill are counted by the allocator as bulk allocations, with their splits and their whole size as the requested and granted size,
+ * so the requested size of the sum counts the blocks left in the caches whole.
+ */
+extern void buddy_allocator_pcp_get_stats(buddy_allocator_pcp_t* pcp_ptr, buddy_allocator_stats_t* stats_ptr);
+
+/*
+ * Sets the instrumentation counters of the allocator and of all CPUs to 0
+ */
+extern void buddy_allocator_pcp_reset_stats(buddy_allocator_pcp_t* pcp_ptr);
+#endif
+
+#endif
@@ -0,0 +1,267 @@
+#include "buddy_allocator_sharded.h"
+#include "buddy_allocator_index.h"
+#include "buddy_allocator_stats.h"
+#include "../atomics/atomics.h"
+#include "../bitops/bitops.h"
+#include <string.h>
+
+/*
+ * Rounds the value up to the alignment, the alignment must be power of 2
+ */
+static size_t round_up(size_t value, size_t alignment)
+{
+    return (value + alignment - 1) & ~(alignment - 1);
+}
+
+static void* get_shard_lock(buddy_allocator_sharded_t* sharded_ptr, size_t shard_index)
+{
+    return sharded_ptr->slots_memory_ptr + shard_index * sharded_ptr->slot_memory_size;
+}
+
+/*
+ * Get the published free orders mask of the shard
+ */
+static volatile uint64_t* get_shard_mask(buddy_allocator_sharded_t* sharded_ptr, size_t shard_index)
+{
+    return (volatile uint64_t*)(sharded_ptr->slots_memory_ptr + shard_index * sharded_ptr->slot_memory_size + sharded_ptr->slot_mask_offset);
+}
+
+/*
+ * Publishes the free orders mask of the shard after allocation or freeing
+ * The shard lock must be held, so there is only one writer of the mask, the summary bit is changed only when the shard becomes empty or non-empty
+ */
+static void publish_shard_mask(buddy_allocator_sharded_t* sharded_ptr, size_t shard_index)
+{
+    volatile uint64_t* mask_ptr = get_shard_mask(sharded_ptr, shard_index);
+    uint64_t old_mask = atomics_load_64(mask_ptr);
+    // Quicklisted blocks can be allocated too, see BUDDY_ALLOCATOR_FLAG_QUICKLISTS
+    uint64_t new_mask = sharded_ptr->shards[shard_index].free_orders_mask | sharded_ptr->shards[shard_index].quicklist_orders_mask;
+    if (old_mask == new_mask) {
+        return;
+    }
+    atomics_store_64(mask_ptr, new_mask);
+    if (old_mask == 0) {
+        atomics_fetch_or_64(&sharded_ptr->non_empty_shards_summary[shard_index / 64], (uint64_t)1 << (shard_index % 64));
+    }
+    else if (new_mask == 0) {
+        atomics_fetch_and_64(&sharded_ptr->non_empty_shards_summary[shard_index / 64], ~((uint64_t)1 << (shard_index % 64)));
+    }
+}
+
+/*
+ * Pre-initializes the shard allocator, returns the required memory size, 0 if failed
+ */
+static size_t preinit_shard(buddy_allocator_sharded_t* sharded_ptr, buddy_allocator_t* shard_ptr, size_t shard_index)
+{
+    uintptr_t shard_area_start_addr = sharded_ptr->area_start_addr + shard_index * sharded_ptr->shard_area_size;
+    size_t shard_area_size = sharded_ptr->shard_area_size;
+    if (shard_index == sharded_ptr->shards_number - 1) {
+        // The last shard gets the remainder
+        shard_area_size = sharded_ptr->area_size - shard_index * sharded_ptr->shard_area_size;
+    }
+    size_t required_memory_size = 0;
+    memset(shard_ptr, 0, sizeof(buddy_allocator_t));
+    buddy_allocator_preinit_ex(shard_ptr, shard_area_start_addr, shard_area_size, sharded_ptr->max_order, sharded_ptr->page_size, sharded_ptr->allocate_all_small_blocks, sharded_ptr->flags, &required_memory_size);
+    return required_memory_size;
+}
+
+void buddy_allocator_sharded_preinit(buddy_allocator_sharded_t* sharded_ptr, uintptr_t area_start_addr, size_t area_size, uint8_t max_order, uint32_t page_size, bool allocate_all_small_blocks, uint32_t flags, size_t shards_number, const buddy_allocator_lock_ops_t* lock_ops_ptr, size_t* required_memory_size_ptr)
+{
+    if (sharded_ptr == NULL || lock_ops_ptr == NULL || lock_ops_ptr->lock == NULL || lock_ops_ptr->unlock == NULL || shards_number == 0 || required_memory_size_ptr == NULL) {
+        return;
+    }
+    if (lock_ops_ptr->lock_size > SIZE_MAX / 4) {
+        return;
+    }
+
+    // The whole area allocator is used only to check the parameters and to count the large blocks
+    buddy_allocator_t area_allocator;
+    size_t area_required_memory_size = 0;
+    memset(&area_allocator, 0, sizeof(buddy_allocator_t));
+    buddy_allocator_preinit_ex(&area_allocator, area_start_addr, area_size, max_order, page_size, allocate_all_small_blocks, flags, &area_required_memory_size);
+    if (area_required_memory_size == 0 || area_allocator.large_blocks_number < shards_number) {
+        return;
+    }
+
+    sharded_ptr->lock_ops = *lock_ops_ptr;
+    sharded_ptr->area_start_addr = area_start_addr;
+    sharded_ptr->area_size = area_allocator.area_size;
+    sharded_ptr->max_order = max_order;
+    sharded_ptr->page_size = page_size;
+    sharded_ptr->allocate_all_small_blocks = allocate_all_small_blocks;
+    sharded_ptr->flags = flags;
+    sharded_ptr->large_block_size = area_allocator.large_block_size;
+    sharded_ptr->shards_number = shards_number;
+    sharded_ptr->shard_area_size = (area_allocator.large_blocks_number / shards_number) * area_allocator.large_block_size;
+
+    // Only the first and the last shards are pre-initialized, other shards are the same as the first one
+    buddy_allocator_t shard;
+    sharded_ptr->shard_required_memory_size = round_up(preinit_shard(sharded_ptr, &shard, 0), BUDDY_ALLOCATOR_CACHE_LINE_SIZE);
+    sharded_ptr->last_shard_required_memory_size = round_up(preinit_shard(sharded_ptr, &shard, shards_number - 1), BUDDY_ALLOCATOR_CACHE_LINE_SIZE);
+    if (sharded_ptr->shard_required_memory_size == 0 || sharded_ptr->last_shard_required_memory_size == 0) {
+        return;
+    }
+
+    // Shard slot = [shard lock, published free orders mask]
+    sharded_ptr->slot_mask_offset = round_up(sharded_ptr->lock_ops.lock_size, sizeof(uint64_t));
+    sharded_ptr->slot_memory_size = round_up(sharded_ptr->slot_mask_offset + sizeof(uint64_t), BUDDY_ALLOCATOR_CACHE_LINE_SIZE);
+
+    // [shards | shards slots | non-empty shards summary | shard 0 memory | shard 1 memory | ...]
+    *required_memory_size_ptr = round_up(shards_number * sizeof(buddy_allocator_t), BUDDY_ALLOCATOR_CACHE_LINE_SIZE) +
+                                shards_number * sharded_ptr->slot_memory_size +
+                                round_up((shards_number / 64 + (shards_number % 64 != 0)) * sizeof(uint64_t), BUDDY_ALLOCATOR_CACHE_LINE_SIZE) +
+                                (shards_number - 1) * sharded_ptr->shard_required_memory_size +
+                                sharded_ptr->last_shard_required_memory_size;
+}
+
+void buddy_allocator_sharded_init(buddy_allocator_sharded_t* sharded_ptr, void* required_memory_ptr)
+{
+    if (sharded_ptr == NULL || required_memory_ptr == NULL) {
+        return;
+    }
+
+    // required_memory_ptr = [shards | shards slots | non-empty shards summary | shard 0 memory | shard 1 memory | ...]
+    size_t summary_words_number = sharded_ptr->shards_number / 64 + (sharded_ptr->shards_number % 64 != 0);
+    sharded_ptr->shards = required_memory_ptr;
+    sharded_ptr->slots_memory_ptr = (uint8_t*)required_memory_ptr + round_up(sharded_ptr->shards_number * sizeof(buddy_allocator_t), BUDDY_ALLOCATOR_CACHE_LINE_SIZE);
+    sharded_ptr->non_empty_shards_summary = (volatile uint64_t*)(sharded_ptr->slots_memory_ptr + sharded_ptr->shards_number * sharded_ptr->slot_memory_size);
+    sharded_ptr->shards_memory_ptr = (uint8_t*)sharded_ptr->non_empty_shards_summary + round_up(summary_words_number * sizeof(uint64_t), BUDDY_ALLOCATOR_CACHE_LINE_SIZE);
+
+    memset(sharded_ptr->slots_memory_ptr, 0, sharded_ptr->shards_number * sharded_ptr->slot_memory_size);
+    for (size_t i = 0; i < summary_words_number; ++i) {
+        atomics_store_64(&sharded_ptr->non_empty_shards_summary[i], 0);
+    }
+
+    for (size_t shard_index = 0; shard_index < sharded_ptr->shards_number; ++shard_index) {
+        preinit_shard(sharded_ptr, &sharded_ptr->shards[shard_index], shard_index);
+        buddy_allocator_init(&sharded_ptr->shards[shard_index], sharded_ptr->shards_memory_ptr + shard_index * sharded_ptr->shard_required_memory_size);
+        if (sharded_ptr->lock_ops.lock_init != NULL) {
+            sharded_ptr->lock_ops.lock_init(get_shard_lock(sharded_ptr, shard_index));
+        }
+        publish_shard_mask(sharded_ptr, shard_index);
+    }
+}
+
+/*
+ * Allocates the block from the first shard which has a suitable free block, starting from the shard of the hint
+ */
+static void* alloc_from_shards(buddy_allocator_sharded_t* sharded_ptr, size_t hint, size_t size)
+{
+    // All shards have the same page size and max order
+    uint8_t required_order = get_order_by_size(&sharded_ptr->shards[0], size);
+    uint64_t suitable_orders_mask = ~(((uint64_t)1 << required_order) - 1);
+
+    size_t first_shard_index = hint % sharded_ptr->shards_number;
+    size_t checked_shards_number = 0;
+    while (checked_shards_number < sharded_ptr->shards_number) {
+        size_t shard_index = (first_shard_index + checked_shards_number) % sharded_ptr->shards_number;
+        // Skip empty shards, bits of the summary word from the current shard to the end of the word
+        uint64_t summary_word = atomics_load_64(&sharded_ptr->non_empty_shards_summary[shard_index / 64]) >> (shard_index % 64);
+        if (summary_word == 0) {
+            // The last word may be incomplete, the scan continues from the first shard
+            size_t word_shards_number = 64 - shard_index % 64;
+            if (word_shards_number > sharded_ptr->shards_number - shard_index) {
+                word_shards_number = sharded_ptr->shards_number - shard_index;
+            }
+            checked_shards_number += word_shards_number;
+            continue;
+        }
+        uint8_t empty_shards_number = bitops_find_first_set(summary_word);
+        if (empty_shards_number != 0) {
+            checked_shards_number += empty_shards_number;
+            continue;
+        }
+
+        if (atomics_load_64(get_shard_mask(sharded_ptr, shard_index)) & suitable_orders_mask) {
+            void* shard_lock_ptr = get_shard_lock(sharded_ptr, shard_index);
+            sharded_ptr->lock_ops.lock(shard_lock_ptr);
+            void* memory_ptr = buddy_allocator_alloc(&sharded_ptr->shards[shard_index], size);
+            publish_shard_mask(sharded_ptr, shard_index);
+            sharded_ptr->lock_ops.unlock(shard_lock_ptr);
+            if (memory_ptr != NULL) {
+                return memory_ptr;
+            }
+            // The published mask was outdated
+        }
+        checked_shards_number++;
+    }
+    return NULL;
+}
+
+/*
+ * Coalesces the quicklisted blocks of all shards which have them, see BUDDY_ALLOCATOR_FLAG_QUICKLISTS
+ */
+static void coalesce_shards(buddy_allocator_sharded_t* sharded_ptr)
+{
+    for (size_t shard_index = 0; shard_index < sharded_ptr->shards_number; ++shard_index) {
+        void* shard_lock_ptr = get_shard_lock(sharded_ptr, shard_index);
+        sharded_ptr->lock_ops.lock(shard_lock_ptr);
+        buddy_allocator_coalesce(&sharded_ptr->shards[shard_index]);
+        publish_shard_mask(sharded_ptr, shard_index);
+        sharded_ptr->lock_ops.unlock(shard_lock_ptr);
+    }
+}
+
+void* buddy_allocator_sharded_alloc(buddy_allocator_sharded_t* sharded_ptr, size_t hint, size_t size)
+{
+    if (sharded_ptr == NULL || size == 0 || size > sharded_ptr->large_block_size) {
+        return NULL;
+    }
+    void* memory_ptr = alloc_from_shards(sharded_ptr, hint, size);
+    if (memory_ptr == NULL && (sharded_ptr->flags & BUDDY_ALLOCATOR_FLAG_QUICKLISTS)) {
+        // The published masks have only the orders of the quicklisted blocks, but they may merge into a block of the size
+        coalesce_shards(sharded_ptr);
+        memory_ptr = alloc_from_shards(sharded_ptr, hint, size);
+    }
+    return memory_ptr;
+}
+
+void buddy_allocator_sharded_free(buddy_allocator_sharded_t* sharded_ptr, void* memory_ptr)
+{
+    if (sharded_ptr == NULL || memory_ptr == NULL) {
+        return;
+    }
+    if ((uintptr_t)memory_ptr < sharded_ptr->area_start_addr || (uintptr_t)memory_ptr - sharded_ptr->area_start_addr >= sharded_ptr->area_size) {
+        return;
+    }
+
+    size_t shard_index = ((uintptr_t)memory_ptr - sharded_ptr->area_start_addr) / sharded_ptr->shard_area_size;
+    if (shard_index >= sharded_ptr->shards_number) {
+        // The remainder of the last shard
+        shard_index = sharded_ptr->shards_number - 1;
+    }
+    void* shard_lock_ptr = get_shard_lock(sharded_ptr, shard_index);
+    sharded_ptr->lock_ops.lock(shard_lock_ptr);
+    buddy_allocator_free(&sharded_ptr->shards[shard_index], memory_ptr);
+    publish_shard_mask(sharded_ptr, shard_index);
+    sharded_ptr->lock_ops.unlock(shard_lock_ptr);
+}
+
+#ifdef BUDDY_ALLOCATOR_STATS
+void buddy_allocator_sharded_get_stats(buddy_allocator_sharded_t* sharded_ptr, buddy_allocator_stats_t* stats_ptr)
+{
+    if (sharded_ptr == NULL || stats_ptr == NULL) {
+        return;
+    }
+    memset(stats_ptr, 0, sizeof(buddy_allocator_stats_t));
+    for (size_t shard_index = 0; shard_index < sharded_ptr->shards_number; ++shard_index) {
+        void* shard_lock_ptr = get_shard_lock(sharded_ptr, shard_index);
+        sharded_ptr->lock_ops.lock(shard_lock_ptr);
+        add_stats(stats_ptr, &sharded_ptr->shards[shard_index].stats);
+        sharded_ptr->lock_ops.unlock(shard_lock_ptr);
+    }
+}
+
+void buddy_allocator_sharded_reset_stats(buddy_allocator_sharded_t* sharded_ptr)
+{
+    if (sharded_ptr == NULL) {
+        return;
+    }
+    for (size_t shard_index = 0; shard_index < sharded_ptr->shards_number; ++shard_index) {
+        void* shard_lock_ptr = get_shard_lock(sharded_ptr, shard_index);
+        sharded_ptr->lock_ops.lock(shard_lock_ptr);
+        buddy_allocator_reset_stats(&sharded_ptr->shards[shard_index]);
+        sharded_ptr->lock_ops.unlock(shard_lock_ptr);
+    }
+}
+#endif
@@ -0,0 +1,110 @@
+#ifndef _BUDDY_ALLOCATOR_SHARDED_H_
+#define _BUDDY_ALLOCATOR_SHARDED_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "buddy_allocator.h"
+#include "buddy_allocator_lock.h"
+
+/*
+ * Thread-safe buddy allocator with fine-grained locking, the area is split into shards.
+ * It doesn't use hosted functions too, the locks are provided by the caller.
+ *
+ * Implementation details:
+ * Largest blocks are never merged, so blocks of different large blocks never interact.
+ * Each shard is a separate allocator for a contiguous range of large blocks, with its own lock and free lists.
+ * All shards get the same number of large blocks, the last one also gets the remainder.
+ * Freeing locks only the shard that owns the address, it is found by division of the offset.
+ *
+ * To route allocations without taking locks, each shard publishes its free orders mask atomically,
+ * and there is a summary bitmap with one bit per shard, the bit is set when the shard has any free blocks.
+ * Allocation starts from the shard selected by the hint (for example, the CPU index), so different threads work in different shards,
+ * and skips empty shards by bit scan of the summary.
+ * The published values may be outdated, in this case the allocation in the shard fails and the next shard is tried.
+ */
+
+typedef struct {
+    buddy_allocator_lock_ops_t lock_ops;
+
+    // Parameters of the whole area, the same as for buddy_allocator_preinit_ex
+    uintptr_t area_start_addr;
+    // The size of the area rounded to largest block size
+    size_t area_size;
+    uint8_t max_order;
+    uint32_t page_size;
+    bool allocate_all_small_blocks;
+    uint32_t flags;
+    size_t large_block_size;
+
+    // Number of shards
+    size_t shards_number;
+    // Size of the area of each shard except the last one
+    size_t shard_area_size;
+    // Required memory of each shard except the last one, rounded to BUDDY_ALLOCATOR_CACHE_LINE_SIZE
+    size_t shard_required_memory_size;
+    // Required memory of the last shard, rounded to BUDDY_ALLOCATOR_CACHE_LINE_SIZE
+    size_t last_shard_required_memory_size;
+
+    /*
+     * Required memory:
+     * [shards | shards slots | non-empty shards summary | shard 0 memory | shard 1 memory | ...]
+     * Each part is rounded up to BUDDY_ALLOCATOR_CACHE_LINE_SIZE.
+     * Shard slot = [shard lock, published free orders mask], each slot is on its own cache lines.
+     */
+    buddy_allocator_t* shards;
+    uint8_t* slots_memory_ptr;
+    // Size of one slot
+    size_t slot_memory_size;
+    // Offset of the free orders mask in a slot
+    size_t slot_mask_offset;
+    // Bit N is set when the shard N has free blocks
+    volatile uint64_t* non_empty_shards_summary;
+    uint8_t* shards_memory_ptr;
+} buddy_allocator_sharded_t;
+
+/*
+ * Pre-initializes the sharded allocator and calculates the size of memory needed.
+ * After this function buddy_allocator_sharded_init function should be called.
+ *
+ * sharded_ptr pointer to sharded allocator data
+ * area_start_addr, area_size, max_order, page_size, allocate_all_small_blocks, flags the same as for buddy_allocator_preinit_ex
+ * shards_number number of shards, must be from 1 to the number of large blocks in the area
+ * lock_ops_ptr lock operations, they are copied
+ * required_memory_size_ptr total size of the memory required by the allocator WILL BE PLACED BY THIS FUNCTION in this variable.
+ * If it contains 0 after the function call, then the initialization has failed.
+ */
+extern void buddy_allocator_sharded_preinit(buddy_allocator_sharded_t* sharded_ptr, uintptr_t area_start_addr, size_t area_size, uint8_t max_order, uint32_t page_size, bool allocate_all_small_blocks, uint32_t flags, size_t shards_number, const buddy_allocator_lock_ops_t* lock_ops_ptr, size_t* required_memory_size_ptr);
+
+/*
+ * Finishes initialization, initializes all shards and locks
+ * sharded_ptr pointer to sharded allocator data
+ * required_memory_ptr pointer to the memory allocated for the allocator, aligned to BUDDY_ALLOCATOR_LOCK_ALIGNMENT
+ */
+extern void buddy_allocator_sharded_init(buddy_allocator_sharded_t* sharded_ptr, void* required_memory_ptr);
+
+/*
+ * Allocates a block of memory, the same as buddy_allocator_alloc, but thread-safe
+ * hint the shard to start with is hint % shards_number, for example, the CPU index can be used
+ */
+extern void* buddy_allocator_sharded_alloc(buddy_allocator_sharded_t* sharded_ptr, size_t hint, size_t size);
+
+/*
+ * Frees the memory, the same as buddy_allocator_free, but thread-safe
+ * Only the shard that owns the address is locked.
+ */
+extern void buddy_allocator_sharded_free(buddy_allocator_sharded_t* sharded_ptr, void* memory_ptr);
+
+#ifdef BUDDY_ALLOCATOR_STATS
+/*
+ * Gets the sum of the instrumentation counters of all shards, each shard has its own counters under its own lock
+ */
+extern void buddy_allocator_sharded_get_stats(buddy_allocator_sharded_t* sharded_ptr, buddy_allocator_stats_t* stats_ptr);
+
+/*
+ * Sets the instrumentation counters of all shards to 0
+ */
+extern void buddy_allocator_sharded_reset_stats(buddy_allocator_sharded_t* sharded_ptr);
+#endif
+
+#endif
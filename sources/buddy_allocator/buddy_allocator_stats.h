@@ -0,0 +1,35 @@
+#ifndef _BUDDY_ALLOCATOR_STATS_H_
+#define _BUDDY_ALLOCATOR_STATS_H_
+
+#include <stdint.h>
+#include "buddy_allocator.h"
+
+/*
+ * Updating of the instrumentation counters, it is internal to the allocator and its front ends.
+ * Without BUDDY_ALLOCATOR_STATS the expression is not compiled at all, so it must not have other side effects.
+ * Example: BUDDY_ALLOCATOR_STATS_UPDATE(allocator_ptr->stats.splits[order]++);
+ */
+#ifdef BUDDY_ALLOCATOR_STATS
+#define BUDDY_ALLOCATOR_STATS_UPDATE(expression) ((void)(expression))
+
+/*
+ * Adds the counters to the sum
+ */
+static inline void add_stats(buddy_allocator_stats_t* sum_stats_ptr, const buddy_allocator_stats_t* stats_ptr)
+{
+    for (uint8_t order = 0; order <= BUDDY_ALLOCATOR_MAX_ORDER_LIMIT; ++order) {
+        sum_stats_ptr->fast_allocations[order] += stats_ptr->fast_allocations[order];
+        sum_stats_ptr->slow_allocations[order] += stats_ptr->slow_allocations[order];
+        sum_stats_ptr->failed_allocations[order] += stats_ptr->failed_allocations[order];
+        sum_stats_ptr->splits[order] += stats_ptr->splits[order];
+        sum_stats_ptr->merges[order] += stats_ptr->merges[order];
+    }
+    sum_stats_ptr->rejected_frees += stats_ptr->rejected_frees;
+    sum_stats_ptr->requested_memory_size += stats_ptr->requested_memory_size;
+    sum_stats_ptr->granted_memory_size += stats_ptr->granted_memory_size;
+}
+#else
+#define BUDDY_ALLOCATOR_STATS_UPDATE(expression) ((void)0)
+#endif
+
+#endif
@@ -0,0 +1,123 @@
+#include "buddy_allocator_trace.h"
+#include <string.h>
+
+#ifdef BUDDY_ALLOCATOR_TRACE
+
+// Number of records written to the file at once by the drain
+#define DRAIN_CHUNK_RECORDS_NUMBER 64
+
+void buddy_allocator_trace_preinit(buddy_allocator_trace_t* trace_ptr, size_t records_number, size_t* required_memory_size_ptr)
+{
+    if (trace_ptr == NULL || required_memory_size_ptr == NULL) {
+        return;
+    }
+    if (records_number == 0 || (records_number & (records_number - 1)) != 0 || records_number > SIZE_MAX / sizeof(buddy_allocator_trace_record_t)) {
+        return;
+    }
+
+    memset(trace_ptr, 0, sizeof(buddy_allocator_trace_t));
+    trace_ptr->records_number = records_number;
+    *required_memory_size_ptr = records_number * sizeof(buddy_allocator_trace_record_t);
+}
+
+void buddy_allocator_trace_init(buddy_allocator_trace_t* trace_ptr, uint16_t source, void* required_memory_ptr)
+{
+    if (trace_ptr == NULL || required_memory_ptr == NULL) {
+        return;
+    }
+
+    trace_ptr->source = source;
+    trace_ptr->records = required_memory_ptr;
+    // No record is ready, the sequence number of a ready record is at least 1
+    memset(trace_ptr->records, 0, trace_ptr->records_number * sizeof(buddy_allocator_trace_record_t));
+    trace_ptr->enqueue_position = 0;
+    trace_ptr->enqueue_limit_position = trace_ptr->records_number;
+    trace_ptr->dropped_records_number = 0;
+    trace_ptr->dequeue_position = 0;
+    trace_ptr->reported_dropped_records_number = 0;
+}
+
+void buddy_allocator_trace_attach(buddy_allocator_t* allocator_ptr, buddy_allocator_trace_t* trace_ptr)
+{
+    if (allocator_ptr == NULL) {
+        return;
+    }
+    allocator_ptr->trace_ptr = trace_ptr;
+}
+
+bool buddy_allocator_trace_write_header(buddy_allocator_t* allocator_ptr, buddy_allocator_trace_write_t write, void* context_ptr)
+{
+    if (allocator_ptr == NULL || write == NULL) {
+        return false;
+    }
+
+    buddy_allocator_trace_header_t header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, BUDDY_ALLOCATOR_TRACE_MAGIC, sizeof(BUDDY_ALLOCATOR_TRACE_MAGIC));
+    header.version = BUDDY_ALLOCATOR_TRACE_VERSION;
+    header.record_size = sizeof(buddy_allocator_trace_record_t);
+    header.area_start_addr = allocator_ptr->area_start_addr;
+    header.area_size = allocator_ptr->area_size;
+    header.page_size = allocator_ptr->page_size;
+    header.flags = allocator_ptr->flags;
+    header.max_order = allocator_ptr->max_order;
+    header.allocate_all_small_blocks = allocator_ptr->allocate_all_small_blocks;
+    return write(context_ptr, &header, sizeof(header));
+}
+
+size_t buddy_allocator_trace_drain(buddy_allocator_trace_t* trace_ptr, buddy_allocator_trace_write_t write, void* context_ptr)
+{
+    if (trace_ptr == NULL || write == NULL) {
+        return 0;
+    }
+
+    buddy_allocator_trace_record_t chunk[DRAIN_CHUNK_RECORDS_NUMBER];
+    size_t chunk_records_number = 0;
+    size_t written_records_number = 0;
+
+    // The drops are reported before the records, the records after the drops may be in the ring already
+    uint64_t dropped_records_number = atomics_load_acquire_64(&trace_ptr->dropped_records_number);
+    if (dropped_records_number != trace_ptr->reported_dropped_records_number) {
+        uint64_t new_dropped_records_number = dropped_records_number - trace_ptr->reported_dropped_records_number;
+        memset(&chunk[0], 0, sizeof(buddy_allocator_trace_record_t));
+        chunk[0].operation = BUDDY_ALLOCATOR_TRACE_DROPPED;
+        chunk[0].value = new_dropped_records_number < UINT32_MAX ? (uint32_t)new_dropped_records_number : UINT32_MAX;
+        chunk[0].source = trace_ptr->source;
+        chunk_records_number = 1;
+        trace_ptr->reported_dropped_records_number = dropped_records_number;
+    }
+
+    while (true) {
+        uint64_t position = trace_ptr->dequeue_position;
+        buddy_allocator_trace_record_t* record_ptr = &trace_ptr->records[position & (trace_ptr->records_number - 1)];
+        bool is_empty = atomics_load_acquire_64((volatile uint64_t*)&record_ptr->sequence_number) != position + 1;
+        if (!is_empty) {
+            chunk[chunk_records_number] = *record_ptr;
+            chunk[chunk_records_number].sequence_number = position;
+            chunk[chunk_records_number].source = trace_ptr->source;
+            chunk_records_number++;
+            // The cell is free for the producer, the record is copied before the release
+            atomics_store_release_64(&trace_ptr->dequeue_position, position + 1);
+        }
+        if (chunk_records_number == DRAIN_CHUNK_RECORDS_NUMBER || (is_empty && chunk_records_number != 0)) {
+            if (write(context_ptr, chunk, chunk_records_number * sizeof(buddy_allocator_trace_record_t))) {
+                written_records_number += chunk_records_number;
+            }
+            chunk_records_number = 0;
+        }
+        if (is_empty) {
+            break;
+        }
+    }
+    return written_records_number;
+}
+
+uint64_t buddy_allocator_trace_get_dropped(buddy_allocator_trace_t* trace_ptr)
+{
+    if (trace_ptr == NULL) {
+        return 0;
+    }
+    return atomics_load_acquire_64(&trace_ptr->dropped_records_number);
+}
+
+#endif
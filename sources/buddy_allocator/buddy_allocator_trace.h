@@ -0,0 +1,191 @@
+#ifndef _BUDDY_ALLOCATOR_TRACE_H_
+#define _BUDDY_ALLOCATOR_TRACE_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "buddy_allocator.h"
+#include "buddy_allocator_lock.h"
+#include "../atomics/atomics.h"
+
+/*
+ * Binary event trace of the allocator, it exists only if BUDDY_ALLOCATOR_TRACE is defined for all files of the allocator (-DBUDDY_ALLOCATOR_TRACE).
+ * Each allocation and free is recorded to a ring buffer attached to the allocator, the ring is drained to a binary file,
+ * which can be replayed or analyzed offline. It doesn't use hosted functions too, the file is written by a callback.
+ *
+ * Implementation details:
+ * The ring is a single producer single consumer queue, the producer publishes each record by the sequence number field of the record,
+ * the consumer publishes its position, so a cell is just a record.
+ * The producer is the allocator, its calls are serialized anyway (by the caller or by the lock of a front end),
+ * the consumer is the drain, it may run on another thread at the same time.
+ * Neither side blocks or takes a lock. The producer caches the position up to which the cells are free and reads the position of the consumer
+ * only when it reaches it, so recording a record is a compare, a copy and a release store, the consumer's cache line is not touched.
+ * When the ring is full, the record is dropped and counted, the drain puts a DROPPED record with the count to the file.
+ * Each allocator of the sharded allocator or of the zones needs its own ring, they can be drained to one file with the source field.
+ *
+ * Traced operations: buddy_allocator_alloc (alloc_typed), buddy_allocator_free, buddy_allocator_alloc_exact,
+ * buddy_allocator_alloc_bulk and buddy_allocator_free_bulk (a record per block), buddy_allocator_free_range and buddy_allocator_reserve_range.
+ * Calls with incorrect arguments and rejected frees are not recorded.
+ *
+ * File format, all fields are in the native byte order:
+ * [header | records]
+ * The version is changed with any change of the header or of the record layout.
+ */
+
+// The file format is defined without BUDDY_ALLOCATOR_TRACE too, so the allocator code has no conditions and the files can be read by any build
+
+// Operations of the records
+// A block is allocated, value is the migrate type
+#define BUDDY_ALLOCATOR_TRACE_ALLOC 1
+// An allocation has failed, order is the requested order, value is the migrate type
+#define BUDDY_ALLOCATOR_TRACE_ALLOC_FAILED 2
+// A block (or a run of buddy_allocator_alloc_exact) is freed
+#define BUDDY_ALLOCATOR_TRACE_FREE 3
+// A run is allocated by buddy_allocator_alloc_exact, value is the number of pages, order is the order of the block the run is cut from
+#define BUDDY_ALLOCATOR_TRACE_ALLOC_EXACT 4
+// Pages are freed by buddy_allocator_free_range, value is the number of pages, order is 0
+#define BUDDY_ALLOCATOR_TRACE_FREE_RANGE 5
+// Pages are reserved by buddy_allocator_reserve_range, value is the number of pages, order is 0
+#define BUDDY_ALLOCATOR_TRACE_RESERVE_RANGE 6
+// Records are dropped because the ring was full, value is the number of dropped records since the previous drain
+#define BUDDY_ALLOCATOR_TRACE_DROPPED 7
+
+#define BUDDY_ALLOCATOR_TRACE_MAGIC "BATRACE"
+#define BUDDY_ALLOCATOR_TRACE_VERSION 1
+
+typedef struct {
+    // Number of the record in the ring, the records of one ring are numbered in the order of the operations, dropped records have no numbers
+    // In the ring it is the position + 1 when the record is ready for the consumer
+    uint64_t sequence_number;
+    // Offset of the block from the start of the area in bytes
+    uint64_t block_offset;
+    // Depends on the operation
+    uint32_t value;
+    uint8_t operation;
+    uint8_t order;
+    // Source of the record, set by buddy_allocator_trace_init, for example the index of the shard, it is filled by the drain
+    uint16_t source;
+} buddy_allocator_trace_record_t;
+
+typedef struct {
+    // BUDDY_ALLOCATOR_TRACE_MAGIC with the terminating zero
+    char magic[8];
+    // BUDDY_ALLOCATOR_TRACE_VERSION
+    uint32_t version;
+    // sizeof(buddy_allocator_trace_record_t)
+    uint32_t record_size;
+    // Parameters of the allocator, enough to create the same allocator for replay
+    uint64_t area_start_addr;
+    uint64_t area_size;
+    uint32_t page_size;
+    uint32_t flags;
+    uint8_t max_order;
+    uint8_t allocate_all_small_blocks;
+    uint8_t reserved[6];
+} buddy_allocator_trace_header_t;
+
+#ifdef BUDDY_ALLOCATOR_TRACE
+
+typedef struct buddy_allocator_trace {
+    // Number of cells, power of 2
+    size_t records_number;
+    uint16_t source;
+
+    /*
+     * Required memory:
+     * [records]
+     */
+    buddy_allocator_trace_record_t* records;
+
+    // Used only by the producer
+    uint64_t enqueue_position;
+    // The cells before this position are known to be free, it is the position of the consumer plus the number of cells, read again when it is reached
+    uint64_t enqueue_limit_position;
+    // Written only by the producer, read by the consumer
+    volatile uint64_t dropped_records_number;
+    // The producer and the consumer fields are in different cache lines
+    uint8_t padding[BUDDY_ALLOCATOR_CACHE_LINE_SIZE];
+    // Written only by the consumer, read by the producer when it reaches its limit position
+    volatile uint64_t dequeue_position;
+    // The number of dropped records reported by the previous drain
+    uint64_t reported_dropped_records_number;
+} buddy_allocator_trace_t;
+
+/*
+ * Writes the data to the file, returns false if the data is not written
+ */
+typedef bool (*buddy_allocator_trace_write_t)(void* context_ptr, const void* data_ptr, size_t size);
+
+/*
+ * Pre-initializes the ring and calculates the size of memory needed.
+ * After this function buddy_allocator_trace_init function should be called.
+ *
+ * trace_ptr pointer to ring data
+ * records_number number of records in the ring, must be a power of 2
+ * required_memory_size_ptr size of the memory required by the ring WILL BE PLACED BY THIS FUNCTION in this variable.
+ * If it contains 0 after the function call, then the initialization has failed.
+ */
+extern void buddy_allocator_trace_preinit(buddy_allocator_trace_t* trace_ptr, size_t records_number, size_t* required_memory_size_ptr);
+
+/*
+ * Finishes initialization, the ring is empty
+ * trace_ptr pointer to ring data
+ * source the source field of the records
+ * required_memory_ptr pointer to the memory allocated for the ring, aligned to 8 bytes
+ */
+extern void buddy_allocator_trace_init(buddy_allocator_trace_t* trace_ptr, uint16_t source, void* required_memory_ptr);
+
+/*
+ * Attaches the ring to the allocator, the operations are recorded from now on
+ * The ring is detached by allocator initialization.
+ * trace_ptr the ring, it must be valid while it is attached, NULL detaches the ring
+ */
+extern void buddy_allocator_trace_attach(buddy_allocator_t* allocator_ptr, buddy_allocator_trace_t* trace_ptr);
+
+/*
+ * Writes the file header with the parameters of the allocator, it must be called before the first drain to the file
+ * Returns false if the header is not written
+ */
+extern bool buddy_allocator_trace_write_header(buddy_allocator_t* allocator_ptr, buddy_allocator_trace_write_t write, void* context_ptr);
+
+/*
+ * Moves all records of the ring to the file, a DROPPED record is written first if records were dropped since the previous drain.
+ * It is not thread-safe with other drains of the same ring, but the allocator can be used at the same time.
+ * Records are written in chunks, if a write fails, the records of the chunk are lost.
+ * Returns the number of written records
+ */
+extern size_t buddy_allocator_trace_drain(buddy_allocator_trace_t* trace_ptr, buddy_allocator_trace_write_t write, void* context_ptr);
+
+/*
+ * Returns the total number of dropped records
+ */
+extern uint64_t buddy_allocator_trace_get_dropped(buddy_allocator_trace_t* trace_ptr);
+
+/*
+ * Puts the record to the ring, drops it if the ring is full
+ * It is called by the allocator, it is in the header so that it is inlined to the hot paths.
+ */
+static inline void buddy_allocator_trace_record(buddy_allocator_trace_t* trace_ptr, uint8_t operation, uint8_t order, uint64_t block_offset, uint32_t value)
+{
+    uint64_t position = trace_ptr->enqueue_position;
+    if (position == trace_ptr->enqueue_limit_position) {
+        // The cells taken by the consumer since the previous check are free, the acquire pairs with its release of the position
+        trace_ptr->enqueue_limit_position = atomics_load_acquire_64(&trace_ptr->dequeue_position) + trace_ptr->records_number;
+        if (position == trace_ptr->enqueue_limit_position) {
+            // The consumer hasn't taken the record of the previous lap yet
+            atomics_store_release_64(&trace_ptr->dropped_records_number, trace_ptr->dropped_records_number + 1);
+            return;
+        }
+    }
+    buddy_allocator_trace_record_t* record_ptr = &trace_ptr->records[position & (trace_ptr->records_number - 1)];
+    record_ptr->block_offset = block_offset;
+    record_ptr->value = value;
+    record_ptr->operation = operation;
+    record_ptr->order = order;
+    atomics_store_release_64((volatile uint64_t*)&record_ptr->sequence_number, position + 1);
+    trace_ptr->enqueue_position = position + 1;
+}
+
+#endif
+
+#endif
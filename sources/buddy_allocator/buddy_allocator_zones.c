@@ -0,0 +1,186 @@
+#include "buddy_allocator_zones.h"
+#include "buddy_allocator_index.h"
+#include <string.h>
+
+/*
+ * Rounds the value up to the alignment, the alignment must be power of 2
+ */
+static size_t round_up(size_t value, size_t alignment)
+{
+    return (value + alignment - 1) & ~(alignment - 1);
+}
+
+/*
+ * Returns true if the first zone is tried before the second one
+ */
+static bool is_zone_before_in_fallback_order(buddy_allocator_zones_t* zones_ptr, size_t first_zone_index, size_t second_zone_index)
+{
+    if (zones_ptr->zones[first_zone_index].priority != zones_ptr->zones[second_zone_index].priority) {
+        return zones_ptr->zones[first_zone_index].priority > zones_ptr->zones[second_zone_index].priority;
+    }
+    return first_zone_index < second_zone_index;
+}
+
+/*
+ * Returns true if the area of the first zone is before the area of the second one
+ */
+static bool is_zone_before_in_address_order(buddy_allocator_zones_t* zones_ptr, size_t first_zone_index, size_t second_zone_index)
+{
+    return zones_ptr->zones[first_zone_index].area_start_addr < zones_ptr->zones[second_zone_index].area_start_addr;
+}
+
+/*
+ * Sorts the zones indices, insertion sort, there are only a few zones
+ */
+static void sort_zones(buddy_allocator_zones_t* zones_ptr, size_t* order, bool (*is_before)(buddy_allocator_zones_t*, size_t, size_t))
+{
+    for (size_t i = 0; i < zones_ptr->zones_number; ++i) {
+        order[i] = i;
+    }
+    for (size_t i = 1; i < zones_ptr->zones_number; ++i) {
+        size_t zone_index = order[i];
+        size_t j = i;
+        while (j > 0 && is_before(zones_ptr, zone_index, order[j - 1])) {
+            order[j] = order[j - 1];
+            j--;
+        }
+        order[j] = zone_index;
+    }
+}
+
+/*
+ * Tries to allocate in the allowed zones in the fallback order
+ * If watermarks are respected, a zone is skipped when its free memory would become less than its low watermark
+ */
+static void* alloc_in_zones(buddy_allocator_zones_t* zones_ptr, size_t size, uint32_t zone_mask, bool respect_watermarks)
+{
+    for (size_t i = 0; i < zones_ptr->zones_number; ++i) {
+        buddy_allocator_zone_t* zone_ptr = &zones_ptr->zones[zones_ptr->fallback_order[i]];
+        if ((zone_ptr->zone_flags & zone_mask) == 0) {
+            continue;
+        }
+        if (size > zone_ptr->allocator.large_block_size) {
+            continue;
+        }
+        if (respect_watermarks) {
+            size_t block_size = (size_t)1 << (get_order_by_size(&zone_ptr->allocator, size) + zone_ptr->allocator.page_shift);
+            if (zone_ptr->allocator.free_memory_size < block_size || zone_ptr->allocator.free_memory_size - block_size < zone_ptr->low_watermark) {
+                continue;
+            }
+        }
+        void* memory_ptr = buddy_allocator_alloc(&zone_ptr->allocator, size);
+        if (memory_ptr != NULL) {
+            return memory_ptr;
+        }
+    }
+    return NULL;
+}
+
+void buddy_allocator_zones_preinit(buddy_allocator_zones_t* zones_ptr, buddy_allocator_zone_t* zones, size_t zones_number, uint8_t max_order, uint32_t page_size, bool allocate_all_small_blocks, uint32_t flags, size_t* required_memory_size_ptr)
+{
+    if (zones_ptr == NULL || zones == NULL || zones_number == 0 || required_memory_size_ptr == NULL) {
+        return;
+    }
+    if (zones_number > SIZE_MAX / (4 * sizeof(size_t))) {
+        return;
+    }
+
+    // The areas must not overlap
+    for (size_t i = 0; i < zones_number; ++i) {
+        for (size_t j = i + 1; j < zones_number; ++j) {
+            uintptr_t first_start_addr = zones[i].area_start_addr;
+            uintptr_t second_start_addr = zones[j].area_start_addr;
+            if (first_start_addr <= second_start_addr ? second_start_addr - first_start_addr < zones[i].area_size : first_start_addr - second_start_addr < zones[j].area_size) {
+                return;
+            }
+        }
+    }
+
+    size_t required_memory_size = 2 * zones_number * sizeof(size_t);
+    for (size_t i = 0; i < zones_number; ++i) {
+        size_t zone_required_memory_size = 0;
+        memset(&zones[i].allocator, 0, sizeof(buddy_allocator_t));
+        buddy_allocator_preinit_ex(&zones[i].allocator, zones[i].area_start_addr, zones[i].area_size, max_order, page_size, allocate_all_small_blocks, flags, &zone_required_memory_size);
+        if (zone_required_memory_size == 0) {
+            return;
+        }
+        // The next zone memory starts with the bitmap, it must be aligned
+        zones[i].required_memory_size = round_up(zone_required_memory_size, sizeof(uint64_t));
+        if (zones[i].required_memory_size > SIZE_MAX - required_memory_size) {
+            return;
+        }
+        required_memory_size += zones[i].required_memory_size;
+    }
+
+    zones_ptr->zones = zones;
+    zones_ptr->zones_number = zones_number;
+    *required_memory_size_ptr = required_memory_size;
+}
+
+void buddy_allocator_zones_init(buddy_allocator_zones_t* zones_ptr, void* required_memory_ptr)
+{
+    if (zones_ptr == NULL || required_memory_ptr == NULL) {
+        return;
+    }
+
+    // required_memory_ptr = [fallback order | address order | zone 0 memory | zone 1 memory | ...]
+    zones_ptr->fallback_order = required_memory_ptr;
+    zones_ptr->address_order = zones_ptr->fallback_order + zones_ptr->zones_number;
+    sort_zones(zones_ptr, zones_ptr->fallback_order, is_zone_before_in_fallback_order);
+    sort_zones(zones_ptr, zones_ptr->address_order, is_zone_before_in_address_order);
+
+    uint8_t* zone_memory_ptr = (uint8_t*)(zones_ptr->address_order + zones_ptr->zones_number);
+    for (size_t i = 0; i < zones_ptr->zones_number; ++i) {
+        buddy_allocator_init(&zones_ptr->zones[i].allocator, zone_memory_ptr);
+        zone_memory_ptr += zones_ptr->zones[i].required_memory_size;
+    }
+}
+
+void* buddy_allocator_zones_alloc(buddy_allocator_zones_t* zones_ptr, size_t size, uint32_t zone_mask)
+{
+    if (zones_ptr == NULL || size == 0) {
+        return NULL;
+    }
+
+    void* memory_ptr = alloc_in_zones(zones_ptr, size, zone_mask, true);
+    if (memory_ptr == NULL) {
+        // The memory pressure, the memory kept by the watermarks is used
+        memory_ptr = alloc_in_zones(zones_ptr, size, zone_mask, false);
+    }
+    return memory_ptr;
+}
+
+void buddy_allocator_zones_free(buddy_allocator_zones_t* zones_ptr, void* memory_ptr)
+{
+    buddy_allocator_zone_t* zone_ptr = buddy_allocator_zones_find_zone(zones_ptr, memory_ptr);
+    if (zone_ptr == NULL) {
+        return;
+    }
+    buddy_allocator_free(&zone_ptr->allocator, memory_ptr);
+}
+
+buddy_allocator_zone_t* buddy_allocator_zones_find_zone(buddy_allocator_zones_t* zones_ptr, void* memory_ptr)
+{
+    if (zones_ptr == NULL || memory_ptr == NULL) {
+        return NULL;
+    }
+
+    // Find the last zone which starts not after the address
+    size_t low = 0;
+    size_t high = zones_ptr->zones_number;
+    while (high - low > 1) {
+        size_t middle = low + (high - low) / 2;
+        if (zones_ptr->zones[zones_ptr->address_order[middle]].area_start_addr <= (uintptr_t)memory_ptr) {
+            low = middle;
+        }
+        else {
+            high = middle;
+        }
+    }
+    buddy_allocator_zone_t* zone_ptr = &zones_ptr->zones[zones_ptr->address_order[low]];
+    // The allocator area is rounded down to the large block size, the rest of the zone area is not used
+    if ((uintptr_t)memory_ptr < zone_ptr->allocator.area_start_addr || (uintptr_t)memory_ptr - zone_ptr->allocator.area_start_addr >= zone_ptr->allocator.area_size) {
+        return NULL;
+    }
+    return zone_ptr;
+}
@@ -0,0 +1,102 @@
+#ifndef _BUDDY_ALLOCATOR_ZONES_H_
+#define _BUDDY_ALLOCATOR_ZONES_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "buddy_allocator.h"
+
+/*
+ * Zone manager, allocator for several disjoint memory areas (zones), like memory zones in Linux.
+ * Each zone is a separate buddy allocator, it doesn't use hosted functions too.
+ *
+ * Implementation details:
+ * Each zone has flags and a priority, the flags are defined by the caller, for example ZONE_DMA32 for the low memory and ZONE_NORMAL for the rest.
+ * An allocation is allowed in the zones which have any flag of the zone mask of the allocation.
+ * The allowed zones are tried in the fallback order: by priority, from the highest one, zones with equal priority are tried in the order of the zones array.
+ *
+ * Each zone has a low watermark, an allocation is not taken from the zone if the free memory of the zone would become less than the watermark.
+ * Only if no allowed zone can allocate above its watermark (the memory pressure), the zones are tried again ignoring the watermarks.
+ * So a scarce zone (like DMA32) with a low priority and a watermark is used as a fallback only while it has enough memory,
+ * and the rest of it is kept for the allocations which need it, or which can't be satisfied anywhere else.
+ *
+ * To free memory, the zone that owns the address is found by binary search over the zones sorted by address, O(log(zones_number)).
+ * It is not thread-safe, like the allocator itself.
+ */
+
+typedef struct {
+    // Set by the caller before buddy_allocator_zones_preinit
+    // The area of the zone, the areas of the zones must not overlap
+    uintptr_t area_start_addr;
+    size_t area_size;
+    // Zone flags, defined by the caller
+    uint32_t zone_flags;
+    // Zones with higher priority are tried first
+    uint32_t priority;
+    // Free memory size in bytes which is kept in the zone until there is no memory in other zones
+    size_t low_watermark;
+
+    // Set by buddy_allocator_zones_preinit
+    // The allocator of the zone
+    buddy_allocator_t allocator;
+    // Memory required by the allocator, rounded up to 8 bytes
+    size_t required_memory_size;
+} buddy_allocator_zone_t;
+
+typedef struct {
+    // Zones array provided by the caller
+    buddy_allocator_zone_t* zones;
+    // Number of zones
+    size_t zones_number;
+
+    /*
+     * Required memory:
+     * [fallback order | address order | zone 0 memory | zone 1 memory | ...]
+     */
+    // Zones indices in the fallback order
+    size_t* fallback_order;
+    // Zones indices in ascending order of areas addresses
+    size_t* address_order;
+} buddy_allocator_zones_t;
+
+/*
+ * Pre-initializes the zones and calculates the size of memory needed.
+ * After this function buddy_allocator_zones_init function should be called.
+ *
+ * zones_ptr pointer to zone manager data
+ * zones array of zones, area_start_addr, area_size, zone_flags, priority and low_watermark must be set by the caller,
+ * the array must be valid while the zone manager is used
+ * zones_number number of zones, must be at least 1
+ * max_order, page_size, allocate_all_small_blocks, flags the same as for buddy_allocator_preinit_ex, they are used for all zones
+ * Each zone must be at least 2^max_order * page_size bytes.
+ * required_memory_size_ptr total size of the memory required by all zones WILL BE PLACED BY THIS FUNCTION in this variable.
+ * If it contains 0 after the function call, then the initialization has failed.
+ */
+extern void buddy_allocator_zones_preinit(buddy_allocator_zones_t* zones_ptr, buddy_allocator_zone_t* zones, size_t zones_number, uint8_t max_order, uint32_t page_size, bool allocate_all_small_blocks, uint32_t flags, size_t* required_memory_size_ptr);
+
+/*
+ * Finishes initialization, initializes all zones
+ * zones_ptr pointer to zone manager data
+ * required_memory_ptr pointer to the memory allocated for the zones, aligned to 8 bytes
+ */
+extern void buddy_allocator_zones_init(buddy_allocator_zones_t* zones_ptr, void* required_memory_ptr);
+
+/*
+ * Allocates a block of memory in one of the zones allowed by the zone mask
+ * zone_mask the allocation is allowed in the zones which have any of these flags
+ * Returns NULL if there is no memory in the allowed zones
+ */
+extern void* buddy_allocator_zones_alloc(buddy_allocator_zones_t* zones_ptr, size_t size, uint32_t zone_mask);
+
+/*
+ * Frees the memory allocated by buddy_allocator_zones_alloc
+ */
+extern void buddy_allocator_zones_free(buddy_allocator_zones_t* zones_ptr, void* memory_ptr);
+
+/*
+ * Returns the zone that owns the address, NULL if the address is not in any zone
+ * It can be used to call other allocator functions for the zone, for example buddy_allocator_free_range
+ */
+extern buddy_allocator_zone_t* buddy_allocator_zones_find_zone(buddy_allocator_zones_t* zones_ptr, void* memory_ptr);
+
+#endif
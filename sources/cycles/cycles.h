@@ -0,0 +1,33 @@
+#ifndef _CYCLES_H_
+#define _CYCLES_H_
+
+#include <stdint.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+// Cheap cycle counter for the latency instrumentation
+// It is the time stamp counter on x86 and the virtual counter on AArch64, a single instruction without serialization,
+// so a measured interval may be shifted by a few tens of cycles, this is enough for log-bucketed histograms.
+
+/*
+ * Returns the current value of the cycle counter
+ */
+static inline uint64_t cycles_read(void)
+{
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+    return __rdtsc();
+#elif defined(_MSC_VER) && defined(_M_ARM64)
+    return (uint64_t)_ReadStatusReg(ARM64_CNTVCT);
+#elif defined(__x86_64__) || defined(__i386__)
+    return __builtin_ia32_rdtsc();
+#elif defined(__aarch64__)
+    uint64_t value = 0;
+    __asm__ __volatile__("mrs %0, cntvct_el0" : "=r"(value));
+    return value;
+#else
+#error "The cycle counter is not supported on this target"
+#endif
+}
+
+#endif
@@ -131,6 +131,25 @@ void dll_remove_node(doubly_linked_list_t* list, dll_node_t* node)
     }
 }
 
+void dll_append_list(doubly_linked_list_t* list, doubly_linked_list_t* appended_list)
+{
+    if (list == NULL || appended_list == NULL || appended_list->count == 0) {
+        return;
+    }
+    if (list->count == 0) {
+        *list = *appended_list;
+    }
+    else {
+        list->tail->next = appended_list->head;
+        appended_list->head->prev = list->tail;
+        list->tail = appended_list->tail;
+        list->count += appended_list->count;
+    }
+    appended_list->head = NULL;
+    appended_list->tail = NULL;
+    appended_list->count = 0;
+}
+
 dll_node_t* dll_get_nth_node(doubly_linked_list_t* list, size_t index)
 {
     if (list == NULL) {
@@ -157,3 +176,99 @@ dll_node_t* dll_get_nth_node(doubly_linked_list_t* list, size_t index)
     // Unreachable
     return NULL;
 }
+
+void dll_index_init_list(doubly_linked_index_list_t* list)
+{
+    if (list == NULL) {
+        return;
+    }
+    list->head = DLL_INDEX_NONE;
+    list->tail = DLL_INDEX_NONE;
+    list->count = 0;
+}
+
+void dll_index_insert_node_to_tail(doubly_linked_index_list_t* list, dll_index_node_t* nodes, uint32_t new_node)
+{
+    if (list == NULL || nodes == NULL || new_node == DLL_INDEX_NONE) {
+        return;
+    }
+    if (list->count == 0) {
+        list->count++;
+        list->head = new_node;
+        list->tail = new_node;
+        nodes[new_node].next = DLL_INDEX_NONE;
+        nodes[new_node].prev = DLL_INDEX_NONE;
+    }
+    else {
+        list->count++;
+        uint32_t old_tail = list->tail;
+        nodes[old_tail].next = new_node;
+        nodes[new_node].prev = old_tail;
+        nodes[new_node].next = DLL_INDEX_NONE;
+        list->tail = new_node;
+    }
+}
+
+void dll_index_insert_node_to_head(doubly_linked_index_list_t* list, dll_index_node_t* nodes, uint32_t new_node)
+{
+    if (list == NULL || nodes == NULL || new_node == DLL_INDEX_NONE) {
+        return;
+    }
+    if (list->count == 0) {
+        dll_index_insert_node_to_tail(list, nodes, new_node);
+    }
+    else {
+        list->count++;
+        uint32_t old_head = list->head;
+        nodes[new_node].next = old_head;
+        nodes[old_head].prev = new_node;
+        nodes[new_node].prev = DLL_INDEX_NONE;
+        list->head = new_node;
+    }
+}
+
+void dll_index_remove_node(doubly_linked_index_list_t* list, dll_index_node_t* nodes, uint32_t node)
+{
+    if (list == NULL || nodes == NULL || node == DLL_INDEX_NONE || list->count == 0) {
+        return;
+    }
+    if (list->count == 1) {
+        list->count--;
+        list->head = DLL_INDEX_NONE;
+        list->tail = DLL_INDEX_NONE;
+    }
+    else /* count > 1 */ {
+        list->count--;
+        if (node == list->head) {
+            list->head = nodes[node].next;
+            nodes[list->head].prev = DLL_INDEX_NONE;
+        }
+        else if (node == list->tail) {
+            list->tail = nodes[node].prev;
+            nodes[list->tail].next = DLL_INDEX_NONE;
+        }
+        else {
+            uint32_t node_prev = nodes[node].prev;
+            uint32_t node_next = nodes[node].next;
+            nodes[node_prev].next = node_next;
+            nodes[node_next].prev = node_prev;
+        }
+    }
+}
+
+void dll_index_append_list(doubly_linked_index_list_t* list, dll_index_node_t* nodes, doubly_linked_index_list_t* appended_list)
+{
+    if (list == NULL || nodes == NULL || appended_list == NULL || appended_list->count == 0) {
+        return;
+    }
+    if (list->count == 0) {
+        *list = *appended_list;
+    }
+    else {
+        nodes[list->tail].next = appended_list->head;
+        nodes[appended_list->head].prev = list->tail;
+        list->tail = appended_list->tail;
+        list->count += appended_list->count;
+    }
+    dll_index_init_list(appended_list);
+}
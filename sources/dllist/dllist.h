@@ -2,6 +2,7 @@
 #define _DLLIST_H_
 
 #include <stdint.h>
+#include <stddef.h>
 
 // Doubly-linked list
 
@@ -47,10 +48,65 @@ extern void dll_insert_node_before_node(doubly_linked_list_t* list, dll_node_t*
  */
 extern void dll_remove_node(doubly_linked_list_t* list, dll_node_t* node);
 
+/*
+ * Move all nodes of appended_list to the end of the list, O(1)
+ * appended_list becomes empty
+ */
+extern void dll_append_list(doubly_linked_list_t* list, doubly_linked_list_t* appended_list);
+
 /*
  * Get node by index
  * Returns NULL if the node failed to be get
  */
 extern dll_node_t* dll_get_nth_node(doubly_linked_list_t* list, size_t index);
 
+// Doubly-linked list of nodes stored in one array, nodes are linked by 32-bit indices in this array instead of pointers
+// A node takes 8 bytes regardless of the pointer size.
+
+// Index meaning "no node"
+#define DLL_INDEX_NONE 0xFFFFFFFF
+
+typedef struct {
+    uint32_t next;
+    uint32_t prev;
+} dll_index_node_t;
+
+typedef struct {
+    uint32_t head;
+    uint32_t tail;
+    size_t count;
+} doubly_linked_index_list_t;
+
+/*
+ * Initialize empty list
+ */
+extern void dll_index_init_list(doubly_linked_index_list_t* list);
+
+/*
+ * Insert node to the end of the list (new tail)
+ * nodes array of nodes, new_node index of the node in it
+ * (adds node to the list)
+ */
+extern void dll_index_insert_node_to_tail(doubly_linked_index_list_t* list, dll_index_node_t* nodes, uint32_t new_node);
+
+/*
+ * Insert node to the start of the list (new head)
+ * nodes array of nodes, new_node index of the node in it
+ * (adds node to the list)
+ */
+extern void dll_index_insert_node_to_head(doubly_linked_index_list_t* list, dll_index_node_t* nodes, uint32_t new_node);
+
+/*
+ * Remove node from the list
+ * nodes array of nodes, node index of the node in it
+ */
+extern void dll_index_remove_node(doubly_linked_index_list_t* list, dll_index_node_t* nodes, uint32_t node);
+
+/*
+ * Move all nodes of appended_list to the end of the list, O(1)
+ * nodes array of nodes of both lists
+ * appended_list becomes empty
+ */
+extern void dll_index_append_list(doubly_linked_index_list_t* list, dll_index_node_t* nodes, doubly_linked_index_list_t* appended_list);
+
 #endif
@@ -1,19 +1,94 @@
 #include "tests/tests.h"
+#include "benchmarks/benchmarks.h"
 #include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <time.h>
 
 int main(int argc, char* argv[])
 {
-    (void)argc; (void)argv;
+    if (argc > 1 && strcmp(argv[1], "bench") == 0) {
+        printf("benchmarks_index_arithmetic()\n");
+        benchmarks_index_arithmetic();
+        printf("benchmarks_bulk()\n");
+        benchmarks_bulk();
+        printf("benchmarks_lazy_init()\n");
+        benchmarks_lazy_init();
+        printf("benchmarks_quicklists()\n");
+        benchmarks_quicklists();
+        printf("benchmarks_address_ordered()\n");
+        benchmarks_address_ordered();
+        printf("benchmarks_init_parallel()\n");
+        benchmarks_init_parallel();
+#ifdef BUDDY_ALLOCATOR_TRACE
+        printf("benchmarks_trace()\n");
+        benchmarks_trace();
+#endif
+        return 0;
+    }
+    if (argc > 1 && strcmp(argv[1], "stress") == 0) {
+        // stress [seed] [operations number] [area size in MB]
+        uint64_t seed = argc > 2 ? strtoull(argv[2], NULL, 10) : (uint64_t)time(NULL);
+        uint64_t operations_number = argc > 3 ? strtoull(argv[3], NULL, 10) : (uint64_t)1 << 28;
+        size_t area_size = (size_t)(argc > 4 ? strtoull(argv[4], NULL, 10) : 2048) * 1024 * 1024;
+        tests_stress_run(seed, operations_number, area_size);
+        printf("OK!\n");
+        return 0;
+    }
     printf("tests_preinit()\n");
     tests_preinit();
     printf("tests_small_sizes_predetermined()\n");
     tests_small_sizes_predetermined();
     printf("tests_small_sizes_predetermined2()\n");
     tests_small_sizes_predetermined2();
+    printf("tests_compact_nodes()\n");
+    tests_compact_nodes();
+    printf("tests_in_block_nodes()\n");
+    tests_in_block_nodes();
     printf("tests_allocate_all_small_blocks()\n");
     tests_allocate_all_small_blocks();
+    printf("tests_64_bit()\n");
+    tests_64_bit();
+    printf("tests_bulk()\n");
+    tests_bulk();
+    printf("tests_alloc_exact()\n");
+    tests_alloc_exact();
+    printf("tests_quicklists()\n");
+    tests_quicklists();
+    printf("tests_address_ordered()\n");
+    tests_address_ordered();
+    printf("tests_free_range()\n");
+    tests_free_range();
+    printf("tests_lazy_init()\n");
+    tests_lazy_init();
+    printf("tests_migrate_types()\n");
+    tests_migrate_types();
+    printf("tests_fragmentation_info()\n");
+    tests_fragmentation_info();
+    printf("tests_init_parallel()\n");
+    tests_init_parallel();
+    printf("tests_pcp()\n");
+    tests_pcp();
+#ifdef BUDDY_ALLOCATOR_STATS
+    printf("tests_stats()\n");
+    tests_stats();
+#endif
+#ifdef BUDDY_ALLOCATOR_LATENCY
+    printf("tests_latency()\n");
+    tests_latency();
+#endif
+#ifdef BUDDY_ALLOCATOR_TRACE
+    printf("tests_trace()\n");
+    tests_trace();
+#endif
+    printf("tests_sharded()\n");
+    tests_sharded();
+    printf("tests_zones()\n");
+    tests_zones();
     printf("tests_random()\n");
     tests_random();
+    printf("tests_stress()\n");
+    tests_stress();
     printf("OK!\n");
     return 0;
 }
@@ -0,0 +1,609 @@
+#include "buddy_allocator/buddy_allocator.h"
+#include "buddy_allocator/buddy_allocator_trace.h"
+#include "cycles/cycles.h"
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <time.h>
+
+/*
+ * Replays an allocation trace against a fresh allocator and against malloc, to measure allocator changes on real workloads.
+ *
+ * Usage:
+ * replay <trace file> [--malloc]
+ * replay --synthetic <spec> [--malloc]
+ *
+ * The trace file is written by buddy_allocator_trace_write_header and buddy_allocator_trace_drain (BUDDY_ALLOCATOR_TRACE),
+ * the allocator is created with the parameters from the header, only the records of the source of the first record are replayed.
+ * The synthetic trace is generated from the spec, comma separated key=value pairs, all are optional:
+ * operations=1000000 number of operations
+ * live=4096 maximum number of live blocks
+ * area=64M area size, K, M and G suffixes are allowed
+ * max_order=10, page_size=4096 allocator parameters
+ * orders=8:4:2:1 weights of the orders, from order 0
+ * seed=1 seed of the generator
+ *
+ * The blocks of the trace are replayed by their allocation, not by their addresses,
+ * so a changed allocator may place blocks anywhere, a free always frees the block of the matching allocation.
+ * The replay is done twice: without timing of each operation for ns/op, then with timing of each operation for the percentiles,
+ * the fragmentation index is calculated after each operation of the second run, outside of the timing.
+ */
+
+// Operations of the prepared trace
+#define REPLAY_ALLOC 0
+#define REPLAY_ALLOC_EXACT 1
+#define REPLAY_FREE 2
+#define REPLAY_FREE_RANGE 3
+#define REPLAY_RESERVE_RANGE 4
+
+// Slot of allocations which are expected to fail, the block is freed at once if the allocation succeeds
+#define REPLAY_NO_SLOT 0
+
+typedef struct {
+    // Block offset, only for ranges
+    uint64_t offset;
+    // Number of pages, for exact allocations and ranges
+    uint32_t pages_number;
+    // Slot of the block of the allocation, the allocation to free
+    uint32_t slot;
+    uint8_t operation;
+    uint8_t order;
+    // Migrate type of allocations
+    uint8_t type;
+} replay_operation_t;
+
+typedef struct {
+    buddy_allocator_trace_header_t header;
+    replay_operation_t* operations;
+    size_t operations_number;
+    // Number of slots, slot 0 is never used
+    size_t slots_number;
+    // Largest allocated order, the fragmentation index is calculated for it
+    uint8_t max_allocated_order;
+    // Records lost by the trace, frees of their blocks are skipped
+    uint64_t dropped_records_number;
+    uint64_t skipped_records_number;
+} replay_trace_t;
+
+typedef struct {
+    uint64_t operations_number;
+    double ns_per_operation;
+    double p50_ns;
+    double p99_ns;
+    double p999_ns;
+    int32_t peak_fragmentation_index;
+    uint64_t failed_allocations_number;
+} replay_result_t;
+
+/*
+ * Returns current time in nanoseconds
+ */
+static uint64_t get_time_ns(void)
+{
+    struct timespec time;
+    timespec_get(&time, TIME_UTC);
+    return (uint64_t)time.tv_sec * 1000000000 + (uint64_t)time.tv_nsec;
+}
+
+/*
+ * splitmix64, the synthetic traces are the same on all platforms for the same seed
+ */
+static uint64_t get_random_64(uint64_t* state_ptr)
+{
+    uint64_t value = (*state_ptr += 0x9E3779B97F4A7C15);
+    value = (value ^ (value >> 30)) * 0xBF58476D1CE4E5B9;
+    value = (value ^ (value >> 27)) * 0x94D049BB133111EB;
+    return value ^ (value >> 31);
+}
+
+static uint8_t get_page_shift(uint32_t page_size)
+{
+    uint8_t page_shift = 0;
+    while (((uint32_t)1 << page_shift) < page_size) {
+        page_shift++;
+    }
+    return page_shift;
+}
+
+static void add_operation(replay_trace_t* trace_ptr, size_t* capacity_ptr, const replay_operation_t* operation_ptr)
+{
+    if (trace_ptr->operations_number == *capacity_ptr) {
+        *capacity_ptr = *capacity_ptr == 0 ? 1024 : *capacity_ptr * 2;
+        trace_ptr->operations = realloc(trace_ptr->operations, *capacity_ptr * sizeof(replay_operation_t));
+        if (trace_ptr->operations == NULL) {
+            printf("Failed to allocate memory for the trace\n");
+            exit(-1);
+        }
+    }
+    trace_ptr->operations[trace_ptr->operations_number++] = *operation_ptr;
+    if ((operation_ptr->operation == REPLAY_ALLOC || operation_ptr->operation == REPLAY_ALLOC_EXACT) && operation_ptr->order > trace_ptr->max_allocated_order) {
+        trace_ptr->max_allocated_order = operation_ptr->order;
+    }
+}
+
+/*
+ * Reads the trace file and converts the records to the operations, the blocks are matched by their offsets
+ * Returns false if the file can't be read
+ */
+static bool read_trace_file(const char* path, replay_trace_t* trace_ptr)
+{
+    FILE* file = fopen(path, "rb");
+    if (file == NULL) {
+        printf("Failed to open %s\n", path);
+        return false;
+    }
+    if (fread(&trace_ptr->header, sizeof(buddy_allocator_trace_header_t), 1, file) != 1 ||
+        memcmp(trace_ptr->header.magic, BUDDY_ALLOCATOR_TRACE_MAGIC, sizeof(BUDDY_ALLOCATOR_TRACE_MAGIC)) != 0) {
+        printf("%s is not a trace file\n", path);
+        fclose(file);
+        return false;
+    }
+    if (trace_ptr->header.version != BUDDY_ALLOCATOR_TRACE_VERSION || trace_ptr->header.record_size != sizeof(buddy_allocator_trace_record_t)) {
+        printf("Unsupported trace version %u\n", trace_ptr->header.version);
+        fclose(file);
+        return false;
+    }
+
+    // The slot of the block allocated at each page
+    uint8_t page_shift = get_page_shift(trace_ptr->header.page_size);
+    size_t pages_number = (size_t)(trace_ptr->header.area_size >> page_shift);
+    uint32_t* slots_by_page = calloc(pages_number, sizeof(uint32_t));
+    if (slots_by_page == NULL) {
+        printf("Failed to allocate memory for the trace\n");
+        exit(-1);
+    }
+
+    size_t capacity = 0;
+    trace_ptr->slots_number = 1;
+    bool is_source_known = false;
+    uint16_t source = 0;
+    buddy_allocator_trace_record_t record;
+    while (fread(&record, sizeof(record), 1, file) == 1) {
+        if (record.operation == BUDDY_ALLOCATOR_TRACE_DROPPED) {
+            trace_ptr->dropped_records_number += record.value;
+            continue;
+        }
+        if (!is_source_known) {
+            source = record.source;
+            is_source_known = true;
+        }
+        size_t page_index = (size_t)(record.block_offset >> page_shift);
+        if (record.source != source || page_index >= pages_number) {
+            trace_ptr->skipped_records_number++;
+            continue;
+        }
+
+        replay_operation_t operation;
+        memset(&operation, 0, sizeof(operation));
+        operation.order = record.order;
+        switch (record.operation) {
+        case BUDDY_ALLOCATOR_TRACE_ALLOC:
+        case BUDDY_ALLOCATOR_TRACE_ALLOC_EXACT:
+            operation.operation = record.operation == BUDDY_ALLOCATOR_TRACE_ALLOC ? REPLAY_ALLOC : REPLAY_ALLOC_EXACT;
+            operation.type = record.operation == BUDDY_ALLOCATOR_TRACE_ALLOC ? (uint8_t)record.value : BUDDY_ALLOCATOR_MIGRATE_UNMOVABLE;
+            operation.pages_number = record.operation == BUDDY_ALLOCATOR_TRACE_ALLOC ? 0 : record.value;
+            operation.slot = (uint32_t)trace_ptr->slots_number++;
+            slots_by_page[page_index] = operation.slot;
+            break;
+        case BUDDY_ALLOCATOR_TRACE_ALLOC_FAILED:
+            operation.operation = REPLAY_ALLOC;
+            operation.type = (uint8_t)record.value;
+            operation.slot = REPLAY_NO_SLOT;
+            break;
+        case BUDDY_ALLOCATOR_TRACE_FREE:
+            if (slots_by_page[page_index] == 0) {
+                // The allocation record is dropped
+                trace_ptr->skipped_records_number++;
+                continue;
+            }
+            operation.operation = REPLAY_FREE;
+            operation.slot = slots_by_page[page_index];
+            slots_by_page[page_index] = 0;
+            break;
+        case BUDDY_ALLOCATOR_TRACE_FREE_RANGE:
+        case BUDDY_ALLOCATOR_TRACE_RESERVE_RANGE:
+            operation.operation = record.operation == BUDDY_ALLOCATOR_TRACE_FREE_RANGE ? REPLAY_FREE_RANGE : REPLAY_RESERVE_RANGE;
+            operation.offset = record.block_offset;
+            operation.pages_number = record.value;
+            break;
+        default:
+            trace_ptr->skipped_records_number++;
+            continue;
+        }
+        add_operation(trace_ptr, &capacity, &operation);
+    }
+
+    free(slots_by_page);
+    fclose(file);
+    return true;
+}
+
+/*
+ * Parses the size with an optional K, M or G suffix
+ */
+static uint64_t parse_size(const char* string)
+{
+    char* end = NULL;
+    uint64_t value = strtoull(string, &end, 10);
+    switch (*end) {
+    case 'G':
+        value <<= 10;
+        // fall through
+    case 'M':
+        value <<= 10;
+        // fall through
+    case 'K':
+        value <<= 10;
+        break;
+    default:
+        break;
+    }
+    return value;
+}
+
+/*
+ * Generates the synthetic trace from the spec, see the usage
+ * Each step allocates a block of a random order or frees a random live block, with equal probability while there are live blocks and free slots.
+ * Returns false if the spec is incorrect
+ */
+static bool generate_synthetic_trace(const char* spec, replay_trace_t* trace_ptr)
+{
+    uint64_t operations_number = 1000000;
+    size_t live_blocks_number_max = 4096;
+    uint32_t order_weights[BUDDY_ALLOCATOR_MAX_ORDER_LIMIT + 1] = { 8, 4, 2, 1 };
+    uint8_t order_weights_number = 4;
+    uint64_t random_state = 1;
+    memset(&trace_ptr->header, 0, sizeof(buddy_allocator_trace_header_t));
+    trace_ptr->header.area_start_addr = 0x100000;
+    trace_ptr->header.area_size = (uint64_t)64 * 1024 * 1024;
+    trace_ptr->header.page_size = 4096;
+    trace_ptr->header.max_order = 10;
+
+    char* spec_copy = malloc(strlen(spec) + 1);
+    if (spec_copy == NULL) {
+        return false;
+    }
+    strcpy(spec_copy, spec);
+    for (char* pair = strtok(spec_copy, ","); pair != NULL; pair = strtok(NULL, ",")) {
+        char* value = strchr(pair, '=');
+        if (value == NULL) {
+            printf("Incorrect spec pair %s\n", pair);
+            free(spec_copy);
+            return false;
+        }
+        *value++ = '\0';
+        if (strcmp(pair, "operations") == 0) {
+            operations_number = strtoull(value, NULL, 10);
+        }
+        else if (strcmp(pair, "live") == 0) {
+            live_blocks_number_max = (size_t)strtoull(value, NULL, 10);
+        }
+        else if (strcmp(pair, "area") == 0) {
+            trace_ptr->header.area_size = parse_size(value);
+        }
+        else if (strcmp(pair, "max_order") == 0) {
+            trace_ptr->header.max_order = (uint8_t)strtoul(value, NULL, 10);
+        }
+        else if (strcmp(pair, "page_size") == 0) {
+            trace_ptr->header.page_size = (uint32_t)parse_size(value);
+        }
+        else if (strcmp(pair, "seed") == 0) {
+            random_state = strtoull(value, NULL, 10);
+        }
+        else if (strcmp(pair, "orders") == 0) {
+            order_weights_number = 0;
+            char* weight = value;
+            while (*weight != '\0' && order_weights_number <= BUDDY_ALLOCATOR_MAX_ORDER_LIMIT) {
+                char* end = NULL;
+                order_weights[order_weights_number++] = (uint32_t)strtoul(weight, &end, 10);
+                if (*end != ':') {
+                    break;
+                }
+                weight = end + 1;
+            }
+        }
+        else {
+            printf("Unknown spec key %s\n", pair);
+            free(spec_copy);
+            return false;
+        }
+    }
+    free(spec_copy);
+
+    uint32_t weights_sum = 0;
+    for (uint8_t order = 0; order < order_weights_number; ++order) {
+        weights_sum += order_weights[order];
+    }
+    if (weights_sum == 0 || live_blocks_number_max == 0 || order_weights_number > trace_ptr->header.max_order + 1) {
+        printf("Incorrect orders or live blocks number\n");
+        return false;
+    }
+
+    // Live slots, a freed slot is replaced by the last one
+    uint32_t* live_slots = malloc(live_blocks_number_max * sizeof(uint32_t));
+    if (live_slots == NULL) {
+        printf("Failed to allocate memory for the trace\n");
+        exit(-1);
+    }
+    size_t live_blocks_number = 0;
+    size_t capacity = 0;
+    trace_ptr->slots_number = 1;
+    for (uint64_t i = 0; i < operations_number; ++i) {
+        uint64_t random = get_random_64(&random_state);
+        replay_operation_t operation;
+        memset(&operation, 0, sizeof(operation));
+        if (live_blocks_number == 0 || (live_blocks_number < live_blocks_number_max && (random & 1) == 0)) {
+            uint32_t weight = (uint32_t)((random >> 1) % weights_sum);
+            uint8_t order = 0;
+            while (weight >= order_weights[order]) {
+                weight -= order_weights[order];
+                order++;
+            }
+            operation.operation = REPLAY_ALLOC;
+            operation.order = order;
+            operation.type = BUDDY_ALLOCATOR_MIGRATE_UNMOVABLE;
+            operation.slot = (uint32_t)trace_ptr->slots_number++;
+            live_slots[live_blocks_number++] = operation.slot;
+        }
+        else {
+            size_t live_slot_index = (size_t)((random >> 1) % live_blocks_number);
+            operation.operation = REPLAY_FREE;
+            operation.slot = live_slots[live_slot_index];
+            live_slots[live_slot_index] = live_slots[--live_blocks_number];
+        }
+        add_operation(trace_ptr, &capacity, &operation);
+    }
+    free(live_slots);
+    return true;
+}
+
+/*
+ * Creates the allocator with the parameters of the trace
+ * With BUDDY_ALLOCATOR_FLAG_IN_BLOCK_NODES the nodes are in the free blocks, so the area must be real memory
+ */
+static bool create_allocator(const buddy_allocator_trace_header_t* header_ptr, buddy_allocator_t* allocator_ptr, void** required_memory_ptr, void** area_memory_ptr)
+{
+    uintptr_t area_start_addr = (uintptr_t)header_ptr->area_start_addr;
+    *area_memory_ptr = NULL;
+    if (header_ptr->flags & BUDDY_ALLOCATOR_FLAG_IN_BLOCK_NODES) {
+        *area_memory_ptr = malloc((size_t)header_ptr->area_size + header_ptr->page_size);
+        if (*area_memory_ptr == NULL) {
+            printf("Failed to allocate memory for the area\n");
+            return false;
+        }
+        area_start_addr = ((uintptr_t)*area_memory_ptr + header_ptr->page_size - 1) & ~((uintptr_t)header_ptr->page_size - 1);
+    }
+
+    size_t required_memory_size = 0;
+    memset(allocator_ptr, 0, sizeof(buddy_allocator_t));
+    buddy_allocator_preinit_ex(allocator_ptr, area_start_addr, (size_t)header_ptr->area_size, header_ptr->max_order, header_ptr->page_size,
+        header_ptr->allocate_all_small_blocks != 0, header_ptr->flags, &required_memory_size);
+    if (required_memory_size == 0) {
+        printf("Failed to preinit the allocator\n");
+        free(*area_memory_ptr);
+        return false;
+    }
+    *required_memory_ptr = malloc(required_memory_size);
+    if (*required_memory_ptr == NULL) {
+        printf("Failed to allocate memory for the allocator\n");
+        free(*area_memory_ptr);
+        return false;
+    }
+    buddy_allocator_init(allocator_ptr, *required_memory_ptr);
+    return true;
+}
+
+/*
+ * Replays one operation, returns false if an allocation has failed
+ * allocator_ptr the allocator, NULL for malloc
+ */
+static bool replay_operation(buddy_allocator_t* allocator_ptr, const replay_trace_t* trace_ptr, const replay_operation_t* operation_ptr, void** slots)
+{
+    uint32_t page_size = trace_ptr->header.page_size;
+    void* memory_ptr = NULL;
+    switch (operation_ptr->operation) {
+    case REPLAY_ALLOC:
+        if (allocator_ptr != NULL) {
+            memory_ptr = buddy_allocator_alloc_typed(allocator_ptr, (size_t)page_size << operation_ptr->order, operation_ptr->type);
+        }
+        else {
+            memory_ptr = malloc((size_t)page_size << operation_ptr->order);
+        }
+        break;
+    case REPLAY_ALLOC_EXACT:
+        if (allocator_ptr != NULL) {
+            memory_ptr = buddy_allocator_alloc_exact(allocator_ptr, (size_t)page_size * operation_ptr->pages_number);
+        }
+        else {
+            memory_ptr = malloc((size_t)page_size * operation_ptr->pages_number);
+        }
+        break;
+    case REPLAY_FREE:
+        if (allocator_ptr != NULL) {
+            buddy_allocator_free(allocator_ptr, slots[operation_ptr->slot]);
+        }
+        else {
+            free(slots[operation_ptr->slot]);
+        }
+        slots[operation_ptr->slot] = NULL;
+        return true;
+    case REPLAY_FREE_RANGE:
+    case REPLAY_RESERVE_RANGE:
+        // The ranges describe the memory map of the area, malloc has no such thing
+        if (allocator_ptr != NULL) {
+            void* start_ptr = (void*)(allocator_ptr->area_start_addr + (uintptr_t)operation_ptr->offset);
+            size_t size = (size_t)page_size * operation_ptr->pages_number;
+            if (operation_ptr->operation == REPLAY_FREE_RANGE) {
+                buddy_allocator_free_range(allocator_ptr, start_ptr, size);
+            }
+            else {
+                buddy_allocator_reserve_range(allocator_ptr, start_ptr, size);
+            }
+        }
+        return true;
+    default:
+        return true;
+    }
+
+    if (operation_ptr->slot == REPLAY_NO_SLOT) {
+        // The allocation has failed when the trace was recorded
+        if (memory_ptr != NULL) {
+            if (allocator_ptr != NULL) {
+                buddy_allocator_free(allocator_ptr, memory_ptr);
+            }
+            else {
+                free(memory_ptr);
+            }
+        }
+    }
+    else {
+        slots[operation_ptr->slot] = memory_ptr;
+    }
+    return memory_ptr != NULL;
+}
+
+/*
+ * Frees all live blocks of the malloc replay
+ */
+static void free_slots(void** slots, size_t slots_number, bool is_malloc)
+{
+    for (size_t slot = 0; slot < slots_number; ++slot) {
+        if (is_malloc) {
+            free(slots[slot]);
+        }
+        slots[slot] = NULL;
+    }
+}
+
+static int compare_cycles(const void* first_ptr, const void* second_ptr)
+{
+    uint64_t first = *(const uint64_t*)first_ptr;
+    uint64_t second = *(const uint64_t*)second_ptr;
+    return (first > second) - (first < second);
+}
+
+/*
+ * Replays the trace twice and fills the result
+ */
+static bool replay_trace(const replay_trace_t* trace_ptr, bool is_malloc, replay_result_t* result_ptr)
+{
+    void** slots = calloc(trace_ptr->slots_number, sizeof(void*));
+    uint64_t* operations_cycles = malloc((trace_ptr->operations_number + 1) * sizeof(uint64_t));
+    if (slots == NULL || operations_cycles == NULL) {
+        printf("Failed to allocate memory for the replay\n");
+        exit(-1);
+    }
+    memset(result_ptr, 0, sizeof(replay_result_t));
+    result_ptr->operations_number = trace_ptr->operations_number;
+    result_ptr->peak_fragmentation_index = -1000;
+
+    // The first run, only the total time is measured
+    buddy_allocator_t allocator;
+    void* required_memory = NULL;
+    void* area_memory = NULL;
+    if (!is_malloc && !create_allocator(&trace_ptr->header, &allocator, &required_memory, &area_memory)) {
+        return false;
+    }
+    buddy_allocator_t* allocator_ptr = is_malloc ? NULL : &allocator;
+    uint64_t start_time = get_time_ns();
+    for (size_t i = 0; i < trace_ptr->operations_number; ++i) {
+        replay_operation(allocator_ptr, trace_ptr, &trace_ptr->operations[i], slots);
+    }
+    uint64_t total_time = get_time_ns() - start_time;
+    result_ptr->ns_per_operation = trace_ptr->operations_number == 0 ? 0.0 : (double)total_time / (double)trace_ptr->operations_number;
+    free_slots(slots, trace_ptr->slots_number, is_malloc);
+
+    // The second run, each operation is timed by the cycle counter, the cycles are converted to nanoseconds by the time of the whole run
+    if (!is_malloc) {
+        buddy_allocator_init(&allocator, required_memory);
+    }
+    uint64_t start_cycles = cycles_read();
+    start_time = get_time_ns();
+    for (size_t i = 0; i < trace_ptr->operations_number; ++i) {
+        uint64_t operation_start_cycles = cycles_read();
+        bool is_allocated = replay_operation(allocator_ptr, trace_ptr, &trace_ptr->operations[i], slots);
+        operations_cycles[i] = cycles_read() - operation_start_cycles;
+        result_ptr->failed_allocations_number += !is_allocated;
+        if (!is_malloc) {
+            int32_t fragmentation_index = buddy_allocator_get_fragmentation_index(&allocator, trace_ptr->max_allocated_order);
+            if (fragmentation_index > result_ptr->peak_fragmentation_index) {
+                result_ptr->peak_fragmentation_index = fragmentation_index;
+            }
+        }
+    }
+    total_time = get_time_ns() - start_time;
+    uint64_t total_cycles = cycles_read() - start_cycles;
+    free_slots(slots, trace_ptr->slots_number, is_malloc);
+
+    if (trace_ptr->operations_number != 0 && total_cycles != 0) {
+        double ns_per_cycle = (double)total_time / (double)total_cycles;
+        qsort(operations_cycles, trace_ptr->operations_number, sizeof(uint64_t), compare_cycles);
+        result_ptr->p50_ns = operations_cycles[(trace_ptr->operations_number - 1) * 50 / 100] * ns_per_cycle;
+        result_ptr->p99_ns = operations_cycles[(trace_ptr->operations_number - 1) * 99 / 100] * ns_per_cycle;
+        result_ptr->p999_ns = operations_cycles[(trace_ptr->operations_number - 1) * 999 / 1000] * ns_per_cycle;
+    }
+
+    free(area_memory);
+    free(required_memory);
+    free(operations_cycles);
+    free(slots);
+    return true;
+}
+
+static void print_result(const char* name, const replay_result_t* result_ptr)
+{
+    printf("%9s | %10llu | %8.2f | %8.2f | %8.2f | %8.2f | ", name, (unsigned long long)result_ptr->operations_number,
+        result_ptr->ns_per_operation, result_ptr->p50_ns, result_ptr->p99_ns, result_ptr->p999_ns);
+    if (strcmp(name, "malloc") == 0) {
+        printf("%22s | %8llu\n", "-", (unsigned long long)result_ptr->failed_allocations_number);
+    }
+    else {
+        printf("%22d | %8llu\n", result_ptr->peak_fragmentation_index, (unsigned long long)result_ptr->failed_allocations_number);
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    replay_trace_t trace;
+    memset(&trace, 0, sizeof(trace));
+    bool is_loaded = false;
+    bool with_malloc = false;
+    int argument_index = 1;
+    if (argc > 2 && strcmp(argv[1], "--synthetic") == 0) {
+        is_loaded = generate_synthetic_trace(argv[2], &trace);
+        argument_index = 3;
+    }
+    else if (argc > 1) {
+        is_loaded = read_trace_file(argv[1], &trace);
+        argument_index = 2;
+    }
+    else {
+        printf("Usage: replay <trace file> [--malloc]\n       replay --synthetic <spec> [--malloc]\n");
+        return 1;
+    }
+    if (argument_index < argc && strcmp(argv[argument_index], "--malloc") == 0) {
+        with_malloc = true;
+    }
+    if (!is_loaded) {
+        return 1;
+    }
+
+    printf("area: %llu bytes, page size: %u, max order: %u, flags: 0x%x, fragmentation index order: %u\n", (unsigned long long)trace.header.area_size,
+        trace.header.page_size, trace.header.max_order, trace.header.flags, trace.max_allocated_order);
+    if (trace.dropped_records_number != 0 || trace.skipped_records_number != 0) {
+        printf("dropped records: %llu, skipped records: %llu\n", (unsigned long long)trace.dropped_records_number, (unsigned long long)trace.skipped_records_number);
+    }
+    printf("allocator | operations |    ns/op |  p50 ns  |  p99 ns  | p999 ns  | peak fragmentation idx | failures\n");
+    replay_result_t result;
+    if (!replay_trace(&trace, false, &result)) {
+        return 1;
+    }
+    print_result("buddy", &result);
+    if (with_malloc) {
+        replay_trace(&trace, true, &result);
+        print_result("malloc", &result);
+    }
+
+    free(trace.operations);
+    return 0;
+}
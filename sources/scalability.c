@@ -0,0 +1,622 @@
+#include "buddy_allocator/buddy_allocator.h"
+#include "buddy_allocator/buddy_allocator_lock.h"
+#include "buddy_allocator/buddy_allocator_pcp.h"
+#include "buddy_allocator/buddy_allocator_sharded.h"
+#include "atomics/atomics.h"
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <time.h>
+#include <pthread.h>
+#include <sched.h>
+
+/*
+ * Multi-threaded stress of the thread-safe modes of the allocator, the scaling curve is printed as CSV.
+ *
+ * Usage:
+ * scalability [--modes mutex,spinlock,pcp,sharded] [--threads 1,2,4,8,16,32,64] [--operations N] [--area MB] [--seed N]
+ *
+ * Modes:
+ * mutex - one allocator behind one pthread mutex
+ * spinlock - one allocator behind one test-and-test-and-set spinlock
+ * pcp - buddy_allocator_pcp, a CPU cache per thread, orders 0 - 3 are cached, the locks are mutexes
+ * sharded - buddy_allocator_sharded, a shard per thread (if the area has enough large blocks), the locks are mutexes
+ *
+ * Each thread does the number of operations, an operation is an allocation (orders 0 - 3, lower orders are more likely),
+ * a free of a random own block, or a cross-thread free: the block is put to a random exchange slot,
+ * and the block taken from the slot, allocated by any thread, is freed instead.
+ * Each thread keeps at most its share of a half of the area allocated, so allocations rarely fail.
+ *
+ * Corruption is detected by canaries and by a shadow bitmap of the allocated pages:
+ * each block has a canary derived from its address and size in the first word, its number of pages in the second one
+ * and the inverted canary in the last one, they are checked before each free by the thread which frees the block.
+ * The bits of the pages are set atomically after allocation and cleared before free, a set bit means that the page is handed out twice.
+ * After each run all blocks are freed and the free memory of the allocator must be the whole area again.
+ * The program exits on the first error, the seed is printed, the operations of each thread are reproduced by it, but not their interleaving.
+ *
+ * The area is real memory, the page size is 4 KB, the max order is 10.
+ * Only the operations are timed, ops_per_second is the total number of operations divided by the time of the slowest thread.
+ */
+
+#define SCALABILITY_PAGE_SIZE 4096
+#define SCALABILITY_MAX_ORDER 10
+// Maximum order of the allocations, a block of this order or smaller is in one word of the shadow bitmap
+#define SCALABILITY_ALLOC_MAX_ORDER 3
+#define SCALABILITY_THREADS_NUMBER_MAX 64
+// Number of the exchange slots of the cross-thread frees
+#define SCALABILITY_EXCHANGE_SLOTS_NUMBER 64
+// One of this number of frees is a cross-thread one
+#define SCALABILITY_CROSS_FREE_PERIOD 4
+// The per-CPU caches parameters of the pcp mode
+#define SCALABILITY_PCP_HIGH 64
+#define SCALABILITY_PCP_BATCH 16
+// Number of reads of a busy spinlock before the CPU is yielded
+#define SCALABILITY_SPINS_NUMBER_BEFORE_YIELD 1024
+
+typedef struct scalability_context scalability_context_t;
+
+typedef struct {
+    const char* name;
+    // Creates the allocator for the number of threads, returns false if it can't be created
+    bool (*create)(scalability_context_t* context_ptr, size_t threads_number);
+    void* (*alloc)(scalability_context_t* context_ptr, size_t thread_index, size_t size);
+    void (*free)(scalability_context_t* context_ptr, size_t thread_index, void* memory_ptr);
+    // Returns all cached blocks to the allocator and returns its free memory size
+    size_t (*get_free_memory_size)(scalability_context_t* context_ptr);
+} scalability_mode_t;
+
+typedef struct {
+    scalability_context_t* context_ptr;
+    size_t thread_index;
+    uint64_t random_state;
+    // Live blocks of the thread, a random one is removed by swapping with the last one
+    void** live_blocks;
+    size_t live_blocks_number;
+    size_t live_blocks_number_max;
+    uint64_t failures_number;
+    uint64_t end_time;
+    // The threads data is written by different threads, each one is on its own cache lines
+    uint8_t padding[BUDDY_ALLOCATOR_CACHE_LINE_SIZE];
+} scalability_thread_t;
+
+struct scalability_context {
+    const scalability_mode_t* mode_ptr;
+    uintptr_t area_start_addr;
+    size_t area_size;
+    uint64_t operations_number;
+
+    buddy_allocator_t allocator;
+    buddy_allocator_pcp_t pcp;
+    buddy_allocator_sharded_t sharded;
+    // The lock of the mutex and spinlock modes
+    void* lock_ptr;
+    const buddy_allocator_lock_ops_t* lock_ops_ptr;
+    void* required_memory;
+    void* front_end_required_memory;
+
+    // Bit N is set when the page N is allocated
+    volatile uint64_t* shadow_bitmap;
+    volatile uint64_t exchange_slots[SCALABILITY_EXCHANGE_SLOTS_NUMBER];
+
+    // The threads wait for the start of the run
+    pthread_mutex_t start_mutex;
+    pthread_cond_t start_cond;
+    bool is_started;
+    uint64_t start_time;
+};
+
+/*
+ * Returns current time in nanoseconds
+ */
+static uint64_t get_time_ns(void)
+{
+    struct timespec time;
+    timespec_get(&time, TIME_UTC);
+    return (uint64_t)time.tv_sec * 1000000000 + (uint64_t)time.tv_nsec;
+}
+
+/*
+ * splitmix64, each thread has its own state
+ */
+static uint64_t get_random_64(uint64_t* state_ptr)
+{
+    uint64_t value = (*state_ptr += 0x9E3779B97F4A7C15);
+    value = (value ^ (value >> 30)) * 0xBF58476D1CE4E5B9;
+    value = (value ^ (value >> 27)) * 0x94D049BB133111EB;
+    return value ^ (value >> 31);
+}
+
+/*
+ * Allocates memory aligned to the cache line, the size is rounded up to it, as aligned_alloc requires
+ */
+static void* cache_line_alloc(size_t size)
+{
+    return aligned_alloc(BUDDY_ALLOCATOR_CACHE_LINE_SIZE, (size + BUDDY_ALLOCATOR_CACHE_LINE_SIZE - 1) & ~(size_t)(BUDDY_ALLOCATOR_CACHE_LINE_SIZE - 1));
+}
+
+static void fail(const char* message, const void* memory_ptr)
+{
+    fprintf(stderr, "%s, block %p\n", message, memory_ptr);
+    exit(-1);
+}
+
+// LOCKS STAFF
+
+static void mutex_init(void* lock_ptr)
+{
+    pthread_mutex_init(lock_ptr, NULL);
+}
+
+static void mutex_lock(void* lock_ptr)
+{
+    pthread_mutex_lock(lock_ptr);
+}
+
+static void mutex_unlock(void* lock_ptr)
+{
+    pthread_mutex_unlock(lock_ptr);
+}
+
+static void spinlock_init(void* lock_ptr)
+{
+    atomics_store_64(lock_ptr, 0);
+}
+
+static void spinlock_lock(void* lock_ptr)
+{
+    // The word is read until it is free, so the waiting threads don't take its cache line from each other
+    // With more threads than CPUs the holder may be preempted, so the CPU is yielded after a while
+    while (atomics_exchange_64(lock_ptr, 1) != 0) {
+        for (uint32_t spins_number = 1; atomics_load_64(lock_ptr) != 0; ++spins_number) {
+            if (spins_number % SCALABILITY_SPINS_NUMBER_BEFORE_YIELD == 0) {
+                sched_yield();
+            }
+        }
+    }
+}
+
+static void spinlock_unlock(void* lock_ptr)
+{
+    atomics_store_64(lock_ptr, 0);
+}
+
+static const buddy_allocator_lock_ops_t g_mutex_lock_ops = { sizeof(pthread_mutex_t), mutex_init, mutex_lock, mutex_unlock };
+static const buddy_allocator_lock_ops_t g_spinlock_lock_ops = { sizeof(uint64_t), spinlock_init, spinlock_lock, spinlock_unlock };
+
+// MODES STAFF
+
+/*
+ * Creates the allocator of the whole area, it is used by the mutex, spinlock and pcp modes
+ */
+static bool create_allocator(scalability_context_t* context_ptr)
+{
+    size_t required_memory_size = 0;
+    buddy_allocator_preinit(&context_ptr->allocator, context_ptr->area_start_addr, context_ptr->area_size, SCALABILITY_MAX_ORDER, SCALABILITY_PAGE_SIZE, false, &required_memory_size);
+    if (required_memory_size == 0) {
+        return false;
+    }
+    context_ptr->required_memory = malloc(required_memory_size);
+    if (context_ptr->required_memory == NULL) {
+        return false;
+    }
+    buddy_allocator_init(&context_ptr->allocator, context_ptr->required_memory);
+    return true;
+}
+
+static bool create_locked(scalability_context_t* context_ptr, const buddy_allocator_lock_ops_t* lock_ops_ptr)
+{
+    if (!create_allocator(context_ptr)) {
+        return false;
+    }
+    // The lock is on its own cache lines
+    context_ptr->lock_ptr = cache_line_alloc(lock_ops_ptr->lock_size);
+    if (context_ptr->lock_ptr == NULL) {
+        return false;
+    }
+    context_ptr->lock_ops_ptr = lock_ops_ptr;
+    lock_ops_ptr->lock_init(context_ptr->lock_ptr);
+    return true;
+}
+
+static bool mutex_create(scalability_context_t* context_ptr, size_t threads_number)
+{
+    (void)threads_number;
+    return create_locked(context_ptr, &g_mutex_lock_ops);
+}
+
+static bool spinlock_create(scalability_context_t* context_ptr, size_t threads_number)
+{
+    (void)threads_number;
+    return create_locked(context_ptr, &g_spinlock_lock_ops);
+}
+
+static void* locked_alloc(scalability_context_t* context_ptr, size_t thread_index, size_t size)
+{
+    (void)thread_index;
+    context_ptr->lock_ops_ptr->lock(context_ptr->lock_ptr);
+    void* memory_ptr = buddy_allocator_alloc(&context_ptr->allocator, size);
+    context_ptr->lock_ops_ptr->unlock(context_ptr->lock_ptr);
+    return memory_ptr;
+}
+
+static void locked_free(scalability_context_t* context_ptr, size_t thread_index, void* memory_ptr)
+{
+    (void)thread_index;
+    context_ptr->lock_ops_ptr->lock(context_ptr->lock_ptr);
+    buddy_allocator_free(&context_ptr->allocator, memory_ptr);
+    context_ptr->lock_ops_ptr->unlock(context_ptr->lock_ptr);
+}
+
+static size_t locked_get_free_memory_size(scalability_context_t* context_ptr)
+{
+    return context_ptr->allocator.free_memory_size;
+}
+
+static bool pcp_create(scalability_context_t* context_ptr, size_t threads_number)
+{
+    if (!create_allocator(context_ptr)) {
+        return false;
+    }
+    size_t required_memory_size = 0;
+    buddy_allocator_pcp_preinit(&context_ptr->pcp, &context_ptr->allocator, threads_number, SCALABILITY_ALLOC_MAX_ORDER + 1, SCALABILITY_PCP_HIGH, SCALABILITY_PCP_BATCH, &g_mutex_lock_ops, &required_memory_size);
+    if (required_memory_size == 0) {
+        return false;
+    }
+    context_ptr->front_end_required_memory = cache_line_alloc(required_memory_size);
+    if (context_ptr->front_end_required_memory == NULL) {
+        return false;
+    }
+    buddy_allocator_pcp_init(&context_ptr->pcp, context_ptr->front_end_required_memory);
+    return true;
+}
+
+static void* pcp_alloc(scalability_context_t* context_ptr, size_t thread_index, size_t size)
+{
+    return buddy_allocator_pcp_alloc(&context_ptr->pcp, thread_index, size);
+}
+
+static void pcp_free(scalability_context_t* context_ptr, size_t thread_index, void* memory_ptr)
+{
+    buddy_allocator_pcp_free(&context_ptr->pcp, thread_index, memory_ptr);
+}
+
+static size_t pcp_get_free_memory_size(scalability_context_t* context_ptr)
+{
+    buddy_allocator_pcp_drain_all(&context_ptr->pcp);
+    return context_ptr->allocator.free_memory_size;
+}
+
+static bool sharded_create(scalability_context_t* context_ptr, size_t threads_number)
+{
+    // A shard per thread, but each shard needs a large block at least
+    size_t shards_number = context_ptr->area_size / ((size_t)SCALABILITY_PAGE_SIZE << SCALABILITY_MAX_ORDER);
+    shards_number = threads_number < shards_number ? threads_number : shards_number;
+    size_t required_memory_size = 0;
+    buddy_allocator_sharded_preinit(&context_ptr->sharded, context_ptr->area_start_addr, context_ptr->area_size, SCALABILITY_MAX_ORDER, SCALABILITY_PAGE_SIZE, false, 0, shards_number, &g_mutex_lock_ops, &required_memory_size);
+    if (required_memory_size == 0) {
+        return false;
+    }
+    context_ptr->front_end_required_memory = cache_line_alloc(required_memory_size);
+    if (context_ptr->front_end_required_memory == NULL) {
+        return false;
+    }
+    buddy_allocator_sharded_init(&context_ptr->sharded, context_ptr->front_end_required_memory);
+    return true;
+}
+
+static void* sharded_alloc(scalability_context_t* context_ptr, size_t thread_index, size_t size)
+{
+    return buddy_allocator_sharded_alloc(&context_ptr->sharded, thread_index, size);
+}
+
+static void sharded_free(scalability_context_t* context_ptr, size_t thread_index, void* memory_ptr)
+{
+    (void)thread_index;
+    buddy_allocator_sharded_free(&context_ptr->sharded, memory_ptr);
+}
+
+static size_t sharded_get_free_memory_size(scalability_context_t* context_ptr)
+{
+    size_t free_memory_size = 0;
+    for (size_t i = 0; i < context_ptr->sharded.shards_number; ++i) {
+        free_memory_size += context_ptr->sharded.shards[i].free_memory_size;
+    }
+    return free_memory_size;
+}
+
+static const scalability_mode_t g_modes[] = {
+    { "mutex", mutex_create, locked_alloc, locked_free, locked_get_free_memory_size },
+    { "spinlock", spinlock_create, locked_alloc, locked_free, locked_get_free_memory_size },
+    { "pcp", pcp_create, pcp_alloc, pcp_free, pcp_get_free_memory_size },
+    { "sharded", sharded_create, sharded_alloc, sharded_free, sharded_get_free_memory_size },
+};
+
+// WORKLOAD STAFF
+
+static uint64_t get_canary(const void* memory_ptr, uint64_t pages_number)
+{
+    uint64_t state = (uint64_t)(uintptr_t)memory_ptr ^ (pages_number << 56);
+    return get_random_64(&state);
+}
+
+/*
+ * Returns the mask of the pages of the block in its word of the shadow bitmap
+ */
+static uint64_t get_shadow_mask(scalability_context_t* context_ptr, const void* memory_ptr, size_t pages_number, size_t* word_index_ptr)
+{
+    size_t page_index = ((uintptr_t)memory_ptr - context_ptr->area_start_addr) / SCALABILITY_PAGE_SIZE;
+    *word_index_ptr = page_index / 64;
+    return (pages_number == 64 ? ~(uint64_t)0 : (((uint64_t)1 << pages_number) - 1)) << (page_index % 64);
+}
+
+static void check_allocated_block(scalability_context_t* context_ptr, void* memory_ptr, size_t pages_number)
+{
+    uintptr_t offset = (uintptr_t)memory_ptr - context_ptr->area_start_addr;
+    if ((uintptr_t)memory_ptr < context_ptr->area_start_addr || offset + pages_number * SCALABILITY_PAGE_SIZE > context_ptr->area_size ||
+        offset % (pages_number * SCALABILITY_PAGE_SIZE) != 0) {
+        fail("The block is out of the area or is not aligned", memory_ptr);
+    }
+    size_t word_index = 0;
+    uint64_t mask = get_shadow_mask(context_ptr, memory_ptr, pages_number, &word_index);
+    if ((atomics_fetch_or_64(&context_ptr->shadow_bitmap[word_index], mask) & mask) != 0) {
+        fail("The block overlaps an allocated block", memory_ptr);
+    }
+    uint64_t* words = memory_ptr;
+    uint64_t canary = get_canary(memory_ptr, pages_number);
+    words[0] = canary;
+    words[1] = pages_number;
+    words[pages_number * SCALABILITY_PAGE_SIZE / sizeof(uint64_t) - 1] = ~canary;
+}
+
+/*
+ * Checks the canaries, clears the pages in the shadow bitmap and frees the block
+ * The block can be allocated by any thread.
+ */
+static void check_and_free_block(scalability_context_t* context_ptr, size_t thread_index, void* memory_ptr)
+{
+    uint64_t* words = memory_ptr;
+    uint64_t pages_number = words[1];
+    if (pages_number == 0 || pages_number > ((uint64_t)1 << SCALABILITY_ALLOC_MAX_ORDER) || (pages_number & (pages_number - 1)) != 0 ||
+        words[0] != get_canary(memory_ptr, pages_number) || words[pages_number * SCALABILITY_PAGE_SIZE / sizeof(uint64_t) - 1] != ~words[0]) {
+        fail("The canary of the block is corrupted", memory_ptr);
+    }
+    size_t word_index = 0;
+    uint64_t mask = get_shadow_mask(context_ptr, memory_ptr, (size_t)pages_number, &word_index);
+    // The bits are cleared before the free, after it the pages can be allocated by another thread at once
+    if ((atomics_fetch_and_64(&context_ptr->shadow_bitmap[word_index], ~mask) & mask) != mask) {
+        fail("The pages of the block are not allocated", memory_ptr);
+    }
+    context_ptr->mode_ptr->free(context_ptr, thread_index, memory_ptr);
+}
+
+static void* scalability_thread_function(void* thread_ptr)
+{
+    scalability_thread_t* thread = thread_ptr;
+    scalability_context_t* context_ptr = thread->context_ptr;
+    pthread_mutex_lock(&context_ptr->start_mutex);
+    while (!context_ptr->is_started) {
+        pthread_cond_wait(&context_ptr->start_cond, &context_ptr->start_mutex);
+    }
+    pthread_mutex_unlock(&context_ptr->start_mutex);
+
+    for (uint64_t operation = 0; operation < context_ptr->operations_number; ++operation) {
+        uint64_t random = get_random_64(&thread->random_state);
+        if (thread->live_blocks_number == 0 || (thread->live_blocks_number < thread->live_blocks_number_max && (random & 1) == 0)) {
+            // Order N is taken with probability 2^-(N + 1), the rest goes to the max order
+            uint8_t order = 0;
+            while (order < SCALABILITY_ALLOC_MAX_ORDER && (random & ((uint64_t)2 << order)) != 0) {
+                order++;
+            }
+            size_t pages_number = (size_t)1 << order;
+            void* memory_ptr = context_ptr->mode_ptr->alloc(context_ptr, thread->thread_index, pages_number * SCALABILITY_PAGE_SIZE);
+            if (memory_ptr == NULL) {
+                thread->failures_number++;
+                continue;
+            }
+            check_allocated_block(context_ptr, memory_ptr, pages_number);
+            thread->live_blocks[thread->live_blocks_number++] = memory_ptr;
+        }
+        else {
+            size_t live_block_index = (size_t)((random >> 8) % thread->live_blocks_number);
+            void* memory_ptr = thread->live_blocks[live_block_index];
+            thread->live_blocks[live_block_index] = thread->live_blocks[--thread->live_blocks_number];
+            if ((random >> 40) % SCALABILITY_CROSS_FREE_PERIOD == 0) {
+                // The block is left for another thread, the block of another thread is freed instead
+                volatile uint64_t* slot_ptr = &context_ptr->exchange_slots[(random >> 48) % SCALABILITY_EXCHANGE_SLOTS_NUMBER];
+                memory_ptr = (void*)(uintptr_t)atomics_exchange_64(slot_ptr, (uint64_t)(uintptr_t)memory_ptr);
+                if (memory_ptr == NULL) {
+                    continue;
+                }
+            }
+            check_and_free_block(context_ptr, thread->thread_index, memory_ptr);
+        }
+    }
+    thread->end_time = get_time_ns();
+
+    // The remaining blocks are freed by the thread too, the pcp mode puts them to the cache of the thread
+    while (thread->live_blocks_number != 0) {
+        check_and_free_block(context_ptr, thread->thread_index, thread->live_blocks[--thread->live_blocks_number]);
+    }
+    return NULL;
+}
+
+// RUN STAFF
+
+/*
+ * Runs the workload with the number of threads, prints the row and returns the number of operations per second
+ */
+static double run(scalability_context_t* context_ptr, const scalability_mode_t* mode_ptr, size_t threads_number, uint64_t seed, double single_thread_ops_per_second)
+{
+    context_ptr->mode_ptr = mode_ptr;
+    context_ptr->required_memory = NULL;
+    context_ptr->front_end_required_memory = NULL;
+    context_ptr->lock_ptr = NULL;
+    if (!mode_ptr->create(context_ptr, threads_number)) {
+        fprintf(stderr, "Failed to create the %s allocator for %zu threads\n", mode_ptr->name, threads_number);
+        exit(-1);
+    }
+    memset((void*)context_ptr->shadow_bitmap, 0, (context_ptr->area_size / SCALABILITY_PAGE_SIZE / 64 + 1) * sizeof(uint64_t));
+    memset((void*)context_ptr->exchange_slots, 0, sizeof(context_ptr->exchange_slots));
+    context_ptr->is_started = false;
+
+    // Each thread keeps at most its share of a half of the area, the average block is about 2 pages
+    size_t live_blocks_number_max = context_ptr->area_size / SCALABILITY_PAGE_SIZE / 4 / threads_number;
+    scalability_thread_t* threads = cache_line_alloc(threads_number * sizeof(scalability_thread_t));
+    pthread_t* thread_ids = malloc(threads_number * sizeof(pthread_t));
+    if (threads == NULL || thread_ids == NULL) {
+        fprintf(stderr, "Failed to allocate memory for the threads\n");
+        exit(-1);
+    }
+    for (size_t i = 0; i < threads_number; ++i) {
+        memset(&threads[i], 0, sizeof(scalability_thread_t));
+        threads[i].context_ptr = context_ptr;
+        threads[i].thread_index = i;
+        threads[i].random_state = seed ^ ((uint64_t)i * 0xD1B54A32D192ED03);
+        threads[i].live_blocks_number_max = live_blocks_number_max != 0 ? live_blocks_number_max : 1;
+        threads[i].live_blocks = malloc(threads[i].live_blocks_number_max * sizeof(void*));
+        if (threads[i].live_blocks == NULL) {
+            fprintf(stderr, "Failed to allocate memory for the threads\n");
+            exit(-1);
+        }
+        if (pthread_create(&thread_ids[i], NULL, scalability_thread_function, &threads[i]) != 0) {
+            fprintf(stderr, "Failed to create thread %zu\n", i);
+            exit(-1);
+        }
+    }
+    pthread_mutex_lock(&context_ptr->start_mutex);
+    context_ptr->start_time = get_time_ns();
+    context_ptr->is_started = true;
+    pthread_cond_broadcast(&context_ptr->start_cond);
+    pthread_mutex_unlock(&context_ptr->start_mutex);
+
+    uint64_t end_time = context_ptr->start_time;
+    uint64_t failures_number = 0;
+    for (size_t i = 0; i < threads_number; ++i) {
+        pthread_join(thread_ids[i], NULL);
+        end_time = threads[i].end_time > end_time ? threads[i].end_time : end_time;
+        failures_number += threads[i].failures_number;
+        free(threads[i].live_blocks);
+    }
+    // The blocks left in the exchange slots are freed by the thread 0
+    for (size_t i = 0; i < SCALABILITY_EXCHANGE_SLOTS_NUMBER; ++i) {
+        void* memory_ptr = (void*)(uintptr_t)context_ptr->exchange_slots[i];
+        if (memory_ptr != NULL) {
+            check_and_free_block(context_ptr, 0, memory_ptr);
+        }
+    }
+    if (mode_ptr->get_free_memory_size(context_ptr) != context_ptr->area_size) {
+        fprintf(stderr, "The free memory of the %s allocator is not the whole area after all blocks are freed\n", mode_ptr->name);
+        exit(-1);
+    }
+
+    uint64_t operations_number = context_ptr->operations_number * threads_number;
+    double seconds = (double)(end_time - context_ptr->start_time) / 1000000000.0;
+    double ops_per_second = seconds > 0 ? (double)operations_number / seconds : 0.0;
+    printf("%s,%zu,%llu,%.3f,%.0f,%.2f,%llu\n", mode_ptr->name, threads_number, (unsigned long long)operations_number, seconds, ops_per_second,
+        single_thread_ops_per_second > 0 ? ops_per_second / single_thread_ops_per_second : 1.0, (unsigned long long)failures_number);
+    fflush(stdout);
+
+    free(thread_ids);
+    free(threads);
+    free(context_ptr->front_end_required_memory);
+    free(context_ptr->lock_ptr);
+    free(context_ptr->required_memory);
+    return ops_per_second;
+}
+
+static void usage(void)
+{
+    fprintf(stderr, "Usage: scalability [--modes mutex,spinlock,pcp,sharded] [--threads 1,2,4,8,16,32,64] [--operations N] [--area MB] [--seed N]\n");
+    exit(1);
+}
+
+int main(int argc, char* argv[])
+{
+    const char* modes = "mutex,spinlock,pcp,sharded";
+    const char* threads_numbers = "1,2,4,8,16,32,64";
+    uint64_t operations_number = 1 << 20;
+    size_t area_size_mb = 256;
+    uint64_t seed = (uint64_t)time(NULL);
+    for (int i = 1; i + 1 < argc; i += 2) {
+        if (strcmp(argv[i], "--modes") == 0) {
+            modes = argv[i + 1];
+        }
+        else if (strcmp(argv[i], "--threads") == 0) {
+            threads_numbers = argv[i + 1];
+        }
+        else if (strcmp(argv[i], "--operations") == 0) {
+            operations_number = strtoull(argv[i + 1], NULL, 10);
+        }
+        else if (strcmp(argv[i], "--area") == 0) {
+            area_size_mb = (size_t)strtoull(argv[i + 1], NULL, 10);
+        }
+        else if (strcmp(argv[i], "--seed") == 0) {
+            seed = strtoull(argv[i + 1], NULL, 10);
+        }
+        else {
+            usage();
+        }
+    }
+    if (argc % 2 == 0) {
+        usage();
+    }
+
+    static scalability_context_t context;
+    context.area_size = area_size_mb * 1024 * 1024;
+    context.operations_number = operations_number;
+    // The area is aligned to the largest block, so the blocks of the sharded mode are aligned too
+    size_t large_block_size = (size_t)SCALABILITY_PAGE_SIZE << SCALABILITY_MAX_ORDER;
+    if (context.area_size < large_block_size) {
+        fprintf(stderr, "The area must be at least %zu MB\n", large_block_size / 1024 / 1024);
+        return 1;
+    }
+    context.area_size -= context.area_size % large_block_size;
+    void* area_memory = aligned_alloc(large_block_size, context.area_size);
+    context.shadow_bitmap = malloc((context.area_size / SCALABILITY_PAGE_SIZE / 64 + 1) * sizeof(uint64_t));
+    if (area_memory == NULL || context.shadow_bitmap == NULL) {
+        fprintf(stderr, "Failed to allocate the area\n");
+        return 1;
+    }
+    context.area_start_addr = (uintptr_t)area_memory;
+    pthread_mutex_init(&context.start_mutex, NULL);
+    pthread_cond_init(&context.start_cond, NULL);
+    fprintf(stderr, "Seed: %llu\n", (unsigned long long)seed);
+
+    printf("mode,threads,operations,seconds,ops_per_second,speedup,failures\n");
+    const char* mode = modes;
+    while (*mode != '\0') {
+        size_t mode_length = strcspn(mode, ",");
+        const scalability_mode_t* mode_ptr = NULL;
+        for (size_t i = 0; i < sizeof(g_modes) / sizeof(scalability_mode_t); ++i) {
+            if (strlen(g_modes[i].name) == mode_length && strncmp(g_modes[i].name, mode, mode_length) == 0) {
+                mode_ptr = &g_modes[i];
+            }
+        }
+        if (mode_ptr == NULL) {
+            fprintf(stderr, "Unknown mode %.*s\n", (int)mode_length, mode);
+            return 1;
+        }
+        // The speedup is relative to the first number of threads
+        double first_ops_per_second = 0.0;
+        const char* threads_number_str = threads_numbers;
+        while (*threads_number_str != '\0') {
+            char* end = NULL;
+            unsigned long long threads_number = strtoull(threads_number_str, &end, 10);
+            if (end == threads_number_str || threads_number == 0 || threads_number > SCALABILITY_THREADS_NUMBER_MAX || (*end != ',' && *end != '\0')) {
+                fprintf(stderr, "Incorrect number of threads %s, it must be from 1 to %u\n", threads_number_str, SCALABILITY_THREADS_NUMBER_MAX);
+                return 1;
+            }
+            double ops_per_second = run(&context, mode_ptr, (size_t)threads_number, seed, first_ops_per_second);
+            if (first_ops_per_second == 0.0) {
+                first_ops_per_second = ops_per_second;
+            }
+            threads_number_str = *end == ',' ? end + 1 : end;
+        }
+        mode += mode_length;
+        mode += *mode == ',';
+    }
+
+    free((void*)context.shadow_bitmap);
+    free(area_memory);
+    return 0;
+}
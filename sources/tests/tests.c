@@ -1,5 +1,9 @@
 #include "tests.h"
 #include "../buddy_allocator/buddy_allocator.h"
+#include "../buddy_allocator/buddy_allocator_pcp.h"
+#include "../buddy_allocator/buddy_allocator_sharded.h"
+#include "../buddy_allocator/buddy_allocator_zones.h"
+#include "../buddy_allocator/buddy_allocator_trace.h"
 #ifndef _DEBUG
 #undef NDEBUG
 #endif // !_DEBUG
@@ -14,8 +18,8 @@
 void tests_preinit()
 {
     // 0, 1 MB, 4 MB, 8 MB, 12 MB, 1 GB
-    uint32_t fake_area_start_addr = 0x1000;
-    const uint32_t area_sizes[] = { 0, 1048576, 4194304, 8388608, 12582912, 1073741824 };
+    uintptr_t fake_area_start_addr = 0x1000;
+    const size_t area_sizes[] = { 0, 1048576, 4194304, 8388608, 12582912, 1073741824 };
     const uint8_t max_order = 10;
     // MAX_ORDER = 10
     // PAGE_SIZE = 4096
@@ -30,17 +34,17 @@ void tests_preinit()
     const uint32_t small_blocks_number_control[] = { 0, 0, 1024, 2048, 3072, 262144 };
     const uint32_t total_blocks_number_control[] = { 0, 0, 2047, 4094, 6141, 524032 };
 
-    // [blocks_nodes free_blocks_lists allocations_orders]
-    const uint32_t required_memory_size_control[] = { total_blocks_number_control[0] * sizeof(memory_block_node_t) + 0 + small_blocks_number_control[0] * sizeof(uint8_t),
-                                                      total_blocks_number_control[1] * sizeof(memory_block_node_t) + 0 + small_blocks_number_control[1] * sizeof(uint8_t),
-                                                      total_blocks_number_control[2] * sizeof(memory_block_node_t) + (max_order + 1) * sizeof(doubly_linked_list_t) + small_blocks_number_control[2] * sizeof(uint8_t),
-                                                      total_blocks_number_control[3] * sizeof(memory_block_node_t) + (max_order + 1) * sizeof(doubly_linked_list_t) + small_blocks_number_control[3] * sizeof(uint8_t),
-                                                      total_blocks_number_control[4] * sizeof(memory_block_node_t) + (max_order + 1) * sizeof(doubly_linked_list_t) + small_blocks_number_control[4] * sizeof(uint8_t),
-                                                      total_blocks_number_control[5] * sizeof(memory_block_node_t) + (max_order + 1) * sizeof(doubly_linked_list_t) + small_blocks_number_control[5] * sizeof(uint8_t) };
+    // [free_blocks_bitmap blocks_nodes free_blocks_lists allocations_orders]
+    const size_t required_memory_size_control[] = { (total_blocks_number_control[0] + 63) / 64 * sizeof(uint64_t) + total_blocks_number_control[0] * sizeof(memory_block_node_t) + 0 + small_blocks_number_control[0] * sizeof(uint8_t),
+                                                      (total_blocks_number_control[1] + 63) / 64 * sizeof(uint64_t) + total_blocks_number_control[1] * sizeof(memory_block_node_t) + 0 + small_blocks_number_control[1] * sizeof(uint8_t),
+                                                      (total_blocks_number_control[2] + 63) / 64 * sizeof(uint64_t) + total_blocks_number_control[2] * sizeof(memory_block_node_t) + (max_order + 1) * sizeof(doubly_linked_list_t) + small_blocks_number_control[2] * sizeof(uint8_t),
+                                                      (total_blocks_number_control[3] + 63) / 64 * sizeof(uint64_t) + total_blocks_number_control[3] * sizeof(memory_block_node_t) + (max_order + 1) * sizeof(doubly_linked_list_t) + small_blocks_number_control[3] * sizeof(uint8_t),
+                                                      (total_blocks_number_control[4] + 63) / 64 * sizeof(uint64_t) + total_blocks_number_control[4] * sizeof(memory_block_node_t) + (max_order + 1) * sizeof(doubly_linked_list_t) + small_blocks_number_control[4] * sizeof(uint8_t),
+                                                      (total_blocks_number_control[5] + 63) / 64 * sizeof(uint64_t) + total_blocks_number_control[5] * sizeof(memory_block_node_t) + (max_order + 1) * sizeof(doubly_linked_list_t) + small_blocks_number_control[5] * sizeof(uint8_t) };
     
-    for (uint32_t i = 0; i < sizeof(area_sizes) / sizeof(uint32_t); ++i) {
+    for (uint32_t i = 0; i < sizeof(area_sizes) / sizeof(size_t); ++i) {
         buddy_allocator_t allocator;
-        uint32_t required_memory_size = 0;
+        size_t required_memory_size = 0;
         memset(&allocator, 0, sizeof(buddy_allocator_t));
         buddy_allocator_preinit(&allocator, fake_area_start_addr, area_sizes[i], max_order, 4096, false, &required_memory_size);
         assert(allocator.large_blocks_number == large_blocks_number_control[i]);
@@ -53,7 +57,7 @@ void tests_preinit()
 void tests_small_sizes_predetermined()
 {
     buddy_allocator_t allocator;
-    uint32_t fake_area_start_addr = 0x1000;
+    uintptr_t fake_area_start_addr = 0x1000;
     uint8_t max_order = 2;
 
     // 48 bytes
@@ -72,10 +76,10 @@ void tests_small_sizes_predetermined()
     const uint32_t small_blocks_number_control = 12;
     const uint32_t total_blocks_number_control = 21;
 
-    // [blocks_nodes free_blocks_lists allocations_orders]
-    const uint32_t required_memory_size_control = total_blocks_number_control * sizeof(memory_block_node_t) + (max_order + 1) * sizeof(doubly_linked_list_t) + small_blocks_number_control * sizeof(uint8_t);
+    // [free_blocks_bitmap blocks_nodes free_blocks_lists allocations_orders]
+    const size_t required_memory_size_control = (total_blocks_number_control + 63) / 64 * sizeof(uint64_t) + total_blocks_number_control * sizeof(memory_block_node_t) + (max_order + 1) * sizeof(doubly_linked_list_t) + small_blocks_number_control * sizeof(uint8_t);
 
-    uint32_t required_memory_size = 0;
+    size_t required_memory_size = 0;
     memset(&allocator, 0, sizeof(buddy_allocator_t));
     buddy_allocator_preinit(&allocator, fake_area_start_addr, 48, max_order, 4, false, &required_memory_size);
 
@@ -288,17 +292,51 @@ void tests_small_sizes_predetermined()
     }
     assert(allocator.free_blocks_lists[allocator.max_order].count == 3);
 
+    // Only large blocks 0, 1, 2 are in the free lists, so only their bits are set in the free blocks bitmap
+    assert(allocator.free_blocks_bitmap[0] == 0x7);
+
     free(required_memory);
 }
 
-void tests_small_sizes_predetermined2(void)
+/*
+ * Returns number of free blocks of the order, regardless of the nodes format
+ * Free large blocks which are not touched yet (BUDDY_ALLOCATOR_FLAG_LAZY_INIT) are counted too
+ */
+static size_t get_free_blocks_number(buddy_allocator_t* allocator_ptr, uint8_t order)
+{
+    size_t untouched_free_blocks_number = 0;
+    if (order == allocator_ptr->max_order && allocator_ptr->allocate_all_small_blocks == false) {
+        untouched_free_blocks_number = allocator_ptr->large_blocks_number - allocator_ptr->untouched_large_block_index;
+    }
+    // With BUDDY_ALLOCATOR_FLAG_MIGRATE_TYPES each type has its own list of the order
+    size_t free_blocks_number = untouched_free_blocks_number;
+    for (uint8_t type = 0; type < allocator_ptr->migrate_types_number; ++type) {
+        if (allocator_ptr->flags & BUDDY_ALLOCATOR_FLAG_COMPACT_NODES) {
+            free_blocks_number += allocator_ptr->free_blocks_index_lists[type * (allocator_ptr->max_order + 1) + order].count;
+        }
+        else {
+            free_blocks_number += allocator_ptr->free_blocks_lists[type * (allocator_ptr->max_order + 1) + order].count;
+        }
+    }
+    return free_blocks_number;
+}
+
+static size_t get_type_free_blocks_number(buddy_allocator_t* allocator_ptr, uint8_t type, uint8_t order)
+{
+    if (allocator_ptr->flags & BUDDY_ALLOCATOR_FLAG_COMPACT_NODES) {
+        return allocator_ptr->free_blocks_index_lists[type * (allocator_ptr->max_order + 1) + order].count;
+    }
+    return allocator_ptr->free_blocks_lists[type * (allocator_ptr->max_order + 1) + order].count;
+}
+
+static void tests_small_sizes_predetermined2_with_flags(uint32_t flags)
 {
     buddy_allocator_t allocator;
-    uint32_t fake_area_start_addr = 0x1000;
+    uintptr_t fake_area_start_addr = 0x1000;
     uint8_t max_order = 2;
-    uint32_t required_memory_size = 0;
+    size_t required_memory_size = 0;
     memset(&allocator, 0, sizeof(buddy_allocator_t));
-    buddy_allocator_preinit(&allocator, fake_area_start_addr, 96, max_order, 8, false, &required_memory_size);
+    buddy_allocator_preinit_ex(&allocator, fake_area_start_addr, 96, max_order, 8, false, flags, &required_memory_size);
     void* required_memory = malloc(required_memory_size);
     assert(required_memory != NULL);
     buddy_allocator_init(&allocator, required_memory);
@@ -341,9 +379,10 @@ void tests_small_sizes_predetermined2(void)
         allocated_addr = buddy_allocator_alloc(&allocator, 32);
         assert(allocated_addr == NULL);
 
-        assert(allocator.free_blocks_lists[2].count == 0);
-        assert(allocator.free_blocks_lists[1].count == 0);
-        assert(allocator.free_blocks_lists[0].count == 0);
+        assert(get_free_blocks_number(&allocator, 2) == 0);
+        assert(get_free_blocks_number(&allocator, 1) == 0);
+        assert(get_free_blocks_number(&allocator, 0) == 0);
+        assert(allocator.free_orders_mask == 0);
 
         // Free all alocated blocks
         // Block 8
@@ -359,9 +398,10 @@ void tests_small_sizes_predetermined2(void)
         // Block 3
         buddy_allocator_free(&allocator, (void*)(0 * 16 + fake_area_start_addr));
 
-        assert(allocator.free_blocks_lists[2].count == 3);
-        assert(allocator.free_blocks_lists[1].count == 0);
-        assert(allocator.free_blocks_lists[0].count == 0);
+        assert(get_free_blocks_number(&allocator, 2) == 3);
+        assert(get_free_blocks_number(&allocator, 1) == 0);
+        assert(get_free_blocks_number(&allocator, 0) == 0);
+        assert(allocator.free_orders_mask == (1 << 2));
     }
 
     for (uint32_t i = 0; i < 3; ++i) {
@@ -389,9 +429,9 @@ void tests_small_sizes_predetermined2(void)
         allocated_addr = buddy_allocator_alloc(&allocator, 32);
         assert(allocated_addr == NULL);
 
-        assert(allocator.free_blocks_lists[2].count == 0);
-        assert(allocator.free_blocks_lists[1].count == 0);
-        assert(allocator.free_blocks_lists[0].count == 0);
+        assert(get_free_blocks_number(&allocator, 2) == 0);
+        assert(get_free_blocks_number(&allocator, 1) == 0);
+        assert(get_free_blocks_number(&allocator, 0) == 0);
 
         // Free all alocated blocks
         // Wrong, out of memory area, block 3 not exist
@@ -410,9 +450,9 @@ void tests_small_sizes_predetermined2(void)
         // Block -1
         buddy_allocator_free(&allocator, (void*)(-1 * 32 + fake_area_start_addr));
 
-        assert(allocator.free_blocks_lists[2].count == 3);
-        assert(allocator.free_blocks_lists[1].count == 0);
-        assert(allocator.free_blocks_lists[0].count == 0);
+        assert(get_free_blocks_number(&allocator, 2) == 3);
+        assert(get_free_blocks_number(&allocator, 1) == 0);
+        assert(get_free_blocks_number(&allocator, 0) == 0);
     }
 
     for (uint32_t i = 0; i < 3; ++i) {
@@ -423,21 +463,128 @@ void tests_small_sizes_predetermined2(void)
             assert((uintptr_t)allocated_addr == j * 8 + fake_area_start_addr);
         }
 
-        assert(allocator.free_blocks_lists[2].count == 0);
-        assert(allocator.free_blocks_lists[1].count == 0);
-        assert(allocator.free_blocks_lists[0].count == 0);
+        assert(get_free_blocks_number(&allocator, 2) == 0);
+        assert(get_free_blocks_number(&allocator, 1) == 0);
+        assert(get_free_blocks_number(&allocator, 0) == 0);
 
         // Free all allocated blocks 20 - 9
         for (int32_t j = 11; j >= 0; --j) {
             buddy_allocator_free(&allocator, (void*)(j * 8 + fake_area_start_addr));
         }
 
-        assert(allocator.free_blocks_lists[2].count == 3);
-        assert(allocator.free_blocks_lists[1].count == 0);
+        assert(get_free_blocks_number(&allocator, 2) == 3);
+        assert(get_free_blocks_number(&allocator, 1) == 0);
+        assert(get_free_blocks_number(&allocator, 0) == 0);
+    }
+
+    free(required_memory);
+}
+
+void tests_small_sizes_predetermined2(void)
+{
+    tests_small_sizes_predetermined2_with_flags(0);
+}
+
+void tests_compact_nodes(void)
+{
+    buddy_allocator_t allocator;
+    uintptr_t fake_area_start_addr = 0x1000;
+    uint8_t max_order = 2;
+    size_t required_memory_size = 0;
+
+    // 21 total blocks, 12 small blocks, the nodes are 8 bytes long regardless of the pointer size
+    // [free_blocks_bitmap blocks_nodes free_blocks_lists allocations_orders]
+    const size_t required_memory_size_control = sizeof(uint64_t) + 21 * 8 + (max_order + 1) * sizeof(doubly_linked_index_list_t) + 12 * sizeof(uint8_t);
+    memset(&allocator, 0, sizeof(buddy_allocator_t));
+    buddy_allocator_preinit_ex(&allocator, fake_area_start_addr, 96, max_order, 8, false, BUDDY_ALLOCATOR_FLAG_COMPACT_NODES, &required_memory_size);
+    assert(sizeof(memory_block_compact_node_t) == 8);
+    assert(required_memory_size == required_memory_size_control);
+
+    // The same allocations and frees give the same addresses with compact nodes
+    tests_small_sizes_predetermined2_with_flags(BUDDY_ALLOCATOR_FLAG_COMPACT_NODES);
+}
+
+void tests_in_block_nodes(void)
+{
+    buddy_allocator_t allocator;
+    uint8_t max_order = 2;
+    uint32_t page_size = 64;
+    size_t required_memory_size = 0;
+
+    // The nodes are written into the area, so it must be real memory
+    // 2 |     0     |     1     |     2     | 256 bytes per blocks
+    // 1 |  3  |  4  |  5  |  6  |  7  |  8  | 128 bytes per blocks
+    // 0 |9 |10|11|12|13|14|15|16|17|18|19|20| 64 bytes per blocks
+    uint8_t* area_ptr = malloc(12 * page_size);
+    assert(area_ptr != NULL);
+
+    // There is no blocks nodes array
+    // [free_blocks_bitmap free_blocks_lists allocations_orders]
+    const size_t required_memory_size_control = sizeof(uint64_t) + (max_order + 1) * sizeof(doubly_linked_list_t) + 12 * sizeof(uint8_t);
+    memset(&allocator, 0, sizeof(buddy_allocator_t));
+    buddy_allocator_preinit_ex(&allocator, (uintptr_t)area_ptr, 12 * page_size, max_order, page_size, false, BUDDY_ALLOCATOR_FLAG_IN_BLOCK_NODES, &required_memory_size);
+    assert(required_memory_size == required_memory_size_control);
+    void* required_memory = malloc(required_memory_size);
+    assert(required_memory != NULL);
+    buddy_allocator_init(&allocator, required_memory);
+
+    // The nodes of the free large blocks are at the start of the blocks
+    assert(allocator.free_blocks_lists[2].count == 3);
+    assert(allocator.free_blocks_lists[2].head == (dll_node_t*)(area_ptr + 0 * 4 * page_size));
+    assert(allocator.free_blocks_lists[2].tail == (dll_node_t*)(area_ptr + 2 * 4 * page_size));
+
+    for (uint32_t i = 0; i < 3; ++i) {
+        // Allocate all small blocks and fill them
+        // Blocks 9 - 20 in the first iteration, after that the large blocks are in a different order in the free list
+        uint8_t* allocated_addrs[12];
+        for (uint32_t j = 0; j < 12; ++j) {
+            allocated_addrs[j] = buddy_allocator_alloc(&allocator, page_size);
+            assert(allocated_addrs[j] != NULL);
+            if (i == 0) {
+                assert(allocated_addrs[j] == area_ptr + j * page_size);
+            }
+            memset(allocated_addrs[j], (int)j, page_size);
+        }
+        assert(buddy_allocator_alloc(&allocator, page_size) == NULL);
+
+        // Free every second block, they can't be merged, other blocks must stay untouched
+        for (uint32_t j = 0; j < 12; ++j) {
+            if (((allocated_addrs[j] - area_ptr) / page_size) % 2 == 1) {
+                buddy_allocator_free(&allocator, allocated_addrs[j]);
+            }
+        }
+        assert(allocator.free_blocks_lists[0].count == 6);
+        for (uint32_t j = 0; j < 12; ++j) {
+            if (((allocated_addrs[j] - area_ptr) / page_size) % 2 == 0) {
+                for (uint32_t k = 0; k < page_size; ++k) {
+                    assert(allocated_addrs[j][k] == (uint8_t)j);
+                }
+            }
+        }
+
+        // Free remaining blocks, all blocks are merged back
+        for (uint32_t j = 0; j < 12; ++j) {
+            if (((allocated_addrs[j] - area_ptr) / page_size) % 2 == 0) {
+                buddy_allocator_free(&allocator, allocated_addrs[j]);
+            }
+        }
         assert(allocator.free_blocks_lists[0].count == 0);
+        assert(allocator.free_blocks_lists[1].count == 0);
+        assert(allocator.free_blocks_lists[2].count == 3);
     }
 
+    // The page size is less than the node
+    memset(&allocator, 0, sizeof(buddy_allocator_t));
+    required_memory_size = 0;
+    buddy_allocator_preinit_ex(&allocator, (uintptr_t)area_ptr, 12 * page_size, max_order, sizeof(dll_node_t) / 2, false, BUDDY_ALLOCATOR_FLAG_IN_BLOCK_NODES, &required_memory_size);
+    assert(required_memory_size == 0);
+
+    // Only one nodes format can be used
+    buddy_allocator_preinit_ex(&allocator, (uintptr_t)area_ptr, 12 * page_size, max_order, page_size, false, BUDDY_ALLOCATOR_FLAG_IN_BLOCK_NODES | BUDDY_ALLOCATOR_FLAG_COMPACT_NODES, &required_memory_size);
+    assert(required_memory_size == 0);
+
     free(required_memory);
+    free(area_ptr);
 }
 
 void tests_allocate_all_small_blocks(void)
@@ -445,9 +592,9 @@ void tests_allocate_all_small_blocks(void)
     // Mark all small blocks as allocated by default
 
     buddy_allocator_t allocator;
-    uint32_t fake_area_start_addr = 0x1000;
+    uintptr_t fake_area_start_addr = 0x1000;
     uint8_t max_order = 2;
-    uint32_t required_memory_size = 0;
+    size_t required_memory_size = 0;
     memset(&allocator, 0, sizeof(buddy_allocator_t));
     buddy_allocator_preinit(&allocator, fake_area_start_addr, 96, max_order, 8, true, &required_memory_size);
     void* required_memory = malloc(required_memory_size);
@@ -481,131 +628,1697 @@ void tests_allocate_all_small_blocks(void)
     free(required_memory);
 }
 
-// TESTS_RANDOM STAFF
-enum ACTION {
-    ALLOCATE_RANDOM_BLOCKS,
-    FREE_RANDOM_BLOCKS,
-    CHECK_RANDOM_ALLOCATED_BLOCKS
-};
-
-uintptr_t g_area_start_addr = 0;
+// Only for 64-bit targets, the sizes below don't fit into 32-bit size_t
+#if UINTPTR_MAX > 0xFFFFFFFF
+static void tests_64_bit_with_flags(uint32_t flags)
+{
+    // 256 GB area above 4 GB, nothing is written into the area, so the address is fake
+    // MAX_ORDER = 10
+    // PAGE_SIZE = 64 MB
+    // 4 large blocks of 64 GB, 4096 small blocks, 8188 blocks total
+    buddy_allocator_t allocator;
+    uintptr_t fake_area_start_addr = (uintptr_t)0x100000000000;
+    const size_t page_size = (size_t)64 * 1024 * 1024;
+    const size_t large_block_size = page_size << 10;
+    size_t required_memory_size = 0;
+    memset(&allocator, 0, sizeof(buddy_allocator_t));
+    buddy_allocator_preinit_ex(&allocator, fake_area_start_addr, large_block_size * 4, 10, (uint32_t)page_size, false, flags, &required_memory_size);
+    assert(required_memory_size != 0);
+    assert(allocator.large_block_size == large_block_size);
+    assert(allocator.large_blocks_number == 4);
+    assert(allocator.small_blocks_number == 4096);
+    assert(allocator.total_blocks_number == 8188);
+    void* required_memory = malloc(required_memory_size);
+    assert(required_memory != NULL);
+    buddy_allocator_init(&allocator, required_memory);
 
-size_t g_area_size_min = 8192; //16384
-size_t g_area_size_max = 16384; //32768
-// Random
-size_t g_area_size = 0;
+    // The whole large blocks, their offsets are larger than 32 bits
+    void* large_blocks[4];
+    for (size_t i = 0; i < 4; ++i) {
+        large_blocks[i] = buddy_allocator_alloc(&allocator, large_block_size);
+        assert(large_blocks[i] == (void*)(fake_area_start_addr + i * large_block_size));
+    }
+    assert(buddy_allocator_alloc(&allocator, page_size) == NULL);
+    assert(allocator.free_orders_mask == 0);
+    // Large blocks are put to the head of the free list, free them in reverse order so that the first one will be allocated first
+    for (size_t i = 4; i > 0; --i) {
+        buddy_allocator_free(&allocator, large_blocks[i - 1]);
+    }
+    assert(get_free_blocks_number(&allocator, 10) == 4);
+
+    // 4 GB + 1 byte is rounded up to 8 GB, the order is 7
+    void* first_page = buddy_allocator_alloc(&allocator, page_size);
+    assert(first_page == (void*)fake_area_start_addr);
+    void* eight_gb_block = buddy_allocator_alloc(&allocator, ((size_t)4 << 30) + 1);
+    assert(eight_gb_block == (void*)(fake_area_start_addr + ((size_t)8 << 30)));
+    assert(allocator.allocations_orders[((size_t)8 << 30) / page_size] == 7 + 1);
+    void* second_large_block = buddy_allocator_alloc(&allocator, large_block_size);
+    assert(second_large_block == (void*)(fake_area_start_addr + large_block_size));
+    // The last page of the area is not allocated, it is ignored
+    buddy_allocator_free(&allocator, (void*)(fake_area_start_addr + large_block_size * 4 - page_size));
+    buddy_allocator_free(&allocator, first_page);
+    buddy_allocator_free(&allocator, eight_gb_block);
+    buddy_allocator_free(&allocator, second_large_block);
+    assert(get_free_blocks_number(&allocator, 10) == 4);
+    assert(allocator.free_orders_mask == ((uint64_t)1 << 10));
 
-const uint8_t g_max_order_min = 2;
-const uint8_t g_max_order_max = 9;
-// Random
-uint8_t g_max_order = 0;
+    free(required_memory);
+}
 
-uint32_t g_page_size = 8;
-//uint32_t g_page_size = 16;
+#endif
 
-// number of elements = max_order_max + 1
-size_t g_block_sizes[] = { 8, 16, 32, 64, 128, 256, 512, 1024, 2048, 4096 };
-//size_t g_block_sizes[] = { 16, 32, 64, 128, 256, 512, 1024, 2048, 4096, 8192 };
+void tests_64_bit(void)
+{
+#if UINTPTR_MAX > 0xFFFFFFFF
+    // Preinit of 1 TB area at the typical mmap address, large blocks are 4 GB
+    {
+        buddy_allocator_t allocator;
+        uintptr_t fake_area_start_addr = (uintptr_t)0x7f0000000000;
+        const size_t area_size = (size_t)1 << 40;
+        const uint8_t max_order = 20;
+        size_t required_memory_size = 0;
+        memset(&allocator, 0, sizeof(buddy_allocator_t));
+        buddy_allocator_preinit(&allocator, fake_area_start_addr, area_size, max_order, 4096, false, &required_memory_size);
+        const size_t large_blocks_number_control = 256;
+        const size_t small_blocks_number_control = (size_t)256 << 20;
+        const size_t total_blocks_number_control = (size_t)256 * (((size_t)1 << 21) - 1);
+        const size_t required_memory_size_control = (total_blocks_number_control + 63) / 64 * sizeof(uint64_t) + total_blocks_number_control * sizeof(memory_block_node_t) + (max_order + 1) * sizeof(doubly_linked_list_t) + small_blocks_number_control * sizeof(uint8_t);
+        assert(allocator.large_block_size == ((size_t)4 << 30));
+        assert(allocator.area_size == area_size);
+        assert(allocator.large_blocks_number == large_blocks_number_control);
+        assert(allocator.small_blocks_number == small_blocks_number_control);
+        assert(allocator.total_blocks_number == total_blocks_number_control);
+        assert(allocator.first_index_by_depth[max_order + 1] == total_blocks_number_control);
+        assert(required_memory_size == required_memory_size_control);
+    }
 
-typedef struct {
-    dll_node_t dll_node;
-    void* block_ptr;
-    uint32_t block_size;
-} block_info_t;
+    // Large max order, there are more than 2^32 blocks
+    {
+        buddy_allocator_t allocator;
+        const uint8_t max_order = 40;
+        size_t required_memory_size = 0;
+        memset(&allocator, 0, sizeof(buddy_allocator_t));
+        buddy_allocator_preinit(&allocator, 0x1000, (size_t)4096 << max_order, max_order, 4096, false, &required_memory_size);
+        assert(required_memory_size != 0);
+        assert(allocator.large_blocks_number == 1);
+        assert(allocator.small_blocks_number == ((size_t)1 << 40));
+        assert(allocator.total_blocks_number == ((size_t)1 << 41) - 1);
+
+        // The same area with compact nodes, the blocks indices don't fit into 32 bits
+        required_memory_size = 0;
+        memset(&allocator, 0, sizeof(buddy_allocator_t));
+        buddy_allocator_preinit_ex(&allocator, 0x1000, (size_t)4096 << max_order, max_order, 4096, false, BUDDY_ALLOCATOR_FLAG_COMPACT_NODES, &required_memory_size);
+        assert(required_memory_size == 0);
+    }
 
-doubly_linked_list_t g_allocated_blocks_list;
+    // Incorrect parameters
+    {
+        buddy_allocator_t allocator;
+        size_t required_memory_size = 0;
+        memset(&allocator, 0, sizeof(buddy_allocator_t));
+        // 2^max_order * page_size doesn't fit into 64 bits
+        buddy_allocator_preinit(&allocator, 0x1000, SIZE_MAX, BUDDY_ALLOCATOR_MAX_ORDER_LIMIT, 4096, false, &required_memory_size);
+        assert(required_memory_size == 0);
+        buddy_allocator_preinit(&allocator, 0x1000, SIZE_MAX, 52, 4096, false, &required_memory_size);
+        assert(required_memory_size == 0);
+        // Too many blocks
+        buddy_allocator_preinit(&allocator, 0x1000, SIZE_MAX, 62, 1, false, &required_memory_size);
+        assert(required_memory_size == 0);
+        // The area wraps around the end of the address space
+        buddy_allocator_preinit(&allocator, UINTPTR_MAX - 0xFFFFF, 1048576 * 2, 8, 4096, false, &required_memory_size);
+        assert(required_memory_size == 0);
+        // But it may end exactly at the end of the address space
+        buddy_allocator_preinit(&allocator, UINTPTR_MAX - 0xFFFFF, 1048576, 8, 4096, false, &required_memory_size);
+        assert(required_memory_size != 0);
+    }
 
-buddy_allocator_t g_allocator;
+    tests_64_bit_with_flags(0);
+    tests_64_bit_with_flags(BUDDY_ALLOCATOR_FLAG_COMPACT_NODES);
+#endif
+}
 
-static enum ACTION get_random_action()
+void tests_bulk(void)
 {
-    if (g_allocated_blocks_list.count == 0) {
-        return ALLOCATE_RANDOM_BLOCKS;
-    }
-    // 0-1 - allocate or free
-    // 2 - check
-    uint8_t af_or_c = rand() % 3;
-    if (af_or_c == 0 || af_or_c == 1) {
-        // Allocate or free
-        if (g_allocated_blocks_list.count == 0) {
-            return ALLOCATE_RANDOM_BLOCKS;
-        }
-        // Let's analyze the free blocks
-        // Allocator has free blocks?
-        bool allocator_has_free_blocks = false;
-        for (uint8_t i = 0; i <= g_max_order; ++i) {
-            if (g_allocator.free_blocks_lists[i].count > 0) {
-                allocator_has_free_blocks = true;
-                break;
-            }
-        }
-        if (allocator_has_free_blocks == false) {
-            return FREE_RANDOM_BLOCKS;
-        }
-        
-        // Allocate or free
-        // 0 - allocate
-        // 1 - free
-        uint8_t al_or_f = rand() % 2;
-        if (al_or_f == 0) {
-            return ALLOCATE_RANDOM_BLOCKS;
-        }
-        else {
-            return FREE_RANDOM_BLOCKS;
-        }
+    buddy_allocator_t allocator;
+    uintptr_t fake_area_start_addr = 0x1000;
+    uint8_t max_order = 2;
+    size_t required_memory_size = 0;
+    memset(&allocator, 0, sizeof(buddy_allocator_t));
+    buddy_allocator_preinit(&allocator, fake_area_start_addr, 96, max_order, 8, false, &required_memory_size);
+    void* required_memory = malloc(required_memory_size);
+    assert(required_memory != NULL);
+    buddy_allocator_init(&allocator, required_memory);
+
+    // 2 |     0     |     1     |     2     | 32 bytes per blocks
+    // 1 |  3  |  4  |  5  |  6  |  7  |  8  | 16 bytes per blocks
+    // 0 |9 |10|11|12|13|14|15|16|17|18|19|20| 8 bytes per blocks
+    void* blocks[16];
+    assert(buddy_allocator_alloc_bulk(&allocator, max_order + 1, 1, blocks) == 0);
+    // Block 0 is handed out whole, block 1 is split once: 13 is handed out, 14 and 6 are put to the free lists
+    assert(buddy_allocator_alloc_bulk(&allocator, 0, 5, blocks) == 5);
+    for (size_t i = 0; i < 5; ++i) {
+        assert(blocks[i] == (void*)(fake_area_start_addr + i * 8));
+        assert(allocator.allocations_orders[i] == 1);
     }
-    else {
-        return CHECK_RANDOM_ALLOCATED_BLOCKS;
+    assert(allocator.free_blocks_lists[0].count == 1);
+    assert(allocator.free_blocks_lists[1].count == 1);
+    assert(allocator.free_blocks_lists[2].count == 1);
+    assert(allocator.free_orders_mask == 0x7);
+
+    // Unsorted, repeated and incorrect addresses
+    void* freeing_blocks[] = { blocks[4], blocks[1], blocks[0], (void*)(fake_area_start_addr + 96), blocks[3], blocks[2], blocks[1], (void*)(fake_area_start_addr + 48) };
+    assert(buddy_allocator_free_bulk(&allocator, freeing_blocks, sizeof(freeing_blocks) / sizeof(void*)) == 5);
+    assert(allocator.free_blocks_lists[0].count == 0);
+    assert(allocator.free_blocks_lists[1].count == 0);
+    assert(allocator.free_blocks_lists[2].count == 3);
+    for (size_t i = 0; i < 12; ++i) {
+        assert(allocator.allocations_orders[i] == 0);
     }
-}
 
-void do_action_allocate();
-void do_action_free();
-void do_action_check();
+    // Less memory than requested
+    assert(buddy_allocator_alloc_bulk(&allocator, 1, 8, blocks) == 6);
+    assert(allocator.free_orders_mask == 0);
+    assert(buddy_allocator_free_bulk(&allocator, blocks, 6) == 6);
+    assert(allocator.free_blocks_lists[2].count == 3);
+
+    // Blocks of different orders
+    blocks[0] = buddy_allocator_alloc(&allocator, 8);
+    blocks[1] = buddy_allocator_alloc(&allocator, 16);
+    blocks[2] = buddy_allocator_alloc(&allocator, 32);
+    blocks[3] = buddy_allocator_alloc(&allocator, 8);
+    assert(buddy_allocator_free_bulk(&allocator, blocks, 4) == 4);
+    assert(allocator.free_blocks_lists[0].count == 0);
+    assert(allocator.free_blocks_lists[1].count == 0);
+    assert(allocator.free_blocks_lists[2].count == 3);
 
-static void do_action()
+    free(required_memory);
+}
+
+void tests_alloc_exact(void)
 {
-    enum ACTION action = get_random_action();
-    switch (action)
-    {
-    case ALLOCATE_RANDOM_BLOCKS:
-        do_action_allocate();
-        break;
-    case FREE_RANDOM_BLOCKS:
-        do_action_free();
-        break;
-    case CHECK_RANDOM_ALLOCATED_BLOCKS:
-        do_action_check();
-        break;
-    default:
-        break;
+    buddy_allocator_t allocator;
+    uintptr_t fake_area_start_addr = 0x1000;
+    uint8_t max_order = 3;
+    size_t required_memory_size = 0;
+    memset(&allocator, 0, sizeof(buddy_allocator_t));
+    buddy_allocator_preinit(&allocator, fake_area_start_addr, 192, max_order, 8, false, &required_memory_size);
+    void* required_memory = malloc(required_memory_size);
+    assert(required_memory != NULL);
+    buddy_allocator_init(&allocator, required_memory);
+
+    // 3 |           0           |           1           |           2           | 64 bytes per blocks
+    // 2 |     3     |     4     |     5     |     6     |     7     |     8     | 32 bytes per blocks
+    // 1 |  9  | 10  | 11  | 12  | 13  | 14  | 15  | 16  | 17  | 18  | 19  | 20  | 16 bytes per blocks
+    // 0 |21|22|23|24|25|26|27|28|29|30|31|32|33|34|35|36|37|38|39|40|41|42|43|44| 8 bytes per blocks
+
+    // 5 pages: pages 0 - 3 and page 4 are kept, page 5 and pages 6 - 7 are free
+    void* run_ptr = buddy_allocator_alloc_exact(&allocator, 33);
+    assert(run_ptr == (void*)(fake_area_start_addr + 0));
+    assert(allocator.allocations_orders[0] == 2 + 1);
+    assert(allocator.allocations_orders[4] == (BUDDY_ALLOCATOR_CONTINUATION_FLAG | (0 + 1)));
+    assert(allocator.allocations_orders[5] == 0);
+    assert(allocator.free_blocks_lists[0].count == 1);
+    assert(allocator.free_blocks_lists[1].count == 1);
+    assert(allocator.free_blocks_lists[2].count == 0);
+    assert(allocator.free_blocks_lists[3].count == 2);
+    // The tail can be allocated
+    assert(buddy_allocator_alloc(&allocator, 8) == (void*)(fake_area_start_addr + 40));
+    assert(buddy_allocator_alloc(&allocator, 16) == (void*)(fake_area_start_addr + 48));
+    buddy_allocator_free(&allocator, (void*)(fake_area_start_addr + 40));
+    buddy_allocator_free(&allocator, (void*)(fake_area_start_addr + 48));
+    // The continuation can't be freed directly
+    buddy_allocator_free(&allocator, (void*)(fake_area_start_addr + 32));
+    assert(allocator.allocations_orders[4] == (BUDDY_ALLOCATOR_CONTINUATION_FLAG | (0 + 1)));
+    // The whole run is freed and merged
+    buddy_allocator_free(&allocator, run_ptr);
+    assert(allocator.allocations_orders[0] == 0);
+    assert(allocator.allocations_orders[4] == 0);
+    assert(allocator.free_blocks_lists[0].count == 0);
+    assert(allocator.free_blocks_lists[1].count == 0);
+    assert(allocator.free_blocks_lists[3].count == 3);
+
+    // A power of two size is the same as buddy_allocator_alloc
+    run_ptr = buddy_allocator_alloc_exact(&allocator, 64);
+    assert(allocator.allocations_orders[((uintptr_t)run_ptr - fake_area_start_addr) / 8] == 3 + 1);
+    buddy_allocator_free(&allocator, run_ptr);
+    assert(buddy_allocator_alloc_exact(&allocator, 65) == NULL);
+    assert(buddy_allocator_alloc_exact(&allocator, 0) == NULL);
+
+    // 7 pages: 4 + 2 + 1, freed with buddy_allocator_free_bulk together with the last page
+    void* blocks[2];
+    blocks[0] = buddy_allocator_alloc_exact(&allocator, 7 * 8);
+    assert(allocator.free_blocks_lists[0].count == 1);
+    blocks[1] = buddy_allocator_alloc(&allocator, 8);
+    assert(blocks[1] == (void*)((uintptr_t)blocks[0] + 56));
+    assert(buddy_allocator_free_bulk(&allocator, blocks, 2) == 2);
+    for (size_t i = 0; i < 24; ++i) {
+        assert(allocator.allocations_orders[i] == 0);
     }
+    assert(allocator.free_blocks_lists[0].count == 0);
+    assert(allocator.free_blocks_lists[3].count == 3);
+
+    free(required_memory);
 }
 
-void do_action_allocate()
+void tests_quicklists(void)
 {
-    //[1 - 3]
-    uint8_t allocations_number = (1 + (rand() % 3));
-    //allocations_number = 1;
-    uint8_t successful_allocated_blocks_number = 0;
+    buddy_allocator_t allocator;
+    uintptr_t fake_area_start_addr = 0x1000;
+    uint8_t max_order = 3;
+    size_t required_memory_size = 0;
+    memset(&allocator, 0, sizeof(buddy_allocator_t));
+    // 16 large blocks of 8 pages
+    buddy_allocator_preinit_ex(&allocator, fake_area_start_addr, 1024, max_order, 8, false, BUDDY_ALLOCATOR_FLAG_QUICKLISTS, &required_memory_size);
+    void* required_memory = malloc(required_memory_size);
+    assert(required_memory != NULL);
+    buddy_allocator_init(&allocator, required_memory);
+    assert(allocator.quicklist_orders_number == 2);
+    buddy_allocator_order_info_t orders_info[BUDDY_ALLOCATOR_MAX_ORDER_LIMIT + 1];
+
+    // Freed blocks are not merged, they are free and are allocated again in LIFO order
+    void* first_block_ptr = buddy_allocator_alloc(&allocator, 8);
+    void* second_block_ptr = buddy_allocator_alloc(&allocator, 8);
+    assert(first_block_ptr == (void*)(fake_area_start_addr + 0));
+    assert(second_block_ptr == (void*)(fake_area_start_addr + 8));
+#ifdef BUDDY_ALLOCATOR_STATS
+    buddy_allocator_reset_stats(&allocator);
+#endif
+    buddy_allocator_free(&allocator, first_block_ptr);
+    buddy_allocator_free(&allocator, second_block_ptr);
+#ifdef BUDDY_ALLOCATOR_STATS
+    buddy_allocator_stats_t stats;
+    buddy_allocator_get_stats(&allocator, &stats);
+    assert(stats.merges[1] == 0);
+#endif
+    assert(allocator.quicklists_counts[0] == 2);
+    assert(allocator.quicklist_orders_mask == 0x1);
+    assert(allocator.free_blocks_lists[0].count == 0);
+    assert(allocator.free_memory_size == 1024);
+    buddy_allocator_get_orders_info(&allocator, orders_info);
+    assert(orders_info[0].free_blocks_number == 2);
+    assert(buddy_allocator_get_fragmentation_index(&allocator, 0) == -1000);
+    assert(buddy_allocator_alloc(&allocator, 8) == second_block_ptr);
+    assert(buddy_allocator_alloc(&allocator, 8) == first_block_ptr);
+    assert(allocator.quicklist_orders_mask == 0);
+    assert(allocator.free_memory_size == 1024 - 16);
+
+    // Double free of a quicklisted block is rejected
+    buddy_allocator_free(&allocator, first_block_ptr);
+    buddy_allocator_free(&allocator, first_block_ptr);
+    assert(allocator.quicklists_counts[0] == 1);
+    assert(allocator.free_memory_size == 1024 - 8);
+
+    // Bulk allocation takes the quicklisted blocks first
+    buddy_allocator_free(&allocator, second_block_ptr);
+    void* blocks[65];
+    assert(buddy_allocator_alloc_bulk(&allocator, 0, 2, blocks) == 2);
+    assert(blocks[0] == second_block_ptr && blocks[1] == first_block_ptr);
+    assert(allocator.quicklists_counts[0] == 0);
+
+    // A quicklisted page can be reserved
+    buddy_allocator_free(&allocator, first_block_ptr);
+    assert(buddy_allocator_reserve_range(&allocator, first_block_ptr, 8));
+    assert(allocator.quicklists_counts[0] == 0);
+    assert(allocator.allocations_orders[0] == 0 + 1);
+    assert(buddy_allocator_free_range(&allocator, first_block_ptr, 8));
+    buddy_allocator_free(&allocator, second_block_ptr);
+
+    // An allocation which finds no free block coalesces the quicklists
+    assert(allocator.quicklists_counts[0] == 1);
+    for (size_t i = 0; i < 15; ++i) {
+        blocks[i] = buddy_allocator_alloc(&allocator, 64);
+        assert(blocks[i] != NULL && blocks[i] != (void*)fake_area_start_addr);
+    }
+    blocks[15] = buddy_allocator_alloc(&allocator, 64);
+    assert(blocks[15] == (void*)fake_area_start_addr);
+    assert(allocator.quicklist_orders_mask == 0);
+    assert(buddy_allocator_alloc(&allocator, 8) == NULL);
+    for (size_t i = 0; i < 16; ++i) {
+        buddy_allocator_free(&allocator, blocks[i]);
+    }
+    assert(allocator.free_blocks_lists[3].count == 16);
 
-    // Get max free order
-    int8_t max_free_order = -1;
-    for (int8_t j = g_max_order; j >= 0; --j) {
-        if (g_allocator.free_blocks_lists[j].count > 0) {
-            max_free_order = (uint8_t)j;
-            break;
-        }
+    // A full quicklist coalesces its oldest blocks: pages 0 - 31 are merged into 4 large blocks, pages 32 - 64 stay quicklisted
+    buddy_allocator_init(&allocator, required_memory);
+    for (size_t i = 0; i < 65; ++i) {
+        blocks[i] = buddy_allocator_alloc(&allocator, 8);
+        assert(blocks[i] == (void*)(fake_area_start_addr + i * 8));
     }
-    assert(max_free_order >= 0);
+    assert(allocator.free_blocks_lists[3].count == 7);
+    for (size_t i = 0; i < 65; ++i) {
+        buddy_allocator_free(&allocator, blocks[i]);
+    }
+    assert(allocator.quicklists_counts[0] == BUDDY_ALLOCATOR_QUICKLIST_HIGH + 1 - BUDDY_ALLOCATOR_QUICKLIST_BATCH);
+    assert(allocator.free_blocks_lists[3].count == 7 + 4);
+    assert(allocator.free_memory_size == 1024);
+
+    // Everything is merged back
+    buddy_allocator_coalesce(&allocator);
+    assert(allocator.quicklists_counts[0] == 0);
+    assert(allocator.quicklist_orders_mask == 0);
+    assert(allocator.free_blocks_lists[0].count == 0);
+    assert(allocator.free_blocks_lists[1].count == 0);
+    assert(allocator.free_blocks_lists[2].count == 0);
+    assert(allocator.free_blocks_lists[3].count == 16);
+    assert(allocator.free_memory_size == 1024);
 
-    // Try to allocate blocks
-    for (uint8_t i = 0; i < allocations_number; ++i) {
+    // The max order is never quicklisted
+    free(required_memory);
+    buddy_allocator_preinit_ex(&allocator, fake_area_start_addr, 1024, 0, 8, false, BUDDY_ALLOCATOR_FLAG_QUICKLISTS, &required_memory_size);
+    required_memory = malloc(required_memory_size);
+    assert(required_memory != NULL);
+    buddy_allocator_init(&allocator, required_memory);
+    assert(allocator.quicklist_orders_number == 0);
+    first_block_ptr = buddy_allocator_alloc(&allocator, 8);
+    buddy_allocator_free(&allocator, first_block_ptr);
+    assert(allocator.free_blocks_lists[0].count == 128);
+
+    free(required_memory);
+}
+
+/*
+ * Sets up the allocator of the fake area 0x1000 of 256 bytes, 8 large blocks of 4 pages of 8 bytes
+ */
+static void* tests_address_ordered_init(buddy_allocator_t* allocator_ptr, uint32_t flags, bool allocate_all_small_blocks)
+{
+    size_t required_memory_size = 0;
+    memset(allocator_ptr, 0, sizeof(buddy_allocator_t));
+    buddy_allocator_preinit_ex(allocator_ptr, 0x1000, 256, 2, 8, allocate_all_small_blocks, flags, &required_memory_size);
+    void* required_memory = malloc(required_memory_size);
+    assert(required_memory != NULL);
+    buddy_allocator_init(allocator_ptr, required_memory);
+    return required_memory;
+}
+
+void tests_address_ordered(void)
+{
+    buddy_allocator_t allocator;
+    uintptr_t fake_area_start_addr = 0x1000;
+
+    // Deferred coalescing can't be used with the address order
+    size_t required_memory_size = 0;
+    memset(&allocator, 0, sizeof(buddy_allocator_t));
+    buddy_allocator_preinit_ex(&allocator, fake_area_start_addr, 256, 2, 8, false, BUDDY_ALLOCATOR_FLAG_QUICKLISTS | BUDDY_ALLOCATOR_FLAG_ADDRESS_ORDERED, &required_memory_size);
+    assert(required_memory_size == 0);
+
+    void* required_memory = tests_address_ordered_init(&allocator, BUDDY_ALLOCATOR_FLAG_ADDRESS_ORDERED, false);
+    assert(allocator.free_blocks_summary != NULL);
+    assert(buddy_allocator_get_free_tail_size(&allocator) == 256);
+    for (size_t i = 0; i < 32; ++i) {
+        assert(buddy_allocator_alloc(&allocator, 8) == (void*)(fake_area_start_addr + i * 8));
+    }
+    assert(buddy_allocator_get_free_tail_size(&allocator) == 0);
+
+    // Odd pages are freed in the ascending order, the last freed one is the head of the list, but the lowest one is allocated
+    for (size_t i = 1; i < 32; i += 2) {
+        buddy_allocator_free(&allocator, (void*)(fake_area_start_addr + i * 8));
+    }
+    for (size_t i = 1; i < 32; i += 2) {
+        assert(buddy_allocator_alloc(&allocator, 8) == (void*)(fake_area_start_addr + i * 8));
+    }
+
+    // Large blocks
+    for (size_t i = 0; i < 32; ++i) {
+        buddy_allocator_free(&allocator, (void*)(fake_area_start_addr + i * 8));
+    }
+    assert(buddy_allocator_get_free_tail_size(&allocator) == 256);
+    for (size_t i = 0; i < 8; ++i) {
+        assert(buddy_allocator_alloc(&allocator, 32) == (void*)(fake_area_start_addr + i * 32));
+    }
+    buddy_allocator_free(&allocator, (void*)(fake_area_start_addr + 5 * 32));
+    buddy_allocator_free(&allocator, (void*)(fake_area_start_addr + 2 * 32));
+    buddy_allocator_free(&allocator, (void*)(fake_area_start_addr + 7 * 32));
+    assert(buddy_allocator_get_free_tail_size(&allocator) == 32);
+    assert(buddy_allocator_alloc(&allocator, 32) == (void*)(fake_area_start_addr + 2 * 32));
+    assert(buddy_allocator_alloc(&allocator, 32) == (void*)(fake_area_start_addr + 5 * 32));
+    assert(buddy_allocator_alloc(&allocator, 32) == (void*)(fake_area_start_addr + 7 * 32));
+    for (size_t i = 0; i < 8; ++i) {
+        buddy_allocator_free(&allocator, (void*)(fake_area_start_addr + i * 32));
+    }
+
+    // The smallest suitable order is chosen first, the lowest block of it is allocated
+    assert(buddy_allocator_alloc(&allocator, 8) == (void*)(fake_area_start_addr + 0));
+    assert(buddy_allocator_alloc(&allocator, 16) == (void*)(fake_area_start_addr + 16));
+    assert(buddy_allocator_alloc(&allocator, 8) == (void*)(fake_area_start_addr + 8));
+    assert(buddy_allocator_alloc(&allocator, 8) == (void*)(fake_area_start_addr + 32));
+    assert(buddy_allocator_get_free_tail_size(&allocator) == 192);
+    free(required_memory);
+
+    // Bulk allocation takes the lowest blocks too
+    required_memory = tests_address_ordered_init(&allocator, BUDDY_ALLOCATOR_FLAG_ADDRESS_ORDERED | BUDDY_ALLOCATOR_FLAG_COMPACT_NODES, false);
+    void* blocks[8];
+    assert(buddy_allocator_alloc_bulk(&allocator, 2, 8, blocks) == 8);
+    buddy_allocator_free(&allocator, blocks[6]);
+    buddy_allocator_free(&allocator, blocks[3]);
+    assert(buddy_allocator_alloc_bulk(&allocator, 0, 5, blocks) == 5);
+    for (size_t i = 0; i < 4; ++i) {
+        assert(blocks[i] == (void*)(fake_area_start_addr + 3 * 32 + i * 8));
+    }
+    assert(blocks[4] == (void*)(fake_area_start_addr + 6 * 32));
+    free(required_memory);
+
+    // Migrate types can't be used with the address order, the bitmap has no types
+    memset(&allocator, 0, sizeof(buddy_allocator_t));
+    buddy_allocator_preinit_ex(&allocator, fake_area_start_addr, 256, 2, 8, false, BUDDY_ALLOCATOR_FLAG_MIGRATE_TYPES | BUDDY_ALLOCATOR_FLAG_ADDRESS_ORDERED, &required_memory_size);
+    assert(required_memory_size == 0);
+
+    // Untouched large blocks are free
+    required_memory = tests_address_ordered_init(&allocator, BUDDY_ALLOCATOR_FLAG_ADDRESS_ORDERED | BUDDY_ALLOCATOR_FLAG_LAZY_INIT, false);
+    assert(buddy_allocator_get_free_tail_size(&allocator) == 256);
+    assert(buddy_allocator_alloc(&allocator, 32) == (void*)(fake_area_start_addr + 0));
+    assert(buddy_allocator_alloc(&allocator, 8) == (void*)(fake_area_start_addr + 32));
+    assert(buddy_allocator_alloc(&allocator, 32) == (void*)(fake_area_start_addr + 64));
+    assert(allocator.untouched_large_block_index == 3);
+    buddy_allocator_free(&allocator, (void*)(fake_area_start_addr + 64));
+    assert(buddy_allocator_get_free_tail_size(&allocator) == 192);
+    assert(buddy_allocator_alloc(&allocator, 8) == (void*)(fake_area_start_addr + 40));
+    free(required_memory);
+
+    // All blocks are allocated
+    required_memory = tests_address_ordered_init(&allocator, BUDDY_ALLOCATOR_FLAG_ADDRESS_ORDERED | BUDDY_ALLOCATOR_FLAG_LAZY_INIT, true);
+    assert(buddy_allocator_get_free_tail_size(&allocator) == 0);
+    assert(buddy_allocator_free_range(&allocator, (void*)(fake_area_start_addr + 128), 128));
+    assert(buddy_allocator_get_free_tail_size(&allocator) == 128);
+    assert(buddy_allocator_alloc(&allocator, 8) == (void*)(fake_area_start_addr + 128));
+    free(required_memory);
+}
+
+void tests_free_range(void)
+{
+    buddy_allocator_t allocator;
+    uintptr_t fake_area_start_addr = 0x1000;
+    uint8_t max_order = 3;
+    size_t required_memory_size = 0;
+    memset(&allocator, 0, sizeof(buddy_allocator_t));
+    buddy_allocator_preinit(&allocator, fake_area_start_addr, 192, max_order, 8, true, &required_memory_size);
+    void* required_memory = malloc(required_memory_size);
+    assert(required_memory != NULL);
+    buddy_allocator_init(&allocator, required_memory);
+
+    // 3 |           0           |           1           |           2           | 64 bytes per blocks
+    // 2 |     3     |     4     |     5     |     6     |     7     |     8     | 32 bytes per blocks
+    // 1 |  9  | 10  | 11  | 12  | 13  | 14  | 15  | 16  | 17  | 18  | 19  | 20  | 16 bytes per blocks
+    // 0 |21|22|23|24|25|26|27|28|29|30|31|32|33|34|35|36|37|38|39|40|41|42|43|44| 8 bytes per blocks
+
+    assert(allocator.free_memory_size == 0);
+    // Pages 1 - 20 are freed as blocks 22, 10, 4, 1, 7, 41
+    assert(buddy_allocator_free_range(&allocator, (void*)(fake_area_start_addr + 8), 160));
+    assert(allocator.free_memory_size == 160);
+    assert(allocator.free_blocks_lists[0].count == 2);
+    assert(allocator.free_blocks_lists[1].count == 1);
+    assert(allocator.free_blocks_lists[2].count == 2);
+    assert(allocator.free_blocks_lists[3].count == 1);
+    assert(allocator.allocations_orders[0] == 0 + 1);
+    assert(allocator.allocations_orders[1] == 0);
+    assert(allocator.allocations_orders[20] == 0);
+    assert(allocator.allocations_orders[21] == 0 + 1);
+    // Page 1 is already free, nothing is changed
+    assert(!buddy_allocator_free_range(&allocator, (void*)(fake_area_start_addr + 0), 16));
+    assert(allocator.allocations_orders[0] == 0 + 1);
+
+    // Pages 10 - 12 are reserved, block 1 is split, pages 8 - 9 and 13 - 15 are put back
+    assert(buddy_allocator_reserve_range(&allocator, (void*)(fake_area_start_addr + 80), 24));
+    assert(allocator.free_blocks_lists[0].count == 3);
+    assert(allocator.free_blocks_lists[1].count == 3);
+    assert(allocator.free_blocks_lists[2].count == 2);
+    assert(allocator.free_blocks_lists[3].count == 0);
+    assert(allocator.allocations_orders[9] == 0);
+    assert(allocator.allocations_orders[10] == 0 + 1);
+    assert(allocator.allocations_orders[12] == 0 + 1);
+    assert(allocator.allocations_orders[13] == 0);
+    // Page 10 is reserved, nothing is changed
+    assert(!buddy_allocator_reserve_range(&allocator, (void*)(fake_area_start_addr + 72), 16));
+    assert(allocator.allocations_orders[9] == 0);
+    assert(allocator.free_blocks_lists[1].count == 3);
+    // The ranges are out of the area
+    assert(!buddy_allocator_reserve_range(&allocator, (void*)(fake_area_start_addr + 184), 16));
+    assert(!buddy_allocator_free_range(&allocator, (void*)(fake_area_start_addr + 200), 8));
+    assert(!buddy_allocator_free_range(&allocator, (void*)(fake_area_start_addr - 8), 16));
+
+    // The reserved pages are merged back to block 1
+    assert(buddy_allocator_free_range(&allocator, (void*)(fake_area_start_addr + 80), 24));
+    assert(allocator.free_blocks_lists[0].count == 2);
+    assert(allocator.free_blocks_lists[1].count == 1);
+    assert(allocator.free_blocks_lists[2].count == 2);
+    assert(allocator.free_blocks_lists[3].count == 1);
+    // Pages 0 and 21 - 23 are freed, everything is merged
+    assert(buddy_allocator_free_range(&allocator, (void*)(fake_area_start_addr + 0), 8));
+    assert(buddy_allocator_free_range(&allocator, (void*)(fake_area_start_addr + 168), 24));
+    assert(allocator.free_blocks_lists[0].count == 0);
+    assert(allocator.free_blocks_lists[1].count == 0);
+    assert(allocator.free_blocks_lists[2].count == 0);
+    assert(allocator.free_blocks_lists[3].count == 3);
+
+    // The whole area is reserved
+    assert(buddy_allocator_reserve_range(&allocator, (void*)(fake_area_start_addr + 0), 192));
+    for (uint8_t order = 0; order <= max_order; ++order) {
+        assert(allocator.free_blocks_lists[order].count == 0);
+    }
+    assert(buddy_allocator_alloc(&allocator, 8) == NULL);
+    // Only whole pages are freed, page 0 is partially in the range and it is freed by buddy_allocator_free
+    assert(buddy_allocator_free_range(&allocator, (void*)(fake_area_start_addr + 4), 188));
+    assert(allocator.allocations_orders[0] == 0 + 1);
+    buddy_allocator_free(&allocator, (void*)(fake_area_start_addr + 0));
+    assert(allocator.free_blocks_lists[3].count == 3);
+
+    // The reserved range touches pages 2 - 3 only
+    assert(buddy_allocator_reserve_range(&allocator, (void*)(fake_area_start_addr + 17), 14));
+    assert(allocator.allocations_orders[1] == 0);
+    assert(allocator.allocations_orders[2] == 0 + 1);
+    assert(allocator.allocations_orders[3] == 0 + 1);
+    assert(allocator.allocations_orders[4] == 0);
+    assert(buddy_allocator_free_range(&allocator, (void*)(fake_area_start_addr + 16), 16));
+    // Pages of an exact allocation can't be freed by range
+    void* run_ptr = buddy_allocator_alloc_exact(&allocator, 24);
+    assert(run_ptr == (void*)(fake_area_start_addr + 0));
+    assert(!buddy_allocator_free_range(&allocator, (void*)(fake_area_start_addr + 16), 8));
+    assert(!buddy_allocator_free_range(&allocator, (void*)(fake_area_start_addr + 0), 8));
+    buddy_allocator_free(&allocator, run_ptr);
+    assert(allocator.free_blocks_lists[3].count == 3);
+
+    free(required_memory);
+}
+
+void tests_lazy_init(void)
+{
+    buddy_allocator_t allocator;
+    uintptr_t fake_area_start_addr = 0x1000;
+    uint8_t max_order = 3;
+    size_t required_memory_size = 0;
+    memset(&allocator, 0, sizeof(buddy_allocator_t));
+    buddy_allocator_preinit_ex(&allocator, fake_area_start_addr, 192, max_order, 8, false, BUDDY_ALLOCATOR_FLAG_LAZY_INIT, &required_memory_size);
+    void* required_memory = malloc(required_memory_size);
+    assert(required_memory != NULL);
+    // The memory is not initialized by buddy_allocator_init, garbage must not matter
+    memset(required_memory, 0xFF, required_memory_size);
+    buddy_allocator_init(&allocator, required_memory);
+
+    // 3 |           0           |           1           |           2           | 64 bytes per blocks
+    // 2 |     3     |     4     |     5     |     6     |     7     |     8     | 32 bytes per blocks
+    // 1 |  9  | 10  | 11  | 12  | 13  | 14  | 15  | 16  | 17  | 18  | 19  | 20  | 16 bytes per blocks
+    // 0 |21|22|23|24|25|26|27|28|29|30|31|32|33|34|35|36|37|38|39|40|41|42|43|44| 8 bytes per blocks
+
+    // Nothing is touched, but there are free large blocks
+    assert(allocator.untouched_large_block_index == 0);
+    assert(allocator.free_orders_mask == ((uint64_t)1 << max_order));
+    assert(allocator.free_blocks_lists[max_order].count == 0);
+    assert(allocator.free_memory_size == 192);
+
+    // Block 0 is touched and split
+    assert(buddy_allocator_alloc(&allocator, 8) == (void*)(fake_area_start_addr + 0));
+    assert(allocator.untouched_large_block_index == 1);
+    assert(allocator.free_memory_size == 184);
+    assert(allocator.free_blocks_lists[0].count == 1);
+    assert(allocator.free_blocks_lists[1].count == 1);
+    assert(allocator.free_blocks_lists[2].count == 1);
+    assert(allocator.free_blocks_lists[3].count == 0);
+    assert(allocator.free_orders_mask & ((uint64_t)1 << max_order));
+    // Block 1 is touched only when there are no other large blocks
+    assert(buddy_allocator_alloc(&allocator, 64) == (void*)(fake_area_start_addr + 64));
+    assert(allocator.untouched_large_block_index == 2);
+    // Block 2 is not touched, it is free
+    buddy_allocator_free(&allocator, (void*)(fake_area_start_addr + 128));
+    assert(allocator.untouched_large_block_index == 2);
+    // Block 2 is touched and carved, there are no free large blocks now
+    assert(buddy_allocator_reserve_range(&allocator, (void*)(fake_area_start_addr + 136), 8));
+    assert(allocator.untouched_large_block_index == 3);
+    assert(allocator.free_blocks_lists[3].count == 0);
+    assert((allocator.free_orders_mask & ((uint64_t)1 << max_order)) == 0);
+
+    buddy_allocator_free(&allocator, (void*)(fake_area_start_addr + 0));
+    buddy_allocator_free(&allocator, (void*)(fake_area_start_addr + 64));
+    assert(buddy_allocator_free_range(&allocator, (void*)(fake_area_start_addr + 136), 8));
+    assert(allocator.free_blocks_lists[0].count == 0);
+    assert(allocator.free_blocks_lists[1].count == 0);
+    assert(allocator.free_blocks_lists[2].count == 0);
+    assert(allocator.free_blocks_lists[3].count == 3);
+
+    // All small blocks are allocated, untouched blocks are allocated too
+    memset(&allocator, 0, sizeof(buddy_allocator_t));
+    buddy_allocator_preinit_ex(&allocator, fake_area_start_addr, 192, max_order, 8, true, BUDDY_ALLOCATOR_FLAG_LAZY_INIT, &required_memory_size);
+    memset(required_memory, 0xFF, required_memory_size);
+    buddy_allocator_init(&allocator, required_memory);
+    assert(allocator.free_orders_mask == 0);
+    assert(buddy_allocator_alloc(&allocator, 8) == NULL);
+    // Blocks 0 and 1 are touched
+    assert(buddy_allocator_free_range(&allocator, (void*)(fake_area_start_addr + 64), 64));
+    assert(allocator.untouched_large_block_index == 2);
+    assert(allocator.free_blocks_lists[3].count == 1);
+    assert(allocator.allocations_orders[0] == 0 + 1);
+    assert(!buddy_allocator_reserve_range(&allocator, (void*)(fake_area_start_addr + 128), 8));
+    // Block 2 is touched
+    buddy_allocator_free(&allocator, (void*)(fake_area_start_addr + 128));
+    assert(allocator.untouched_large_block_index == 3);
+    assert(allocator.free_blocks_lists[0].count == 1);
+    assert(allocator.allocations_orders[16] == 0);
+    assert(allocator.allocations_orders[17] == 0 + 1);
+
+    free(required_memory);
+}
+
+static void tests_migrate_types_with_flags(uint32_t flags)
+{
+    buddy_allocator_t allocator;
+    uintptr_t fake_area_start_addr = 0x1000;
+    uint8_t max_order = 3;
+    size_t required_memory_size = 0;
+    memset(&allocator, 0, sizeof(buddy_allocator_t));
+    buddy_allocator_preinit_ex(&allocator, fake_area_start_addr, 192, max_order, 8, false, flags | BUDDY_ALLOCATOR_FLAG_MIGRATE_TYPES, &required_memory_size);
+    void* required_memory = malloc(required_memory_size);
+    assert(required_memory != NULL);
+    buddy_allocator_init(&allocator, required_memory);
+
+    // 3 |           0           |           1           |           2           | 64 bytes per blocks
+    // 2 |     3     |     4     |     5     |     6     |     7     |     8     | 32 bytes per blocks
+    // 1 |  9  | 10  | 11  | 12  | 13  | 14  | 15  | 16  | 17  | 18  | 19  | 20  | 16 bytes per blocks
+    // 0 |21|22|23|24|25|26|27|28|29|30|31|32|33|34|35|36|37|38|39|40|41|42|43|44| 8 bytes per blocks
+
+    // All large blocks are movable after initialization, untouched blocks become movable when they are touched
+    assert(allocator.migrate_types_number == BUDDY_ALLOCATOR_MIGRATE_TYPES_NUMBER);
+    if ((flags & BUDDY_ALLOCATOR_FLAG_LAZY_INIT) == 0) {
+        assert(get_type_free_blocks_number(&allocator, BUDDY_ALLOCATOR_MIGRATE_MOVABLE, max_order) == 3);
+        assert(allocator.free_orders_masks[BUDDY_ALLOCATOR_MIGRATE_MOVABLE] == ((uint64_t)1 << max_order));
+    }
+    assert(allocator.free_orders_masks[BUDDY_ALLOCATOR_MIGRATE_UNMOVABLE] == 0);
+
+    // Each type takes a whole large block
+    assert(buddy_allocator_alloc(&allocator, 8) == (void*)(fake_area_start_addr + 0));
+    assert(allocator.large_block_types[0] == BUDDY_ALLOCATOR_MIGRATE_UNMOVABLE);
+    assert(buddy_allocator_alloc_typed(&allocator, 8, BUDDY_ALLOCATOR_MIGRATE_MOVABLE) == (void*)(fake_area_start_addr + 64));
+    assert(allocator.large_block_types[1] == BUDDY_ALLOCATOR_MIGRATE_MOVABLE);
+    assert(buddy_allocator_alloc_typed(&allocator, 8, BUDDY_ALLOCATOR_MIGRATE_RECLAIMABLE) == (void*)(fake_area_start_addr + 128));
+    assert(allocator.large_block_types[2] == BUDDY_ALLOCATOR_MIGRATE_RECLAIMABLE);
+    assert(get_free_blocks_number(&allocator, max_order) == 0);
+    // Unmovable blocks are packed into the unmovable large block
+    assert(buddy_allocator_alloc(&allocator, 8) == (void*)(fake_area_start_addr + 8));
+    assert(buddy_allocator_alloc(&allocator, 16) == (void*)(fake_area_start_addr + 16));
+    assert(buddy_allocator_alloc(&allocator, 32) == (void*)(fake_area_start_addr + 32));
+    assert(allocator.free_orders_masks[BUDDY_ALLOCATOR_MIGRATE_UNMOVABLE] == 0);
+
+    // There are no free large blocks, a block of the reclaimable large block is used, it keeps its type
+    assert(buddy_allocator_alloc(&allocator, 8) == (void*)(fake_area_start_addr + 136));
+    assert(allocator.large_block_types[2] == BUDDY_ALLOCATOR_MIGRATE_RECLAIMABLE);
+    assert(buddy_allocator_alloc(&allocator, 64) == NULL);
+    assert(buddy_allocator_alloc_typed(&allocator, 8, BUDDY_ALLOCATOR_MIGRATE_TYPES_NUMBER) == NULL);
+
+    // Freed blocks are merged in the lists of the types of their large blocks
+    buddy_allocator_free(&allocator, (void*)(fake_area_start_addr + 0));
+    buddy_allocator_free(&allocator, (void*)(fake_area_start_addr + 8));
+    buddy_allocator_free(&allocator, (void*)(fake_area_start_addr + 16));
+    buddy_allocator_free(&allocator, (void*)(fake_area_start_addr + 32));
+    buddy_allocator_free(&allocator, (void*)(fake_area_start_addr + 64));
+    buddy_allocator_free(&allocator, (void*)(fake_area_start_addr + 128));
+    buddy_allocator_free(&allocator, (void*)(fake_area_start_addr + 136));
+    assert(get_type_free_blocks_number(&allocator, BUDDY_ALLOCATOR_MIGRATE_UNMOVABLE, max_order) == 1);
+    assert(get_type_free_blocks_number(&allocator, BUDDY_ALLOCATOR_MIGRATE_MOVABLE, max_order) == 1);
+    assert(get_type_free_blocks_number(&allocator, BUDDY_ALLOCATOR_MIGRATE_RECLAIMABLE, max_order) == 1);
+    assert(allocator.free_orders_mask == ((uint64_t)1 << max_order));
+    assert(allocator.free_memory_size == 192);
+    // The own large block of the type is used first
+    assert(buddy_allocator_alloc_typed(&allocator, 8, BUDDY_ALLOCATOR_MIGRATE_RECLAIMABLE) == (void*)(fake_area_start_addr + 128));
+    assert(buddy_allocator_alloc(&allocator, 64) == (void*)(fake_area_start_addr + 0));
+    // Bulk allocations are unmovable, the movable large block is stolen
+    void* blocks[8];
+    assert(buddy_allocator_alloc_bulk(&allocator, 0, 8, blocks) == 8);
+    assert(blocks[0] == (void*)(fake_area_start_addr + 64));
+    assert(allocator.large_block_types[1] == BUDDY_ALLOCATOR_MIGRATE_UNMOVABLE);
+
+    // Without the flag the type is ignored
+    memset(&allocator, 0, sizeof(buddy_allocator_t));
+    buddy_allocator_preinit_ex(&allocator, fake_area_start_addr, 192, max_order, 8, false, flags, &required_memory_size);
+    buddy_allocator_init(&allocator, required_memory);
+    assert(allocator.migrate_types_number == 1);
+    assert(allocator.large_block_types == NULL);
+    assert(buddy_allocator_alloc_typed(&allocator, 8, BUDDY_ALLOCATOR_MIGRATE_MOVABLE) == (void*)(fake_area_start_addr + 0));
+    assert(buddy_allocator_alloc_typed(&allocator, 8, BUDDY_ALLOCATOR_MIGRATE_TYPES_NUMBER) == (void*)(fake_area_start_addr + 8));
+
+    free(required_memory);
+}
+
+void tests_migrate_types(void)
+{
+    tests_migrate_types_with_flags(0);
+    tests_migrate_types_with_flags(BUDDY_ALLOCATOR_FLAG_COMPACT_NODES);
+    tests_migrate_types_with_flags(BUDDY_ALLOCATOR_FLAG_LAZY_INIT);
+}
+
+void tests_fragmentation_info(void)
+{
+    buddy_allocator_t allocator;
+    uintptr_t fake_area_start_addr = 0x1000;
+    uint8_t max_order = 3;
+    size_t required_memory_size = 0;
+    memset(&allocator, 0, sizeof(buddy_allocator_t));
+    buddy_allocator_preinit_ex(&allocator, fake_area_start_addr, 192, max_order, 8, false, 0, &required_memory_size);
+    void* required_memory = malloc(required_memory_size);
+    assert(required_memory != NULL);
+    buddy_allocator_init(&allocator, required_memory);
+
+    // 3 |           0           |           1           |           2           | 64 bytes per blocks
+    // 2 |     3     |     4     |     5     |     6     |     7     |     8     | 32 bytes per blocks
+    // 1 |  9  | 10  | 11  | 12  | 13  | 14  | 15  | 16  | 17  | 18  | 19  | 20  | 16 bytes per blocks
+    // 0 |21|22|23|24|25|26|27|28|29|30|31|32|33|34|35|36|37|38|39|40|41|42|43|44| 8 bytes per blocks
+
+    buddy_allocator_order_info_t orders_info[4];
+    buddy_allocator_get_orders_info(&allocator, orders_info);
+    assert(orders_info[3].free_blocks_number == 3);
+    assert(orders_info[3].free_memory_size == 192);
+    for (uint8_t order = 0; order <= max_order; ++order) {
+        assert(orders_info[order].unusable_free_space_index == 0);
+    }
+    assert(buddy_allocator_get_fragmentation_index(&allocator, 3) == -1000);
+
+    // Block 0 is split, 23 pages are free, 7 of them are in blocks smaller than a large block
+    assert(buddy_allocator_alloc(&allocator, 8) == (void*)(fake_area_start_addr + 0));
+    buddy_allocator_get_orders_info(&allocator, orders_info);
+    assert(orders_info[0].free_blocks_number == 1 && orders_info[0].free_memory_size == 8);
+    assert(orders_info[1].free_blocks_number == 1 && orders_info[1].free_memory_size == 16);
+    assert(orders_info[2].free_blocks_number == 1 && orders_info[2].free_memory_size == 32);
+    assert(orders_info[3].free_blocks_number == 2 && orders_info[3].free_memory_size == 128);
+    assert(orders_info[0].unusable_free_space_index == 0);
+    assert(orders_info[1].unusable_free_space_index == 1 * 1000 / 23);
+    assert(orders_info[2].unusable_free_space_index == 3 * 1000 / 23);
+    assert(orders_info[3].unusable_free_space_index == 7 * 1000 / 23);
+
+    // There are no free large blocks, 7 free pages are in 3 blocks
+    assert(buddy_allocator_alloc(&allocator, 64) == (void*)(fake_area_start_addr + 64));
+    assert(buddy_allocator_alloc(&allocator, 64) == (void*)(fake_area_start_addr + 128));
+    assert(buddy_allocator_get_fragmentation_index(&allocator, 3) == 1000 - (1000 + 7 * 1000 / 8) / 3);
+    assert(buddy_allocator_get_fragmentation_index(&allocator, 2) == -1000);
+
+    char buffer[256];
+    const char* buddyinfo = "Area 0x1000, type         All      1      1      1      0\n";
+    assert(buddy_allocator_format_buddyinfo(&allocator, buffer, sizeof(buffer)) == strlen(buddyinfo));
+    assert(strcmp(buffer, buddyinfo) == 0);
+    // The text is truncated, but the whole length is returned
+    assert(buddy_allocator_format_buddyinfo(&allocator, buffer, 10) == strlen(buddyinfo));
+    assert(strcmp(buffer, "Area 0x10") == 0);
+    assert(buddy_allocator_format_buddyinfo(&allocator, NULL, 0) == strlen(buddyinfo));
+
+    // There is no free memory
+    assert(buddy_allocator_alloc(&allocator, 8) == (void*)(fake_area_start_addr + 8));
+    assert(buddy_allocator_alloc(&allocator, 16) == (void*)(fake_area_start_addr + 16));
+    assert(buddy_allocator_alloc(&allocator, 32) == (void*)(fake_area_start_addr + 32));
+    buddy_allocator_get_orders_info(&allocator, orders_info);
+    for (uint8_t order = 0; order <= max_order; ++order) {
+        assert(orders_info[order].free_blocks_number == 0);
+        assert(orders_info[order].unusable_free_space_index == 1000);
+    }
+    assert(buddy_allocator_get_fragmentation_index(&allocator, 0) == 0);
+
+    // A line for each type
+    memset(&allocator, 0, sizeof(buddy_allocator_t));
+    buddy_allocator_preinit_ex(&allocator, fake_area_start_addr, 192, max_order, 8, false, BUDDY_ALLOCATOR_FLAG_MIGRATE_TYPES | BUDDY_ALLOCATOR_FLAG_LAZY_INIT, &required_memory_size);
+    free(required_memory);
+    required_memory = malloc(required_memory_size);
+    assert(required_memory != NULL);
+    buddy_allocator_init(&allocator, required_memory);
+    assert(buddy_allocator_alloc(&allocator, 8) == (void*)(fake_area_start_addr + 0));
+    buddyinfo = "Area 0x1000, type         All      1      1      1      2\n"
+                "Area 0x1000, type   Unmovable      1      1      1      0\n"
+                "Area 0x1000, type     Movable      0      0      0      0\n"
+                "Area 0x1000, type Reclaimable      0      0      0      0\n";
+    assert(buddy_allocator_format_buddyinfo(&allocator, buffer, sizeof(buffer)) == strlen(buddyinfo));
+    assert(strcmp(buffer, buddyinfo) == 0);
+
+    free(required_memory);
+}
+
+void tests_zones(void)
+{
+    // Flags of the zones
+    const uint32_t zone_dma32 = 0x1;
+    const uint32_t zone_normal = 0x2;
+    // Zones are not in the address order, the DMA32 zone has the lowest priority and keeps 64 bytes
+    buddy_allocator_zone_t zones[3];
+    memset(zones, 0, sizeof(zones));
+    zones[0].area_start_addr = 0x10000;
+    zones[0].area_size = 128;
+    zones[0].zone_flags = zone_normal;
+    zones[0].priority = 1;
+    zones[1].area_start_addr = 0x1000;
+    zones[1].area_size = 128;
+    zones[1].zone_flags = zone_dma32;
+    zones[1].priority = 0;
+    zones[1].low_watermark = 64;
+    // The area is rounded down to 64 bytes
+    zones[2].area_start_addr = 0x20000;
+    zones[2].area_size = 100;
+    zones[2].zone_flags = zone_normal;
+    zones[2].priority = 1;
+
+    buddy_allocator_zones_t zones_manager;
+    size_t required_memory_size = 0;
+    memset(&zones_manager, 0, sizeof(buddy_allocator_zones_t));
+    buddy_allocator_zones_preinit(&zones_manager, zones, 3, 3, 8, false, 0, &required_memory_size);
+    assert(required_memory_size != 0);
+    void* required_memory = malloc(required_memory_size);
+    assert(required_memory != NULL);
+    buddy_allocator_zones_init(&zones_manager, required_memory);
+    assert(zones_manager.fallback_order[0] == 0 && zones_manager.fallback_order[1] == 2 && zones_manager.fallback_order[2] == 1);
+    assert(zones_manager.address_order[0] == 1 && zones_manager.address_order[1] == 0 && zones_manager.address_order[2] == 2);
+
+    // The zone is found by address
+    assert(buddy_allocator_zones_find_zone(&zones_manager, (void*)0x1000) == &zones[1]);
+    assert(buddy_allocator_zones_find_zone(&zones_manager, (void*)0x107F) == &zones[1]);
+    assert(buddy_allocator_zones_find_zone(&zones_manager, (void*)0x1080) == NULL);
+    assert(buddy_allocator_zones_find_zone(&zones_manager, (void*)0x10040) == &zones[0]);
+    assert(buddy_allocator_zones_find_zone(&zones_manager, (void*)0x20040) == NULL);
+    assert(buddy_allocator_zones_find_zone(&zones_manager, (void*)0x800) == NULL);
+
+    // The normal zones are used first, then the DMA32 zone up to its watermark
+    assert(buddy_allocator_zones_alloc(&zones_manager, 64, zone_normal | zone_dma32) == (void*)0x10000);
+    assert(buddy_allocator_zones_alloc(&zones_manager, 64, zone_normal | zone_dma32) == (void*)0x10040);
+    assert(buddy_allocator_zones_alloc(&zones_manager, 64, zone_normal | zone_dma32) == (void*)0x20000);
+    assert(buddy_allocator_zones_alloc(&zones_manager, 64, zone_normal) == NULL);
+    assert(buddy_allocator_zones_alloc(&zones_manager, 64, zone_normal | zone_dma32) == (void*)0x1000);
+    assert(zones[1].allocator.free_memory_size == 64);
+    // The memory pressure, the watermark is ignored
+    assert(buddy_allocator_zones_alloc(&zones_manager, 8, zone_normal | zone_dma32) == (void*)0x1040);
+    assert(zones[1].allocator.free_memory_size == 56);
+    // A normal block is freed, it is used instead of the DMA32 zone again
+    buddy_allocator_zones_free(&zones_manager, (void*)0x10040);
+    assert(zones[0].allocator.free_memory_size == 64);
+    assert(buddy_allocator_zones_alloc(&zones_manager, 8, zone_normal | zone_dma32) == (void*)0x10040);
+    // Only the DMA32 zone is allowed
+    assert(buddy_allocator_zones_alloc(&zones_manager, 16, zone_dma32) == (void*)0x1050);
+    assert(buddy_allocator_zones_alloc(&zones_manager, 65, zone_normal | zone_dma32) == NULL);
+    assert(buddy_allocator_zones_alloc(&zones_manager, 8, 0x4) == NULL);
+
+    buddy_allocator_zones_free(&zones_manager, (void*)0x10000);
+    buddy_allocator_zones_free(&zones_manager, (void*)0x10040);
+    buddy_allocator_zones_free(&zones_manager, (void*)0x20000);
+    buddy_allocator_zones_free(&zones_manager, (void*)0x1000);
+    buddy_allocator_zones_free(&zones_manager, (void*)0x1040);
+    buddy_allocator_zones_free(&zones_manager, (void*)0x1050);
+    // Not in any zone
+    buddy_allocator_zones_free(&zones_manager, (void*)0x800);
+    assert(zones[0].allocator.free_memory_size == 128);
+    assert(zones[1].allocator.free_memory_size == 128);
+    assert(zones[2].allocator.free_memory_size == 64);
+    free(required_memory);
+
+    // Overlapping zones
+    zones[2].area_start_addr = 0x1070;
+    required_memory_size = 0;
+    buddy_allocator_zones_preinit(&zones_manager, zones, 3, 3, 8, false, 0, &required_memory_size);
+    assert(required_memory_size == 0);
+}
+
+/*
+ * Runs the tasks of buddy_allocator_init_parallel one by one in the reverse order, the order must not matter
+ */
+static void tests_run_tasks(void* context_ptr, buddy_allocator_task_t task, void* task_data_ptr, size_t tasks_number)
+{
+    (void)context_ptr;
+    for (size_t i = tasks_number; i > 0; --i) {
+        task(task_data_ptr, i - 1);
+    }
+}
+
+static void tests_init_parallel_with_flags(uint32_t flags, bool allocate_all_small_blocks, size_t tasks_number)
+{
+    // 100 large blocks, the area is real memory for the nodes in the blocks
+    const size_t area_size = 100 * 4 * 16;
+    uintptr_t area_start_addr = (uintptr_t)malloc(area_size);
+    assert(area_start_addr != 0);
+    buddy_allocator_t allocator;
+    buddy_allocator_t parallel_allocator;
+    size_t required_memory_size = 0;
+    memset(&allocator, 0, sizeof(buddy_allocator_t));
+    memset(&parallel_allocator, 0, sizeof(buddy_allocator_t));
+    buddy_allocator_preinit_ex(&allocator, area_start_addr, area_size, 2, 16, allocate_all_small_blocks, flags, &required_memory_size);
+    buddy_allocator_preinit_ex(&parallel_allocator, area_start_addr, area_size, 2, 16, allocate_all_small_blocks, flags, &required_memory_size);
+    assert(required_memory_size != 0);
+    void* required_memory = malloc(required_memory_size);
+    void* parallel_required_memory = malloc(required_memory_size);
+    assert(required_memory != NULL && parallel_required_memory != NULL);
+    memset(parallel_required_memory, 0xFF, required_memory_size);
+    buddy_allocator_init(&allocator, required_memory);
+    buddy_allocator_init_parallel(&parallel_allocator, parallel_required_memory, tasks_number, tests_run_tasks, NULL);
+
+    // The metadata is the same, except the nodes, their addresses are different
+    assert(memcmp(allocator.free_blocks_bitmap, parallel_allocator.free_blocks_bitmap, allocator.free_blocks_bitmap_memory_size) == 0);
+    if (allocator.free_blocks_summary != NULL) {
+        assert(memcmp(allocator.free_blocks_summary, parallel_allocator.free_blocks_summary, allocator.free_blocks_summary_memory_size) == 0);
+    }
+    assert(memcmp(allocator.allocations_orders, parallel_allocator.allocations_orders, allocator.allocations_orders_memory_size) == 0);
+    assert(allocator.free_orders_mask == parallel_allocator.free_orders_mask);
+    assert(parallel_allocator.untouched_large_block_index == parallel_allocator.large_blocks_number);
+    assert(get_free_blocks_number(&parallel_allocator, 2) == (allocate_all_small_blocks ? 0 : 100));
+
+    // The large blocks are allocated in the address order, and they are the same after freeing
+    if (allocate_all_small_blocks == false) {
+        for (size_t i = 0; i < 100; ++i) {
+            assert(buddy_allocator_alloc(&parallel_allocator, 64) == (void*)(area_start_addr + i * 64));
+        }
+        assert(buddy_allocator_alloc(&parallel_allocator, 16) == NULL);
+        for (size_t i = 0; i < 100; ++i) {
+            buddy_allocator_free(&parallel_allocator, (void*)(area_start_addr + i * 64));
+        }
+        assert(get_free_blocks_number(&parallel_allocator, 2) == 100);
+    }
+    else {
+        assert(buddy_allocator_free_range(&parallel_allocator, (void*)area_start_addr, area_size));
+        assert(get_free_blocks_number(&parallel_allocator, 2) == 100);
+    }
+
+    free(parallel_required_memory);
+    free(required_memory);
+    free((void*)area_start_addr);
+}
+
+void tests_init_parallel(void)
+{
+    const uint32_t flags[] = { 0, BUDDY_ALLOCATOR_FLAG_COMPACT_NODES, BUDDY_ALLOCATOR_FLAG_IN_BLOCK_NODES, BUDDY_ALLOCATOR_FLAG_ADDRESS_ORDERED };
+    // More tasks than words of the bitmap and than large blocks, some tasks have nothing to do
+    const size_t tasks_numbers[] = { 1, 2, 7, 150 };
+    for (uint32_t i = 0; i < sizeof(flags) / sizeof(uint32_t); ++i) {
+        for (uint32_t j = 0; j < sizeof(tasks_numbers) / sizeof(size_t); ++j) {
+            tests_init_parallel_with_flags(flags[i], false, tasks_numbers[j]);
+            tests_init_parallel_with_flags(flags[i], true, tasks_numbers[j]);
+        }
+    }
+}
+
+// TESTS_PCP STAFF
+// Single-threaded lock, checks that locks are not taken recursively and counts acquisitions
+typedef struct {
+    bool locked;
+    size_t acquisitions_number;
+} tests_lock_t;
+
+static void tests_lock_init(void* lock_ptr)
+{
+    tests_lock_t* tests_lock_ptr = lock_ptr;
+    tests_lock_ptr->locked = false;
+    tests_lock_ptr->acquisitions_number = 0;
+}
+
+static void tests_lock(void* lock_ptr)
+{
+    tests_lock_t* tests_lock_ptr = lock_ptr;
+    assert(tests_lock_ptr->locked == false);
+    tests_lock_ptr->locked = true;
+    tests_lock_ptr->acquisitions_number++;
+}
+
+static void tests_unlock(void* lock_ptr)
+{
+    tests_lock_t* tests_lock_ptr = lock_ptr;
+    assert(tests_lock_ptr->locked == true);
+    tests_lock_ptr->locked = false;
+}
+
+static const buddy_allocator_lock_ops_t g_tests_lock_ops = { sizeof(tests_lock_t), tests_lock_init, tests_lock, tests_unlock };
+
+void tests_pcp(void)
+{
+    buddy_allocator_t allocator;
+    buddy_allocator_pcp_t pcp;
+    uintptr_t fake_area_start_addr = 0x1000;
+    uint8_t max_order = 2;
+    size_t required_memory_size = 0;
+    size_t pcp_required_memory_size = 0;
+
+    // 2 |     0     |     1     |     2     | 32 bytes per blocks
+    // 1 |  3  |  4  |  5  |  6  |  7  |  8  | 16 bytes per blocks
+    // 0 |9 |10|11|12|13|14|15|16|17|18|19|20| 8 bytes per blocks
+    memset(&allocator, 0, sizeof(buddy_allocator_t));
+    memset(&pcp, 0, sizeof(buddy_allocator_pcp_t));
+    buddy_allocator_preinit(&allocator, fake_area_start_addr, 96, max_order, 8, false, &required_memory_size);
+    assert(required_memory_size != 0);
+    // Incorrect parameters
+    buddy_allocator_pcp_preinit(&pcp, &allocator, 0, 1, 4, 2, &g_tests_lock_ops, &pcp_required_memory_size);
+    assert(pcp_required_memory_size == 0);
+    buddy_allocator_pcp_preinit(&pcp, &allocator, 2, max_order + 2, 4, 2, &g_tests_lock_ops, &pcp_required_memory_size);
+    assert(pcp_required_memory_size == 0);
+    buddy_allocator_pcp_preinit(&pcp, &allocator, 2, 1, 4, 5, &g_tests_lock_ops, &pcp_required_memory_size);
+    assert(pcp_required_memory_size == 0);
+    // 2 CPUs, only order 0 is cached, up to 4 blocks in a cache, 2 blocks are moved at once
+    buddy_allocator_pcp_preinit(&pcp, &allocator, 2, 1, 4, 2, &g_tests_lock_ops, &pcp_required_memory_size);
+    assert(pcp_required_memory_size != 0);
+    assert(pcp_required_memory_size % BUDDY_ALLOCATOR_CACHE_LINE_SIZE == 0);
+    void* required_memory = malloc(required_memory_size);
+    void* pcp_required_memory = malloc(pcp_required_memory_size);
+    assert(required_memory != NULL && pcp_required_memory != NULL);
+    buddy_allocator_init(&allocator, required_memory);
+    buddy_allocator_pcp_init(&pcp, pcp_required_memory);
+    tests_lock_t* global_lock_ptr = pcp.global_lock_ptr;
+
+    // The cache of CPU 0 is refilled with 2 blocks under one global lock acquisition
+    assert(buddy_allocator_pcp_alloc(&pcp, 0, 8) == (void*)(fake_area_start_addr + 0));
+    assert(global_lock_ptr->acquisitions_number == 1);
+    assert(buddy_allocator_pcp_alloc(&pcp, 0, 8) == (void*)(fake_area_start_addr + 8));
+    assert(global_lock_ptr->acquisitions_number == 1);
+    // Order 1 is not cached
+    assert(buddy_allocator_pcp_alloc(&pcp, 0, 16) == (void*)(fake_area_start_addr + 16));
+    assert(global_lock_ptr->acquisitions_number == 2);
+    // CPU 1 has its own cache
+    assert(buddy_allocator_pcp_alloc(&pcp, 1, 8) == (void*)(fake_area_start_addr + 32));
+    assert(global_lock_ptr->acquisitions_number == 3);
+    assert(allocator.free_blocks_lists[0].count == 0);
+    assert(allocator.free_blocks_lists[1].count == 1);
+    assert(allocator.free_blocks_lists[2].count == 1);
+
+    // Freed small blocks stay in the cache, they are not merged
+    buddy_allocator_pcp_free(&pcp, 0, (void*)(fake_area_start_addr + 0));
+    buddy_allocator_pcp_free(&pcp, 0, (void*)(fake_area_start_addr + 8));
+    // A block allocated by CPU 1 can be freed to the cache of CPU 0
+    buddy_allocator_pcp_free(&pcp, 0, (void*)(fake_area_start_addr + 32));
+    assert(global_lock_ptr->acquisitions_number == 3);
+    assert(allocator.free_blocks_lists[0].count == 0);
+    // The last block freed is allocated first
+    assert(buddy_allocator_pcp_alloc(&pcp, 0, 8) == (void*)(fake_area_start_addr + 32));
+    buddy_allocator_pcp_free(&pcp, 0, (void*)(fake_area_start_addr + 32));
+    // Unallocated and outside addresses are ignored
+    buddy_allocator_pcp_free(&pcp, 0, (void*)(fake_area_start_addr + 48));
+    buddy_allocator_pcp_free(&pcp, 0, (void*)(fake_area_start_addr + 96));
+    // Order 1 block is freed directly, its buddy (pages 0 and 8) is in the cache, so it is not merged
+    buddy_allocator_pcp_free(&pcp, 0, (void*)(fake_area_start_addr + 16));
+    assert(allocator.free_blocks_lists[1].count == 2);
+
+    // All blocks are returned and merged
+    buddy_allocator_pcp_drain_all(&pcp);
+    assert(allocator.free_blocks_lists[0].count == 0);
+    assert(allocator.free_blocks_lists[1].count == 0);
+    assert(allocator.free_blocks_lists[2].count == 3);
+
+    // Start again with the initial state, so that the blocks are allocated in address order
+    buddy_allocator_init(&allocator, required_memory);
+    buddy_allocator_pcp_init(&pcp, pcp_required_memory);
+
+    // Allocate all small blocks by CPU 0, 6 refills
+    void* pages[12];
+    size_t acquisitions_number = global_lock_ptr->acquisitions_number;
+    for (size_t i = 0; i < 12; ++i) {
+        pages[i] = buddy_allocator_pcp_alloc(&pcp, 0, 8);
+        assert(pages[i] == (void*)(fake_area_start_addr + i * 8));
+    }
+    assert(global_lock_ptr->acquisitions_number == acquisitions_number + 6);
+    // Free 8 of them by CPU 1, when its cache is full, the 2 coldest blocks are drained
+    // At the end the cache contains pages 4 - 7, pages 0 - 3 are merged
+    for (size_t i = 0; i < 8; ++i) {
+        buddy_allocator_pcp_free(&pcp, 1, pages[i]);
+    }
+    assert(global_lock_ptr->acquisitions_number == acquisitions_number + 6 + 2);
+    assert(allocator.free_blocks_lists[2].count == 1);
+    assert(buddy_allocator_pcp_alloc(&pcp, 0, 32) == (void*)(fake_area_start_addr + 0));
+    // There are no free large blocks in the allocator, the caches are drained and the allocation is retried
+    assert(buddy_allocator_pcp_alloc(&pcp, 0, 32) == (void*)(fake_area_start_addr + 32));
+    assert(buddy_allocator_pcp_alloc(&pcp, 0, 8) == NULL);
+    free(pcp_required_memory);
+    free(required_memory);
+
+    // Each page is a large block, the metadata of the next large block isn't initialized yet, it isn't read
+    memset(&allocator, 0, sizeof(buddy_allocator_t));
+    buddy_allocator_preinit_ex(&allocator, fake_area_start_addr, 96, 0, 8, false, BUDDY_ALLOCATOR_FLAG_LAZY_INIT, &required_memory_size);
+    buddy_allocator_pcp_preinit(&pcp, &allocator, 1, 1, 4, 1, &g_tests_lock_ops, &pcp_required_memory_size);
+    required_memory = malloc(required_memory_size);
+    pcp_required_memory = malloc(pcp_required_memory_size);
+    assert(required_memory != NULL && pcp_required_memory != NULL);
+    memset(required_memory, 0xFF, required_memory_size);
+    buddy_allocator_init(&allocator, required_memory);
+    buddy_allocator_pcp_init(&pcp, pcp_required_memory);
+    global_lock_ptr = pcp.global_lock_ptr;
+    assert(buddy_allocator_pcp_alloc(&pcp, 0, 8) == (void*)(fake_area_start_addr + 0));
+    assert(allocator.untouched_large_block_index == 1);
+    acquisitions_number = global_lock_ptr->acquisitions_number;
+    buddy_allocator_pcp_free(&pcp, 0, (void*)(fake_area_start_addr + 0));
+    // The block is cached, it is not taken for the start of a run
+    assert(global_lock_ptr->acquisitions_number == acquisitions_number);
+    assert(buddy_allocator_pcp_alloc(&pcp, 0, 8) == (void*)(fake_area_start_addr + 0));
+    assert(global_lock_ptr->acquisitions_number == acquisitions_number);
+    free(pcp_required_memory);
+    free(required_memory);
+
+    // Runs are not cached, after the first run the next page is checked under the global lock
+    memset(&allocator, 0, sizeof(buddy_allocator_t));
+    buddy_allocator_preinit(&allocator, fake_area_start_addr, 96, max_order, 8, false, &required_memory_size);
+    buddy_allocator_pcp_preinit(&pcp, &allocator, 1, 2, 4, 1, &g_tests_lock_ops, &pcp_required_memory_size);
+    required_memory = malloc(required_memory_size);
+    pcp_required_memory = malloc(pcp_required_memory_size);
+    assert(required_memory != NULL && pcp_required_memory != NULL);
+    buddy_allocator_init(&allocator, required_memory);
+    buddy_allocator_pcp_init(&pcp, pcp_required_memory);
+    global_lock_ptr = pcp.global_lock_ptr;
+    assert(buddy_allocator_pcp_alloc(&pcp, 0, 8) == (void*)(fake_area_start_addr + 0));
+    assert(allocator.has_runs == 0);
+    // The run is pages 4 - 6, its first block is of order 1
+    void* run_ptr = buddy_allocator_alloc_exact(&allocator, 24);
+    assert(run_ptr == (void*)(fake_area_start_addr + 32));
+    assert(allocator.has_runs == 1);
+    acquisitions_number = global_lock_ptr->acquisitions_number;
+    buddy_allocator_pcp_free(&pcp, 0, run_ptr);
+    assert(global_lock_ptr->acquisitions_number == acquisitions_number + 2);
+    assert(allocator.allocations_orders[4] == 0 && allocator.allocations_orders[6] == 0);
+    buddy_allocator_pcp_free(&pcp, 0, (void*)(fake_area_start_addr + 0));
+    assert(global_lock_ptr->acquisitions_number == acquisitions_number + 3);
+    assert(allocator.allocations_orders[0] == 0 + 1);
+    assert(buddy_allocator_pcp_alloc(&pcp, 0, 8) == (void*)(fake_area_start_addr + 0));
+
+    free(pcp_required_memory);
+    free(required_memory);
+}
+
+#ifdef BUDDY_ALLOCATOR_STATS
+void tests_stats(void)
+{
+    buddy_allocator_t allocator;
+    uintptr_t fake_area_start_addr = 0x1000;
+    uint8_t max_order = 3;
+    size_t required_memory_size = 0;
+    memset(&allocator, 0, sizeof(buddy_allocator_t));
+    buddy_allocator_preinit_ex(&allocator, fake_area_start_addr, 192, max_order, 8, false, 0, &required_memory_size);
+    void* required_memory = malloc(required_memory_size);
+    assert(required_memory != NULL);
+    // The counters are reset by initialization
+    memset(&allocator.stats, 0xFF, sizeof(buddy_allocator_stats_t));
+    buddy_allocator_init(&allocator, required_memory);
+    buddy_allocator_stats_t stats;
+    buddy_allocator_get_stats(&allocator, &stats);
+    assert(stats.fast_allocations[0] == 0 && stats.rejected_frees == 0 && stats.granted_memory_size == 0);
+
+    // 3 |           0           |           1           |           2           | 64 bytes per blocks
+    // 2 |     3     |     4     |     5     |     6     |     7     |     8     | 32 bytes per blocks
+    // 1 |  9  | 10  | 11  | 12  | 13  | 14  | 15  | 16  | 17  | 18  | 19  | 20  | 16 bytes per blocks
+    // 0 |21|22|23|24|25|26|27|28|29|30|31|32|33|34|35|36|37|38|39|40|41|42|43|44| 8 bytes per blocks
+
+    // Block 0 is split down to order 0, then the buddy is taken by the fast path
+    assert(buddy_allocator_alloc(&allocator, 8) == (void*)(fake_area_start_addr + 0));
+    assert(buddy_allocator_alloc(&allocator, 8) == (void*)(fake_area_start_addr + 8));
+    // Block 10 is split
+    assert(buddy_allocator_alloc(&allocator, 5) == (void*)(fake_area_start_addr + 16));
+    assert(buddy_allocator_alloc(&allocator, 64) == (void*)(fake_area_start_addr + 64));
+    assert(buddy_allocator_alloc(&allocator, 64) == (void*)(fake_area_start_addr + 128));
+    assert(buddy_allocator_alloc(&allocator, 64) == NULL);
+    buddy_allocator_get_stats(&allocator, &stats);
+    assert(stats.fast_allocations[0] == 1 && stats.slow_allocations[0] == 2);
+    assert(stats.fast_allocations[3] == 2 && stats.slow_allocations[3] == 0);
+    assert(stats.failed_allocations[3] == 1);
+    assert(stats.splits[3] == 1 && stats.splits[2] == 1 && stats.splits[1] == 2 && stats.splits[0] == 0);
+    assert(stats.requested_memory_size == 8 + 8 + 5 + 64 + 64);
+    assert(stats.granted_memory_size == 8 + 8 + 8 + 64 + 64);
+
+    // Rejected frees, NULL is not counted
+    buddy_allocator_free(&allocator, NULL);
+    buddy_allocator_free(&allocator, (void*)(fake_area_start_addr - 8));
+    buddy_allocator_free(&allocator, (void*)(fake_area_start_addr + 24));
+    buddy_allocator_free(&allocator, (void*)(fake_area_start_addr + 72));
+    buddy_allocator_get_stats(&allocator, &stats);
+    assert(stats.rejected_frees == 3);
+
+    // Blocks 21 and 22 are merged, then block 23 is merged up to block 0
+    buddy_allocator_free(&allocator, (void*)(fake_area_start_addr + 0));
+    buddy_allocator_free(&allocator, (void*)(fake_area_start_addr + 8));
+    buddy_allocator_free(&allocator, (void*)(fake_area_start_addr + 16));
+    buddy_allocator_get_stats(&allocator, &stats);
+    assert(stats.merges[0] == 0 && stats.merges[1] == 2 && stats.merges[2] == 1 && stats.merges[3] == 1);
+
+    // Only 3 pages of the exact allocation are granted, the tail of the block is split off
+    buddy_allocator_reset_stats(&allocator);
+    assert(buddy_allocator_alloc_exact(&allocator, 24) == (void*)(fake_area_start_addr + 0));
+    buddy_allocator_get_stats(&allocator, &stats);
+    assert(stats.requested_memory_size == 24 && stats.granted_memory_size == 24);
+    assert(stats.splits[3] == 1 && stats.splits[2] == 1 && stats.splits[1] == 1);
+
+    // Bulk allocations and frees, block 1 is taken whole
+    buddy_allocator_reset_stats(&allocator);
+    buddy_allocator_free(&allocator, (void*)(fake_area_start_addr + 0));
+    buddy_allocator_free(&allocator, (void*)(fake_area_start_addr + 64));
+    void* blocks[8];
+    assert(buddy_allocator_alloc_bulk(&allocator, 0, 8, blocks) == 8);
+    buddy_allocator_get_stats(&allocator, &stats);
+    assert(stats.splits[3] == 1 && stats.splits[2] == 2 && stats.splits[1] == 4);
+    assert(stats.slow_allocations[0] == 8 && stats.fast_allocations[0] == 0);
+    assert(stats.requested_memory_size == 64 && stats.granted_memory_size == 64);
+    blocks[7] = (void*)(fake_area_start_addr + 72);
+    assert(buddy_allocator_free_bulk(&allocator, blocks, 8) == 7);
+    buddy_allocator_get_stats(&allocator, &stats);
+    assert(stats.rejected_frees == 1);
+    // The run is merged up to block 0, then the bulk blocks are merged before they are put to the free lists
+    assert(stats.merges[1] == 1 + 3 && stats.merges[2] == 1 + 1 && stats.merges[3] == 1);
+
+    // Range reservations split the blocks down to the reserved pages, blocks 0, 3, 4, 10 and 11 are split
+    memset(&allocator, 0, sizeof(buddy_allocator_t));
+    buddy_allocator_preinit_ex(&allocator, fake_area_start_addr, 192, max_order, 8, false, 0, &required_memory_size);
+    buddy_allocator_init(&allocator, required_memory);
+    assert(buddy_allocator_reserve_range(&allocator, (void*)(fake_area_start_addr + 16), 24));
+    buddy_allocator_get_stats(&allocator, &stats);
+    assert(stats.splits[3] == 1 && stats.splits[2] == 2 && stats.splits[1] == 2 && stats.splits[0] == 0);
+
+    // The per-CPU caches count cache hits by the CPU
+    buddy_allocator_pcp_t pcp;
+    size_t pcp_required_memory_size = 0;
+    memset(&allocator, 0, sizeof(buddy_allocator_t));
+    memset(&pcp, 0, sizeof(buddy_allocator_pcp_t));
+    buddy_allocator_preinit_ex(&allocator, fake_area_start_addr, 192, max_order, 8, false, 0, &required_memory_size);
+    buddy_allocator_pcp_preinit(&pcp, &allocator, 2, 1, 4, 2, &g_tests_lock_ops, &pcp_required_memory_size);
+    void* pcp_required_memory = malloc(pcp_required_memory_size);
+    assert(pcp_required_memory != NULL);
+    buddy_allocator_init(&allocator, required_memory);
+    buddy_allocator_pcp_init(&pcp, pcp_required_memory);
+    void* first_ptr = buddy_allocator_pcp_alloc(&pcp, 0, 8);
+    void* second_ptr = buddy_allocator_pcp_alloc(&pcp, 0, 7);
+    void* third_ptr = buddy_allocator_pcp_alloc(&pcp, 1, 16);
+    assert(first_ptr != NULL && second_ptr != NULL && third_ptr != NULL);
+    buddy_allocator_pcp_get_stats(&pcp, &stats);
+    // The refill is counted by the CPU, its 2 blocks split from a large block are counted by the allocator
+    assert(stats.slow_allocations[0] == 1 + 2 && stats.fast_allocations[0] == 1);
+    assert(stats.splits[3] == 1 && stats.splits[2] == 1 && stats.splits[1] == 1);
+    // Order 1 is not cached, the block left by the refill is taken by the allocator
+    assert(stats.fast_allocations[1] == 1);
+    assert(stats.requested_memory_size == 8 + 7 + 16 && stats.granted_memory_size == 8 + 8 + 16);
+    buddy_allocator_pcp_free(&pcp, 1, (void*)(fake_area_start_addr - 8));
+    buddy_allocator_pcp_get_stats(&pcp, &stats);
+    assert(stats.rejected_frees == 1);
+    buddy_allocator_pcp_reset_stats(&pcp);
+    buddy_allocator_pcp_get_stats(&pcp, &stats);
+    assert(stats.slow_allocations[0] == 0 && stats.fast_allocations[0] == 0 && stats.rejected_frees == 0);
+
+    free(pcp_required_memory);
+    free(required_memory);
+}
+#endif
+
+#ifdef BUDDY_ALLOCATOR_LATENCY
+/*
+ * Get number of calls counted in the histogram
+ */
+static uint64_t get_histogram_calls_number(uint64_t* histogram)
+{
+    uint64_t calls_number = 0;
+    for (size_t bucket = 0; bucket < BUDDY_ALLOCATOR_LATENCY_BUCKETS_NUMBER; ++bucket) {
+        calls_number += histogram[bucket];
+    }
+    return calls_number;
+}
+
+void tests_latency(void)
+{
+    buddy_allocator_t allocator;
+    uintptr_t fake_area_start_addr = 0x1000;
+    uint8_t max_order = 3;
+    size_t required_memory_size = 0;
+    memset(&allocator, 0, sizeof(buddy_allocator_t));
+    buddy_allocator_preinit_ex(&allocator, fake_area_start_addr, 192, max_order, 8, false, 0, &required_memory_size);
+    void* required_memory = malloc(required_memory_size);
+    buddy_allocator_latency_t* latency_ptr = malloc(sizeof(buddy_allocator_latency_t));
+    buddy_allocator_latency_t* snapshot_ptr = malloc(sizeof(buddy_allocator_latency_t));
+    assert(required_memory != NULL && latency_ptr != NULL && snapshot_ptr != NULL);
+    buddy_allocator_init(&allocator, required_memory);
+
+    // Calls are not timed until the histograms are attached
+    assert(buddy_allocator_alloc(&allocator, 64) == (void*)(fake_area_start_addr + 0));
+    buddy_allocator_get_latency(&allocator, snapshot_ptr);
+    assert(get_histogram_calls_number(snapshot_ptr->alloc_by_order[3]) == 0);
+    buddy_allocator_free(&allocator, (void*)(fake_area_start_addr + 0));
+
+    memset(latency_ptr, 0xFF, sizeof(buddy_allocator_latency_t));
+    buddy_allocator_attach_latency(&allocator, latency_ptr);
+    // Split from max order down to 0, then the buddy without splits
+    assert(buddy_allocator_alloc(&allocator, 8) == (void*)(fake_area_start_addr + 0));
+    assert(buddy_allocator_alloc(&allocator, 8) == (void*)(fake_area_start_addr + 8));
+    assert(buddy_allocator_alloc(&allocator, 128) == NULL);
+    // Failed allocations are counted too
+    assert(buddy_allocator_alloc(&allocator, 64) == (void*)(fake_area_start_addr + 64));
+    assert(buddy_allocator_alloc(&allocator, 64) == (void*)(fake_area_start_addr + 128));
+    assert(buddy_allocator_alloc(&allocator, 64) == NULL);
+    buddy_allocator_get_latency(&allocator, snapshot_ptr);
+    assert(get_histogram_calls_number(snapshot_ptr->alloc_by_order[0]) == 2);
+    assert(get_histogram_calls_number(snapshot_ptr->alloc_by_order[3]) == 3);
+    assert(get_histogram_calls_number(snapshot_ptr->alloc_by_splits[3]) == 1);
+    assert(get_histogram_calls_number(snapshot_ptr->alloc_by_splits[0]) == 4);
+
+    // The second free merges up to max order, rejected frees are not counted
+    buddy_allocator_free(&allocator, (void*)(fake_area_start_addr + 0));
+    buddy_allocator_free(&allocator, (void*)(fake_area_start_addr + 8));
+    buddy_allocator_free(&allocator, (void*)(fake_area_start_addr + 8));
+    buddy_allocator_get_latency(&allocator, snapshot_ptr);
+    assert(get_histogram_calls_number(snapshot_ptr->free_by_order[0]) == 2);
+    assert(get_histogram_calls_number(snapshot_ptr->free_by_merges[0]) == 1);
+    assert(get_histogram_calls_number(snapshot_ptr->free_by_merges[3]) == 1);
+
+    buddy_allocator_reset_latency(&allocator);
+    buddy_allocator_get_latency(&allocator, snapshot_ptr);
+    assert(get_histogram_calls_number(snapshot_ptr->alloc_by_order[0]) == 0);
+    assert(get_histogram_calls_number(snapshot_ptr->free_by_merges[3]) == 0);
+    free(required_memory);
+
+    // Coalescing of quicklisted blocks is counted as merges by the call which does it
+    memset(&allocator, 0, sizeof(buddy_allocator_t));
+    buddy_allocator_preinit_ex(&allocator, fake_area_start_addr, (BUDDY_ALLOCATOR_QUICKLIST_HIGH + 8) * 8, max_order, 8, false, BUDDY_ALLOCATOR_FLAG_QUICKLISTS, &required_memory_size);
+    required_memory = malloc(required_memory_size);
+    assert(required_memory != NULL);
+    buddy_allocator_init(&allocator, required_memory);
+    buddy_allocator_attach_latency(&allocator, latency_ptr);
+    for (size_t i = 0; i < BUDDY_ALLOCATOR_QUICKLIST_HIGH + 1; ++i) {
+        assert(buddy_allocator_alloc(&allocator, 8) == (void*)(fake_area_start_addr + i * 8));
+    }
+    for (size_t i = 0; i < BUDDY_ALLOCATOR_QUICKLIST_HIGH; ++i) {
+        buddy_allocator_free(&allocator, (void*)(fake_area_start_addr + i * 8));
+    }
+    // The quicklist is full, the oldest blocks merge into large blocks, 7 merges per large block
+    buddy_allocator_free(&allocator, (void*)(fake_area_start_addr + BUDDY_ALLOCATOR_QUICKLIST_HIGH * 8));
+    buddy_allocator_get_latency(&allocator, snapshot_ptr);
+    assert(get_histogram_calls_number(snapshot_ptr->free_by_merges[0]) == BUDDY_ALLOCATOR_QUICKLIST_HIGH);
+    assert(get_histogram_calls_number(snapshot_ptr->free_by_merges[BUDDY_ALLOCATOR_QUICKLIST_BATCH / 8 * 7]) == 1);
+    // The other blocks merge when the coalesced large blocks are taken, the last quicklisted block merges with its free buddies, 3 merges
+    for (size_t i = 0; i < BUDDY_ALLOCATOR_QUICKLIST_BATCH / 8; ++i) {
+        assert(buddy_allocator_alloc(&allocator, 64) != NULL);
+    }
+    buddy_allocator_reset_latency(&allocator);
+    assert(buddy_allocator_alloc(&allocator, 64) == (void*)(fake_area_start_addr + BUDDY_ALLOCATOR_QUICKLIST_HIGH * 8));
+    buddy_allocator_get_latency(&allocator, snapshot_ptr);
+    assert(get_histogram_calls_number(snapshot_ptr->alloc_by_splits[(BUDDY_ALLOCATOR_QUICKLIST_HIGH - BUDDY_ALLOCATOR_QUICKLIST_BATCH) / 8 * 7 + 3]) == 1);
+
+    free(snapshot_ptr);
+    free(latency_ptr);
+    free(required_memory);
+}
+#endif
+
+#ifdef BUDDY_ALLOCATOR_TRACE
+typedef struct {
+    uint8_t data[1024];
+    size_t size;
+} tests_trace_file_t;
+
+static bool tests_trace_write(void* context_ptr, const void* data_ptr, size_t size)
+{
+    tests_trace_file_t* file_ptr = context_ptr;
+    if (size > sizeof(file_ptr->data) - file_ptr->size) {
+        return false;
+    }
+    memcpy(file_ptr->data + file_ptr->size, data_ptr, size);
+    file_ptr->size += size;
+    return true;
+}
+
+static void check_trace_record(const buddy_allocator_trace_record_t* record_ptr, uint8_t operation, uint8_t order, uint64_t block_offset, uint32_t value)
+{
+    assert(record_ptr->operation == operation);
+    assert(record_ptr->order == order);
+    assert(record_ptr->block_offset == block_offset);
+    assert(record_ptr->value == value);
+    assert(record_ptr->source == 7);
+}
+
+void tests_trace(void)
+{
+    buddy_allocator_t allocator;
+    uintptr_t fake_area_start_addr = 0x1000;
+    uint8_t max_order = 3;
+    size_t required_memory_size = 0;
+    memset(&allocator, 0, sizeof(buddy_allocator_t));
+    buddy_allocator_preinit_ex(&allocator, fake_area_start_addr, 192, max_order, 8, false, 0, &required_memory_size);
+    void* required_memory = malloc(required_memory_size);
+    assert(required_memory != NULL);
+    buddy_allocator_init(&allocator, required_memory);
+
+    buddy_allocator_trace_t trace;
+    size_t trace_required_memory_size = 0;
+    buddy_allocator_trace_preinit(&trace, 3, &trace_required_memory_size);
+    assert(trace_required_memory_size == 0);
+    buddy_allocator_trace_preinit(&trace, 4, &trace_required_memory_size);
+    assert(trace_required_memory_size == 4 * sizeof(buddy_allocator_trace_record_t));
+    void* trace_required_memory = malloc(trace_required_memory_size);
+    assert(trace_required_memory != NULL);
+    buddy_allocator_trace_init(&trace, 7, trace_required_memory);
+
+    tests_trace_file_t* file_ptr = calloc(1, sizeof(tests_trace_file_t));
+    assert(file_ptr != NULL);
+    assert(buddy_allocator_trace_write_header(&allocator, tests_trace_write, file_ptr));
+    assert(file_ptr->size == sizeof(buddy_allocator_trace_header_t));
+    buddy_allocator_trace_header_t* header_ptr = (buddy_allocator_trace_header_t*)file_ptr->data;
+    assert(strcmp(header_ptr->magic, BUDDY_ALLOCATOR_TRACE_MAGIC) == 0);
+    assert(header_ptr->version == BUDDY_ALLOCATOR_TRACE_VERSION);
+    assert(header_ptr->record_size == sizeof(buddy_allocator_trace_record_t));
+    assert(header_ptr->area_start_addr == fake_area_start_addr && header_ptr->area_size == 192);
+    assert(header_ptr->page_size == 8 && header_ptr->max_order == max_order);
+    file_ptr->size = 0;
+
+    // Operations are not recorded until the ring is attached
+    assert(buddy_allocator_alloc(&allocator, 64) == (void*)(fake_area_start_addr + 0));
+    buddy_allocator_free(&allocator, (void*)(fake_area_start_addr + 0));
+    assert(buddy_allocator_trace_drain(&trace, tests_trace_write, file_ptr) == 0);
+
+    buddy_allocator_trace_attach(&allocator, &trace);
+    assert(buddy_allocator_alloc(&allocator, 8) == (void*)(fake_area_start_addr + 0));
+    assert(buddy_allocator_alloc(&allocator, 64) == (void*)(fake_area_start_addr + 64));
+    assert(buddy_allocator_alloc(&allocator, 64) == (void*)(fake_area_start_addr + 128));
+    assert(buddy_allocator_alloc(&allocator, 64) == NULL);
+    // Incorrect arguments are not recorded
+    assert(buddy_allocator_alloc(&allocator, 128) == NULL);
+    // The ring is full, the record is dropped, but the allocator works
+    buddy_allocator_free(&allocator, (void*)(fake_area_start_addr + 128));
+    assert(buddy_allocator_trace_get_dropped(&trace) == 1);
+
+    assert(buddy_allocator_trace_drain(&trace, tests_trace_write, file_ptr) == 5);
+    assert(file_ptr->size == 5 * sizeof(buddy_allocator_trace_record_t));
+    buddy_allocator_trace_record_t* records = (buddy_allocator_trace_record_t*)file_ptr->data;
+    check_trace_record(&records[0], BUDDY_ALLOCATOR_TRACE_DROPPED, 0, 0, 1);
+    check_trace_record(&records[1], BUDDY_ALLOCATOR_TRACE_ALLOC, 0, 0, BUDDY_ALLOCATOR_MIGRATE_UNMOVABLE);
+    check_trace_record(&records[2], BUDDY_ALLOCATOR_TRACE_ALLOC, 3, 64, BUDDY_ALLOCATOR_MIGRATE_UNMOVABLE);
+    check_trace_record(&records[3], BUDDY_ALLOCATOR_TRACE_ALLOC, 3, 128, BUDDY_ALLOCATOR_MIGRATE_UNMOVABLE);
+    check_trace_record(&records[4], BUDDY_ALLOCATOR_TRACE_ALLOC_FAILED, 3, 0, BUDDY_ALLOCATOR_MIGRATE_UNMOVABLE);
+    for (size_t i = 1; i < 5; ++i) {
+        assert(records[i].sequence_number == i - 1);
+    }
+    file_ptr->size = 0;
+
+    // The ring is reused after the drain, rejected frees are not recorded, drops are reported once
+    buddy_allocator_free(&allocator, (void*)(fake_area_start_addr + 64));
+    buddy_allocator_free(&allocator, (void*)(fake_area_start_addr + 64));
+    assert(buddy_allocator_alloc_exact(&allocator, 24) == (void*)(fake_area_start_addr + 32));
+    assert(buddy_allocator_reserve_range(&allocator, (void*)(fake_area_start_addr + 136), 16));
+    assert(buddy_allocator_free_range(&allocator, (void*)(fake_area_start_addr + 136), 16));
+    assert(buddy_allocator_trace_drain(&trace, tests_trace_write, file_ptr) == 4);
+    check_trace_record(&records[0], BUDDY_ALLOCATOR_TRACE_FREE, 3, 64, 0);
+    check_trace_record(&records[1], BUDDY_ALLOCATOR_TRACE_ALLOC_EXACT, 2, 32, 3);
+    check_trace_record(&records[2], BUDDY_ALLOCATOR_TRACE_RESERVE_RANGE, 0, 136, 2);
+    check_trace_record(&records[3], BUDDY_ALLOCATOR_TRACE_FREE_RANGE, 0, 136, 2);
+    assert(records[0].sequence_number == 4 && records[3].sequence_number == 7);
+    file_ptr->size = 0;
+
+    // A record per block of bulk operations
+    void* blocks[2];
+    assert(buddy_allocator_alloc_bulk(&allocator, 1, 2, blocks) == 2);
+    uint64_t first_block_offset = (uintptr_t)blocks[0] - fake_area_start_addr;
+    uint64_t second_block_offset = (uintptr_t)blocks[1] - fake_area_start_addr;
+    assert(first_block_offset < second_block_offset);
+    assert(buddy_allocator_free_bulk(&allocator, blocks, 2) == 2);
+    assert(buddy_allocator_trace_drain(&trace, tests_trace_write, file_ptr) == 4);
+    check_trace_record(&records[0], BUDDY_ALLOCATOR_TRACE_ALLOC, 1, first_block_offset, BUDDY_ALLOCATOR_MIGRATE_UNMOVABLE);
+    check_trace_record(&records[1], BUDDY_ALLOCATOR_TRACE_ALLOC, 1, second_block_offset, BUDDY_ALLOCATOR_MIGRATE_UNMOVABLE);
+    check_trace_record(&records[2], BUDDY_ALLOCATOR_TRACE_FREE, 1, first_block_offset, 0);
+    check_trace_record(&records[3], BUDDY_ALLOCATOR_TRACE_FREE, 1, second_block_offset, 0);
+
+    // Nothing is recorded after the ring is detached
+    buddy_allocator_trace_attach(&allocator, NULL);
+    assert(buddy_allocator_alloc(&allocator, 8) != NULL);
+    assert(buddy_allocator_trace_drain(&trace, tests_trace_write, file_ptr) == 0);
+    assert(buddy_allocator_trace_get_dropped(&trace) == 1);
+
+    free(file_ptr);
+    free(trace_required_memory);
+    free(required_memory);
+}
+#endif
+
+static tests_lock_t* get_shard_tests_lock(buddy_allocator_sharded_t* sharded_ptr, size_t shard_index)
+{
+    return (tests_lock_t*)(sharded_ptr->slots_memory_ptr + shard_index * sharded_ptr->slot_memory_size);
+}
+
+void tests_sharded(void)
+{
+    buddy_allocator_sharded_t sharded;
+    uintptr_t fake_area_start_addr = 0x1000;
+    uint8_t max_order = 2;
+    size_t required_memory_size = 0;
+
+    // 10 large blocks of 32 bytes, 4 shards
+    // Shards 0 - 2 have 2 large blocks, shard 3 has 4 large blocks
+    memset(&sharded, 0, sizeof(buddy_allocator_sharded_t));
+    // More shards than large blocks
+    buddy_allocator_sharded_preinit(&sharded, fake_area_start_addr, 320, max_order, 8, false, 0, 11, &g_tests_lock_ops, &required_memory_size);
+    assert(required_memory_size == 0);
+    buddy_allocator_sharded_preinit(&sharded, fake_area_start_addr, 320, max_order, 8, false, 0, 4, &g_tests_lock_ops, &required_memory_size);
+    assert(required_memory_size != 0);
+    void* required_memory = malloc(required_memory_size);
+    assert(required_memory != NULL);
+    buddy_allocator_sharded_init(&sharded, required_memory);
+    assert(sharded.shards[0].large_blocks_number == 2);
+    assert(sharded.shards[2].area_start_addr == fake_area_start_addr + 128);
+    assert(sharded.shards[3].large_blocks_number == 4);
+    assert(sharded.non_empty_shards_summary[0] == 0xF);
+
+    // Shard 0 is used until it is empty, then the next shard
+    assert(buddy_allocator_sharded_alloc(&sharded, 0, 32) == (void*)(fake_area_start_addr + 0));
+    assert(buddy_allocator_sharded_alloc(&sharded, 0, 32) == (void*)(fake_area_start_addr + 32));
+    assert(sharded.non_empty_shards_summary[0] == 0xE);
+    assert(buddy_allocator_sharded_alloc(&sharded, 0, 32) == (void*)(fake_area_start_addr + 64));
+    // 5 % 4, shard 1
+    assert(buddy_allocator_sharded_alloc(&sharded, 5, 8) == (void*)(fake_area_start_addr + 96));
+    assert(sharded.non_empty_shards_summary[0] == 0xE);
+    assert(buddy_allocator_sharded_alloc(&sharded, 3, 16) == (void*)(fake_area_start_addr + 192));
+    // Empty shard 0 was skipped without locking
+    assert(get_shard_tests_lock(&sharded, 0)->acquisitions_number == 2);
+    assert(get_shard_tests_lock(&sharded, 1)->acquisitions_number == 2);
+    assert(get_shard_tests_lock(&sharded, 2)->acquisitions_number == 0);
+    assert(get_shard_tests_lock(&sharded, 3)->acquisitions_number == 1);
+
+    // Only the owner shard is locked
+    buddy_allocator_sharded_free(&sharded, (void*)(fake_area_start_addr + 32));
+    assert(get_shard_tests_lock(&sharded, 0)->acquisitions_number == 3);
+    assert(get_shard_tests_lock(&sharded, 1)->acquisitions_number == 2);
+    assert(sharded.non_empty_shards_summary[0] == 0xF);
+    // The remainder of the last shard
+    buddy_allocator_sharded_free(&sharded, (void*)(fake_area_start_addr + 192));
+    assert(get_shard_tests_lock(&sharded, 3)->acquisitions_number == 2);
+    // Outside address
+    buddy_allocator_sharded_free(&sharded, (void*)(fake_area_start_addr + 320));
+    buddy_allocator_sharded_free(&sharded, (void*)(fake_area_start_addr + 0));
+    buddy_allocator_sharded_free(&sharded, (void*)(fake_area_start_addr + 64));
+    buddy_allocator_sharded_free(&sharded, (void*)(fake_area_start_addr + 96));
+    for (size_t i = 0; i < 4; ++i) {
+        assert(sharded.shards[i].free_blocks_lists[max_order].count == sharded.shards[i].large_blocks_number);
+    }
+
+    // Allocate everything, the scan wraps around from the last shard to the first one
+    for (size_t i = 0; i < 10; ++i) {
+        assert(buddy_allocator_sharded_alloc(&sharded, 3, 32) != NULL);
+    }
+    assert(sharded.non_empty_shards_summary[0] == 0);
+    assert(buddy_allocator_sharded_alloc(&sharded, 2, 8) == NULL);
+    buddy_allocator_sharded_free(&sharded, (void*)(fake_area_start_addr + 96));
+    assert(sharded.non_empty_shards_summary[0] == 0x2);
+    assert(buddy_allocator_sharded_alloc(&sharded, 2, 8) == (void*)(fake_area_start_addr + 96));
+
+    free(required_memory);
+}
+
+// TESTS_RANDOM STAFF
+enum ACTION {
+    ALLOCATE_RANDOM_BLOCKS,
+    FREE_RANDOM_BLOCKS,
+    CHECK_RANDOM_ALLOCATED_BLOCKS
+};
+
+uintptr_t g_area_start_addr = 0;
+
+size_t g_area_size_min = 8192; //16384
+size_t g_area_size_max = 16384; //32768
+// Random
+size_t g_area_size = 0;
+
+const uint8_t g_max_order_min = 2;
+const uint8_t g_max_order_max = 9;
+// Random
+uint8_t g_max_order = 0;
+
+uint32_t g_page_size = 8;
+//uint32_t g_page_size = 16;
+
+// number of elements = max_order_max + 1
+size_t g_block_sizes[] = { 8, 16, 32, 64, 128, 256, 512, 1024, 2048, 4096 };
+//size_t g_block_sizes[] = { 16, 32, 64, 128, 256, 512, 1024, 2048, 4096, 8192 };
+
+typedef struct {
+    dll_node_t dll_node;
+    void* block_ptr;
+    uint32_t block_size;
+} block_info_t;
+
+doubly_linked_list_t g_allocated_blocks_list;
+
+buddy_allocator_t g_allocator;
+
+static enum ACTION get_random_action()
+{
+    if (g_allocated_blocks_list.count == 0) {
+        return ALLOCATE_RANDOM_BLOCKS;
+    }
+    // 0-1 - allocate or free
+    // 2 - check
+    uint8_t af_or_c = rand() % 3;
+    if (af_or_c == 0 || af_or_c == 1) {
+        // Allocate or free
+        if (g_allocated_blocks_list.count == 0) {
+            return ALLOCATE_RANDOM_BLOCKS;
+        }
+        // Let's analyze the free blocks
+        // Allocator has free blocks?
+        bool allocator_has_free_blocks = g_allocator.free_orders_mask != 0;
+        if (allocator_has_free_blocks == false) {
+            return FREE_RANDOM_BLOCKS;
+        }
+        
+        // Allocate or free
+        // 0 - allocate
+        // 1 - free
+        uint8_t al_or_f = rand() % 2;
+        if (al_or_f == 0) {
+            return ALLOCATE_RANDOM_BLOCKS;
+        }
+        else {
+            return FREE_RANDOM_BLOCKS;
+        }
+    }
+    else {
+        return CHECK_RANDOM_ALLOCATED_BLOCKS;
+    }
+}
+
+void do_action_allocate();
+void do_action_free();
+void do_action_check();
+
+static void do_action()
+{
+    enum ACTION action = get_random_action();
+    switch (action)
+    {
+    case ALLOCATE_RANDOM_BLOCKS:
+        do_action_allocate();
+        break;
+    case FREE_RANDOM_BLOCKS:
+        do_action_free();
+        break;
+    case CHECK_RANDOM_ALLOCATED_BLOCKS:
+        do_action_check();
+        break;
+    default:
+        break;
+    }
+}
+
+void do_action_allocate()
+{
+    //[1 - 3]
+    uint8_t allocations_number = (1 + (rand() % 3));
+    //allocations_number = 1;
+    uint8_t successful_allocated_blocks_number = 0;
+
+    // Get max free order
+    int8_t max_free_order = -1;
+    for (int8_t j = g_max_order; j >= 0; --j) {
+        if (get_free_blocks_number(&g_allocator, (uint8_t)j) > 0) {
+            max_free_order = (uint8_t)j;
+            break;
+        }
+    }
+    assert(max_free_order >= 0);
+
+    // Try to allocate blocks
+    for (uint8_t i = 0; i < allocations_number; ++i) {
         // Try to allocate random block
         uint8_t random_free_order = rand() % (max_free_order + 1);
         size_t random_allocation_size = g_block_sizes[random_free_order];
         //printf("TRY ALLOCATE %u bytes: ", random_allocation_size);
-        void* allocated_block_ptr = buddy_allocator_alloc(&g_allocator, random_allocation_size);
+        // The type is ignored without BUDDY_ALLOCATOR_FLAG_MIGRATE_TYPES
+        void* allocated_block_ptr = buddy_allocator_alloc_typed(&g_allocator, random_allocation_size, rand() % BUDDY_ALLOCATOR_MIGRATE_TYPES_NUMBER);
         if (allocated_block_ptr == NULL) {
             // Failed to allocate blocks, try again with new size
             break;
@@ -651,7 +2364,7 @@ void do_action_free()
         // Check block memory
         for (uint32_t j = 0; j < block_info_ptr->block_size / sizeof(void*); j++) {
             void** block_mem_ptr = block_info_ptr->block_ptr;
-            block_mem_ptr[i] = block_info_ptr->block_ptr;
+            assert(block_mem_ptr[j] == block_info_ptr->block_ptr);
         }
 
         // Free block
@@ -685,7 +2398,7 @@ void do_action_check()
         // Check block memory
         for (uint32_t j = 0; j < block_info_ptr->block_size / sizeof(void*); j++) {
             void** block_mem_ptr = block_info_ptr->block_ptr;
-            block_mem_ptr[i] = block_info_ptr->block_ptr;
+            assert(block_mem_ptr[j] == block_info_ptr->block_ptr);
         }
     }
 }
@@ -733,7 +2446,7 @@ void tests_random()
 
         // Generate random area size
         g_area_size = g_area_size_min + (rand() % ((g_area_size_max + 1) - g_area_size_min));
-        printf("Random area size number: %u\n", g_area_size);
+        printf("Random area size number: %zu\n", g_area_size);
 
         // I want the first iterations to check the maximum and minimum max order
         if (k == 1) {
@@ -761,20 +2474,47 @@ void tests_random()
             memset(&g_allocated_blocks_list, 0, sizeof(doubly_linked_list_t));
             memset(&g_allocator, 0, sizeof(buddy_allocator_t));
             size_t required_memory_size = 0;
-            buddy_allocator_preinit(&g_allocator, g_area_start_addr, g_area_size, g_max_order, g_page_size, false, &required_memory_size);
+            // Nodes format is random too, the nodes can be placed in blocks only if they fit into a page
+            const uint32_t nodes_flags[] = { 0, BUDDY_ALLOCATOR_FLAG_COMPACT_NODES, BUDDY_ALLOCATOR_FLAG_IN_BLOCK_NODES };
+            uint32_t flags = nodes_flags[rand() % (g_page_size >= sizeof(dll_node_t) ? 3 : 2)];
+            if (rand() % 2) {
+                flags |= BUDDY_ALLOCATOR_FLAG_LAZY_INIT;
+            }
+            if (rand() % 2) {
+                flags |= BUDDY_ALLOCATOR_FLAG_MIGRATE_TYPES;
+            }
+            buddy_allocator_preinit_ex(&g_allocator, g_area_start_addr, g_area_size, g_max_order, g_page_size, rand() % 2, flags, &required_memory_size);
             required_memory_ptr = malloc(required_memory_size);
             assert(required_memory_ptr);
-            buddy_allocator_init(&g_allocator, required_memory_ptr);
+            if (rand() % 2) {
+                buddy_allocator_init(&g_allocator, required_memory_ptr);
+            }
+            else {
+                buddy_allocator_init_parallel(&g_allocator, required_memory_ptr, 1 + rand() % 8, tests_run_tasks, NULL);
+            }
             if (g_allocator.allocate_all_small_blocks) {
-                for (size_t i = 0; i < g_allocator.small_blocks_number; ++i) {
-                    buddy_allocator_free(&g_allocator, (void*)(g_area_start_addr + i * g_page_size));
+                // The area is freed by ranges of random sizes, the result must be the same as freeing page by page
+                size_t page_index = 0;
+                while (page_index < g_allocator.small_blocks_number) {
+                    size_t pages_number = 1 + rand() % (g_allocator.small_blocks_number - page_index);
+                    assert(buddy_allocator_free_range(&g_allocator, (void*)(g_area_start_addr + page_index * g_page_size), pages_number * g_page_size));
+                    page_index += pages_number;
                 }
+                assert(get_free_blocks_number(&g_allocator, g_max_order) == g_allocator.large_blocks_number);
             }
 
             uint32_t rand_actions_number = rand() % 256;
             for (uint32_t i = 0; i < rand_actions_number; ++i) {
                 do_action();
             }
+            // The free space distribution matches the free memory counter
+            buddy_allocator_order_info_t orders_info[BUDDY_ALLOCATOR_MAX_ORDER_LIMIT + 1];
+            buddy_allocator_get_orders_info(&g_allocator, orders_info);
+            size_t free_memory_size = 0;
+            for (uint8_t order = 0; order <= g_max_order; ++order) {
+                free_memory_size += orders_info[order].free_memory_size;
+            }
+            assert(free_memory_size == g_allocator.free_memory_size);
             //printf("-end-free-\n");
             uint32_t allocated_blocks_count = g_allocated_blocks_list.count;
             for (uint32_t i = 0; i < allocated_blocks_count; ++i) {
@@ -792,3 +2532,232 @@ void tests_random()
         free((void*)g_area_start_addr);
     }
 }
+
+// STRESS STAFF
+// Unlike tests_random, the live blocks are kept in a flat array and a random one is removed by swapping with the last one,
+// and the pages of the live blocks are marked in a shadow bitmap, so each operation is O(1) (or O(pages / 64) for the bitmap),
+// and the allocator takes most of the time.
+#define STRESS_PAGE_SIZE 4096
+#define STRESS_MAX_ORDER 10
+// The consistency of the counters and the canaries of all live blocks are checked after each this number of operations
+#define STRESS_FULL_CHECK_PERIOD ((uint64_t)1 << 20)
+
+typedef struct {
+    void* block_ptr;
+    // The canary is written to the first and to the last word of the block
+    uint64_t canary;
+    uint32_t pages_number;
+} stress_block_t;
+
+static uint64_t g_stress_random_state = 0;
+
+/*
+ * splitmix64, the whole run is reproduced by the seed
+ */
+static uint64_t stress_random(void)
+{
+    uint64_t value = (g_stress_random_state += 0x9E3779B97F4A7C15);
+    value = (value ^ (value >> 30)) * 0xBF58476D1CE4E5B9;
+    value = (value ^ (value >> 27)) * 0x94D049BB133111EB;
+    return value ^ (value >> 31);
+}
+
+/*
+ * Marks the pages as allocated in the shadow bitmap, or clears them
+ * The pages must be free when they are marked and allocated when they are cleared, so overlapping blocks are detected
+ */
+static void stress_mark_pages(uint64_t* shadow_bitmap, size_t first_page_index, size_t pages_number, bool is_allocated)
+{
+    while (pages_number != 0) {
+        size_t bit_index = first_page_index % 64;
+        size_t bits_number = 64 - bit_index < pages_number ? 64 - bit_index : pages_number;
+        uint64_t mask = (bits_number == 64 ? ~(uint64_t)0 : (((uint64_t)1 << bits_number) - 1)) << bit_index;
+        uint64_t* word_ptr = &shadow_bitmap[first_page_index / 64];
+        if (is_allocated) {
+            assert((*word_ptr & mask) == 0);
+            *word_ptr |= mask;
+        }
+        else {
+            assert((*word_ptr & mask) == mask);
+            *word_ptr &= ~mask;
+        }
+        first_page_index += bits_number;
+        pages_number -= bits_number;
+    }
+}
+
+static void stress_write_canary(const stress_block_t* block_ptr)
+{
+    uint64_t* words = block_ptr->block_ptr;
+    size_t last_word_index = (size_t)block_ptr->pages_number * STRESS_PAGE_SIZE / sizeof(uint64_t) - 1;
+    words[0] = block_ptr->canary;
+    words[last_word_index] = ~block_ptr->canary;
+}
+
+static void stress_check_canary(const stress_block_t* block_ptr)
+{
+    uint64_t* words = block_ptr->block_ptr;
+    size_t last_word_index = (size_t)block_ptr->pages_number * STRESS_PAGE_SIZE / sizeof(uint64_t) - 1;
+    assert(words[0] == block_ptr->canary);
+    assert(words[last_word_index] == ~block_ptr->canary);
+}
+
+/*
+ * Checks the allocated block and adds it to the live blocks
+ * order the order of the block, the block is aligned to its size
+ */
+static void stress_add_block(buddy_allocator_t* allocator_ptr, stress_block_t* live_blocks, size_t* live_blocks_number_ptr, uint64_t* shadow_bitmap, void* memory_ptr, uint8_t order, size_t pages_number)
+{
+    uintptr_t offset = (uintptr_t)memory_ptr - allocator_ptr->area_start_addr;
+    assert((uintptr_t)memory_ptr >= allocator_ptr->area_start_addr && offset < allocator_ptr->area_size);
+    assert((offset & (((uintptr_t)STRESS_PAGE_SIZE << order) - 1)) == 0);
+    assert(offset + pages_number * STRESS_PAGE_SIZE <= allocator_ptr->area_size);
+    stress_mark_pages(shadow_bitmap, (size_t)(offset / STRESS_PAGE_SIZE), pages_number, true);
+
+    stress_block_t* block_ptr = &live_blocks[(*live_blocks_number_ptr)++];
+    block_ptr->block_ptr = memory_ptr;
+    block_ptr->canary = stress_random();
+    block_ptr->pages_number = (uint32_t)pages_number;
+    stress_write_canary(block_ptr);
+}
+
+/*
+ * Checks the consistency of the free memory counter, of the free space distribution and of the canaries of all live blocks
+ */
+static void stress_full_check(buddy_allocator_t* allocator_ptr, stress_block_t* live_blocks, size_t live_blocks_number)
+{
+    size_t live_memory_size = 0;
+    for (size_t i = 0; i < live_blocks_number; ++i) {
+        stress_check_canary(&live_blocks[i]);
+        live_memory_size += (size_t)live_blocks[i].pages_number * STRESS_PAGE_SIZE;
+    }
+    assert(allocator_ptr->free_memory_size + live_memory_size == allocator_ptr->area_size);
+
+    buddy_allocator_order_info_t orders_info[BUDDY_ALLOCATOR_MAX_ORDER_LIMIT + 1];
+    buddy_allocator_get_orders_info(allocator_ptr, orders_info);
+    size_t free_memory_size = 0;
+    for (uint8_t order = 0; order <= allocator_ptr->max_order; ++order) {
+        free_memory_size += orders_info[order].free_memory_size;
+    }
+    assert(free_memory_size == allocator_ptr->free_memory_size);
+}
+
+void tests_stress_run(uint64_t seed, uint64_t operations_number, size_t area_size)
+{
+    g_stress_random_state = seed;
+    printf("Stress seed: %llu, operations: %llu, area size: %zu\n", (unsigned long long)seed, (unsigned long long)operations_number, area_size);
+
+    // The configuration is random too, it is reproduced by the seed
+    uint8_t max_order = STRESS_MAX_ORDER;
+    while (max_order > 0 && ((size_t)STRESS_PAGE_SIZE << max_order) > area_size) {
+        max_order--;
+    }
+    const uint32_t nodes_flags[] = { 0, BUDDY_ALLOCATOR_FLAG_COMPACT_NODES, BUDDY_ALLOCATOR_FLAG_IN_BLOCK_NODES };
+    uint32_t flags = nodes_flags[stress_random() % 3];
+    flags |= (stress_random() % 2) ? BUDDY_ALLOCATOR_FLAG_LAZY_INIT : 0;
+    flags |= (stress_random() % 2) ? BUDDY_ALLOCATOR_FLAG_MIGRATE_TYPES : 0;
+    // Allocation policy: default, deferred coalescing or address-ordered
+    uint64_t policy = stress_random() % 3;
+    flags |= policy == 1 ? BUDDY_ALLOCATOR_FLAG_QUICKLISTS : (policy == 2 ? BUDDY_ALLOCATOR_FLAG_ADDRESS_ORDERED : 0);
+    if (policy == 2) {
+        // Migrate types can't be used with the address order
+        flags &= ~(uint32_t)BUDDY_ALLOCATOR_FLAG_MIGRATE_TYPES;
+    }
+    bool allocate_all_small_blocks = stress_random() % 2;
+    printf("Stress max order: %u, flags: 0x%x, allocate all small blocks: %u\n", max_order, flags, allocate_all_small_blocks);
+
+    // The area is real memory, the blocks are written, it is aligned to the page size
+    void* area_memory = malloc(area_size + STRESS_PAGE_SIZE);
+    assert(area_memory != NULL);
+    uintptr_t area_start_addr = ((uintptr_t)area_memory + STRESS_PAGE_SIZE - 1) & ~((uintptr_t)STRESS_PAGE_SIZE - 1);
+    buddy_allocator_t allocator;
+    size_t required_memory_size = 0;
+    memset(&allocator, 0, sizeof(buddy_allocator_t));
+    buddy_allocator_preinit_ex(&allocator, area_start_addr, area_size, max_order, STRESS_PAGE_SIZE, allocate_all_small_blocks, flags, &required_memory_size);
+    assert(required_memory_size != 0);
+    void* required_memory = malloc(required_memory_size);
+    stress_block_t* live_blocks = malloc(allocator.small_blocks_number * sizeof(stress_block_t));
+    uint64_t* shadow_bitmap = calloc(allocator.small_blocks_number / 64 + 1, sizeof(uint64_t));
+    assert(required_memory != NULL && live_blocks != NULL && shadow_bitmap != NULL);
+    buddy_allocator_init(&allocator, required_memory);
+    if (allocate_all_small_blocks) {
+        bool is_freed = buddy_allocator_free_range(&allocator, (void*)area_start_addr, allocator.area_size);
+        assert(is_freed);
+    }
+    assert(allocator.free_memory_size == allocator.area_size);
+
+    size_t live_blocks_number = 0;
+    uint64_t failed_allocations_number = 0;
+    clock_t start_clock = clock();
+    for (uint64_t operation = 1; operation <= operations_number; ++operation) {
+        uint64_t random = stress_random();
+        if (live_blocks_number == 0 || (random & 1) == 0) {
+            // The orders are geometric, order N is taken with probability 2^-(N + 1), the rest goes to the max order
+            uint8_t order = 0;
+            while (order < max_order && (random & ((uint64_t)2 << order)) != 0) {
+                order++;
+            }
+            void* memory_ptr = NULL;
+            size_t pages_number = (size_t)1 << order;
+            if (((random >> 16) & 15) == 0) {
+                // An exact allocation, its run is aligned to the block it is cut from
+                pages_number = 1 + (size_t)((random >> 20) % ((size_t)1 << order));
+                while (order > 0 && ((size_t)1 << (order - 1)) >= pages_number) {
+                    order--;
+                }
+                memory_ptr = buddy_allocator_alloc_exact(&allocator, pages_number * STRESS_PAGE_SIZE);
+            }
+            else {
+                memory_ptr = buddy_allocator_alloc_typed(&allocator, pages_number * STRESS_PAGE_SIZE, (uint8_t)((random >> 24) % BUDDY_ALLOCATOR_MIGRATE_TYPES_NUMBER));
+            }
+            if (memory_ptr == NULL) {
+                // Allocations fail only if there are no free blocks of the order or larger
+                assert((allocator.free_orders_mask >> order) == 0);
+                failed_allocations_number++;
+            }
+            else {
+                stress_add_block(&allocator, live_blocks, &live_blocks_number, shadow_bitmap, memory_ptr, order, pages_number);
+            }
+        }
+        else {
+            size_t live_block_index = (size_t)((random >> 1) % live_blocks_number);
+            stress_block_t* block_ptr = &live_blocks[live_block_index];
+            stress_check_canary(block_ptr);
+            size_t free_memory_size = allocator.free_memory_size;
+            buddy_allocator_free(&allocator, block_ptr->block_ptr);
+            assert(allocator.free_memory_size == free_memory_size + (size_t)block_ptr->pages_number * STRESS_PAGE_SIZE);
+            stress_mark_pages(shadow_bitmap, (size_t)(((uintptr_t)block_ptr->block_ptr - area_start_addr) / STRESS_PAGE_SIZE), block_ptr->pages_number, false);
+            *block_ptr = live_blocks[--live_blocks_number];
+        }
+        if (operation % STRESS_FULL_CHECK_PERIOD == 0) {
+            stress_full_check(&allocator, live_blocks, live_blocks_number);
+        }
+    }
+    stress_full_check(&allocator, live_blocks, live_blocks_number);
+
+    // Everything is merged back to the large blocks
+    while (live_blocks_number != 0) {
+        stress_block_t* block_ptr = &live_blocks[--live_blocks_number];
+        stress_check_canary(block_ptr);
+        buddy_allocator_free(&allocator, block_ptr->block_ptr);
+    }
+    assert(allocator.free_memory_size == allocator.area_size);
+    buddy_allocator_coalesce(&allocator);
+    assert(get_free_blocks_number(&allocator, max_order) == allocator.large_blocks_number);
+    assert(buddy_allocator_get_free_tail_size(&allocator) == allocator.area_size);
+
+    double seconds = (double)(clock() - start_clock) / CLOCKS_PER_SEC;
+    printf("Stress failed allocations: %llu, %.2f s, %.2f million operations per second\n", (unsigned long long)failed_allocations_number, seconds,
+        seconds > 0 ? (double)operations_number / seconds / 1000000.0 : 0.0);
+
+    free(shadow_bitmap);
+    free(live_blocks);
+    free(required_memory);
+    free(area_memory);
+}
+
+void tests_stress(void)
+{
+    // A short run with a new seed each time, the seed is printed, a failed run is repeated by "stress <seed>"
+    tests_stress_run((uint64_t)time(NULL), (uint64_t)1 << 22, (size_t)64 * 1024 * 1024);
+}
@@ -1,14 +1,64 @@
 #ifndef _TESTS_H_
 #define _TESTS_H_
 
+#include <stdint.h>
+#include <stddef.h>
+
 extern void tests_preinit(void);
 
 extern void tests_small_sizes_predetermined(void);
 
 extern void tests_small_sizes_predetermined2(void);
 
+extern void tests_compact_nodes(void);
+
+extern void tests_in_block_nodes(void);
+
 extern void tests_allocate_all_small_blocks(void);
 
+extern void tests_64_bit(void);
+
+extern void tests_bulk(void);
+
+extern void tests_alloc_exact(void);
+
+extern void tests_quicklists(void);
+
+extern void tests_address_ordered(void);
+
+extern void tests_free_range(void);
+
+extern void tests_lazy_init(void);
+
+extern void tests_migrate_types(void);
+
+extern void tests_fragmentation_info(void);
+
+extern void tests_init_parallel(void);
+
+extern void tests_pcp(void);
+#ifdef BUDDY_ALLOCATOR_STATS
+extern void tests_stats(void);
+#endif
+#ifdef BUDDY_ALLOCATOR_LATENCY
+extern void tests_latency(void);
+#endif
+#ifdef BUDDY_ALLOCATOR_TRACE
+extern void tests_trace(void);
+#endif
+
+extern void tests_sharded(void);
+
+extern void tests_zones(void);
+
 extern void tests_random(void);
 
+/*
+ * Randomized stress test, the configuration and the operations are random, the run is reproduced by the seed
+ * operations_number number of allocations and frees
+ * area_size size of the area, the area is real memory
+ */
+extern void tests_stress_run(uint64_t seed, uint64_t operations_number, size_t area_size);
+extern void tests_stress(void);
+
 #endif